@@ -1,9 +1,13 @@
 class FirstOrderFilter():
   # first order filter
   def __init__(self, x0, ts, dt):
-    self.k = (dt / ts) / (1. + dt / ts)
+    self.ts = ts
+    self.update_dt(dt)
     self.x = x0
 
+  def update_dt(self, dt):
+    self.k = (dt / self.ts) / (1. + dt / self.ts)
+
   def update(self, x):
     self.x = (1. - self.k) * self.x + self.k * x
     return self.x
@@ -65,6 +65,59 @@ Geodetic ecef2geodetic(ECEF e){
   return to_degrees({lat, lon, h});
 }
 
+void geodetic2ecef_batch(const double *geodetic, double *ecef, int n){
+  // Same as geodetic2ecef, with the constants loaded once and sin/cos of each angle computed once
+  const double a_ = a, esq_ = esq;
+
+  for (int i = 0; i < n; i++) {
+    const double *g = geodetic + 3 * i;
+    double lat = DEG2RAD(g[0]), lon = DEG2RAD(g[1]), alt = g[2];
+    double sin_lat = sin(lat), cos_lat = cos(lat);
+    double sin_lon = sin(lon), cos_lon = cos(lon);
+
+    double N = a_ / sqrt(1.0 - esq_ * sin_lat * sin_lat);
+    double *e = ecef + 3 * i;
+    e[0] = (N + alt) * cos_lat * cos_lon;
+    e[1] = (N + alt) * cos_lat * sin_lon;
+    e[2] = (N * (1.0 - esq_) + alt) * sin_lat;
+  }
+}
+
+void ecef2geodetic_batch(const double *ecef, double *geodetic, int n){
+  // Ferrari's solution as in ecef2geodetic, closed form with no iterations. The terms
+  // that don't depend on the point are computed once, powers are multiplications
+  const double a_ = a, esq_ = esq, e1sq_ = e1sq;
+  const double a2 = a * a, b2 = b * b;
+  const double Esq = a2 - b2;
+  const double esq2 = esq_ * esq_;
+
+  for (int i = 0; i < n; i++) {
+    const double *e = ecef + 3 * i;
+    double x = e[0], y = e[1], z = e[2];
+
+    double r2 = x * x + y * y;
+    double r = sqrt(r2);
+    double z2 = z * z;
+    double F = 54 * b2 * z2;
+    double G = r2 + (1 - esq_) * z2 - esq_ * Esq;
+    double C = (esq2 * F * r2) / (G * G * G);
+    double S = cbrt(1 + C + sqrt(C * C + 2 * C));
+    double k = S + 1 / S + 1;
+    double P = F / (3 * k * k * G * G);
+    double Q = sqrt(1 + 2 * esq2 * P);
+    double r_0 = -(P * esq_ * r) / (1 + Q) + sqrt(0.5 * a2 * (1 + 1.0 / Q) - P * (1 - esq_) * z2 / (Q * (1 + Q)) - 0.5 * P * r2);
+    double t = r - esq_ * r_0;
+    double U = sqrt(t * t + z2);
+    double V = sqrt(t * t + (1 - esq_) * z2);
+    double Z_0 = b2 * z / (a_ * V);
+
+    double *g = geodetic + 3 * i;
+    g[0] = RAD2DEG(atan((z + e1sq_ * Z_0) / r));
+    g[1] = RAD2DEG(atan2(y, x));
+    g[2] = U * (1 - b2 / (a_ * V));
+  }
+}
+
 LocalCoord::LocalCoord(Geodetic g, ECEF e){
   init_ecef <<  e.x, e.y, e.z;
 
@@ -102,3 +155,27 @@ Geodetic LocalCoord::ned2geodetic(NED n){
   ECEF e = ned2ecef(n);
   return ::ecef2geodetic(e);
 }
+
+void LocalCoord::ecef2ned_batch(const double *ecef, double *ned, int n) {
+  for (int i = 0; i < n; i++) {
+    Eigen::Vector3d e = Eigen::Map<const Eigen::Vector3d>(ecef + 3 * i) - init_ecef;
+    Eigen::Map<Eigen::Vector3d>(ned + 3 * i) = ecef2ned_matrix * e;
+  }
+}
+
+void LocalCoord::ned2ecef_batch(const double *ned, double *ecef, int n) {
+  for (int i = 0; i < n; i++) {
+    Eigen::Vector3d e = ned2ecef_matrix * Eigen::Map<const Eigen::Vector3d>(ned + 3 * i);
+    Eigen::Map<Eigen::Vector3d>(ecef + 3 * i) = e + init_ecef;
+  }
+}
+
+void LocalCoord::geodetic2ned_batch(const double *geodetic, double *ned, int n) {
+  ::geodetic2ecef_batch(geodetic, ned, n);
+  ecef2ned_batch(ned, ned, n);
+}
+
+void LocalCoord::ned2geodetic_batch(const double *ned, double *geodetic, int n) {
+  ned2ecef_batch(ned, geodetic, n);
+  ::ecef2geodetic_batch(geodetic, geodetic, n);
+}
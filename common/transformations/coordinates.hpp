@@ -19,6 +19,11 @@ struct Geodetic {
 ECEF geodetic2ecef(Geodetic g);
 Geodetic ecef2geodetic(ECEF e);
 
+// Batch versions, for n points stored contiguously as [x, y, z], [lat, lon, alt] or [n, e, d].
+// Geodetic coordinates are in degrees, input and output may be the same array.
+void geodetic2ecef_batch(const double *geodetic, double *ecef, int n);
+void ecef2geodetic_batch(const double *ecef, double *geodetic, int n);
+
 class LocalCoord {
 public:
   Eigen::Matrix3d ned2ecef_matrix;
@@ -32,4 +37,9 @@ public:
   ECEF ned2ecef(NED n);
   NED geodetic2ned(Geodetic g);
   Geodetic ned2geodetic(NED n);
+
+  void ecef2ned_batch(const double *ecef, double *ned, int n);
+  void ned2ecef_batch(const double *ned, double *ecef, int n);
+  void geodetic2ned_batch(const double *geodetic, double *ned, int n);
+  void ned2geodetic_batch(const double *ned, double *geodetic, int n);
 };
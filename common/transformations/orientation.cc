@@ -62,34 +62,46 @@ Eigen::Matrix3d rot(Eigen::Vector3d axis, double angle){
 }
 
 
-Eigen::Vector3d ecef_euler_from_ned(ECEF ecef_init, Eigen::Vector3d ned_pose) {
+// The north, east and down axes at ecef_init, in ECEF, as columns
+static Eigen::Matrix3d ned_axes(ECEF ecef_init) {
+  LocalCoord converter = LocalCoord(ecef_init);
+  Eigen::Vector3d zero = ecef_init.to_vector();
+
+  Eigen::Matrix3d axes;
+  axes.col(0) = converter.ned2ecef({1, 0, 0}).to_vector() - zero;
+  axes.col(1) = converter.ned2ecef({0, 1, 0}).to_vector() - zero;
+  axes.col(2) = converter.ned2ecef({0, 0, 1}).to_vector() - zero;
+  return axes;
+}
+
+// The euler angles in the "to" frame of a pose in the "from" frame, both frames given by their axes
+static Eigen::Vector3d euler_between_axes(const Eigen::Matrix3d &from, const Eigen::Matrix3d &to, Eigen::Vector3d pose) {
   /*
     Using Rotations to Build Aerospace Coordinate Systems
     Don Koks
     https://apps.dtic.mil/dtic/tr/fulltext/u2/a484864.pdf
   */
-  LocalCoord converter = LocalCoord(ecef_init);
-  Eigen::Vector3d zero = ecef_init.to_vector();
-
-  Eigen::Vector3d x0 = converter.ned2ecef({1, 0, 0}).to_vector() - zero;
-  Eigen::Vector3d y0 = converter.ned2ecef({0, 1, 0}).to_vector() - zero;
-  Eigen::Vector3d z0 = converter.ned2ecef({0, 0, 1}).to_vector() - zero;
+  Eigen::Vector3d x0 = from.col(0);
+  Eigen::Vector3d y0 = from.col(1);
+  Eigen::Vector3d z0 = from.col(2);
 
-  Eigen::Vector3d x1 = rot(z0, ned_pose(2)) * x0;
-  Eigen::Vector3d y1 = rot(z0, ned_pose(2)) * y0;
-  Eigen::Vector3d z1 = rot(z0, ned_pose(2)) * z0;
+  Eigen::Matrix3d r = rot(z0, pose(2));
+  Eigen::Vector3d x1 = r * x0;
+  Eigen::Vector3d y1 = r * y0;
+  Eigen::Vector3d z1 = r * z0;
 
-  Eigen::Vector3d x2 = rot(y1, ned_pose(1)) * x1;
-  Eigen::Vector3d y2 = rot(y1, ned_pose(1)) * y1;
-  Eigen::Vector3d z2 = rot(y1, ned_pose(1)) * z1;
+  r = rot(y1, pose(1));
+  Eigen::Vector3d x2 = r * x1;
+  Eigen::Vector3d y2 = r * y1;
+  Eigen::Vector3d z2 = r * z1;
 
-  Eigen::Vector3d x3 = rot(x2, ned_pose(0)) * x2;
-  Eigen::Vector3d y3 = rot(x2, ned_pose(0)) * y2;
+  r = rot(x2, pose(0));
+  Eigen::Vector3d x3 = r * x2;
+  Eigen::Vector3d y3 = r * y2;
 
-
-  x0 = Eigen::Vector3d(1, 0, 0);
-  y0 = Eigen::Vector3d(0, 1, 0);
-  z0 = Eigen::Vector3d(0, 0, 1);
+  x0 = to.col(0);
+  y0 = to.col(1);
+  z0 = to.col(2);
 
   double psi = atan2(x3.dot(y0), x3.dot(x0));
   double theta = atan2(-x3.dot(z0), sqrt(pow(x3.dot(x0), 2) + pow(x3.dot(y0), 2)));
@@ -102,43 +114,72 @@ Eigen::Vector3d ecef_euler_from_ned(ECEF ecef_init, Eigen::Vector3d ned_pose) {
   return {phi, theta, psi};
 }
 
+Eigen::Vector3d ecef_euler_from_ned(ECEF ecef_init, Eigen::Vector3d ned_pose) {
+  return euler_between_axes(ned_axes(ecef_init), Eigen::Matrix3d::Identity(), ned_pose);
+}
+
 Eigen::Vector3d ned_euler_from_ecef(ECEF ecef_init, Eigen::Vector3d ecef_pose){
-  /*
-    Using Rotations to Build Aerospace Coordinate Systems
-    Don Koks
-    https://apps.dtic.mil/dtic/tr/fulltext/u2/a484864.pdf
-  */
-  LocalCoord converter = LocalCoord(ecef_init);
+  return euler_between_axes(Eigen::Matrix3d::Identity(), ned_axes(ecef_init), ecef_pose);
+}
 
-  Eigen::Vector3d x0 = Eigen::Vector3d(1, 0, 0);
-  Eigen::Vector3d y0 = Eigen::Vector3d(0, 1, 0);
-  Eigen::Vector3d z0 = Eigen::Vector3d(0, 0, 1);
 
-  Eigen::Vector3d x1 = rot(z0, ecef_pose(2)) * x0;
-  Eigen::Vector3d y1 = rot(z0, ecef_pose(2)) * y0;
-  Eigen::Vector3d z1 = rot(z0, ecef_pose(2)) * z0;
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> RowMatrix3d;
 
-  Eigen::Vector3d x2 = rot(y1, ecef_pose(1)) * x1;
-  Eigen::Vector3d y2 = rot(y1, ecef_pose(1)) * y1;
-  Eigen::Vector3d z2 = rot(y1, ecef_pose(1)) * z1;
+void euler2quat_batch(const double *euler, double *quat, int n){
+  for (int i = 0; i < n; i++) {
+    Eigen::Quaterniond q = euler2quat(Eigen::Map<const Eigen::Vector3d>(euler + 3 * i));
+    Eigen::Map<Eigen::Vector4d>(quat + 4 * i) << q.w(), q.x(), q.y(), q.z();
+  }
+}
 
-  Eigen::Vector3d x3 = rot(x2, ecef_pose(0)) * x2;
-  Eigen::Vector3d y3 = rot(x2, ecef_pose(0)) * y2;
+void quat2euler_batch(const double *quat, double *euler, int n){
+  for (int i = 0; i < n; i++) {
+    const double *q = quat + 4 * i;
+    Eigen::Map<Eigen::Vector3d>(euler + 3 * i) = quat2euler(Eigen::Quaterniond(q[0], q[1], q[2], q[3]));
+  }
+}
 
-  Eigen::Vector3d zero = ecef_init.to_vector();
-  x0 = converter.ned2ecef({1, 0, 0}).to_vector() - zero;
-  y0 = converter.ned2ecef({0, 1, 0}).to_vector() - zero;
-  z0 = converter.ned2ecef({0, 0, 1}).to_vector() - zero;
+void quat2rot_batch(const double *quat, double *rot, int n){
+  for (int i = 0; i < n; i++) {
+    const double *q = quat + 4 * i;
+    Eigen::Map<RowMatrix3d>(rot + 9 * i) = quat2rot(Eigen::Quaterniond(q[0], q[1], q[2], q[3]));
+  }
+}
 
-  double psi = atan2(x3.dot(y0), x3.dot(x0));
-  double theta = atan2(-x3.dot(z0), sqrt(pow(x3.dot(x0), 2) + pow(x3.dot(y0), 2)));
+void rot2quat_batch(const double *rot, double *quat, int n){
+  for (int i = 0; i < n; i++) {
+    Eigen::Quaterniond q = rot2quat(Eigen::Map<const RowMatrix3d>(rot + 9 * i));
+    Eigen::Map<Eigen::Vector4d>(quat + 4 * i) << q.w(), q.x(), q.y(), q.z();
+  }
+}
 
-  y2 = rot(z0, psi) * y0;
-  z2 = rot(y2, theta) * z0;
+void euler2rot_batch(const double *euler, double *rot, int n){
+  for (int i = 0; i < n; i++) {
+    Eigen::Map<RowMatrix3d>(rot + 9 * i) = euler2rot(Eigen::Map<const Eigen::Vector3d>(euler + 3 * i));
+  }
+}
 
-  double phi = atan2(y3.dot(z2), y3.dot(y2));
+void rot2euler_batch(const double *rot, double *euler, int n){
+  for (int i = 0; i < n; i++) {
+    Eigen::Map<Eigen::Vector3d>(euler + 3 * i) = rot2euler(Eigen::Map<const RowMatrix3d>(rot + 9 * i));
+  }
+}
 
-  return {phi, theta, psi};
+void ecef_euler_from_ned_batch(ECEF ecef_init, const double *ned_pose, double *ecef_pose, int n){
+  // the NED axes are the same for every pose, find them once
+  Eigen::Matrix3d axes = ned_axes(ecef_init);
+  for (int i = 0; i < n; i++) {
+    Eigen::Vector3d pose = euler_between_axes(axes, Eigen::Matrix3d::Identity(), Eigen::Map<const Eigen::Vector3d>(ned_pose + 3 * i));
+    Eigen::Map<Eigen::Vector3d>(ecef_pose + 3 * i) = pose;
+  }
+}
+
+void ned_euler_from_ecef_batch(ECEF ecef_init, const double *ecef_pose, double *ned_pose, int n){
+  Eigen::Matrix3d axes = ned_axes(ecef_init);
+  for (int i = 0; i < n; i++) {
+    Eigen::Vector3d pose = euler_between_axes(Eigen::Matrix3d::Identity(), axes, Eigen::Map<const Eigen::Vector3d>(ecef_pose + 3 * i));
+    Eigen::Map<Eigen::Vector3d>(ned_pose + 3 * i) = pose;
+  }
 }
 
 
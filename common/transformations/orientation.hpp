@@ -15,3 +15,14 @@ Eigen::Matrix3d rot_matrix(double roll, double pitch, double yaw);
 Eigen::Matrix3d rot(Eigen::Vector3d axis, double angle);
 Eigen::Vector3d ecef_euler_from_ned(ECEF ecef_init, Eigen::Vector3d ned_pose);
 Eigen::Vector3d ned_euler_from_ecef(ECEF ecef_init, Eigen::Vector3d ecef_pose);
+
+// Batch versions, for n orientations stored contiguously: euler angles as [roll, pitch, yaw],
+// quaternions as [w, x, y, z] and rotation matrices row major
+void euler2quat_batch(const double *euler, double *quat, int n);
+void quat2euler_batch(const double *quat, double *euler, int n);
+void quat2rot_batch(const double *quat, double *rot, int n);
+void rot2quat_batch(const double *rot, double *quat, int n);
+void euler2rot_batch(const double *euler, double *rot, int n);
+void rot2euler_batch(const double *rot, double *euler, int n);
+void ecef_euler_from_ned_batch(ECEF ecef_init, const double *ned_pose, double *ecef_pose, int n);
+void ned_euler_from_ecef_batch(ECEF ecef_init, const double *ecef_pose, double *ned_pose, int n);
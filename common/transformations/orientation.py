@@ -1,46 +1,36 @@
 # pylint: skip-file
 import numpy as np
 
-from common.transformations.transformations import (ecef_euler_from_ned_single,
-                                                    euler2quat_single,
-                                                    euler2rot_single,
-                                                    ned_euler_from_ecef_single,
-                                                    quat2euler_single,
-                                                    quat2rot_single,
-                                                    rot2euler_single,
-                                                    rot2quat_single)
-
-
-def numpy_wrap(function, input_shape, output_shape):
-  """Wrap a function to take either an input or list of inputs and return the correct shape"""
+from common.transformations.transformations import (ecef_euler_from_ned_batch,
+                                                    euler2quat_batch,
+                                                    euler2rot_batch,
+                                                    ned_euler_from_ecef_batch,
+                                                    quat2euler_batch,
+                                                    quat2rot_batch,
+                                                    rot2euler_batch,
+                                                    rot2quat_batch)
+
+
+def numpy_batch_wrap(function, input_shape):
+  """Wrap a function that converts a whole (N,) + input_shape array in one call to also take a single input"""
   def f(*inps):
     *args, inp = inps
-    inp = np.array(inp)
-    shape = inp.shape
-
-    if len(shape) == len(input_shape):
-      out_shape = output_shape
-    else:
-      out_shape = (shape[0],) + output_shape
-
-    # Add empty dimension if inputs is not a list
-    if len(shape) == len(input_shape):
-      inp.shape = (1, ) + inp.shape
+    inp = np.asarray(inp, dtype=np.float64)
 
-    result = np.asarray([function(*args, i) for i in inp])
-    result.shape = out_shape
-    return result
+    if inp.ndim == len(input_shape):
+      return function(*args, inp.reshape((1,) + input_shape))[0]
+    return function(*args, inp)
   return f
 
 
-euler2quat = numpy_wrap(euler2quat_single, (3,), (4,))
-quat2euler = numpy_wrap(quat2euler_single, (4,), (3,))
-quat2rot = numpy_wrap(quat2rot_single, (4,), (3, 3))
-rot2quat = numpy_wrap(rot2quat_single, (3, 3), (4,))
-euler2rot = numpy_wrap(euler2rot_single, (3,), (3, 3))
-rot2euler = numpy_wrap(rot2euler_single, (3, 3), (3,))
-ecef_euler_from_ned = numpy_wrap(ecef_euler_from_ned_single, (3,), (3,))
-ned_euler_from_ecef = numpy_wrap(ned_euler_from_ecef_single, (3,), (3,))
+euler2quat = numpy_batch_wrap(euler2quat_batch, (3,))
+quat2euler = numpy_batch_wrap(quat2euler_batch, (4,))
+quat2rot = numpy_batch_wrap(quat2rot_batch, (4,))
+rot2quat = numpy_batch_wrap(rot2quat_batch, (3, 3))
+euler2rot = numpy_batch_wrap(euler2rot_batch, (3,))
+rot2euler = numpy_batch_wrap(rot2euler_batch, (3, 3))
+ecef_euler_from_ned = numpy_batch_wrap(ecef_euler_from_ned_batch, (3,))
+ned_euler_from_ecef = numpy_batch_wrap(ned_euler_from_ecef_batch, (3,))
 
 quats_from_rotations = rot2quat
 quat_from_rot = rot2quat
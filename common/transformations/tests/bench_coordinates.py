@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+# Points per second of the coordinate conversions, one call per point against one call per array
+import sys
+import time
+import numpy as np
+
+import common.transformations.transformations as transformations
+from common.transformations.coordinates import LocalCoord
+
+N = int(sys.argv[1]) if len(sys.argv) > 1 else 1000000
+SINGLE_N = min(N, 100000)
+
+
+def rate(f, arg, n):
+  t = time.monotonic()
+  f(arg)
+  return n / (time.monotonic() - t)
+
+
+if __name__ == "__main__":
+  np.random.seed(0)
+  geodetic = np.column_stack([np.random.uniform(-89, 89, N),
+                              np.random.uniform(-180, 180, N),
+                              np.random.uniform(-100, 5000, N)])
+  ecef = transformations.geodetic2ecef_batch(geodetic)
+  lc = LocalCoord.from_geodetic(geodetic[0])
+  ned = lc.ecef2ned_batch(ecef)
+
+  benches = [
+    ("geodetic2ecef", transformations.geodetic2ecef_single, transformations.geodetic2ecef_batch, geodetic),
+    ("ecef2geodetic", transformations.ecef2geodetic_single, transformations.ecef2geodetic_batch, ecef),
+    ("ecef2ned", lc.ecef2ned_single, lc.ecef2ned_batch, ecef),
+    ("ned2ecef", lc.ned2ecef_single, lc.ned2ecef_batch, ned),
+    ("geodetic2ned", lc.geodetic2ned_single, lc.geodetic2ned_batch, geodetic),
+    ("ned2geodetic", lc.ned2geodetic_single, lc.ned2geodetic_batch, ned),
+  ]
+
+  print(f"{N} points, single calls on {SINGLE_N}")
+  print(f"{'':16}{'single pts/s':>16}{'batch pts/s':>16}{'speedup':>10}")
+  for name, single, batch, pts in benches:
+    single_rate = rate(lambda p: [single(x) for x in p], pts[:SINGLE_N], SINGLE_N)
+    batch_rate = rate(batch, pts, N)
+    print(f"{name:16}{single_rate:16.3g}{batch_rate:16.3g}{batch_rate / single_rate:10.1f}")
@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+# Samples per second of the orientation conversions, one call per sample against one call per array
+import sys
+import time
+import numpy as np
+
+import common.transformations.transformations as transformations
+
+N = int(sys.argv[1]) if len(sys.argv) > 1 else 1000000
+SINGLE_N = min(N, 100000)
+ECEF_INIT = [-2711076.55270557, -4259167.14692758, 3884579.87669935]
+
+
+def rate(f, arg, n):
+  t = time.monotonic()
+  f(arg)
+  return n / (time.monotonic() - t)
+
+
+if __name__ == "__main__":
+  np.random.seed(0)
+  euler = np.random.uniform(-np.pi, np.pi, (N, 3))
+  quat = transformations.euler2quat_batch(euler)
+  rot = transformations.quat2rot_batch(quat)
+
+  t = transformations
+  benches = [
+    ("euler2quat", t.euler2quat_single, t.euler2quat_batch, euler),
+    ("quat2euler", t.quat2euler_single, t.quat2euler_batch, quat),
+    ("quat2rot", t.quat2rot_single, t.quat2rot_batch, quat),
+    ("rot2quat", t.rot2quat_single, t.rot2quat_batch, rot),
+    ("euler2rot", t.euler2rot_single, t.euler2rot_batch, euler),
+    ("rot2euler", t.rot2euler_single, t.rot2euler_batch, rot),
+    ("ned_euler_from_ecef", lambda e: t.ned_euler_from_ecef_single(ECEF_INIT, e),
+     lambda e: t.ned_euler_from_ecef_batch(ECEF_INIT, e), euler),
+    ("ecef_euler_from_ned", lambda e: t.ecef_euler_from_ned_single(ECEF_INIT, e),
+     lambda e: t.ecef_euler_from_ned_batch(ECEF_INIT, e), euler),
+  ]
+
+  print(f"{N} samples, single calls on {SINGLE_N}")
+  print(f"{'':22}{'single /s':>14}{'batch /s':>14}{'speedup':>10}")
+  for name, single, batch, samples in benches:
+    single_rate = rate(lambda s: [single(x) for x in s], samples[:SINGLE_N], SINGLE_N)
+    batch_rate = rate(batch, samples, N)
+    print(f"{name:22}{single_rate:14.3g}{batch_rate:14.3g}{batch_rate / single_rate:10.1f}")
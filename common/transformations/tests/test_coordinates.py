@@ -4,6 +4,7 @@ import numpy as np
 import unittest
 
 import common.transformations.coordinates as coord
+import common.transformations.transformations as transformations
 
 geodetic_positions = np.array([[37.7610403, -122.4778699, 115],
                                  [27.4840915, -68.5867592, 2380],
@@ -105,5 +106,39 @@ class TestNED(unittest.TestCase):
     np.testing.assert_allclose(converter.ned2ecef(ned_offsets_batch),
                                                            ecef_positions_offset_batch,
                                                            rtol=1e-9, atol=1e-7)
+
+  def test_batch_same_as_single(self):
+    np.random.seed(0)
+    geodetic = np.column_stack([np.random.uniform(-89, 89, 1000),
+                                np.random.uniform(-180, 180, 1000),
+                                np.random.uniform(-100, 5000, 1000)])
+    ecef = np.array([transformations.geodetic2ecef_single(g) for g in geodetic])
+    np.testing.assert_allclose(transformations.geodetic2ecef_batch(geodetic), ecef, rtol=1e-12, atol=1e-6)
+
+    geodetic_single = np.array([transformations.ecef2geodetic_single(e) for e in ecef])
+    geodetic_batch = transformations.ecef2geodetic_batch(ecef)
+    np.testing.assert_allclose(geodetic_batch[:, :2], geodetic_single[:, :2], rtol=1e-12, atol=1e-12)
+    np.testing.assert_allclose(geodetic_batch[:, 2], geodetic_single[:, 2], rtol=1e-9, atol=1e-6)
+
+    converter = coord.LocalCoord.from_geodetic(geodetic[0])
+    ned = np.random.uniform(-1000, 1000, (1000, 3))
+    np.testing.assert_allclose(converter.ned2ecef_batch(ned),
+                               [converter.ned2ecef_single(n) for n in ned], rtol=1e-15, atol=1e-8)
+    np.testing.assert_allclose(converter.ecef2ned_batch(ecef[:10]),
+                               [converter.ecef2ned_single(e) for e in ecef[:10]], rtol=1e-12, atol=1e-6)
+    np.testing.assert_allclose(converter.geodetic2ned_batch(geodetic),
+                               [converter.geodetic2ned_single(g) for g in geodetic], rtol=1e-12, atol=1e-6)
+    np.testing.assert_allclose(converter.ned2geodetic_batch(ned),
+                               [converter.ned2geodetic_single(n) for n in ned], rtol=1e-12, atol=1e-6)
+
+  def test_batch_shapes(self):
+    self.assertEqual(coord.geodetic2ecef(np.zeros((0, 3))).shape, (0, 3))
+    self.assertEqual(coord.geodetic2ecef(geodetic_positions[0].tolist()).shape, (3,))
+    # transposed input is copied, not misread
+    np.testing.assert_allclose(coord.geodetic2ecef(geodetic_positions.T.copy().T), ecef_positions, rtol=1e-9)
+    with self.assertRaises(ValueError):
+      transformations.geodetic2ecef_batch(np.zeros((5, 2)))
+
+
 if __name__ == "__main__":
   unittest.main()
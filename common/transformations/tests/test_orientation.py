@@ -6,6 +6,7 @@ import unittest
 from common.transformations.orientation import euler2quat, quat2euler, euler2rot, rot2euler, \
                                                rot2quat, quat2rot, \
                                                ned_euler_from_ecef
+import common.transformations.transformations as transformations
 
 eulers = np.array([[ 1.46520501,  2.78688383,  2.92780854],
        [ 4.86909526,  3.60618161,  4.30648981],
@@ -63,6 +64,39 @@ class TestOrientation(unittest.TestCase):
       #np.testing.assert_allclose(eulers[i], ecef_euler_from_ned(ecef_positions[i], ned_eulers[i]), rtol=1e-7)
     # np.testing.assert_allclose(ned_eulers, ned_euler_from_ecef(ecef_positions, eulers), rtol=1e-7)
 
+  def test_batch_same_as_single(self):
+    np.random.seed(0)
+    n = 1000
+    euler = np.random.uniform(-np.pi, np.pi, (n, 3))
+    quat = np.random.normal(size=(n, 4))
+    quat /= np.linalg.norm(quat, axis=1)[:, None]
+    rot = np.array([transformations.quat2rot_single(q) for q in quat])
+
+    pairs = [
+      (transformations.euler2quat_single, transformations.euler2quat_batch, euler),
+      (transformations.quat2euler_single, transformations.quat2euler_batch, quat),
+      (transformations.quat2rot_single, transformations.quat2rot_batch, quat),
+      (transformations.rot2quat_single, transformations.rot2quat_batch, rot),
+      (transformations.euler2rot_single, transformations.euler2rot_batch, euler),
+      (transformations.rot2euler_single, transformations.rot2euler_batch, rot),
+    ]
+    for single, batch, inp in pairs:
+      np.testing.assert_allclose(batch(inp), [single(i) for i in inp], rtol=0, atol=1e-12)
+
+    for ecef in ecef_positions:
+      np.testing.assert_allclose(transformations.ned_euler_from_ecef_batch(ecef, euler),
+                                 [transformations.ned_euler_from_ecef_single(ecef, e) for e in euler], rtol=0, atol=1e-12)
+      np.testing.assert_allclose(transformations.ecef_euler_from_ned_batch(ecef, euler),
+                                 [transformations.ecef_euler_from_ned_single(ecef, e) for e in euler], rtol=0, atol=1e-12)
+
+  def test_batch_shapes(self):
+    self.assertEqual(euler2quat(np.zeros((0, 3))).shape, (0, 4))
+    self.assertEqual(quat2rot(quats).shape, (len(quats), 3, 3))
+    self.assertEqual(quat2rot(quats[0]).shape, (3, 3))
+    self.assertEqual(rot2euler(quat2rot(quats[0])).shape, (3,))
+    with self.assertRaises(ValueError):
+      transformations.rot2quat_batch(np.zeros((5, 4)))
+
 
 if __name__ == "__main__":
   unittest.main()
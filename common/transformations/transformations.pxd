@@ -33,6 +33,15 @@ cdef extern from "orientation.hpp":
   Vector3 ecef_euler_from_ned(ECEF, Vector3)
   Vector3 ned_euler_from_ecef(ECEF, Vector3)
 
+  void euler2quat_batch_c "euler2quat_batch"(const double*, double*, int) nogil
+  void quat2euler_batch_c "quat2euler_batch"(const double*, double*, int) nogil
+  void quat2rot_batch_c "quat2rot_batch"(const double*, double*, int) nogil
+  void rot2quat_batch_c "rot2quat_batch"(const double*, double*, int) nogil
+  void euler2rot_batch_c "euler2rot_batch"(const double*, double*, int) nogil
+  void rot2euler_batch_c "rot2euler_batch"(const double*, double*, int) nogil
+  void ecef_euler_from_ned_batch_c "ecef_euler_from_ned_batch"(ECEF, const double*, double*, int) nogil
+  void ned_euler_from_ecef_batch_c "ned_euler_from_ecef_batch"(ECEF, const double*, double*, int) nogil
+
 
 cdef extern from "coordinates.cc":
   cdef struct ECEF:
@@ -54,6 +63,9 @@ cdef extern from "coordinates.cc":
   ECEF geodetic2ecef(Geodetic)
   Geodetic ecef2geodetic(ECEF)
 
+  void geodetic2ecef_batch_c "geodetic2ecef_batch"(const double*, double*, int) nogil
+  void ecef2geodetic_batch_c "ecef2geodetic_batch"(const double*, double*, int) nogil
+
   cdef cppclass LocalCoord_c "LocalCoord":
     Matrix3 ned2ecef_matrix
     Matrix3 ecef2ned_matrix
@@ -67,5 +79,10 @@ cdef extern from "coordinates.cc":
     NED geodetic2ned(Geodetic)
     Geodetic ned2geodetic(NED)
 
+    void ecef2ned_batch(const double*, double*, int) nogil
+    void ned2ecef_batch(const double*, double*, int) nogil
+    void geodetic2ned_batch(const double*, double*, int) nogil
+    void ned2geodetic_batch(const double*, double*, int) nogil
+
 cdef extern from "coordinates.hpp":
   pass
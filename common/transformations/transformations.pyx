@@ -12,6 +12,10 @@ from transformations cimport ecef_euler_from_ned as ecef_euler_from_ned_c
 from transformations cimport ned_euler_from_ecef as ned_euler_from_ecef_c
 from transformations cimport geodetic2ecef as geodetic2ecef_c
 from transformations cimport ecef2geodetic as ecef2geodetic_c
+from transformations cimport geodetic2ecef_batch_c, ecef2geodetic_batch_c
+from transformations cimport euler2quat_batch_c, quat2euler_batch_c, quat2rot_batch_c, rot2quat_batch_c
+from transformations cimport euler2rot_batch_c, rot2euler_batch_c
+from transformations cimport ecef_euler_from_ned_batch_c, ned_euler_from_ecef_batch_c
 from transformations cimport LocalCoord_c
 
 
@@ -52,6 +56,28 @@ cdef Geodetic list2geodetic(geodetic):
     g.alt = geodetic[2]
     return g
 
+ctypedef void (*batch_function)(const double*, double*, int) nogil
+
+cdef np.ndarray batch_array(a, tuple shape):
+    # An (N,) + shape C contiguous array of doubles, the same array when it already is one
+    cdef np.ndarray p = np.ascontiguousarray(a, dtype=np.double)
+    if np.shape(p)[1:] != shape or p.ndim != len(shape) + 1:
+        raise ValueError("expected an (N, %s) array, got shape %s" % (", ".join(map(str, shape)), np.shape(a)))
+    return p
+
+cdef double * data(np.ndarray a):
+    return <double*>np.PyArray_DATA(a)
+
+cdef np.ndarray run_batch(batch_function f, inp, tuple input_shape, tuple output_shape):
+    cdef np.ndarray i = batch_array(inp, input_shape)
+    cdef np.ndarray o = np.empty((i.shape[0],) + output_shape)
+    cdef double * i_ptr = data(i)
+    cdef double * o_ptr = data(o)
+    cdef int n = i.shape[0]
+    with nogil:
+        f(i_ptr, o_ptr, n)
+    return o
+
 def euler2quat_single(euler):
     cdef Vector3 e = Vector3(euler[0], euler[1], euler[2])
     cdef Quaternion q = euler2quat_c(e)
@@ -109,6 +135,52 @@ def ecef2geodetic_single(ecef):
     cdef Geodetic g = ecef2geodetic_c(e)
     return [g.lat, g.lon, g.alt]
 
+def geodetic2ecef_batch(geodetic):
+    return run_batch(geodetic2ecef_batch_c, geodetic, (3,), (3,))
+
+def ecef2geodetic_batch(ecef):
+    return run_batch(ecef2geodetic_batch_c, ecef, (3,), (3,))
+
+def euler2quat_batch(euler):
+    return run_batch(euler2quat_batch_c, euler, (3,), (4,))
+
+def quat2euler_batch(quat):
+    return run_batch(quat2euler_batch_c, quat, (4,), (3,))
+
+def quat2rot_batch(quat):
+    return run_batch(quat2rot_batch_c, quat, (4,), (3, 3))
+
+def rot2quat_batch(rot):
+    return run_batch(rot2quat_batch_c, rot, (3, 3), (4,))
+
+def euler2rot_batch(euler):
+    return run_batch(euler2rot_batch_c, euler, (3,), (3, 3))
+
+def rot2euler_batch(rot):
+    return run_batch(rot2euler_batch_c, rot, (3, 3), (3,))
+
+def ecef_euler_from_ned_batch(ecef_init, ned_pose):
+    cdef ECEF init = list2ecef(ecef_init)
+    cdef np.ndarray p = batch_array(ned_pose, (3,))
+    cdef np.ndarray e = np.empty_like(p)
+    cdef double * p_ptr = data(p)
+    cdef double * e_ptr = data(e)
+    cdef int n = p.shape[0]
+    with nogil:
+        ecef_euler_from_ned_batch_c(init, p_ptr, e_ptr, n)
+    return e
+
+def ned_euler_from_ecef_batch(ecef_init, ecef_pose):
+    cdef ECEF init = list2ecef(ecef_init)
+    cdef np.ndarray p = batch_array(ecef_pose, (3,))
+    cdef np.ndarray n = np.empty_like(p)
+    cdef double * p_ptr = data(p)
+    cdef double * n_ptr = data(n)
+    cdef int count = p.shape[0]
+    with nogil:
+        ned_euler_from_ecef_batch_c(init, p_ptr, n_ptr, count)
+    return n
+
 
 cdef class LocalCoord:
     cdef LocalCoord_c * lc
@@ -168,5 +240,49 @@ cdef class LocalCoord:
         cdef Geodetic g = self.lc.ned2geodetic(n)
         return [g.lat, g.lon, g.alt]
 
+    def ecef2ned_batch(self, ecef):
+        assert self.lc
+        cdef np.ndarray e = batch_array(ecef, (3,))
+        cdef np.ndarray n = np.empty_like(e)
+        cdef double * e_ptr = data(e)
+        cdef double * n_ptr = data(n)
+        cdef int count = e.shape[0]
+        with nogil:
+            self.lc.ecef2ned_batch(e_ptr, n_ptr, count)
+        return n
+
+    def ned2ecef_batch(self, ned):
+        assert self.lc
+        cdef np.ndarray n = batch_array(ned, (3,))
+        cdef np.ndarray e = np.empty_like(n)
+        cdef double * n_ptr = data(n)
+        cdef double * e_ptr = data(e)
+        cdef int count = n.shape[0]
+        with nogil:
+            self.lc.ned2ecef_batch(n_ptr, e_ptr, count)
+        return e
+
+    def geodetic2ned_batch(self, geodetic):
+        assert self.lc
+        cdef np.ndarray g = batch_array(geodetic, (3,))
+        cdef np.ndarray n = np.empty_like(g)
+        cdef double * g_ptr = data(g)
+        cdef double * n_ptr = data(n)
+        cdef int count = g.shape[0]
+        with nogil:
+            self.lc.geodetic2ned_batch(g_ptr, n_ptr, count)
+        return n
+
+    def ned2geodetic_batch(self, ned):
+        assert self.lc
+        cdef np.ndarray n = batch_array(ned, (3,))
+        cdef np.ndarray g = np.empty_like(n)
+        cdef double * n_ptr = data(n)
+        cdef double * g_ptr = data(g)
+        cdef int count = n.shape[0]
+        with nogil:
+            self.lc.ned2geodetic_batch(n_ptr, g_ptr, count)
+        return g
+
     def __dealloc__(self):
         del self.lc
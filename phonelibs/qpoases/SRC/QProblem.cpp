@@ -842,11 +842,12 @@ returnValue QProblem::solveInitialQP(	const real_t* const xOpt, const real_t* co
 
 	/* 3) Obtain linear independent working set for auxiliary QP. */
 
-	static Bounds auxiliaryBounds;
+	/* not static, the QProblems of different threads must not share it */
+	Bounds auxiliaryBounds;
 
 	auxiliaryBounds.init( nV );
 
-	static Constraints auxiliaryConstraints;
+	Constraints auxiliaryConstraints;
 
 	auxiliaryConstraints.init( nC );
 
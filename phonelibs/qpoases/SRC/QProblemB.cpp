@@ -867,7 +867,8 @@ returnValue QProblemB::solveInitialQP(	const real_t* const xOpt, const real_t* c
 
 	/* 3) Obtain linear independent working set for auxiliary QP. */
 
-	static Bounds auxiliaryBounds;
+	/* not static, the QProblems of different threads must not share it */
+	Bounds auxiliaryBounds;
 
 	auxiliaryBounds.init( nV );
 
@@ -1611,6 +1611,7 @@ int main(int argc, char *argv[]) {
   s->frame_size = s->cameras.rear.frame_size;
 
   init_buffers(s);
+  clu_print_stats("camerad");
 
 #if defined(QCOM) && !defined(QCOM_REPLAY)
   s->pm = new PubMaster({"frame", "frontFrame", "thumbnail"});
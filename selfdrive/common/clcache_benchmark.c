@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/timing.h"
+#include "clutil.h"
+
+// cold and warm build times of a set of programs through the cl cache
+// usage: clcache_benchmark <file.cl>[:<build args>]...
+// e.g. the modeld kernels from selfdrive/modeld:
+//   clcache_benchmark transforms/transform.cl "transforms/loadyuv.cl:-cl-fast-relaxed-math -DTRANSFORMED_WIDTH=512 -DTRANSFORMED_HEIGHT=256"
+
+static double build_all(cl_context ctx, cl_device_id device_id, int n, char **paths, char **args, double *times) {
+  double total = 0;
+  for (int i = 0; i < n; i++) {
+    double t1 = millis_since_boot();
+    cl_program prg = cl_cached_program_from_file(ctx, device_id, paths[i], args[i], NULL);
+    times[i] = millis_since_boot() - t1;
+    total += times[i];
+    clReleaseProgram(prg);
+  }
+  return total;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("usage: %s <file.cl>[:<build args>]...\n", argv[0]);
+    return 1;
+  }
+
+  int n = argc - 1;
+  char **paths = calloc(n, sizeof(char*));
+  char **args = calloc(n, sizeof(char*));
+  double *cold = calloc(n, sizeof(double));
+  double *warm = calloc(n, sizeof(double));
+  for (int i = 0; i < n; i++) {
+    paths[i] = strdup(argv[i+1]);
+    char *sep = strchr(paths[i], ':');
+    if (sep != NULL) *sep = '\0';
+    args[i] = sep != NULL ? sep+1 : "";
+  }
+
+  // start from an empty cache unless one was given
+  char tmp_dir[] = "/tmp/clcache_benchmark_XXXXXX";
+  if (getenv("CLCACHE_PATH") == NULL) {
+    if (mkdtemp(tmp_dir) == NULL) return 1;
+    setenv("CLCACHE_PATH", tmp_dir, 1);
+  }
+  clu_init();
+
+  cl_device_id device_id = cl_get_device_id(CL_DEVICE_TYPE_DEFAULT);
+  int err;
+  cl_context ctx = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+  cl_check_error(err);
+
+  double cold_total = build_all(ctx, device_id, n, paths, args, cold);
+  double warm_total = build_all(ctx, device_id, n, paths, args, warm);
+
+  printf("cache: %s\n", clu_cache_dir());
+  for (int i = 0; i < n; i++) {
+    printf("%-40s cold %8.2f ms  warm %8.2f ms\n", paths[i], cold[i], warm[i]);
+  }
+  printf("%-40s cold %8.2f ms  warm %8.2f ms\n", "total", cold_total, warm_total);
+  clu_print_stats("benchmark");
+
+  clReleaseContext(ctx);
+  return 0;
+}
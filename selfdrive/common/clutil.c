@@ -5,6 +5,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 
 #ifdef __APPLE__
@@ -14,6 +15,7 @@
 #endif
 
 #include "common/util.h"
+#include "common/timing.h"
 
 #include "clutil.h"
 
@@ -29,13 +31,41 @@ typedef struct CLUProgramIndex {
 static const CLUProgramIndex clu_index[] = {};
 #endif
 
+// bump when the cache key or file layout changes
+#define CLU_CACHE_VERSION 2
+
+#ifndef CLU_CACHE_DIR
+#if defined(QCOM) || defined(QCOM2)
+// survives reboots
+#define CLU_CACHE_DIR "/data/clcache"
+#else
+#define CLU_CACHE_DIR "/tmp/clcache"
+#endif
+#endif
+
+static CLUStats clu_stats;
+
+const char* clu_cache_dir(void) {
+  const char* dir = getenv("CLCACHE_PATH");
+  return (dir != NULL && dir[0] != '\0') ? dir : CLU_CACHE_DIR;
+}
+
 void clu_init(void) {
 #ifndef CLU_NO_SRC
-  mkdir("/tmp/clcache", 0777);
-  unlink("/tmp/clcache/index.cli");
+  // the cache and the index are kept across restarts, entries are keyed on the driver
+  mkdir(clu_cache_dir(), 0777);
 #endif
 }
 
+void clu_get_stats(CLUStats *stats) {
+  *stats = clu_stats;
+}
+
+void clu_print_stats(const char *name) {
+  printf("clcache %s: %d programs built in %.1f ms, %d loaded from %s in %.1f ms\n", name,
+         clu_stats.built, clu_stats.build_ms, clu_stats.loaded, clu_cache_dir(), clu_stats.load_ms);
+}
+
 cl_device_id cl_get_device_id(cl_device_type device_type) {
   bool opencl_platform_found = false;
   cl_device_id device_id = NULL;
@@ -190,11 +220,15 @@ uint64_t clu_fnv_hash(const uint8_t *data, size_t len) {
   return hval;
 }
 
+static void cache_path_for_hash(uint64_t hash, char *out, size_t out_size) {
+  snprintf(out, out_size, "%s/%016" PRIx64 ".clb", clu_cache_dir(), hash);
+}
+
 cl_program cl_cached_program_from_hash(cl_context ctx, cl_device_id device_id, uint64_t hash) {
-  int err;
+  int err, status = 0;
 
   char cache_path[1024];
-  snprintf(cache_path, sizeof(cache_path), "/tmp/clcache/%016" PRIx64 ".clb", hash);
+  cache_path_for_hash(hash, cache_path, sizeof(cache_path));
 
   size_t bin_size;
   uint8_t *bin = read_file(cache_path, &bin_size);
@@ -202,18 +236,41 @@ cl_program cl_cached_program_from_hash(cl_context ctx, cl_device_id device_id, u
     return NULL;
   }
 
-  cl_program prg = clCreateProgramWithBinary(ctx, 1, &device_id, &bin_size, (const uint8_t**)&bin, NULL, &err);
-  assert(err == 0);
-
+  cl_program prg = clCreateProgramWithBinary(ctx, 1, &device_id, &bin_size, (const uint8_t**)&bin, &status, &err);
   free(bin);
-
-  err = clBuildProgram(prg, 1, &device_id, NULL, NULL, NULL);
-  assert(err == 0);
+  if (err == 0 && status == 0) {
+    err = clBuildProgram(prg, 1, &device_id, NULL, NULL, NULL);
+  }
+  if (err != 0 || status != 0) {
+    // the driver rejected it, rebuild from source and replace it
+    printf("clcache: dropping bad entry %s: %s\n", cache_path, cl_get_error_string(err != 0 ? err : status));
+    if (prg != NULL) clReleaseProgram(prg);
+    unlink(cache_path);
+    return NULL;
+  }
 
   return prg;
 }
 
 #ifndef CLU_NO_CACHE
+// write to a temporary file and rename it into place, so concurrent readers
+// never see a partial entry
+static void write_file_atomic(const char *path, const uint8_t *data, size_t size) {
+  char tmp_path[1024];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, getpid());
+  FILE* of = fopen(tmp_path, "wb");
+  if (of == NULL) {
+    printf("clcache: couldn't open %s\n", tmp_path);
+    return;
+  }
+  bool ok = fwrite(data, 1, size, of) == size;
+  ok = (fclose(of) == 0) && ok;
+  if (!ok || rename(tmp_path, path) != 0) {
+    printf("clcache: couldn't write %s\n", path);
+    unlink(tmp_path);
+  }
+}
+
 static uint8_t* get_program_binary(cl_program prg, size_t *out_size) {
   int err;
 
@@ -251,21 +308,33 @@ cl_program cl_cached_program_from_string(cl_context ctx, cl_device_id device_id,
 
   const char* platform_version = get_version_string(platform);
 
-  const size_t hash_len = strlen(platform_version)+1+strlen(src)+1+strlen(args)+1;
+  // a driver or device change invalidates the binaries
+  char device_name[256] = {0}, device_version[256] = {0}, driver_version[256] = {0};
+  clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(device_name)-1, device_name, NULL);
+  clGetDeviceInfo(device_id, CL_DEVICE_VERSION, sizeof(device_version)-1, device_version, NULL);
+  clGetDeviceInfo(device_id, CL_DRIVER_VERSION, sizeof(driver_version)-1, driver_version, NULL);
+
+  const size_t hash_len = 16+strlen(platform_version)+1+strlen(device_name)+1+strlen(device_version)+1+
+                          strlen(driver_version)+1+strlen(src)+1+strlen(args)+1;
   char* hash_buf = malloc(hash_len);
   assert(hash_buf);
   memset(hash_buf, 0, hash_len);
-  snprintf(hash_buf, hash_len, "%s%c%s%c%s", platform_version, 1, src, 1, args);
+  snprintf(hash_buf, hash_len, "%d%c%s%c%s%c%s%c%s%c%s%c%s", CLU_CACHE_VERSION, 1, platform_version, 1,
+           device_name, 1, device_version, 1, driver_version, 1, src, 1, args);
   free((void*)platform_version);
 
   uint64_t hash = clu_fnv_hash((uint8_t*)hash_buf, hash_len);
   free(hash_buf);
 
+  double t1 = millis_since_boot();
   cl_program prg = NULL;
 #ifndef CLU_NO_CACHE
   prg = cl_cached_program_from_hash(ctx, device_id, hash);
 #endif
-  if (prg == NULL) {
+  if (prg != NULL) {
+    clu_stats.loaded++;
+    clu_stats.load_ms += millis_since_boot() - t1;
+  } else {
     prg = clCreateProgramWithSource(ctx, 1, (const char**)&src, NULL, &err);
     assert(err == 0);
 
@@ -282,14 +351,13 @@ cl_program cl_cached_program_from_string(cl_context ctx, cl_device_id device_id,
     uint8_t *binary_buf = get_program_binary(prg, &binary_size);
 
     char cache_path[1024];
-    snprintf(cache_path, sizeof(cache_path), "/tmp/clcache/%016" PRIx64 ".clb", hash);
-    FILE* of = fopen(cache_path, "wb");
-    assert(of);
-    fwrite(binary_buf, 1, binary_size, of);
-    fclose(of);
+    cache_path_for_hash(hash, cache_path, sizeof(cache_path));
+    write_file_atomic(cache_path, binary_buf, binary_size);
 
     free(binary_buf);
 #endif
+    clu_stats.built++;
+    clu_stats.build_ms += millis_since_boot() - t1;
   }
 
   if (out_hash) *out_hash = hash;
@@ -306,11 +374,79 @@ cl_program cl_cached_program_from_file(cl_context ctx, cl_device_id device_id, c
 }
 
 #ifndef CLU_NO_CACHE
+static bool index_has_src(const char *index, uint64_t src_hash) {
+  for (const char *l = index; *l != '\0';) {
+    uint64_t ih, sh;
+    if (sscanf(l, "%" SCNx64 " %" SCNx64, &ih, &sh) == 2 && sh == src_hash) return true;
+    const char *next = strchr(l, '\n');
+    if (next == NULL) break;
+    l = next + 1;
+  }
+  return false;
+}
+
 static void add_index(uint64_t index_hash, uint64_t src_hash) {
-  FILE *f = fopen("/tmp/clcache/index.cli", "a");
-  assert(f);
-  fprintf(f, "%016" PRIx64 " %016" PRIx64 "\n", index_hash, src_hash);
-  fclose(f);
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/index.cli", clu_cache_dir());
+
+  char line[64];
+  int len = snprintf(line, sizeof(line), "%016" PRIx64 " %016" PRIx64 "\n", index_hash, src_hash);
+
+  // the index persists now, don't add the same entry on every start
+  size_t index_len = 0;
+  char *index = read_file(path, &index_len);
+  if (index != NULL && strstr(index, line) != NULL) {
+    free(index);
+    return;
+  }
+
+  // an entry rebuilt for another driver or source replaces its old line, so the index
+  // doesn't grow with every update. The old binary goes too, unless another entry uses it
+  char *kept = calloc(index_len + len + 1, 1);
+  assert(kept);
+  uint64_t replaced[16];
+  int num_replaced = 0;
+  for (char *l = index; l != NULL && *l != '\0';) {
+    char *next = strchr(l, '\n');
+    next = next ? next + 1 : l + strlen(l);
+    uint64_t ih, sh;
+    if (sscanf(l, "%" SCNx64 " %" SCNx64, &ih, &sh) == 2) {
+      if (ih != index_hash) {
+        strncat(kept, l, next - l);
+      } else if (num_replaced < ARRAYSIZE(replaced)) {
+        replaced[num_replaced++] = sh;
+      }
+    }
+    l = next;
+  }
+  free(index);
+
+  if (num_replaced > 0) {
+    // rare, a line another process appends meanwhile is lost and added again on its next start
+    strcat(kept, line);
+    write_file_atomic(path, (const uint8_t*)kept, strlen(kept));
+    for (int i = 0; i < num_replaced; i++) {
+      if (replaced[i] != src_hash && !index_has_src(kept, replaced[i])) {
+        char cache_path[1024];
+        cache_path_for_hash(replaced[i], cache_path, sizeof(cache_path));
+        unlink(cache_path);
+      }
+    }
+    free(kept);
+    return;
+  }
+  free(kept);
+
+  // a single O_APPEND write of a line is atomic with other processes appending
+  int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+  if (fd < 0) {
+    printf("clcache: couldn't open %s\n", path);
+    return;
+  }
+  if (write(fd, line, len) != len) {
+    printf("clcache: couldn't write %s\n", path);
+  }
+  close(fd);
 }
 #endif
 
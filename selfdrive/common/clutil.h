@@ -17,6 +17,19 @@ extern "C" {
 
 void clu_init(void);
 
+// the program cache is in $CLCACHE_PATH, or CLU_CACHE_DIR if that's unset
+const char* clu_cache_dir(void);
+
+// program build times in this process
+typedef struct CLUStats {
+  int built;
+  double build_ms;
+  int loaded;
+  double load_ms;
+} CLUStats;
+void clu_get_stats(CLUStats *stats);
+void clu_print_stats(const char *name);
+
 cl_device_id cl_get_device_id(cl_device_type device_type);
 cl_program cl_create_program_from_file(cl_context ctx, const char* path);
 void cl_print_info(cl_platform_id platform, cl_device_id device);
@@ -2,6 +2,14 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#ifdef __linux__
+#include <linux/gpio.h>
+#endif
 
 // We assume that all pins have already been exported on boot,
 // and that we have permission to write to them.
@@ -73,3 +81,77 @@ cleanup:
   }
   return ret;
 }
+
+#ifdef __linux__
+
+int gpio_get_edge_fd(int chip_nr, int line_nr){
+  int ret = -1;
+  int fd = -1;
+
+  char chip_path[50];
+  int chip_path_len = snprintf(chip_path, sizeof(chip_path), "/dev/gpiochip%d", chip_nr);
+  if(chip_path_len <= 0){
+    goto cleanup;
+  }
+
+  fd = open(chip_path, O_RDONLY);
+  if(fd == -1){
+    goto cleanup;
+  }
+
+  struct gpioevent_request req;
+  memset(&req, 0, sizeof(req));
+  req.lineoffset = line_nr;
+  req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+  req.eventflags = GPIOEVENT_REQUEST_RISING_EDGE;
+  strncpy(req.consumer_label, "openpilot", sizeof(req.consumer_label) - 1);
+  if(ioctl(fd, GPIO_GET_LINEEVENT_IOCTL, &req) < 0){
+    goto cleanup;
+  }
+
+  ret = req.fd;
+  if(fcntl(ret, F_SETFL, fcntl(ret, F_GETFL) | O_NONBLOCK) < 0){
+    close(ret);
+    ret = -1;
+  }
+
+cleanup:
+  if(fd >= 0){
+    close(fd);
+  }
+  return ret;
+}
+
+static uint64_t clock_ns(clockid_t clock){
+  struct timespec t;
+  clock_gettime(clock, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+int gpio_read_edge(int fd, uint64_t *timestamp){
+  struct gpioevent_data event;
+  if(read(fd, &event, sizeof(event)) != sizeof(event)){
+    return -1;
+  }
+
+  // kernels before 5.7 stamp the edges with CLOCK_REALTIME, later ones with CLOCK_MONOTONIC
+  int64_t boottime = clock_ns(CLOCK_BOOTTIME);
+  int64_t realtime = clock_ns(CLOCK_REALTIME);
+  int64_t monotonic = clock_ns(CLOCK_MONOTONIC);
+  int64_t t = event.timestamp;
+  int64_t age = llabs(realtime - t) < llabs(monotonic - t) ? realtime - t : monotonic - t;
+  *timestamp = boottime - (age > 0 ? age : 0);
+  return 0;
+}
+
+#else
+
+int gpio_get_edge_fd(int chip_nr, int line_nr){
+  return -1;
+}
+
+int gpio_read_edge(int fd, uint64_t *timestamp){
+  return -1;
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define GPIO_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 // Pin definitions
 #ifdef QCOM2
@@ -28,6 +29,13 @@ extern "C" {
 int gpio_init(int pin_nr, bool output);
 int gpio_set(int pin_nr, bool high);
 
+// Requests the rising edges of line line_nr of /dev/gpiochip<chip_nr> as events. The returned
+// fd is nonblocking and readable when there is an edge to read with gpio_read_edge.
+int gpio_get_edge_fd(int chip_nr, int line_nr);
+// Reads one edge event. Returns 0 and the time of the edge in nanos_since_boot, -1 when
+// there is none.
+int gpio_read_edge(int fd, uint64_t *timestamp);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -54,6 +54,18 @@ fail:
   return ret;
 }
 
+int I2CBus::read_burst(uint8_t device_address, uint register_address, uint8_t *buffer, size_t len){
+  uint8_t reg = register_address;
+  struct i2c_msg msgs[2] = {
+    {device_address, 0, 1, &reg},
+    {device_address, I2C_M_RD, (uint16_t)len, buffer},
+  };
+  struct i2c_rdwr_ioctl_data data = {msgs, 2};
+
+  int ret = ioctl(i2c_fd, I2C_RDWR, &data);
+  return ret < 0 ? ret : len;
+}
+
 #else
 
 I2CBus::I2CBus(uint8_t bus_id){
@@ -77,4 +89,12 @@ int I2CBus::set_register(uint8_t device_address, uint register_address, uint8_t
   UNUSED(data);
   return -1;
 }
+
+int I2CBus::read_burst(uint8_t device_address, uint register_address, uint8_t *buffer, size_t len){
+  UNUSED(device_address);
+  UNUSED(register_address);
+  UNUSED(buffer);
+  UNUSED(len);
+  return -1;
+}
 #endif
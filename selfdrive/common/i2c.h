@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -7,10 +8,17 @@ class I2CBus {
   private:
     int i2c_fd;
 
+  protected:
+    // for buses without a device, see EmulatedI2CBus in sensord
+    I2CBus() : i2c_fd(-1) {}
+
   public:
     I2CBus(uint8_t bus_id);
-    ~I2CBus();
+    virtual ~I2CBus();
 
-    int read_register(uint8_t device_address, uint register_address, uint8_t *buffer, uint8_t len);
-    int set_register(uint8_t device_address, uint register_address, uint8_t data);
+    virtual int read_register(uint8_t device_address, uint register_address, uint8_t *buffer, uint8_t len);
+    virtual int set_register(uint8_t device_address, uint register_address, uint8_t data);
+    // Writes the register address and reads len bytes in one I2C_RDWR transfer. Unlike
+    // read_register it isn't limited to the 32 bytes of an SMBus block, for draining FIFOs.
+    virtual int read_burst(uint8_t device_address, uint register_address, uint8_t *buffer, size_t len);
 };
@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "common/timing.h"
+
+#include "cluster_engine.h"
+
+extern "C" {
+#include "fastcluster.h"
+}
+
+// Time per frame of cluster_points_centroid and ClusterEngine for 16 to 256 radar points,
+// in a scene of cars with a few points each, spread over the road. Moving: every point
+// moves every frame. Stopped: the scene doesn't move, most points repeat.
+//   ./bench_cluster_engine [frames]
+
+#define DIST (2.5 * 2.5)
+#define DT 0.05
+
+struct Target {
+  uint64_t id;
+  double d, y, v;
+};
+
+struct Scene {
+  std::mt19937 gen;
+  std::vector<Target> targets;
+  uint64_t next_id = 0;
+  size_t size;
+  bool moving;
+
+  Scene(size_t size, bool moving) : gen(size), size(size), moving(moving) {
+    while (targets.size() < size) add();
+  }
+
+  double uniform(double lo, double hi) {
+    return std::uniform_real_distribution<double>(lo, hi)(gen);
+  }
+
+  // a car, with up to 4 points on it
+  void add() {
+    double d = uniform(5, 150), y = uniform(-6, 6), v = uniform(-10, 5);
+    int points = 1 + gen() % 4;
+    for (int i = 0; i < points && targets.size() < size; i++) {
+      targets.push_back({next_id++, d + uniform(0, 1.5), y + uniform(-0.5, 0.5), v + uniform(-0.2, 0.2)});
+    }
+  }
+
+  void step(std::vector<uint64_t> &ids, std::vector<double> &pts) {
+    for (size_t i = 0; i < targets.size(); i++) {
+      // a point drops out now and then
+      if (uniform(0, 1) < 0.02) {
+        targets.erase(targets.begin() + i--);
+        continue;
+      }
+      if (moving) {
+        targets[i].d += targets[i].v * DT;
+        targets[i].v += uniform(-0.05, 0.05);
+      }
+    }
+    while (targets.size() < size) add();
+
+    ids.clear();
+    pts.clear();
+    for (const Target &t : targets) {
+      ids.push_back(t.id);
+      // like radard's keys, y weighs double
+      pts.insert(pts.end(), {t.d, t.y * 2, t.v});
+    }
+  }
+};
+
+int main(int argc, char *argv[]) {
+  const int frames = argc > 1 ? atoi(argv[1]) : 1000;
+  printf("%d frames\n", frames);
+  printf("%-8s %6s %16s %16s %8s %14s %14s\n", "scene", "points", "centroid us", "engine us", "speedup",
+         "solved/frame", "reused/frame");
+
+  bool same = true;
+  for (bool moving : {true, false}) {
+    for (int n = 16; n <= 256; n *= 2) {
+      Scene scene(n, moving);
+      ClusterEngine engine(3, DIST);
+      std::vector<uint64_t> ids;
+      std::vector<double> pts;
+      std::vector<int> expected(n), labels(n);
+      double centroid_us = 0, engine_us = 0;
+      long solved = 0, reused = 0;
+
+      for (int f = 0; f < frames; f++) {
+        scene.step(ids, pts);
+
+        uint64_t t = nanos_since_boot();
+        cluster_points_centroid(ids.size(), 3, pts.data(), DIST, expected.data());
+        centroid_us += (nanos_since_boot() - t) * 1e-3;
+
+        t = nanos_since_boot();
+        engine.update(ids.size(), ids.data(), pts.data(), labels.data());
+        engine_us += (nanos_since_boot() - t) * 1e-3;
+
+        solved += engine.solved;
+        reused += engine.reused;
+        same &= labels == expected;
+      }
+
+      printf("%-8s %6d %16.1f %16.1f %8.2f %14.1f %14.1f\n", moving ? "moving" : "stopped", n,
+             centroid_us / frames, engine_us / frames, centroid_us / engine_us,
+             (double)solved / frames, (double)reused / frames);
+    }
+  }
+
+  if (!same) {
+    printf("different clusters\n");
+  }
+  return same ? 0 : 1;
+}
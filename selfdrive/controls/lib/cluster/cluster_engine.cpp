@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+
+#include "cluster_engine.h"
+
+ClusterEngine::ClusterEngine(int m, double dist)
+  : m(m), dist(dist), cell_size(dist > 0 ? std::sqrt(dist) : 1.0) {}
+
+void ClusterEngine::Groups::clear() {
+  start.assign(1, 0);
+  hist_start.assign(1, 0);
+  members.clear();
+  clusters.clear();
+  hist.clear();
+}
+
+// Points closer than the cutoff are in the same or in neighboring cells
+int64_t ClusterEngine::cell_of(const double *p) const {
+  double c = std::floor(p[0] / cell_size);
+  // NaN ends up at the lower end, it's never close to anything anyway
+  if (!(c > -1e15)) c = -1e15;
+  if (!(c < 1e15)) c = 1e15;
+  return (int64_t)c;
+}
+
+double ClusterEngine::sqdist(const double *a, const double *b) const {
+  double d = 0;
+  for (int k = 0; k < m; k++) {
+    double error = a[k] - b[k];
+    d += error * error;
+  }
+  return d;
+}
+
+int ClusterEngine::find(std::vector<int> &parent, int i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+void ClusterEngine::move_points(int n, const uint64_t *ids, const double *pts) {
+  slots.resize(n);
+  for (int i = 0; i < n; i++) {
+    const double *p = &pts[i * m];
+    auto it = slot_of.find(ids[i]);
+    int s;
+    if (it == slot_of.end()) {
+      if (free_slots.empty()) {
+        s = points.size();
+        points.push_back({});
+        coords.resize(points.size() * m);
+      } else {
+        s = free_slots.back();
+        free_slots.pop_back();
+      }
+      slot_of[ids[i]] = s;
+      points[s] = {ids[i], cell_of(p), frame, i, true, -1, -1};
+      std::copy(p, p + m, &coords[s * m]);
+      grid.push_back(s);
+    } else {
+      s = it->second;
+      Point &pt = points[s];
+      pt.frame = frame;
+      pt.input = i;
+      pt.moved = !std::equal(p, p + m, &coords[s * m]);
+      if (pt.moved) {
+        std::copy(p, p + m, &coords[s * m]);
+        pt.cell = cell_of(p);
+      }
+    }
+    slots[i] = s;
+  }
+
+  // drop the points that are gone
+  if (slot_of.size() > (size_t)n) {
+    for (auto it = slot_of.begin(); it != slot_of.end();) {
+      if (points[it->second].frame != frame) {
+        free_slots.push_back(it->second);
+        it = slot_of.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  grid.erase(std::remove_if(grid.begin(), grid.end(), [&](int s) { return points[s].frame != frame; }), grid.end());
+
+  for (size_t a = 1; a < grid.size(); a++) {
+    int s = grid[a];
+    size_t b = a;
+    for (; b > 0 && points[grid[b - 1]].cell > points[s].cell; b--) {
+      grid[b] = grid[b - 1];
+    }
+    grid[b] = s;
+  }
+}
+
+// Points connected by pairs closer than the cutoff, groups of input indices
+void ClusterEngine::islands(int n, const double *pts) {
+  parent.resize(n);
+  std::iota(parent.begin(), parent.end(), 0);
+  for (size_t a = 0; a < grid.size(); a++) {
+    const Point &pa = points[grid[a]];
+    for (size_t b = a + 1; b < grid.size() && points[grid[b]].cell <= pa.cell + 1; b++) {
+      const Point &pb = points[grid[b]];
+      if (sqdist(&pts[pa.input * m], &pts[pb.input * m]) < dist) {
+        parent[find(parent, pa.input)] = find(parent, pb.input);
+      }
+    }
+  }
+
+  // numbered in order of their first point, with the points in order
+  group_of.assign(n, -1);
+  groups.clear();
+  int count = 0;
+  for (int i = 0; i < n; i++) {
+    int r = find(parent, i);
+    if (group_of[r] < 0) group_of[r] = count++;
+    group_of[i] = group_of[r];
+  }
+  groups.start.assign(count + 1, 0);
+  for (int i = 0; i < n; i++) groups.start[group_of[i] + 1]++;
+  for (int g = 0; g < count; g++) groups.start[g + 1] += groups.start[g];
+  groups.members.resize(n);
+  groups.clusters.resize(n);
+  key.assign(groups.start.begin(), groups.start.end() - 1);
+  for (int i = 0; i < n; i++) groups.members[key[group_of[i]]++] = i;
+}
+
+// The clusters of the group of the last frame with exactly these points, unmoved
+bool ClusterEngine::reuse(Groups &gs, int g) {
+  const int *members = &gs.members[gs.start[g]];
+  int pg = points[slots[members[0]]].prev_group;
+  if (pg < 0 || prev_groups.count(pg) != gs.count(g)) {
+    return false;
+  }
+  for (int u = 0; u < gs.count(g); u++) {
+    const Point &pt = points[slots[members[u]]];
+    if (pt.moved || pt.prev_group != pg) {
+      return false;
+    }
+  }
+
+  for (int u = 0; u < gs.count(g); u++) {
+    gs.clusters[gs.start[g] + u] = points[slots[members[u]]].prev_cluster;
+  }
+  gs.hist.insert(gs.hist.end(), &prev_groups.hist[prev_groups.hist_start[pg] * m],
+                 &prev_groups.hist[prev_groups.hist_start[pg + 1] * m]);
+  gs.hist_start.push_back(gs.hist.size() / m);
+  return true;
+}
+
+// Centroid linkage of the group's points, merging the closest pair of clusters for as
+// long as it is closer than the cutoff, like hclust_fast and cutree_cdist do. Pairs
+// closer than the cutoff wait in a heap until they are the closest.
+void ClusterEngine::agglomerate(Groups &gs, int g, const double *pts) {
+  const int *members = &gs.members[gs.start[g]];
+  const int k = gs.count(g);
+  const int total = 2 * k - 1;
+  cent.resize(total * m);
+  size.assign(total, 0);
+  up.assign(total, -1);
+  alive.assign(total, 0);
+  heap.clear();
+
+  auto add = [&](int c) {
+    for (int v = 0; v < c; v++) {
+      if (!alive[v]) continue;
+      double d = sqdist(&cent[c * m], &cent[v * m]);
+      if (d < dist) {
+        heap.push_back({d, v, c});
+        std::push_heap(heap.begin(), heap.end(), std::greater<Pair>());
+      }
+    }
+    alive[c] = 1;
+  };
+
+  for (int u = 0; u < k; u++) {
+    std::copy(&pts[members[u] * m], &pts[members[u] * m] + m, &cent[u * m]);
+    size[u] = 1;
+    add(u);
+  }
+
+  int count = k;
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<Pair>());
+    Pair p = heap.back();
+    heap.pop_back();
+    if (!alive[p.a] || !alive[p.b]) continue;
+
+    int c = count++;
+    size[c] = size[p.a] + size[p.b];
+    for (int i = 0; i < m; i++) {
+      cent[c * m + i] = (size[p.a] * cent[p.a * m + i] + size[p.b] * cent[p.b * m + i]) / size[c];
+    }
+    alive[p.a] = alive[p.b] = 0;
+    up[p.a] = up[p.b] = c;
+    add(c);
+  }
+
+  for (int u = 0; u < k; u++) {
+    int r = u;
+    while (up[r] >= 0) r = up[r];
+    gs.clusters[gs.start[g] + u] = r;
+  }
+  gs.hist.insert(gs.hist.end(), cent.begin(), cent.begin() + count * m);
+  gs.hist_start.push_back(gs.hist.size() / m);
+}
+
+// Joins groups when a cluster of one, at any point, was closer than the cutoff to a
+// cluster of another. They might not have been clustered on their own then. Points of
+// different groups are never that close, only the merged clusters need checking
+bool ClusterEngine::join_groups(const double *pts) {
+  const int count = groups.size();
+  entries.clear();
+  for (int g = 0; g < count; g++) {
+    for (int h = groups.hist_start[g] + groups.count(g); h < groups.hist_start[g + 1]; h++) {
+      entries.push_back({groups.hist[h * m], h, g});
+    }
+    for (int u = groups.start[g]; u < groups.start[g + 1]; u++) {
+      input_group[groups.members[u]] = g;
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.x < b.x; });
+
+  parent.resize(count);
+  std::iota(parent.begin(), parent.end(), 0);
+  bool any = false;
+  auto check = [&](int ga, int gb, const double *a, const double *b) {
+    if (ga != gb && find(parent, ga) != find(parent, gb) && sqdist(a, b) < dist) {
+      parent[find(parent, ga)] = find(parent, gb);
+      any = true;
+    }
+  };
+
+  for (size_t e = 0; e < entries.size(); e++) {
+    const double *a = &groups.hist[entries[e].h * m];
+
+    // the points in the same and the neighboring cells
+    int64_t cell = cell_of(a);
+    auto it = std::lower_bound(grid.begin(), grid.end(), cell - 1, [&](int s, int64_t c) { return points[s].cell < c; });
+    for (; it != grid.end() && points[*it].cell <= cell + 1; ++it) {
+      int i = points[*it].input;
+      check(entries[e].g, input_group[i], a, &pts[i * m]);
+    }
+
+    // the other merged clusters
+    for (size_t f = e + 1; f < entries.size() && entries[f].x - entries[e].x < cell_size; f++) {
+      check(entries[e].g, entries[f].g, a, &groups.hist[entries[f].h * m]);
+    }
+  }
+  if (!any) {
+    return false;
+  }
+
+  // the joined groups, in order of their first point
+  joined.clear();
+  group_of.assign(count, -1);
+  std::vector<int> order;
+  for (int g = 0; g < count; g++) {
+    int r = find(parent, g);
+    if (group_of[r] < 0) {
+      group_of[r] = order.size();
+      order.push_back(r);
+    }
+  }
+  for (int r : order) {
+    std::vector<int> parts;
+    for (int g = 0; g < count; g++) {
+      if (find(parent, g) == r) parts.push_back(g);
+    }
+
+    size_t first = joined.members.size();
+    for (int g : parts) {
+      joined.members.insert(joined.members.end(), &groups.members[groups.start[g]], &groups.members[groups.start[g + 1]]);
+      joined.clusters.insert(joined.clusters.end(), &groups.clusters[groups.start[g]], &groups.clusters[groups.start[g + 1]]);
+    }
+    joined.start.push_back(joined.members.size());
+
+    int j = joined.size() - 1;
+    if (parts.size() == 1) {
+      joined.hist.insert(joined.hist.end(), &groups.hist[groups.hist_start[parts[0]] * m],
+                         &groups.hist[groups.hist_start[parts[0] + 1] * m]);
+      joined.hist_start.push_back(joined.hist.size() / m);
+    } else {
+      std::sort(joined.members.begin() + first, joined.members.end());
+      if (reuse(joined, j)) {
+        reused++;
+      } else {
+        agglomerate(joined, j, pts);
+        solved++;
+      }
+    }
+  }
+  std::swap(groups, joined);
+  return true;
+}
+
+void ClusterEngine::update(int n, const uint64_t *ids, const double *pts, int *labels) {
+  frame++;
+  solved = reused = 0;
+  input_group.resize(n);
+
+  move_points(n, ids, pts);
+  islands(n, pts);
+  for (int g = 0; g < groups.size(); g++) {
+    if (reuse(groups, g)) {
+      reused++;
+    } else {
+      agglomerate(groups, g, pts);
+      solved++;
+    }
+  }
+  while (join_groups(pts)) {}
+
+  // labels in order of first appearance, like cutree_k
+  key.resize(n);
+  int offset = 0;
+  for (int g = 0; g < groups.size(); g++) {
+    for (int u = groups.start[g]; u < groups.start[g + 1]; u++) {
+      key[groups.members[u]] = offset + groups.clusters[u];
+    }
+    offset += 2 * groups.count(g) - 1;
+  }
+  root_label.assign(offset, -1);
+  int label = 0;
+  for (int i = 0; i < n; i++) {
+    if (root_label[key[i]] < 0) root_label[key[i]] = label++;
+    labels[i] = root_label[key[i]];
+  }
+
+  // keep the groups for the next frame
+  std::swap(prev_groups, groups);
+  for (int g = 0; g < prev_groups.size(); g++) {
+    for (int u = prev_groups.start[g]; u < prev_groups.start[g + 1]; u++) {
+      Point &pt = points[slots[prev_groups.members[u]]];
+      pt.prev_group = g;
+      pt.prev_cluster = prev_groups.clusters[u];
+    }
+  }
+}
+
+extern "C" {
+  ClusterEngine* cluster_engine_create(int m, double dist) {
+    return new ClusterEngine(m, dist);
+  }
+
+  void cluster_engine_destroy(ClusterEngine* engine) {
+    delete engine;
+  }
+
+  void cluster_engine_update(ClusterEngine* engine, int n, const uint64_t* ids, const double* pts, int* labels) {
+    engine->update(n, ids, pts, labels);
+  }
+}
@@ -0,0 +1,124 @@
+#ifndef cluster_engine_H
+#define cluster_engine_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+#include <unordered_map>
+#include <vector>
+
+//
+// Centroid linkage clustering of points that persist across frames, like radar tracks.
+// The labels of a frame are the ones cluster_points_centroid gives for its points.
+//
+// Points are kept by id, in a grid along the first dimension that is updated as they
+// move. Each frame, the points are split into islands: groups with no point closer
+// than the cutoff to another group. Each island is clustered on its own, and islands
+// are joined and clustered again when one of their intermediate clusters comes
+// closer than the cutoff to another island's. An island whose points are the same,
+// unmoved, as a group of the last frame keeps that group's clusters.
+//
+class ClusterEngine {
+public:
+  // m = dimension of the points, dist = squared cutoff distance
+  ClusterEngine(int m, double dist);
+
+  // Input arguments:
+  //   n   = number of points in this frame
+  //   ids = n ids, unique in the frame, of points that are kept from frame to frame
+  //   pts = n * m coordinates
+  // Output arguments:
+  //   labels = n cluster labels 0, ..., nclust-1, in order of first appearance
+  void update(int n, const uint64_t *ids, const double *pts, int *labels);
+
+  // groups of the last update that were clustered, and that were kept from the frame before
+  int solved = 0;
+  int reused = 0;
+
+private:
+  struct Point {
+    uint64_t id;
+    int64_t cell;
+    int frame;
+    int input;
+    bool moved;
+    // the group of the last frame, and the point's cluster in it
+    int prev_group;
+    int prev_cluster;
+  };
+
+  // Groups are stored flat: their members (input indices, ascending), the cluster of
+  // each member, and the centroids of all clusters the group went through
+  struct Groups {
+    std::vector<int> start, hist_start;
+    std::vector<int> members, clusters;
+    std::vector<double> hist;
+
+    void clear();
+    int size() const { return start.size() - 1; }
+    int count(int g) const { return start[g + 1] - start[g]; }
+  };
+
+  struct Entry {
+    double x;
+    int h, g;
+  };
+
+  struct Pair {
+    double d;
+    int a, b;
+    bool operator>(const Pair &o) const {
+      return d != o.d ? d > o.d : (a != o.a ? a > o.a : b > o.b);
+    }
+  };
+
+  int64_t cell_of(const double *p) const;
+  double sqdist(const double *a, const double *b) const;
+  static int find(std::vector<int> &parent, int i);
+
+  void move_points(int n, const uint64_t *ids, const double *pts);
+  void islands(int n, const double *pts);
+  bool join_groups(const double *pts);
+  bool reuse(Groups &gs, int g);
+  void agglomerate(Groups &gs, int g, const double *pts);
+
+  const int m;
+  const double dist;
+  const double cell_size;
+  int frame = 0;
+
+  std::vector<Point> points;
+  std::vector<double> coords;
+  std::vector<int> free_slots;
+  std::unordered_map<uint64_t, int> slot_of;
+  // the slots in order of their cell along the first dimension, points in the same
+  // or the next cell are neighbors. Points move little from frame to frame, an
+  // insertion sort keeps it in order
+  std::vector<int> grid;
+
+  Groups groups, prev_groups;
+
+  // scratch, kept to not allocate every frame
+  std::vector<int> slots, parent, group_of, input_group, key, root_label;
+  std::vector<double> cent;
+  std::vector<int> size, up;
+  std::vector<char> alive;
+  std::vector<Pair> heap;
+  std::vector<Entry> entries;
+  Groups joined;
+};
+
+extern "C" {
+#else
+typedef struct ClusterEngine ClusterEngine;
+#endif
+
+ClusterEngine* cluster_engine_create(int m, double dist);
+void cluster_engine_destroy(ClusterEngine* engine);
+void cluster_engine_update(ClusterEngine* engine, int n, const uint64_t* ids, const double* pts, int* labels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -13,6 +13,11 @@ int hclust_fast(int n, double* distmat, int method, int* merge, double* height);
 void cutree_cdist(int n, const int* merge, double* height, double cdist, int* labels);
 void hclust_pdist(int n, int m, double* pts, double* out);
 void cluster_points_centroid(int n, int m, double* pts, double dist, int* idx);
+
+typedef struct ClusterEngine ClusterEngine;
+ClusterEngine* cluster_engine_create(int m, double dist);
+void cluster_engine_destroy(ClusterEngine* engine);
+void cluster_engine_update(ClusterEngine* engine, int n, const uint64_t* ids, const double* pts, int* labels);
 """)
 
 hclust = ffi.dlopen(cluster_fn)
@@ -26,3 +31,22 @@ def cluster_points_centroid(pts, dist):
   labels_ptr = ffi.new("int[]", n)
   hclust.cluster_points_centroid(n, m, pts_ptr, dist**2, labels_ptr)
   return list(labels_ptr)
+
+
+class ClusterEngine():
+  """Gives the labels of cluster_points_centroid for points that persist from call
+  to call, keyed by id, and clusters again only what changed."""
+  def __init__(self, dist, m=3):
+    self.m = m
+    self.engine = ffi.gc(hclust.cluster_engine_create(m, dist**2), hclust.cluster_engine_destroy)
+
+  def update(self, ids, pts):
+    ids = np.ascontiguousarray(ids, dtype=np.uint64)
+    pts = np.ascontiguousarray(pts, dtype=np.float64).reshape(-1, self.m)
+    n = len(ids)
+    assert pts.shape[0] == n
+
+    labels_ptr = ffi.new("int[]", n)
+    hclust.cluster_engine_update(self.engine, n, ffi.cast("uint64_t *", ids.ctypes.data),
+                                 ffi.cast("double *", pts.ctypes.data), labels_ptr)
+    return list(labels_ptr)
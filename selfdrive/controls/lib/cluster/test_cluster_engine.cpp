@@ -0,0 +1,118 @@
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "cluster_engine.h"
+
+extern "C" {
+#include "fastcluster.h"
+}
+
+// Checks that ClusterEngine gives the labels of cluster_points_centroid, frame after
+// frame, as points come, go, move and stay.
+
+#define DIST (2.5 * 2.5)
+
+static std::vector<int> centroid_labels(const std::vector<double> &pts) {
+  int n = pts.size() / 3;
+  std::vector<int> idx(n, 0);
+  // cluster_points_centroid needs at least 2 points
+  if (n > 1) {
+    cluster_points_centroid(n, 3, (double *)pts.data(), DIST, idx.data());
+  }
+  return idx;
+}
+
+static void check(ClusterEngine &engine, const std::vector<uint64_t> &ids, const std::vector<double> &pts) {
+  std::vector<int> labels(ids.size());
+  engine.update(ids.size(), ids.data(), pts.data(), labels.data());
+  assert(labels == centroid_labels(pts));
+}
+
+int main(int argc, const char* argv[]) {
+  // the points of test.cpp
+  {
+    ClusterEngine engine(3, DIST);
+    std::vector<double> pts = {59.26000137, -9.35999966, -5.42500019,
+                               91.61999817, -0.31999999, -2.75,
+                               31.38000031, 0.40000001, -0.2,
+                               89.57999725, -8.07999992, -18.04999924,
+                               53.42000122, 0.63999999, -0.175,
+                               31.38000031, 0.47999999, -0.2,
+                               36.33999939, 0.16, -0.2,
+                               53.33999939, 0.95999998, -0.175,
+                               59.26000137, -9.76000023, -5.44999981,
+                               33.93999977, 0.40000001, -0.22499999,
+                               106.74000092, -5.76000023, -18.04999924};
+    std::vector<uint64_t> ids = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    std::vector<int> labels(ids.size());
+    engine.update(ids.size(), ids.data(), pts.data(), labels.data());
+    assert((labels == std::vector<int>{0, 1, 2, 3, 4, 2, 5, 4, 0, 5, 6}));
+
+    // unchanged, nothing to cluster again
+    engine.update(ids.size(), ids.data(), pts.data(), labels.data());
+    assert((labels == std::vector<int>{0, 1, 2, 3, 4, 2, 5, 4, 0, 5, 6}));
+    assert(engine.solved == 0 && engine.reused == 7);
+  }
+
+  // no closer than the cutoff to either point of a pair, but to its centroid
+  {
+    ClusterEngine engine(3, DIST);
+    std::vector<double> pts = {-1.2, 0, 0,  1.2, 0, 0,  0, 2.2, 0,  10, 0, 0};
+    std::vector<uint64_t> ids = {1, 2, 3, 4};
+    std::vector<int> labels(ids.size());
+    engine.update(ids.size(), ids.data(), pts.data(), labels.data());
+    assert((labels == std::vector<int>{0, 0, 0, 1}));
+    assert(labels == centroid_labels(pts));
+  }
+
+  // none and one point
+  {
+    ClusterEngine engine(3, DIST);
+    std::vector<uint64_t> ids = {7};
+    std::vector<double> pts = {1, 2, 3};
+    int label = -1;
+    engine.update(0, NULL, NULL, NULL);
+    engine.update(1, ids.data(), pts.data(), &label);
+    assert(label == 0);
+    engine.update(0, NULL, NULL, NULL);
+  }
+
+  // radar like frames, some points moving, some staying, some coming and going
+  std::mt19937 gen(1337);
+  std::uniform_real_distribution<double> u(0.0, 1.0);
+  int frames = 0;
+  for (int run = 0; run < 50; run++) {
+    ClusterEngine engine(3, DIST);
+    std::vector<uint64_t> ids;
+    std::vector<double> pts;
+    uint64_t next_id = 0;
+    int size = 2 + (int)(u(gen) * 62);
+
+    for (int f = 0; f < 100; f++, frames++) {
+      std::vector<uint64_t> new_ids;
+      std::vector<double> new_pts;
+      for (size_t i = 0; i < ids.size(); i++) {
+        if (u(gen) < 0.05) continue;  // gone
+        new_ids.push_back(ids[i]);
+        for (int k = 0; k < 3; k++) {
+          double p = pts[i * 3 + k];
+          new_pts.push_back(u(gen) < 0.3 ? p : p + (u(gen) - 0.5) * 0.5);
+        }
+      }
+      while (new_ids.size() < (size_t)size) {
+        new_ids.push_back(next_id++);
+        new_pts.push_back(-10 + 60 * u(gen));
+        new_pts.push_back(-5 + 10 * u(gen));
+        new_pts.push_back(-5 + 10 * u(gen));
+      }
+      ids.swap(new_ids);
+      pts.swap(new_pts);
+      check(engine, ids, pts);
+    }
+  }
+
+  printf("%d frames, same clusters\n", frames);
+  return 0;
+}
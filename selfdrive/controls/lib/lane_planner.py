@@ -47,10 +47,10 @@ def calc_d_poly(l_poly, r_poly, p_poly, l_prob, r_prob, lane_width, v_ego):
 
 class LanePlanner():
   def __init__(self):
-    self.l_poly = [0., 0., 0., 0.]
-    self.r_poly = [0., 0., 0., 0.]
-    self.p_poly = [0., 0., 0., 0.]
-    self.d_poly = [0., 0., 0., 0.]
+    self.l_poly = np.zeros(4)
+    self.r_poly = np.zeros(4)
+    self.p_poly = np.zeros(4)
+    self.d_poly = np.zeros(4)
 
     self.lane_width_estimate = 3.7
     self.lane_width_certainty = 1.0
@@ -2,6 +2,7 @@
 #include "acado_auxiliary_functions.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #define NX          ACADO_NX  /* Number of differential state variables.  */
 #define NXA         ACADO_NXA /* Number of algebraic variables. */
@@ -13,8 +14,63 @@
 
 #define N           ACADO_N   /* Number of intervals in the horizon. */
 
-ACADOvariables acadoVariables;
-ACADOworkspace acadoWorkspace;
+#define STEP        0.05      /* Length of the first intervals, seconds. */
+
+#include "../mpc_solve.h"
+
+// The state of one solver instance. The generated code reaches the variables and workspace
+// through acado_variables and acado_workspace, which are per thread: an mpc_* call points them
+// at its context, so instances don't share anything and can run on different threads at once.
+typedef struct mpc_context {
+  ACADOvariables variables;
+  ACADOworkspace workspace;
+  mpc_settings settings;
+  FILE *record;
+} mpc_context;
+
+__thread ACADOvariables *acado_variables;
+__thread ACADOworkspace *acado_workspace;
+
+// the instance of init() and run_mpc()
+static mpc_context default_context = {.settings = MPC_SETTINGS_DEFAULT};
+
+static void select_context(mpc_context *ctx){
+  acado_variables = &ctx->variables;
+  acado_workspace = &ctx->workspace;
+}
+
+mpc_context *mpc_create(void){
+  mpc_context *ctx = calloc(1, sizeof(mpc_context));
+  if (ctx != NULL){
+    ctx->settings = (mpc_settings)MPC_SETTINGS_DEFAULT;
+  }
+  return ctx;
+}
+
+void mpc_destroy(mpc_context *ctx){
+  if (ctx->record != NULL){
+    fclose(ctx->record);
+  }
+  free(ctx);
+}
+
+void mpc_set_budget(mpc_context *ctx, int max_iterations, double kkt_tolerance, double deadline_us){
+  ctx->settings.max_iterations = max_iterations;
+  ctx->settings.kkt_tolerance = kkt_tolerance;
+  ctx->settings.deadline_us = deadline_us;
+}
+
+void mpc_set_warm_start(mpc_context *ctx, double dt){
+  ctx->settings.shift = dt;
+}
+
+int mpc_start_recording(mpc_context *ctx, const char *path){
+  if (ctx->record != NULL){
+    fclose(ctx->record);
+  }
+  ctx->record = mpc_record_open(path, "lateral_mpc");
+  return ctx->record != NULL ? 0 : -1;
+}
 
 typedef struct {
   double x, y, psi, delta, t;
@@ -28,9 +84,14 @@ typedef struct {
   double delta[N+1];
   double rate[N];
   double cost;
+  // of the solve, see mpc_settings
+  int iterations;
+  int deadline_hit;
+  double kkt;
+  double solve_us;
 } log_t;
 
-void init_weights(double pathCost, double laneCost, double headingCost, double steerRateCost){
+static void set_weights(double pathCost, double laneCost, double headingCost, double steerRateCost){
   int    i;
   const int STEP_MULTIPLIER = 3;
 
@@ -52,7 +113,19 @@ void init_weights(double pathCost, double laneCost, double headingCost, double s
   acadoVariables.WN[(NYN+1)*3] = headingCost * STEP_MULTIPLIER;
 }
 
-void init(double pathCost, double laneCost, double headingCost, double steerRateCost){
+void mpc_init_weights(mpc_context *ctx, double pathCost, double laneCost, double headingCost, double steerRateCost){
+  select_context(ctx);
+  double args[] = {pathCost, laneCost, headingCost, steerRateCost};
+  mpc_record(ctx->record, "init_weights", args, 4);
+
+  set_weights(pathCost, laneCost, headingCost, steerRateCost);
+}
+
+void mpc_init(mpc_context *ctx, double pathCost, double laneCost, double headingCost, double steerRateCost){
+  select_context(ctx);
+  double args[] = {pathCost, laneCost, headingCost, steerRateCost};
+  mpc_record(ctx->record, "init", args, 4);
+
   acado_initializeSolver();
   int    i;
 
@@ -67,12 +140,21 @@ void init(double pathCost, double laneCost, double headingCost, double steerRate
   /* MPC: initialize the current state feedback. */
   for (i = 0; i < NX; ++i) acadoVariables.x0[ i ] = 0.0;
 
-  init_weights(pathCost, laneCost, headingCost, steerRateCost);
+  set_weights(pathCost, laneCost, headingCost, steerRateCost);
 }
 
-int run_mpc(state_t * x0, log_t * solution,
+int mpc_run(mpc_context *ctx, state_t * x0, log_t * solution,
              double l_poly[4], double r_poly[4], double d_poly[4],
              double l_prob, double r_prob, double curvature_factor, double v_ref, double lane_width){
+  select_context(ctx);
+  if (ctx->record != NULL){
+    double args[] = {x0->x, x0->y, x0->psi, x0->delta, x0->t,
+                     l_poly[0], l_poly[1], l_poly[2], l_poly[3],
+                     r_poly[0], r_poly[1], r_poly[2], r_poly[3],
+                     d_poly[0], d_poly[1], d_poly[2], d_poly[3],
+                     l_prob, r_prob, curvature_factor, v_ref, lane_width};
+    mpc_record(ctx->record, "run", args, 22);
+  }
 
   int    i;
 
@@ -108,8 +190,8 @@ int run_mpc(state_t * x0, log_t * solution,
   acadoVariables.x0[3] = x0->delta;
 
 
-  acado_preparationStep();
-  acado_feedbackStep();
+  mpc_stats stats;
+  mpc_solve(&ctx->settings, &stats);
 
   /* printf("lat its: %d\n", acado_getNWSR());  // n iterations
   printf("Objective: %.6f\n", acado_getObjective());  // solution cost */
@@ -124,11 +206,31 @@ int run_mpc(state_t * x0, log_t * solution,
     }
   }
   solution->cost = acado_getObjective();
-
-  // Dont shift states here. Current solution is closer to next timestep than if
-  // we use the old solution as a starting point
-  //acado_shiftStates(2, 0, 0);
-  //acado_shiftControls( 0 );
+  solution->iterations = stats.iterations;
+  solution->deadline_hit = stats.deadline_hit;
+  solution->kkt = stats.kkt;
+  solution->solve_us = stats.solve_us;
+
+  // Not acado_shiftStates(), it shifts by a node and the nodes are further apart than the
+  // time to the next solve. Without warm start the current solution is closer to the next
+  // timestep than a solution shifted by a node.
+  if (ctx->settings.shift > 0){
+    mpc_shift(ctx->settings.shift, STEP);
+  }
 
   return acado_getNWSR();
 }
+
+void init_weights(double pathCost, double laneCost, double headingCost, double steerRateCost){
+  mpc_init_weights(&default_context, pathCost, laneCost, headingCost, steerRateCost);
+}
+
+void init(double pathCost, double laneCost, double headingCost, double steerRateCost){
+  mpc_init(&default_context, pathCost, laneCost, headingCost, steerRateCost);
+}
+
+int run_mpc(state_t * x0, log_t * solution,
+             double l_poly[4], double r_poly[4], double d_poly[4],
+             double l_prob, double r_prob, double curvature_factor, double v_ref, double lane_width){
+  return mpc_run(&default_context, x0, solution, l_poly, r_poly, d_poly, l_prob, r_prob, curvature_factor, v_ref, lane_width);
+}
@@ -0,0 +1,125 @@
+# cython: language_level=3
+# cython: boundscheck=False, wraparound=False
+from cpython.mem cimport PyMem_Malloc, PyMem_Free
+cimport numpy as cnp
+import numpy as np
+
+cnp.import_array()
+
+cdef extern from "lateral_mpc.c" nogil:
+  ctypedef struct mpc_context:
+    pass
+
+  ctypedef struct state_t:
+    double x, y, psi, delta, t
+
+  ctypedef struct log_t:
+    double x[21]
+    double y[21]
+    double psi[21]
+    double delta[21]
+    double rate[20]
+    double cost
+    int iterations
+    int deadline_hit
+    double kkt
+    double solve_us
+
+  mpc_context *mpc_create()
+  void mpc_destroy(mpc_context *ctx)
+  void mpc_set_budget(mpc_context *ctx, int max_iterations, double kkt_tolerance, double deadline_us)
+  void mpc_set_warm_start(mpc_context *ctx, double dt)
+  int mpc_start_recording(mpc_context *ctx, const char *path)
+  void mpc_init(mpc_context *ctx, double pathCost, double laneCost, double headingCost, double steerRateCost)
+  void mpc_init_weights(mpc_context *ctx, double pathCost, double laneCost, double headingCost, double steerRateCost)
+  int mpc_run(mpc_context *ctx, state_t *x0, log_t *solution,
+              double l_poly[4], double r_poly[4], double d_poly[4],
+              double l_prob, double r_prob, double curvature_factor, double v_ref, double lane_width)
+
+state_dtype = np.dtype([('x', np.float64), ('y', np.float64), ('psi', np.float64), ('delta', np.float64),
+                        ('t', np.float64)], align=True)
+log_dtype = np.dtype([('x', np.float64, 21), ('y', np.float64, 21), ('psi', np.float64, 21),
+                      ('delta', np.float64, 21), ('rate', np.float64, 20), ('cost', np.float64),
+                      ('iterations', np.int32), ('deadline_hit', np.int32), ('kkt', np.float64),
+                      ('solve_us', np.float64)], align=True)
+assert state_dtype.itemsize == sizeof(state_t) and log_dtype.itemsize == sizeof(log_t)
+
+
+cdef class LateralMpc:
+  """n solvers, each with its own initial state and solution.
+
+  state and solution are structured arrays over the structs the solvers read and write,
+  so nothing is copied in or out: set state[i]['delta'] before run(), read
+  solution[i]['delta'] after. The same arrays are reused by every run(), state[i] and
+  solution[i] stay valid views of them.
+  """
+  cdef mpc_context **ctxs
+  cdef readonly int n
+  cdef readonly object state
+  cdef readonly object solution
+  # QP working set recalculations of the last run, per solver
+  cdef readonly object qp_iterations
+
+  def __cinit__(self, int n=1):
+    if n < 1:
+      raise ValueError("n must be at least 1")
+    self.ctxs = <mpc_context **>PyMem_Malloc(n * sizeof(mpc_context *))
+    if self.ctxs == NULL:
+      raise MemoryError()
+    self.n = 0
+    for i in range(n):
+      self.ctxs[i] = mpc_create()
+      if self.ctxs[i] == NULL:
+        raise MemoryError()
+      self.n += 1
+
+    self.state = np.zeros(n, dtype=state_dtype)
+    self.solution = np.zeros(n, dtype=log_dtype)
+    self.qp_iterations = np.zeros(n, dtype=np.int32)
+
+  def __dealloc__(self):
+    if self.ctxs != NULL:
+      for i in range(self.n):
+        mpc_destroy(self.ctxs[i])
+      PyMem_Free(self.ctxs)
+
+  def init(self, double path_cost, double lane_cost, double heading_cost, double steer_rate_cost):
+    for i in range(self.n):
+      mpc_init(self.ctxs[i], path_cost, lane_cost, heading_cost, steer_rate_cost)
+
+  def init_weights(self, double path_cost, double lane_cost, double heading_cost, double steer_rate_cost):
+    for i in range(self.n):
+      mpc_init_weights(self.ctxs[i], path_cost, lane_cost, heading_cost, steer_rate_cost)
+
+  def set_budget(self, int max_iterations, double kkt_tolerance=0.0, double deadline_us=0.0):
+    for i in range(self.n):
+      mpc_set_budget(self.ctxs[i], max_iterations, kkt_tolerance, deadline_us)
+
+  def set_warm_start(self, double dt):
+    for i in range(self.n):
+      mpc_set_warm_start(self.ctxs[i], dt)
+
+  def start_recording(self, path, int i=0):
+    if mpc_start_recording(self.ctxs[i], path.encode()) != 0:
+      raise OSError("can't record to %s" % path)
+
+  def run(self, const double[::1] l_poly, const double[::1] r_poly, const double[::1] d_poly,
+          double l_prob, double r_prob, double curvature_factor, double v_ref, double lane_width):
+    """Solves from every state with the same lanes and path, which can be any float64
+    buffers of 4 values. Returns the QP iterations of the first solver."""
+    if l_poly.shape[0] != 4 or r_poly.shape[0] != 4 or d_poly.shape[0] != 4:
+      raise ValueError("the polys need 4 coefficients")
+
+    cdef state_t *states = <state_t *>cnp.PyArray_DATA(self.state)
+    cdef log_t *solutions = <log_t *>cnp.PyArray_DATA(self.solution)
+    cdef int[::1] qp_iterations = self.qp_iterations
+    cdef double *l = <double *>&l_poly[0]
+    cdef double *r = <double *>&r_poly[0]
+    cdef double *d = <double *>&d_poly[0]
+    cdef int i
+
+    with nogil:
+      for i in range(self.n):
+        qp_iterations[i] = mpc_run(self.ctxs[i], &states[i], &solutions[i], l, r, d,
+                                   l_prob, r_prob, curvature_factor, v_ref, lane_width)
+    return qp_iterations[0]
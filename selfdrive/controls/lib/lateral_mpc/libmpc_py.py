@@ -19,8 +19,25 @@ typedef struct {
     double delta[21];
     double rate[20];
     double cost;
+    int iterations;
+    int deadline_hit;
+    double kkt;
+    double solve_us;
 } log_t;
 
+typedef struct mpc_context mpc_context;
+
+mpc_context *mpc_create(void);
+void mpc_destroy(mpc_context *ctx);
+void mpc_set_budget(mpc_context *ctx, int max_iterations, double kkt_tolerance, double deadline_us);
+void mpc_set_warm_start(mpc_context *ctx, double dt);
+int mpc_start_recording(mpc_context *ctx, const char *path);
+void mpc_init(mpc_context *ctx, double pathCost, double laneCost, double headingCost, double steerRateCost);
+void mpc_init_weights(mpc_context *ctx, double pathCost, double laneCost, double headingCost, double steerRateCost);
+int mpc_run(mpc_context *ctx, state_t * x0, log_t * solution,
+             double l_poly[4], double r_poly[4], double d_poly[4],
+             double l_prob, double r_prob, double curvature_factor, double v_ref, double lane_width);
+
 void init(double pathCost, double laneCost, double headingCost, double steerRateCost);
 void init_weights(double pathCost, double laneCost, double headingCost, double steerRateCost);
 int run_mpc(state_t * x0, log_t * solution,
@@ -1,14 +1,16 @@
 import os
-import math
+import numpy as np
 
 import cereal.messaging as messaging
 from selfdrive.swaglog import cloudlog
 from common.realtime import sec_since_boot
 from selfdrive.controls.lib.radar_helpers import _LEAD_ACCEL_TAU
-from selfdrive.controls.lib.longitudinal_mpc import libmpc_py
+from selfdrive.controls.lib.longitudinal_mpc.libmpc_impl import LongitudinalMpc as LongitudinalSolver  # pylint: disable=no-name-in-module, import-error
 from selfdrive.controls.lib.drive_helpers import MPC_COST_LONG
 
 LOG_MPC = os.environ.get('LOG_MPC', False)
+# directory to record the calls on the solvers in, for mpc_replay
+MPC_RECORD = os.environ.get('MPC_RECORD')
 
 
 class LongitudinalMpc():
@@ -29,12 +31,12 @@ class LongitudinalMpc():
   def send_mpc_solution(self, pm, qp_iterations, calculation_time):
     qp_iterations = max(0, qp_iterations)
     dat = messaging.new_message('liveLongitudinalMpc')
-    dat.liveLongitudinalMpc.xEgo = list(self.mpc_solution[0].x_ego)
-    dat.liveLongitudinalMpc.vEgo = list(self.mpc_solution[0].v_ego)
-    dat.liveLongitudinalMpc.aEgo = list(self.mpc_solution[0].a_ego)
-    dat.liveLongitudinalMpc.xLead = list(self.mpc_solution[0].x_l)
-    dat.liveLongitudinalMpc.vLead = list(self.mpc_solution[0].v_l)
-    dat.liveLongitudinalMpc.cost = self.mpc_solution[0].cost
+    dat.liveLongitudinalMpc.xEgo = self.mpc_solution['x_ego'].tolist()
+    dat.liveLongitudinalMpc.vEgo = self.mpc_solution['v_ego'].tolist()
+    dat.liveLongitudinalMpc.aEgo = self.mpc_solution['a_ego'].tolist()
+    dat.liveLongitudinalMpc.xLead = self.mpc_solution['x_l'].tolist()
+    dat.liveLongitudinalMpc.vLead = self.mpc_solution['v_l'].tolist()
+    dat.liveLongitudinalMpc.cost = float(self.mpc_solution['cost'])
     dat.liveLongitudinalMpc.aLeadTau = self.a_lead_tau
     dat.liveLongitudinalMpc.qpIterations = qp_iterations
     dat.liveLongitudinalMpc.mpcId = self.mpc_id
@@ -42,25 +44,27 @@ class LongitudinalMpc():
     pm.send('liveLongitudinalMpc', dat)
 
   def setup_mpc(self):
-    ffi, self.libmpc = libmpc_py.get_libmpc(self.mpc_id)
-    self.libmpc.init(MPC_COST_LONG.TTC, MPC_COST_LONG.DISTANCE,
-                     MPC_COST_LONG.ACCELERATION, MPC_COST_LONG.JERK)
-
-    self.mpc_solution = ffi.new("log_t *")
-    self.cur_state = ffi.new("state_t *")
-    self.cur_state[0].v_ego = 0
-    self.cur_state[0].a_ego = 0
+    # every LongitudinalMpc has its own solver
+    self.mpc = LongitudinalSolver()
+    if MPC_RECORD:
+      self.mpc.start_recording(os.path.join(MPC_RECORD, "longitudinal_mpc_%d.txt" % self.mpc_id))
+    self.mpc.init(MPC_COST_LONG.TTC, MPC_COST_LONG.DISTANCE,
+                  MPC_COST_LONG.ACCELERATION, MPC_COST_LONG.JERK)
+
+    # the solver's own state and solution, updated in place by every run
+    self.mpc_solution = self.mpc.solution[0]
+    self.cur_state = self.mpc.state[0]
     self.a_lead_tau = _LEAD_ACCEL_TAU
 
   def set_cur_state(self, v, a):
-    self.cur_state[0].v_ego = v
-    self.cur_state[0].a_ego = a
+    self.cur_state['v_ego'] = v
+    self.cur_state['a_ego'] = a
 
   def update(self, pm, CS, lead, v_cruise_setpoint):
     v_ego = CS.vEgo
 
     # Setup current mpc state
-    self.cur_state[0].x_ego = 0.0
+    self.cur_state['x_ego'] = 0.0
 
     if lead is not None and lead.status:
       x_lead = lead.dRel
@@ -74,38 +78,38 @@ class LongitudinalMpc():
       self.a_lead_tau = lead.aLeadTau
       self.new_lead = False
       if not self.prev_lead_status or abs(x_lead - self.prev_lead_x) > 2.5:
-        self.libmpc.init_with_simulation(self.v_mpc, x_lead, v_lead, a_lead, self.a_lead_tau)
+        self.mpc.init_with_simulation(self.v_mpc, x_lead, v_lead, a_lead, self.a_lead_tau)
         self.new_lead = True
 
       self.prev_lead_status = True
       self.prev_lead_x = x_lead
-      self.cur_state[0].x_l = x_lead
-      self.cur_state[0].v_l = v_lead
+      self.cur_state['x_l'] = x_lead
+      self.cur_state['v_l'] = v_lead
     else:
       self.prev_lead_status = False
       # Fake a fast lead car, so mpc keeps running
-      self.cur_state[0].x_l = 50.0
-      self.cur_state[0].v_l = v_ego + 10.0
+      self.cur_state['x_l'] = 50.0
+      self.cur_state['v_l'] = v_ego + 10.0
       a_lead = 0.0
       self.a_lead_tau = _LEAD_ACCEL_TAU
 
     # Calculate mpc
     t = sec_since_boot()
-    n_its = self.libmpc.run_mpc(self.cur_state, self.mpc_solution, self.a_lead_tau, a_lead)
+    n_its = self.mpc.run(self.a_lead_tau, a_lead)
     duration = int((sec_since_boot() - t) * 1e9)
 
     if LOG_MPC:
       self.send_mpc_solution(pm, n_its, duration)
 
     # Get solution. MPC timestep is 0.2 s, so interpolation to 0.05 s is needed
-    self.v_mpc = self.mpc_solution[0].v_ego[1]
-    self.a_mpc = self.mpc_solution[0].a_ego[1]
-    self.v_mpc_future = self.mpc_solution[0].v_ego[10]
+    self.v_mpc = self.mpc_solution['v_ego'][1]
+    self.a_mpc = self.mpc_solution['a_ego'][1]
+    self.v_mpc_future = self.mpc_solution['v_ego'][10]
 
     # Reset if NaN or goes through lead car
-    crashing = any(lead - ego < -50 for (lead, ego) in zip(self.mpc_solution[0].x_l, self.mpc_solution[0].x_ego))
-    nans = any(math.isnan(x) for x in self.mpc_solution[0].v_ego)
-    backwards = min(self.mpc_solution[0].v_ego) < -0.01
+    crashing = bool((self.mpc_solution['x_l'] - self.mpc_solution['x_ego'] < -50).any())
+    nans = bool(np.isnan(self.mpc_solution['v_ego']).any())
+    backwards = bool(self.mpc_solution['v_ego'].min() < -0.01)
 
     if ((backwards or crashing) and self.prev_lead_status) or nans:
       if t > self.last_cloudlog_t + 5.0:
@@ -113,10 +117,10 @@ class LongitudinalMpc():
         cloudlog.warning("Longitudinal mpc %d reset - backwards: %s crashing: %s nan: %s" % (
                           self.mpc_id, backwards, crashing, nans))
 
-      self.libmpc.init(MPC_COST_LONG.TTC, MPC_COST_LONG.DISTANCE,
-                       MPC_COST_LONG.ACCELERATION, MPC_COST_LONG.JERK)
-      self.cur_state[0].v_ego = v_ego
-      self.cur_state[0].a_ego = 0.0
+      self.mpc.init(MPC_COST_LONG.TTC, MPC_COST_LONG.DISTANCE,
+                    MPC_COST_LONG.ACCELERATION, MPC_COST_LONG.JERK)
+      self.cur_state['v_ego'] = v_ego
+      self.cur_state['a_ego'] = 0.0
       self.v_mpc = v_ego
       self.a_mpc = CS.aEgo
       self.prev_lead_status = False
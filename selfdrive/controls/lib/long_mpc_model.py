@@ -1,9 +1,12 @@
+import os
 import numpy as np
-import math
 
 from selfdrive.swaglog import cloudlog
 from common.realtime import sec_since_boot
-from selfdrive.controls.lib.longitudinal_mpc_model import libmpc_py
+from selfdrive.controls.lib.longitudinal_mpc_model.libmpc_impl import LongitudinalMpcModel as LongitudinalModelSolver  # pylint: disable=no-name-in-module, import-error
+
+# directory to record the calls on the solver in, for mpc_replay
+MPC_RECORD = os.environ.get('MPC_RECORD')
 
 
 class LongitudinalMpcModel():
@@ -19,42 +22,41 @@ class LongitudinalMpcModel():
     self.valid = False
 
   def setup_mpc(self, v_ego=0.0):
-    self.libmpc = libmpc_py.libmpc
-    self.libmpc.init(1.0, 1.0, 1.0, 1.0, 1.0)
-    self.libmpc.init_with_simulation(v_ego)
-
-    self.mpc_solution = libmpc_py.ffi.new("log_t *")
-    self.cur_state = libmpc_py.ffi.new("state_t *")
+    self.mpc = LongitudinalModelSolver()
+    if MPC_RECORD:
+      self.mpc.start_recording(os.path.join(MPC_RECORD, "longitudinal_mpc_model.txt"))
+    self.mpc.init(1.0, 1.0, 1.0, 1.0, 1.0)
+    self.mpc.init_with_simulation(v_ego)
 
-    self.cur_state[0].x_ego = 0
-    self.cur_state[0].v_ego = 0
-    self.cur_state[0].a_ego = 0
+    # the solver's own state and solution, updated in place by every run
+    self.mpc_solution = self.mpc.solution[0]
+    self.cur_state = self.mpc.state[0]
 
   def set_cur_state(self, v, a):
-    self.cur_state[0].x_ego = 0.0
-    self.cur_state[0].v_ego = v
-    self.cur_state[0].a_ego = a
+    self.cur_state['x_ego'] = 0.0
+    self.cur_state['v_ego'] = v
+    self.cur_state['a_ego'] = a
 
   def update(self, v_ego, a_ego, poss, speeds, accels):
     if len(poss) == 0:
       self.valid = False
       return
 
-    x_poly = list(map(float, np.polyfit(self.ts, poss, 3)))
-    v_poly = list(map(float, np.polyfit(self.ts, speeds, 3)))
-    a_poly = list(map(float, np.polyfit(self.ts, accels, 3)))
+    x_poly = np.polyfit(self.ts, poss, 3)
+    v_poly = np.polyfit(self.ts, speeds, 3)
+    a_poly = np.polyfit(self.ts, accels, 3)
 
     # Calculate mpc
-    self.libmpc.run_mpc(self.cur_state, self.mpc_solution, x_poly, v_poly, a_poly)
+    self.mpc.run(x_poly, v_poly, a_poly)
 
     # Get solution. MPC timestep is 0.2 s, so interpolation to 0.05 s is needed
-    self.v_mpc = self.mpc_solution[0].v_ego[1]
-    self.a_mpc = self.mpc_solution[0].a_ego[1]
-    self.v_mpc_future = self.mpc_solution[0].v_ego[10]
+    self.v_mpc = self.mpc_solution['v_ego'][1]
+    self.a_mpc = self.mpc_solution['a_ego'][1]
+    self.v_mpc_future = self.mpc_solution['v_ego'][10]
     self.valid = True
 
     # Reset if NaN or goes through lead car
-    nans = any(math.isnan(x) for x in self.mpc_solution[0].v_ego)
+    nans = bool(np.isnan(self.mpc_solution['v_ego']).any())
 
     t = sec_since_boot()
     if nans:
@@ -62,11 +64,11 @@ class LongitudinalMpcModel():
         self.last_cloudlog_t = t
         cloudlog.warning("Longitudinal model mpc reset - backwards")
 
-      self.libmpc.init(1.0, 1.0, 1.0, 1.0, 1.0)
-      self.libmpc.init_with_simulation(v_ego)
+      self.mpc.init(1.0, 1.0, 1.0, 1.0, 1.0)
+      self.mpc.init_with_simulation(v_ego)
 
-      self.cur_state[0].v_ego = v_ego
-      self.cur_state[0].a_ego = 0.0
+      self.cur_state['v_ego'] = v_ego
+      self.cur_state['a_ego'] = 0.0
 
       self.v_mpc = v_ego
       self.a_mpc = a_ego
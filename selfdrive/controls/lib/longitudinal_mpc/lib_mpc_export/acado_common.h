@@ -340,8 +340,14 @@ real_t acado_getObjective(  );
  * Extern declarations. 
  */
 
-extern ACADOworkspace acadoWorkspace;
-extern ACADOvariables acadoVariables;
+/* Not generated: the solver works on the variables and workspace of the context the
+ * calling thread selected last, so every context is a separate solver. See mpc_context
+ * in the solver's source. Initial exec, the default model for a shared library costs a
+ * call on every access. */
+extern __thread ACADOworkspace *acado_workspace __attribute__((tls_model("initial-exec")));
+extern __thread ACADOvariables *acado_variables __attribute__((tls_model("initial-exec")));
+#define acadoWorkspace (*acado_workspace)
+#define acadoVariables (*acado_variables)
 
 /** @} */
 
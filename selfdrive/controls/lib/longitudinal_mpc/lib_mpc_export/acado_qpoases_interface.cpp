@@ -28,7 +28,8 @@ extern "C"
 #include "INCLUDE/EXTRAS/SolutionAnalysis.hpp"
 #endif /* ACADO_COMPUTE_COVARIANCE_MATRIX */
 
-static int acado_nWSR;
+/* Not generated: per thread, like the solver state */
+static __thread int acado_nWSR;
 
 
 
@@ -4,38 +4,47 @@ from cffi import FFI
 from common.ffi_wrapper import suffix
 
 mpc_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)))
-
-def _get_libmpc(mpc_id):
-    libmpc_fn = os.path.join(mpc_dir, "libmpc%d%s" % (mpc_id, suffix()))
-
-    ffi = FFI()
-    ffi.cdef("""
-    typedef struct {
-    double x_ego, v_ego, a_ego, x_l, v_l, a_l;
-    } state_t;
-
-
-    typedef struct {
-    double x_ego[21];
-    double v_ego[21];
-    double a_ego[21];
-    double j_ego[20];
-    double x_l[21];
-    double v_l[21];
-    double a_l[21];
-    double t[21];
-    double cost;
-    } log_t;
-
-    void init(double ttcCost, double distanceCost, double accelerationCost, double jerkCost);
-    void init_with_simulation(double v_ego, double x_l, double v_l, double a_l, double l);
-    int run_mpc(state_t * x0, log_t * solution,
-                double l, double a_l_0);
-    """)
-
-    return (ffi, ffi.dlopen(libmpc_fn))
-
-mpcs = [_get_libmpc(1), _get_libmpc(2)]
-
-def get_libmpc(mpc_id):
-    return mpcs[mpc_id - 1]
+libmpc_fn = os.path.join(mpc_dir, "libmpc"+suffix())
+
+ffi = FFI()
+ffi.cdef("""
+typedef struct {
+double x_ego, v_ego, a_ego, x_l, v_l, a_l;
+} state_t;
+
+
+typedef struct {
+double x_ego[21];
+double v_ego[21];
+double a_ego[21];
+double j_ego[20];
+double x_l[21];
+double v_l[21];
+double a_l[21];
+double t[21];
+double cost;
+int iterations;
+int deadline_hit;
+double kkt;
+double solve_us;
+} log_t;
+
+typedef struct mpc_context mpc_context;
+
+mpc_context *mpc_create(void);
+void mpc_destroy(mpc_context *ctx);
+void mpc_set_budget(mpc_context *ctx, int max_iterations, double kkt_tolerance, double deadline_us);
+void mpc_set_warm_start(mpc_context *ctx, double dt);
+int mpc_start_recording(mpc_context *ctx, const char *path);
+void mpc_init(mpc_context *ctx, double ttcCost, double distanceCost, double accelerationCost, double jerkCost);
+void mpc_init_with_simulation(mpc_context *ctx, double v_ego, double x_l, double v_l, double a_l, double l);
+int mpc_run(mpc_context *ctx, state_t * x0, log_t * solution,
+            double l, double a_l_0);
+
+void init(double ttcCost, double distanceCost, double accelerationCost, double jerkCost);
+void init_with_simulation(double v_ego, double x_l, double v_l, double a_l, double l);
+int run_mpc(state_t * x0, log_t * solution,
+            double l, double a_l_0);
+""")
+
+libmpc = ffi.dlopen(libmpc_fn)
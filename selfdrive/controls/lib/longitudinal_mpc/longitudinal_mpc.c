@@ -2,6 +2,7 @@
 #include "acado_auxiliary_functions.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 #define NX          ACADO_NX  /* Number of differential state variables.  */
@@ -14,8 +15,63 @@
 
 #define N           ACADO_N   /* Number of intervals in the horizon. */
 
-ACADOvariables acadoVariables;
-ACADOworkspace acadoWorkspace;
+#define STEP        0.2       /* Length of the first intervals, seconds. */
+
+#include "../mpc_solve.h"
+
+// The state of one solver instance. The generated code reaches the variables and workspace
+// through acado_variables and acado_workspace, which are per thread: an mpc_* call points them
+// at its context, so instances don't share anything and can run on different threads at once.
+typedef struct mpc_context {
+  ACADOvariables variables;
+  ACADOworkspace workspace;
+  mpc_settings settings;
+  FILE *record;
+} mpc_context;
+
+__thread ACADOvariables *acado_variables;
+__thread ACADOworkspace *acado_workspace;
+
+// the instance of init() and run_mpc()
+static mpc_context default_context = {.settings = MPC_SETTINGS_DEFAULT};
+
+static void select_context(mpc_context *ctx){
+  acado_variables = &ctx->variables;
+  acado_workspace = &ctx->workspace;
+}
+
+mpc_context *mpc_create(void){
+  mpc_context *ctx = calloc(1, sizeof(mpc_context));
+  if (ctx != NULL){
+    ctx->settings = (mpc_settings)MPC_SETTINGS_DEFAULT;
+  }
+  return ctx;
+}
+
+void mpc_destroy(mpc_context *ctx){
+  if (ctx->record != NULL){
+    fclose(ctx->record);
+  }
+  free(ctx);
+}
+
+void mpc_set_budget(mpc_context *ctx, int max_iterations, double kkt_tolerance, double deadline_us){
+  ctx->settings.max_iterations = max_iterations;
+  ctx->settings.kkt_tolerance = kkt_tolerance;
+  ctx->settings.deadline_us = deadline_us;
+}
+
+void mpc_set_warm_start(mpc_context *ctx, double dt){
+  ctx->settings.shift = dt;
+}
+
+int mpc_start_recording(mpc_context *ctx, const char *path){
+  if (ctx->record != NULL){
+    fclose(ctx->record);
+  }
+  ctx->record = mpc_record_open(path, "longitudinal_mpc");
+  return ctx->record != NULL ? 0 : -1;
+}
 
 typedef struct {
   double x_ego, v_ego, a_ego, x_l, v_l, a_l;
@@ -32,9 +88,18 @@ typedef struct {
   double a_l[N+1];
   double t[N+1];
   double cost;
+  // of the solve, see mpc_settings
+  int iterations;
+  int deadline_hit;
+  double kkt;
+  double solve_us;
 } log_t;
 
-void init(double ttcCost, double distanceCost, double accelerationCost, double jerkCost){
+void mpc_init(mpc_context *ctx, double ttcCost, double distanceCost, double accelerationCost, double jerkCost){
+  select_context(ctx);
+  double args[] = {ttcCost, distanceCost, accelerationCost, jerkCost};
+  mpc_record(ctx->record, "init", args, 4);
+
   acado_initializeSolver();
   int    i;
   const int STEP_MULTIPLIER = 3;
@@ -68,7 +133,11 @@ void init(double ttcCost, double distanceCost, double accelerationCost, double j
 
 }
 
-void init_with_simulation(double v_ego, double x_l_0, double v_l_0, double a_l_0, double l){
+void mpc_init_with_simulation(mpc_context *ctx, double v_ego, double x_l_0, double v_l_0, double a_l_0, double l){
+  select_context(ctx);
+  double args[] = {v_ego, x_l_0, v_l_0, a_l_0, l};
+  mpc_record(ctx->record, "init_with_simulation", args, 5);
+
   int i;
 
   double x_l = x_l_0;
@@ -112,7 +181,13 @@ void init_with_simulation(double v_ego, double x_l_0, double v_l_0, double a_l_0
   for (i = 0; i < NYN; ++i)  acadoVariables.yN[ i ] = 0.0;
 }
 
-int run_mpc(state_t * x0, log_t * solution, double l, double a_l_0){
+int mpc_run(mpc_context *ctx, state_t * x0, log_t * solution, double l, double a_l_0){
+  select_context(ctx);
+  if (ctx->record != NULL){
+    double args[] = {x0->x_ego, x0->v_ego, x0->a_ego, x0->x_l, x0->v_l, x0->a_l, l, a_l_0};
+    mpc_record(ctx->record, "run", args, 8);
+  }
+
   // Calculate lead vehicle predictions
   int i;
   double t = 0.;
@@ -152,8 +227,8 @@ int run_mpc(state_t * x0, log_t * solution, double l, double a_l_0){
   acadoVariables.x[1] = acadoVariables.x0[1] = x0->v_ego;
   acadoVariables.x[2] = acadoVariables.x0[2] = x0->a_ego;
 
-  acado_preparationStep();
-  acado_feedbackStep();
+  mpc_stats stats;
+  mpc_solve(&ctx->settings, &stats);
 
   for (i = 0; i <= N; i++){
     solution->x_ego[i] = acadoVariables.x[i*NX];
@@ -165,9 +240,29 @@ int run_mpc(state_t * x0, log_t * solution, double l, double a_l_0){
     }
   }
   solution->cost = acado_getObjective();
-
-  // Dont shift states here. Current solution is closer to next timestep than if
-  // we shift by 0.2 seconds.
+  solution->iterations = stats.iterations;
+  solution->deadline_hit = stats.deadline_hit;
+  solution->kkt = stats.kkt;
+  solution->solve_us = stats.solve_us;
+
+  // Not acado_shiftStates(), it shifts by a node and the nodes are further apart than the
+  // time to the next solve. Without warm start the current solution is closer to the next
+  // timestep than a solution shifted by a node.
+  if (ctx->settings.shift > 0){
+    mpc_shift(ctx->settings.shift, STEP);
+  }
 
   return acado_getNWSR();
 }
+
+void init(double ttcCost, double distanceCost, double accelerationCost, double jerkCost){
+  mpc_init(&default_context, ttcCost, distanceCost, accelerationCost, jerkCost);
+}
+
+void init_with_simulation(double v_ego, double x_l_0, double v_l_0, double a_l_0, double l){
+  mpc_init_with_simulation(&default_context, v_ego, x_l_0, v_l_0, a_l_0, l);
+}
+
+int run_mpc(state_t * x0, log_t * solution, double l, double a_l_0){
+  return mpc_run(&default_context, x0, solution, l, a_l_0);
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+
+#include "common/timing.h"
+
+// Solves/s of the longitudinal MPC with 1 to 8 instances, each following its own lead, when
+// every instance runs on its own thread and when one thread runs them all in turn. Checks
+// that an instance gets the same solutions either way, instances don't share solver state.
+//   ./mpc_bench [solves per instance]
+
+#define N 20
+
+extern "C" {
+  typedef struct {
+    double x_ego, v_ego, a_ego, x_l, v_l, a_l;
+  } state_t;
+
+  typedef struct {
+    double x_ego[N+1];
+    double v_ego[N+1];
+    double a_ego[N+1];
+    double j_ego[N];
+    double x_l[N+1];
+    double v_l[N+1];
+    double a_l[N+1];
+    double t[N+1];
+    double cost;
+    int iterations;
+    int deadline_hit;
+    double kkt;
+    double solve_us;
+  } log_t;
+
+  typedef struct mpc_context mpc_context;
+
+  mpc_context *mpc_create(void);
+  void mpc_destroy(mpc_context *ctx);
+  void mpc_init(mpc_context *ctx, double ttcCost, double distanceCost, double accelerationCost, double jerkCost);
+  void mpc_init_with_simulation(mpc_context *ctx, double v_ego, double x_l, double v_l, double a_l, double l);
+  int mpc_run(mpc_context *ctx, state_t *x0, log_t *solution, double l, double a_l_0);
+}
+
+#define MAX_INSTANCES 8
+
+// MPC_COST_LONG of drive_helpers.py
+#define COST_TTC 5.0
+#define COST_DISTANCE 0.1
+#define COST_ACCELERATION 10.0
+#define COST_JERK 20.0
+
+#define LEAD_ACCEL_TAU 1.5
+#define DT 0.05
+#define LEAD_FREQ 0.5
+
+struct Instance {
+  mpc_context *ctx;
+  state_t state;
+  log_t solution;
+  int its;
+  double t, gap, lead_accel;
+
+  explicit Instance(int k) {
+    ctx = mpc_create();
+    mpc_init(ctx, COST_TTC, COST_DISTANCE, COST_ACCELERATION, COST_JERK);
+
+    // a different lead for every instance, at its own distance and phase
+    memset(&state, 0, sizeof(state));
+    t = 0.0;
+    gap = 20.0 + 5.0 * k;
+    state.v_ego = 20.0;
+    lead(k);
+    mpc_init_with_simulation(ctx, state.v_ego, state.x_l, state.v_l, lead_accel, LEAD_ACCEL_TAU);
+    its = 0;
+  }
+
+  ~Instance() {
+    mpc_destroy(ctx);
+  }
+
+  // the lead closes in and falls back around gap, relative to the ego
+  void lead(double phase) {
+    state.x_l = gap + 10.0 * sin(LEAD_FREQ * t + phase);
+    state.v_l = state.v_ego + 10.0 * LEAD_FREQ * cos(LEAD_FREQ * t + phase);
+    lead_accel = -10.0 * LEAD_FREQ * LEAD_FREQ * sin(LEAD_FREQ * t + phase);
+  }
+
+  // one planner cycle: solve, then take the acceleration of the plan
+  void step(int k) {
+    its += mpc_run(ctx, &state, &solution, LEAD_ACCEL_TAU, lead_accel);
+
+    state.a_ego = solution.a_ego[1];
+    t += DT;
+    lead(k);
+  }
+};
+
+static double run_threads(std::vector<Instance*> &instances, int solves) {
+  std::vector<std::thread> threads;
+  uint64_t t = nanos_since_boot();
+  for (Instance *instance : instances) {
+    int k = threads.size();
+    threads.emplace_back([instance, k, solves]() {
+      for (int i = 0; i < solves; i++) {
+        instance->step(k);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  return (nanos_since_boot() - t) * 1e-9;
+}
+
+static double run_round_robin(std::vector<Instance*> &instances, int solves) {
+  uint64_t t = nanos_since_boot();
+  for (int i = 0; i < solves; i++) {
+    for (size_t k = 0; k < instances.size(); k++) {
+      instances[k]->step(k);
+    }
+  }
+  return (nanos_since_boot() - t) * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+  const int solves = argc > 1 ? atoi(argv[1]) : 2000;
+  unsigned cores = std::thread::hardware_concurrency();
+  printf("%d solves per instance, %u cores\n", solves, cores);
+  printf("instances  threads solves/s  one thread solves/s  speedup\n");
+
+  bool identical = true;
+  for (int n = 1; n <= MAX_INSTANCES; n++) {
+    std::vector<Instance*> threaded, sequential;
+    for (int k = 0; k < n; k++) {
+      threaded.push_back(new Instance(k));
+      sequential.push_back(new Instance(k));
+    }
+
+    double threaded_s = run_threads(threaded, solves);
+    double sequential_s = run_round_robin(sequential, solves);
+
+    for (int k = 0; k < n; k++) {
+      // all but the solve time
+      if (memcmp(&threaded[k]->solution, &sequential[k]->solution, offsetof(log_t, solve_us)) != 0 ||
+          threaded[k]->its != sequential[k]->its) {
+        printf("instance %d of %d: solutions differ between the threaded and sequential runs\n", k, n);
+        identical = false;
+      }
+      delete threaded[k];
+      delete sequential[k];
+    }
+
+    double total = (double)n * solves;
+    printf("%9d  %17.0f  %19.0f  %7.2f\n", n, total / threaded_s, total / sequential_s,
+           sequential_s / threaded_s);
+  }
+
+  return identical ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+# cython: language_level=3
+# cython: boundscheck=False, wraparound=False
+from cpython.mem cimport PyMem_Malloc, PyMem_Free
+cimport numpy as cnp
+import numpy as np
+
+cnp.import_array()
+
+cdef extern from "longitudinal_mpc.c" nogil:
+  ctypedef struct mpc_context:
+    pass
+
+  ctypedef struct state_t:
+    double x_ego, v_ego, a_ego
+
+  ctypedef struct log_t:
+    double x_ego[21]
+    double v_ego[21]
+    double a_ego[21]
+    double t[21]
+    double j_ego[20]
+    double cost
+    int iterations
+    int deadline_hit
+    double kkt
+    double solve_us
+
+  mpc_context *mpc_create()
+  void mpc_destroy(mpc_context *ctx)
+  void mpc_set_budget(mpc_context *ctx, int max_iterations, double kkt_tolerance, double deadline_us)
+  void mpc_set_warm_start(mpc_context *ctx, double dt)
+  int mpc_start_recording(mpc_context *ctx, const char *path)
+  void mpc_init(mpc_context *ctx, double xCost, double vCost, double aCost, double accelCost, double jerkCost)
+  void mpc_init_with_simulation(mpc_context *ctx, double v_ego)
+  int mpc_run(mpc_context *ctx, state_t *x0, log_t *solution, double x_poly[4], double v_poly[4], double a_poly[4])
+
+state_dtype = np.dtype([('x_ego', np.float64), ('v_ego', np.float64), ('a_ego', np.float64)], align=True)
+log_dtype = np.dtype([('x_ego', np.float64, 21), ('v_ego', np.float64, 21), ('a_ego', np.float64, 21),
+                      ('t', np.float64, 21), ('j_ego', np.float64, 20), ('cost', np.float64),
+                      ('iterations', np.int32), ('deadline_hit', np.int32), ('kkt', np.float64),
+                      ('solve_us', np.float64)], align=True)
+assert state_dtype.itemsize == sizeof(state_t) and log_dtype.itemsize == sizeof(log_t)
+
+
+cdef class LongitudinalMpcModel:
+  """n solvers, each with its own initial state and solution.
+
+  state and solution are structured arrays over the structs the solvers read and write,
+  so nothing is copied in or out: set state[i]['v_ego'] before run(), read
+  solution[i]['v_ego'] after. The same arrays are reused by every run(), state[i] and
+  solution[i] stay valid views of them.
+  """
+  cdef mpc_context **ctxs
+  cdef readonly int n
+  cdef readonly object state
+  cdef readonly object solution
+  # QP working set recalculations of the last run, per solver
+  cdef readonly object qp_iterations
+
+  def __cinit__(self, int n=1):
+    if n < 1:
+      raise ValueError("n must be at least 1")
+    self.ctxs = <mpc_context **>PyMem_Malloc(n * sizeof(mpc_context *))
+    if self.ctxs == NULL:
+      raise MemoryError()
+    self.n = 0
+    for i in range(n):
+      self.ctxs[i] = mpc_create()
+      if self.ctxs[i] == NULL:
+        raise MemoryError()
+      self.n += 1
+
+    self.state = np.zeros(n, dtype=state_dtype)
+    self.solution = np.zeros(n, dtype=log_dtype)
+    self.qp_iterations = np.zeros(n, dtype=np.int32)
+
+  def __dealloc__(self):
+    if self.ctxs != NULL:
+      for i in range(self.n):
+        mpc_destroy(self.ctxs[i])
+      PyMem_Free(self.ctxs)
+
+  def init(self, double x_cost, double v_cost, double a_cost, double accel_cost, double jerk_cost):
+    for i in range(self.n):
+      mpc_init(self.ctxs[i], x_cost, v_cost, a_cost, accel_cost, jerk_cost)
+
+  def init_with_simulation(self, double v_ego, int i=0):
+    mpc_init_with_simulation(self.ctxs[i], v_ego)
+
+  def set_budget(self, int max_iterations, double kkt_tolerance=0.0, double deadline_us=0.0):
+    for i in range(self.n):
+      mpc_set_budget(self.ctxs[i], max_iterations, kkt_tolerance, deadline_us)
+
+  def set_warm_start(self, double dt):
+    for i in range(self.n):
+      mpc_set_warm_start(self.ctxs[i], dt)
+
+  def start_recording(self, path, int i=0):
+    if mpc_start_recording(self.ctxs[i], path.encode()) != 0:
+      raise OSError("can't record to %s" % path)
+
+  def run(self, const double[::1] x_poly, const double[::1] v_poly, const double[::1] a_poly):
+    """Solves from every state towards the same plan, which can be any float64 buffers
+    of 4 values. Returns the QP iterations of the first solver."""
+    if x_poly.shape[0] != 4 or v_poly.shape[0] != 4 or a_poly.shape[0] != 4:
+      raise ValueError("the polys need 4 coefficients")
+
+    cdef state_t *states = <state_t *>cnp.PyArray_DATA(self.state)
+    cdef log_t *solutions = <log_t *>cnp.PyArray_DATA(self.solution)
+    cdef int[::1] qp_iterations = self.qp_iterations
+    cdef double *x = <double *>&x_poly[0]
+    cdef double *v = <double *>&v_poly[0]
+    cdef double *a = <double *>&a_poly[0]
+    cdef int i
+
+    with nogil:
+      for i in range(self.n):
+        qp_iterations[i] = mpc_run(self.ctxs[i], &states[i], &solutions[i], x, v, a)
+    return qp_iterations[0]
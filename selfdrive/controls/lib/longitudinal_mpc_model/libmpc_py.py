@@ -21,8 +21,22 @@ double a_ego[21];
 double t[21];
 double j_ego[20];
 double cost;
+int iterations;
+int deadline_hit;
+double kkt;
+double solve_us;
 } log_t;
 
+typedef struct mpc_context mpc_context;
+
+mpc_context *mpc_create(void);
+void mpc_destroy(mpc_context *ctx);
+void mpc_set_budget(mpc_context *ctx, int max_iterations, double kkt_tolerance, double deadline_us);
+void mpc_set_warm_start(mpc_context *ctx, double dt);
+int mpc_start_recording(mpc_context *ctx, const char *path);
+void mpc_init(mpc_context *ctx, double xCost, double vCost, double aCost, double accelCost, double jerkCost);
+void mpc_init_with_simulation(mpc_context *ctx, double v_ego);
+int mpc_run(mpc_context *ctx, state_t * x0, log_t * solution, double x_poly[4], double v_poly[4], double a_poly[4]);
 
 void init(double xCost, double vCost, double aCost, double accelCost, double jerkCost);
 void init_with_simulation(double v_ego);
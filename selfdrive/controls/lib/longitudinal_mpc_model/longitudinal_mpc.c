@@ -2,6 +2,7 @@
 #include "acado_auxiliary_functions.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 #define NX          ACADO_NX  /* Number of differential state variables.  */
@@ -14,8 +15,63 @@
 
 #define N           ACADO_N   /* Number of intervals in the horizon. */
 
-ACADOvariables acadoVariables;
-ACADOworkspace acadoWorkspace;
+#define STEP        0.2       /* Length of the first intervals, seconds. */
+
+#include "../mpc_solve.h"
+
+// The state of one solver instance. The generated code reaches the variables and workspace
+// through acado_variables and acado_workspace, which are per thread: an mpc_* call points them
+// at its context, so instances don't share anything and can run on different threads at once.
+typedef struct mpc_context {
+  ACADOvariables variables;
+  ACADOworkspace workspace;
+  mpc_settings settings;
+  FILE *record;
+} mpc_context;
+
+__thread ACADOvariables *acado_variables;
+__thread ACADOworkspace *acado_workspace;
+
+// the instance of init() and run_mpc()
+static mpc_context default_context = {.settings = MPC_SETTINGS_DEFAULT};
+
+static void select_context(mpc_context *ctx){
+  acado_variables = &ctx->variables;
+  acado_workspace = &ctx->workspace;
+}
+
+mpc_context *mpc_create(void){
+  mpc_context *ctx = calloc(1, sizeof(mpc_context));
+  if (ctx != NULL){
+    ctx->settings = (mpc_settings)MPC_SETTINGS_DEFAULT;
+  }
+  return ctx;
+}
+
+void mpc_destroy(mpc_context *ctx){
+  if (ctx->record != NULL){
+    fclose(ctx->record);
+  }
+  free(ctx);
+}
+
+void mpc_set_budget(mpc_context *ctx, int max_iterations, double kkt_tolerance, double deadline_us){
+  ctx->settings.max_iterations = max_iterations;
+  ctx->settings.kkt_tolerance = kkt_tolerance;
+  ctx->settings.deadline_us = deadline_us;
+}
+
+void mpc_set_warm_start(mpc_context *ctx, double dt){
+  ctx->settings.shift = dt;
+}
+
+int mpc_start_recording(mpc_context *ctx, const char *path){
+  if (ctx->record != NULL){
+    fclose(ctx->record);
+  }
+  ctx->record = mpc_record_open(path, "longitudinal_mpc_model");
+  return ctx->record != NULL ? 0 : -1;
+}
 
 typedef struct {
   double x_ego, v_ego, a_ego;
@@ -29,9 +85,18 @@ typedef struct {
   double t[N+1];
   double j_ego[N];
   double cost;
+  // of the solve, see mpc_settings
+  int iterations;
+  int deadline_hit;
+  double kkt;
+  double solve_us;
 } log_t;
 
-void init(double xCost, double vCost, double aCost, double accelCost, double jerkCost){
+void mpc_init(mpc_context *ctx, double xCost, double vCost, double aCost, double accelCost, double jerkCost){
+  select_context(ctx);
+  double args[] = {xCost, vCost, aCost, accelCost, jerkCost};
+  mpc_record(ctx->record, "init", args, 5);
+
   acado_initializeSolver();
   int    i;
   const int STEP_MULTIPLIER = 3;
@@ -67,7 +132,10 @@ void init(double xCost, double vCost, double aCost, double accelCost, double jer
 
 }
 
-void init_with_simulation(double v_ego){
+void mpc_init_with_simulation(mpc_context *ctx, double v_ego){
+  select_context(ctx);
+  mpc_record(ctx->record, "init_with_simulation", &v_ego, 1);
+
   int i;
 
   double x_ego = 0.0;
@@ -94,8 +162,17 @@ void init_with_simulation(double v_ego){
   for (i = 0; i < NYN; ++i)  acadoVariables.yN[ i ] = 0.0;
 }
 
-int run_mpc(state_t * x0, log_t * solution,
+int mpc_run(mpc_context *ctx, state_t * x0, log_t * solution,
             double x_poly[4], double v_poly[4], double a_poly[4]){
+  select_context(ctx);
+  if (ctx->record != NULL){
+    double args[] = {x0->x_ego, x0->v_ego, x0->a_ego,
+                     x_poly[0], x_poly[1], x_poly[2], x_poly[3],
+                     v_poly[0], v_poly[1], v_poly[2], v_poly[3],
+                     a_poly[0], a_poly[1], a_poly[2], a_poly[3]};
+    mpc_record(ctx->record, "run", args, 15);
+  }
+
   int i;
 
   for (i = 0; i < N + 1; ++i){
@@ -120,8 +197,8 @@ int run_mpc(state_t * x0, log_t * solution,
   acadoVariables.x[2] = acadoVariables.x0[2] = x0->a_ego;
   acadoVariables.x[3] = acadoVariables.x0[3] = 0;
 
-  acado_preparationStep();
-  acado_feedbackStep();
+  mpc_stats stats;
+  mpc_solve(&ctx->settings, &stats);
 
   for (i = 0; i <= N; i++){
     solution->x_ego[i] = acadoVariables.x[i*NX];
@@ -134,8 +211,29 @@ int run_mpc(state_t * x0, log_t * solution,
     }
   }
   solution->cost = acado_getObjective();
-
-  // Dont shift states here. Current solution is closer to next timestep than if
-  // we shift by 0.1 seconds.
+  solution->iterations = stats.iterations;
+  solution->deadline_hit = stats.deadline_hit;
+  solution->kkt = stats.kkt;
+  solution->solve_us = stats.solve_us;
+
+  // Not acado_shiftStates(), it shifts by a node and the nodes are further apart than the
+  // time to the next solve. Without warm start the current solution is closer to the next
+  // timestep than a solution shifted by a node.
+  if (ctx->settings.shift > 0){
+    mpc_shift(ctx->settings.shift, STEP);
+  }
   return acado_getNWSR();
 }
+
+void init(double xCost, double vCost, double aCost, double accelCost, double jerkCost){
+  mpc_init(&default_context, xCost, vCost, aCost, accelCost, jerkCost);
+}
+
+void init_with_simulation(double v_ego){
+  mpc_init_with_simulation(&default_context, v_ego);
+}
+
+int run_mpc(state_t * x0, log_t * solution,
+            double x_poly[4], double v_poly[4], double a_poly[4]){
+  return mpc_run(&default_context, x0, solution, x_poly, v_poly, a_poly);
+}
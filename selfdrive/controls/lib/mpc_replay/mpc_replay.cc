@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dlfcn.h>
+#include <libgen.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Replays recorded planner inputs through the MPC solvers with different iteration budgets
+// and warm start, and compares solve time, iterations and the planned output with a solve
+// iterated until it converged. Record with MPC_RECORD=<dir> set for plannerd, then
+//   ./mpc_replay <dir>/lateral_mpc.txt <dir>/longitudinal_mpc_1.txt ...
+
+#define N 20
+
+// the planners solve at 20 Hz
+#define PLANNER_DT 0.05
+
+typedef struct mpc_context mpc_context;
+
+namespace lateral {
+  typedef struct {
+    double x, y, psi, delta, t;
+  } state_t;
+
+  typedef struct {
+    double x[N+1];
+    double y[N+1];
+    double psi[N+1];
+    double delta[N+1];
+    double rate[N];
+    double cost;
+    int iterations;
+    int deadline_hit;
+    double kkt;
+    double solve_us;
+  } log_t;
+}
+
+namespace longitudinal {
+  typedef struct {
+    double x_ego, v_ego, a_ego, x_l, v_l, a_l;
+  } state_t;
+
+  typedef struct {
+    double x_ego[N+1];
+    double v_ego[N+1];
+    double a_ego[N+1];
+    double j_ego[N];
+    double x_l[N+1];
+    double v_l[N+1];
+    double a_l[N+1];
+    double t[N+1];
+    double cost;
+    int iterations;
+    int deadline_hit;
+    double kkt;
+    double solve_us;
+  } log_t;
+}
+
+namespace model {
+  typedef struct {
+    double x_ego, v_ego, a_ego;
+  } state_t;
+
+  typedef struct {
+    double x_ego[N+1];
+    double v_ego[N+1];
+    double a_ego[N+1];
+    double t[N+1];
+    double j_ego[N];
+    double cost;
+    int iterations;
+    int deadline_hit;
+    double kkt;
+    double solve_us;
+  } log_t;
+}
+
+struct Telemetry {
+  int iterations;
+  int deadline_hit;
+  double kkt;
+  double solve_us;
+  // what the planner takes from the solution: the steering angle or the speed at the next node
+  double output;
+};
+
+struct Call {
+  std::string name;
+  std::vector<double> args;
+};
+
+// The functions of a solver library, loaded on their own since they all have the same names
+struct Solver {
+  const char *name;
+  void *lib;
+  mpc_context *(*create)(void);
+  void (*destroy)(mpc_context *ctx);
+  void (*set_budget)(mpc_context *ctx, int max_iterations, double kkt_tolerance, double deadline_us);
+  void (*set_warm_start)(mpc_context *ctx, double dt);
+  void *init;
+  void *init_weights;
+  void *init_with_simulation;
+  void *run;
+
+  // Applies a recorded call, returns whether it was a solve
+  bool apply(mpc_context *ctx, const Call &call, Telemetry *t) const;
+};
+
+template <typename Log>
+static void telemetry(const Log &log, double output, Telemetry *t) {
+  t->iterations = log.iterations;
+  t->deadline_hit = log.deadline_hit;
+  t->kkt = log.kkt;
+  t->solve_us = log.solve_us;
+  t->output = output;
+}
+
+bool Solver::apply(mpc_context *ctx, const Call &call, Telemetry *t) const {
+  const double *a = call.args.data();
+  const size_t n = call.args.size();
+
+  if (call.name == "init" && n == 4) {
+    ((void (*)(mpc_context*, double, double, double, double))init)(ctx, a[0], a[1], a[2], a[3]);
+  } else if (call.name == "init" && n == 5) {
+    ((void (*)(mpc_context*, double, double, double, double, double))init)(ctx, a[0], a[1], a[2], a[3], a[4]);
+  } else if (call.name == "init_weights" && n == 4) {
+    ((void (*)(mpc_context*, double, double, double, double))init_weights)(ctx, a[0], a[1], a[2], a[3]);
+  } else if (call.name == "init_with_simulation" && n == 5) {
+    ((void (*)(mpc_context*, double, double, double, double, double))init_with_simulation)(ctx, a[0], a[1], a[2], a[3], a[4]);
+  } else if (call.name == "init_with_simulation" && n == 1) {
+    ((void (*)(mpc_context*, double))init_with_simulation)(ctx, a[0]);
+  } else if (call.name == "run" && n == 22) {
+    lateral::state_t x0 = {a[0], a[1], a[2], a[3], a[4]};
+    double l_poly[4] = {a[5], a[6], a[7], a[8]};
+    double r_poly[4] = {a[9], a[10], a[11], a[12]};
+    double d_poly[4] = {a[13], a[14], a[15], a[16]};
+    lateral::log_t log;
+    ((int (*)(mpc_context*, lateral::state_t*, lateral::log_t*, double*, double*, double*,
+              double, double, double, double, double))run)(ctx, &x0, &log, l_poly, r_poly, d_poly,
+                                                           a[17], a[18], a[19], a[20], a[21]);
+    telemetry(log, log.delta[1], t);
+    return true;
+  } else if (call.name == "run" && n == 8) {
+    longitudinal::state_t x0 = {a[0], a[1], a[2], a[3], a[4], a[5]};
+    longitudinal::log_t log;
+    ((int (*)(mpc_context*, longitudinal::state_t*, longitudinal::log_t*, double, double))run)(ctx, &x0, &log, a[6], a[7]);
+    telemetry(log, log.v_ego[1], t);
+    return true;
+  } else if (call.name == "run" && n == 15) {
+    model::state_t x0 = {a[0], a[1], a[2]};
+    double x_poly[4] = {a[3], a[4], a[5], a[6]};
+    double v_poly[4] = {a[7], a[8], a[9], a[10]};
+    double a_poly[4] = {a[11], a[12], a[13], a[14]};
+    model::log_t log;
+    ((int (*)(mpc_context*, model::state_t*, model::log_t*, double*, double*, double*))run)(ctx, &x0, &log, x_poly, v_poly, a_poly);
+    telemetry(log, log.v_ego[1], t);
+    return true;
+  } else {
+    fprintf(stderr, "%s: unknown call %s with %zu arguments\n", name, call.name.c_str(), n);
+  }
+  return false;
+}
+
+// libmpc.so of the solver, in its directory next to this one
+static bool load_solver(const char *name, Solver *s) {
+  char exe[PATH_MAX] = {};
+  if (readlink("/proc/self/exe", exe, sizeof(exe) - 1) < 0) {
+    return false;
+  }
+  std::string path = std::string(dirname(exe)) + "/../" + name + "/libmpc.so";
+
+  memset(s, 0, sizeof(*s));
+  s->name = name;
+  s->lib = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (s->lib == NULL) {
+    fprintf(stderr, "%s\n", dlerror());
+    return false;
+  }
+  s->create = (mpc_context *(*)(void))dlsym(s->lib, "mpc_create");
+  s->destroy = (void (*)(mpc_context*))dlsym(s->lib, "mpc_destroy");
+  s->set_budget = (void (*)(mpc_context*, int, double, double))dlsym(s->lib, "mpc_set_budget");
+  s->set_warm_start = (void (*)(mpc_context*, double))dlsym(s->lib, "mpc_set_warm_start");
+  s->init = dlsym(s->lib, "mpc_init");
+  s->init_weights = dlsym(s->lib, "mpc_init_weights");
+  s->init_with_simulation = dlsym(s->lib, "mpc_init_with_simulation");
+  s->run = dlsym(s->lib, "mpc_run");
+  return s->create && s->destroy && s->set_budget && s->set_warm_start && s->init && s->run;
+}
+
+static bool read_recording(const char *fn, std::string *solver, std::vector<Call> *calls) {
+  FILE *f = fopen(fn, "r");
+  if (f == NULL) {
+    return false;
+  }
+
+  char *line = NULL;
+  size_t size = 0;
+  while (getline(&line, &size, f) > 0) {
+    char *save;
+    char *token = strtok_r(line, " \n", &save);
+    if (token == NULL) {
+      continue;
+    }
+    if (solver->empty()) {
+      *solver = token;
+      continue;
+    }
+    Call call = {token, {}};
+    while ((token = strtok_r(NULL, " \n", &save)) != NULL) {
+      call.args.push_back(strtod(token, NULL));
+    }
+    calls->push_back(call);
+  }
+  free(line);
+  fclose(f);
+  return !solver->empty();
+}
+
+struct Config {
+  const char *name;
+  int max_iterations;
+  double kkt_tolerance;
+  double deadline_us;
+  double shift;
+};
+
+static const Config configs[] = {
+  {"1 iteration (planners)", 1, 0.0, 0.0, 0.0},
+  {"1 iteration, warm start", 1, 0.0, 0.0, PLANNER_DT},
+  {"<= 3 iterations, kkt 1e-6", 3, 1e-6, 0.0, 0.0},
+  {"<= 3 iterations, kkt 1e-6, warm", 3, 1e-6, 0.0, PLANNER_DT},
+  {"<= 10 iterations, kkt 1e-8", 10, 1e-8, 0.0, 0.0},
+  {"<= 10 its, kkt 1e-8, 500 us", 10, 1e-8, 500.0, 0.0},
+};
+
+// iterated until it converged, what the output of the others is compared with
+static const Config reference = {"reference", 50, 1e-12, 0.0, 0.0};
+
+static std::vector<Telemetry> replay(const Solver &s, const std::vector<Call> &calls, const Config &c) {
+  std::vector<Telemetry> solves;
+  mpc_context *ctx = s.create();
+  s.set_budget(ctx, c.max_iterations, c.kkt_tolerance, c.deadline_us);
+  s.set_warm_start(ctx, c.shift);
+  for (const Call &call : calls) {
+    Telemetry t;
+    if (s.apply(ctx, call, &t)) {
+      solves.push_back(t);
+    }
+  }
+  s.destroy(ctx);
+  return solves;
+}
+
+static void print(const Config &c, const std::vector<Telemetry> &solves, const std::vector<Telemetry> &ref) {
+  std::vector<double> us;
+  double iterations = 0, kkt = 0, error = 0, max_error = 0;
+  int deadline_hits = 0;
+  for (size_t i = 0; i < solves.size(); i++) {
+    us.push_back(solves[i].solve_us);
+    iterations += solves[i].iterations;
+    kkt += solves[i].kkt;
+    deadline_hits += solves[i].deadline_hit;
+    double e = fabs(solves[i].output - ref[i].output);
+    error += e;
+    max_error = std::max(max_error, e);
+  }
+  std::sort(us.begin(), us.end());
+
+  double n = solves.size();
+  printf("  %-32s %8.1f %8.1f %8.1f %8.1f %6.2f %9.2e %6d %9.2e %9.2e\n", c.name,
+         std::accumulate(us.begin(), us.end(), 0.0) / n, us[us.size() / 2], us[us.size() * 99 / 100], us.back(),
+         iterations / n, kkt / n, deadline_hits, error / n, max_error);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <recording>...\n", argv[0]);
+    return 1;
+  }
+
+  for (int i = 1; i < argc; i++) {
+    std::string solver_name;
+    std::vector<Call> calls;
+    Solver solver;
+    if (!read_recording(argv[i], &solver_name, &calls) || !load_solver(solver_name.c_str(), &solver)) {
+      fprintf(stderr, "can't replay %s\n", argv[i]);
+      return 1;
+    }
+
+    std::vector<Telemetry> ref = replay(solver, calls, reference);
+    if (ref.empty()) {
+      printf("%s: no solves\n", argv[i]);
+      continue;
+    }
+    printf("%s: %s, %zu solves\n", argv[i], solver.name, ref.size());
+    printf("  %-32s %8s %8s %8s %8s %6s %9s %6s %9s %9s\n", "", "mean us", "p50 us", "p99 us", "max us",
+           "its", "kkt", "late", "err mean", "err max");
+    for (const Config &c : configs) {
+      print(c, replay(solver, calls, c), ref);
+    }
+    dlclose(solver.lib);
+  }
+  return 0;
+}
@@ -0,0 +1,35 @@
+import glob
+import os
+
+import numpy
+from Cython.Build import cythonize
+from distutils.core import Extension, setup  # pylint: disable=import-error,no-name-in-module
+
+from common.cython_hacks import BuildExtWithoutPlatformSuffix
+
+# Builds libmpc_impl of the solver in the current directory, from the solver's sources and the
+# qpOASES library its SConscript built. It has its own copy of the solver, independent of libmpc
+phonelibs = os.path.join(os.path.dirname(os.path.abspath(__file__)), "../../../phonelibs")
+
+setup(name='MPC solver bindings',
+      cmdclass={'build_ext': BuildExtWithoutPlatformSuffix},
+      ext_modules=cythonize(
+        Extension(
+          "libmpc_impl",
+          sources=["libmpc_impl.pyx"] + sorted(glob.glob("lib_mpc_export/*.c")) + sorted(glob.glob("lib_mpc_export/*.cpp")),
+          include_dirs=[
+            numpy.get_include(),
+            "lib_mpc_export",
+            os.path.join(phonelibs, "acado/include"),
+            os.path.join(phonelibs, "acado/include/acado"),
+            os.path.join(phonelibs, "qpoases/INCLUDE"),
+            os.path.join(phonelibs, "qpoases/INCLUDE/EXTRAS"),
+            os.path.join(phonelibs, "qpoases/SRC"),
+            os.path.join(phonelibs, "qpoases"),
+          ],
+          extra_objects=["lib_qp/libqpoases.a"],
+          libraries=["stdc++", "m"],
+          extra_compile_args=["-O2", "-Wno-unused-function"],
+        )
+      )
+)
@@ -0,0 +1,121 @@
+#pragma once
+
+// Solving, warm starting and recording shared by the ACADO solvers. Include after
+// acado_common.h and the NX, NU and N defines of the solver.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  // SQP iterations per solve, at least 1. Fewer when the KKT value gets below
+  // kkt_tolerance, or when another iteration wouldn't end deadline_us after the start
+  // of the solve (0 for no deadline)
+  int max_iterations;
+  double kkt_tolerance;
+  double deadline_us;
+  // seconds to shift the last solution by before the next solve, 0 to start from it as is
+  double shift;
+} mpc_settings;
+
+#define MPC_SETTINGS_DEFAULT {1, 0.0, 0.0, 0.0}
+
+typedef struct {
+  int iterations;
+  int deadline_hit;
+  double kkt;
+  double solve_us;
+} mpc_stats;
+
+static double mpc_now_us(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e6 + t.tv_nsec * 1e-3;
+}
+
+// Runs SQP iterations on the selected context within the budget of settings
+static void mpc_solve(const mpc_settings *settings, mpc_stats *stats){
+  double start = mpc_now_us();
+  int max_iterations = settings->max_iterations > 1 ? settings->max_iterations : 1;
+
+  stats->iterations = 0;
+  stats->deadline_hit = 0;
+  while (1) {
+    acado_preparationStep();
+    acado_feedbackStep();
+    stats->iterations++;
+    stats->kkt = acado_getKKT();
+
+    double elapsed = mpc_now_us() - start;
+    if (stats->iterations >= max_iterations || stats->kkt < settings->kkt_tolerance){
+      break;
+    }
+    // the next iteration takes about as long as the average one so far
+    if (settings->deadline_us > 0 && elapsed * (stats->iterations + 1) / stats->iterations > settings->deadline_us){
+      stats->deadline_hit = 1;
+      break;
+    }
+  }
+  stats->solve_us = mpc_now_us() - start;
+}
+
+// The horizon of the solvers: the first 5 intervals are step long, the others 3 steps
+static double mpc_node_time(int i, double step){
+  return i <= 5 ? i * step : (5 + 3 * (i - 5)) * step;
+}
+
+// Warm start: the states and controls at node i become the ones the last solution had dt
+// later, interpolating the states. After the end of the horizon they are held.
+static void mpc_shift(double dt, double step){
+  real_t x[NX * (N + 1)];
+  real_t u[NU * N];
+  int i, k, j = 0;
+
+  for (i = 0; i <= N; i++){
+    double t = mpc_node_time(i, step) + dt;
+    while (j < N && mpc_node_time(j + 1, step) <= t){
+      j++;
+    }
+
+    if (j < N){
+      double a = (t - mpc_node_time(j, step)) / (mpc_node_time(j + 1, step) - mpc_node_time(j, step));
+      for (k = 0; k < NX; k++){
+        x[i*NX + k] = (1.0 - a) * acadoVariables.x[j*NX + k] + a * acadoVariables.x[(j+1)*NX + k];
+      }
+    } else {
+      memcpy(&x[i*NX], &acadoVariables.x[N*NX], NX * sizeof(real_t));
+    }
+
+    if (i < N){
+      memcpy(&u[i*NU], &acadoVariables.u[(j < N ? j : N - 1)*NU], NU * sizeof(real_t));
+    }
+  }
+
+  memcpy(acadoVariables.x, x, sizeof(x));
+  memcpy(acadoVariables.u, u, sizeof(u));
+}
+
+// Recording of the calls on a context, for mpc_replay. A line per call, its name and the
+// arguments, after a first line naming the solver
+static FILE *mpc_record_open(const char *path, const char *solver){
+  FILE *f = fopen(path, "w");
+  if (f != NULL){
+    // a line at a time, a recording ends with the last complete call
+    setvbuf(f, NULL, _IOLBF, 0);
+    fprintf(f, "%s\n", solver);
+  }
+  return f;
+}
+
+static void mpc_record(FILE *f, const char *call, const double *args, int n){
+  int i;
+  if (f == NULL){
+    return;
+  }
+  fputs(call, f);
+  for (i = 0; i < n; i++){
+    // round trips exactly
+    fprintf(f, " %.17g", args[i]);
+  }
+  fputc('\n', f);
+}
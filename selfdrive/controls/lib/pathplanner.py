@@ -1,8 +1,9 @@
 import os
 import math
+import numpy as np
 from common.realtime import sec_since_boot, DT_MDL
 from selfdrive.swaglog import cloudlog
-from selfdrive.controls.lib.lateral_mpc import libmpc_py
+from selfdrive.controls.lib.lateral_mpc.libmpc_impl import LateralMpc  # pylint: disable=no-name-in-module, import-error
 from selfdrive.controls.lib.drive_helpers import MPC_COST_LAT
 from selfdrive.controls.lib.lane_planner import LanePlanner
 from selfdrive.config import Conversions as CV
@@ -15,6 +16,8 @@ LaneChangeState = log.PathPlan.LaneChangeState
 LaneChangeDirection = log.PathPlan.LaneChangeDirection
 
 LOG_MPC = os.environ.get('LOG_MPC', False)
+# directory to record the calls on the solver in, for mpc_replay
+MPC_RECORD = os.environ.get('MPC_RECORD')
 
 LANE_CHANGE_SPEED_MIN = 45 * CV.MPH_TO_MS
 LANE_CHANGE_TIME_MAX = 10.
@@ -42,8 +45,8 @@ DESIRES = {
 
 
 def calc_states_after_delay(states, v_ego, steer_angle, curvature_factor, steer_ratio, delay):
-  states[0].x = v_ego * delay
-  states[0].psi = v_ego * curvature_factor * math.radians(steer_angle) / steer_ratio * delay
+  states['x'] = v_ego * delay
+  states['psi'] = v_ego * curvature_factor * math.radians(steer_angle) / steer_ratio * delay
   return states
 
 
@@ -64,15 +67,14 @@ class PathPlanner():
     self.prev_one_blinker = False
 
   def setup_mpc(self):
-    self.libmpc = libmpc_py.libmpc
-    self.libmpc.init(MPC_COST_LAT.PATH, MPC_COST_LAT.LANE, MPC_COST_LAT.HEADING, self.steer_rate_cost)
+    self.mpc = LateralMpc()
+    if MPC_RECORD:
+      self.mpc.start_recording(os.path.join(MPC_RECORD, "lateral_mpc.txt"))
+    self.mpc.init(MPC_COST_LAT.PATH, MPC_COST_LAT.LANE, MPC_COST_LAT.HEADING, self.steer_rate_cost)
 
-    self.mpc_solution = libmpc_py.ffi.new("log_t *")
-    self.cur_state = libmpc_py.ffi.new("state_t *")
-    self.cur_state[0].x = 0.0
-    self.cur_state[0].y = 0.0
-    self.cur_state[0].psi = 0.0
-    self.cur_state[0].delta = 0.0
+    # the solver's own state and solution, updated in place by every run
+    self.mpc_solution = self.mpc.solution[0]
+    self.cur_state = self.mpc.state[0]
 
     self.angle_steers_des = 0.0
     self.angle_steers_des_mpc = 0.0
@@ -175,34 +177,33 @@ class PathPlanner():
     self.cur_state = calc_states_after_delay(self.cur_state, v_ego, angle_steers - angle_offset, curvature_factor, VM.sR, delay)
 
     v_ego_mpc = max(v_ego, 5.0)  # avoid mpc roughness due to low speed
-    self.libmpc.run_mpc(self.cur_state, self.mpc_solution,
-                        list(self.LP.l_poly), list(self.LP.r_poly), list(self.LP.d_poly),
-                        self.LP.l_prob, self.LP.r_prob, curvature_factor, v_ego_mpc, self.LP.lane_width)
+    self.mpc.run(self.LP.l_poly, self.LP.r_poly, self.LP.d_poly,
+                 self.LP.l_prob, self.LP.r_prob, curvature_factor, v_ego_mpc, self.LP.lane_width)
 
     # reset to current steer angle if not active or overriding
     if active:
-      delta_desired = self.mpc_solution[0].delta[1]
-      rate_desired = math.degrees(self.mpc_solution[0].rate[0] * VM.sR)
+      delta_desired = self.mpc_solution['delta'][1]
+      rate_desired = math.degrees(self.mpc_solution['rate'][0] * VM.sR)
     else:
       delta_desired = math.radians(angle_steers - angle_offset) / VM.sR
       rate_desired = 0.0
 
-    self.cur_state[0].delta = delta_desired
+    self.cur_state['delta'] = delta_desired
 
     self.angle_steers_des_mpc = float(math.degrees(delta_desired * VM.sR) + angle_offset)
 
     #  Check for infeasable MPC solution
-    mpc_nans = any(math.isnan(x) for x in self.mpc_solution[0].delta)
+    mpc_nans = bool(np.isnan(self.mpc_solution['delta']).any())
     t = sec_since_boot()
     if mpc_nans:
-      self.libmpc.init(MPC_COST_LAT.PATH, MPC_COST_LAT.LANE, MPC_COST_LAT.HEADING, CP.steerRateCost)
-      self.cur_state[0].delta = math.radians(angle_steers - angle_offset) / VM.sR
+      self.mpc.init(MPC_COST_LAT.PATH, MPC_COST_LAT.LANE, MPC_COST_LAT.HEADING, CP.steerRateCost)
+      self.cur_state['delta'] = math.radians(angle_steers - angle_offset) / VM.sR
 
       if t > self.last_cloudlog_t + 5.0:
         self.last_cloudlog_t = t
         cloudlog.warning("Lateral mpc - nan: True")
 
-    if self.mpc_solution[0].cost > 20000. or mpc_nans:   # TODO: find a better way to detect when MPC did not converge
+    if self.mpc_solution['cost'] > 20000. or mpc_nans:   # TODO: find a better way to detect when MPC did not converge
       self.solution_invalid_cnt += 1
     else:
       self.solution_invalid_cnt = 0
@@ -231,9 +232,9 @@ class PathPlanner():
 
     if LOG_MPC:
       dat = messaging.new_message('liveMpc')
-      dat.liveMpc.x = list(self.mpc_solution[0].x)
-      dat.liveMpc.y = list(self.mpc_solution[0].y)
-      dat.liveMpc.psi = list(self.mpc_solution[0].psi)
-      dat.liveMpc.delta = list(self.mpc_solution[0].delta)
-      dat.liveMpc.cost = self.mpc_solution[0].cost
+      dat.liveMpc.x = self.mpc_solution['x'].tolist()
+      dat.liveMpc.y = self.mpc_solution['y'].tolist()
+      dat.liveMpc.psi = self.mpc_solution['psi'].tolist()
+      dat.liveMpc.delta = self.mpc_solution['delta'].tolist()
+      dat.liveMpc.cost = float(self.mpc_solution['cost'])
       pm.send('liveMpc', dat)
@@ -9,7 +9,7 @@ from common.numpy_fast import interp
 from common.params import Params
 from common.realtime import Ratekeeper, Priority, set_realtime_priority
 from selfdrive.config import RADAR_TO_CAMERA
-from selfdrive.controls.lib.cluster.fastcluster_py import cluster_points_centroid
+from selfdrive.controls.lib.cluster.fastcluster_py import ClusterEngine
 from selfdrive.controls.lib.radar_helpers import Cluster, Track
 from selfdrive.swaglog import cloudlog
 
@@ -90,6 +90,7 @@ class RadarD():
 
     self.tracks = defaultdict(dict)
     self.kalman_params = KalmanParams(radar_ts)
+    self.cluster_engine = ClusterEngine(2.5)
 
     self.active = 0
 
@@ -133,23 +134,15 @@ class RadarD():
     idens = list(sorted(self.tracks.keys()))
     track_pts = list([self.tracks[iden].get_key_for_cluster() for iden in idens])
 
-    # If we have multiple points, cluster them
-    if len(track_pts) > 1:
-      cluster_idxs = cluster_points_centroid(track_pts, 2.5)
-      clusters = [None] * (max(cluster_idxs) + 1)
-
-      for idx in range(len(track_pts)):
-        cluster_i = cluster_idxs[idx]
-        if clusters[cluster_i] is None:
-          clusters[cluster_i] = Cluster()
-        clusters[cluster_i].add(self.tracks[idens[idx]])
-    elif len(track_pts) == 1:
-      # FIXME: cluster_point_centroid hangs forever if len(track_pts) == 1
-      cluster_idxs = [0]
-      clusters = [Cluster()]
-      clusters[0].add(self.tracks[idens[0]])
-    else:
-      clusters = []
+    # Cluster the points, the engine keeps the clusters of tracks that didn't change
+    cluster_idxs = self.cluster_engine.update(idens, track_pts)
+    clusters = [None] * (max(cluster_idxs, default=-1) + 1)
+
+    for idx in range(len(track_pts)):
+      cluster_i = cluster_idxs[idx]
+      if clusters[cluster_i] is None:
+        clusters[cluster_i] = Cluster()
+      clusters[cluster_i].add(self.tracks[idens[idx]])
 
     # if a new point, reset accel to the rest of the cluster
     for idx in range(len(track_pts)):
@@ -8,7 +8,7 @@ from scipy.cluster import _hierarchy
 from scipy.spatial.distance import pdist
 
 from selfdrive.controls.lib.cluster.fastcluster_py import hclust, ffi
-from selfdrive.controls.lib.cluster.fastcluster_py import cluster_points_centroid
+from selfdrive.controls.lib.cluster.fastcluster_py import cluster_points_centroid, ClusterEngine
 
 
 def fcluster(Z, t, criterion='inconsistent', depth=2, R=None, monocrit=None):
@@ -135,6 +135,24 @@ class TestClustering(unittest.TestCase):
 
       self.assertTrue(same_clusters(old_cluster_idx, cluster_idx))
 
+  def test_engine_clustering(self):
+    np.random.seed(1337)
+    engine = ClusterEngine(2.5)
+    self.assertEqual(engine.update([], []), [])
+
+    ids = np.arange(32)
+    pts = np.hstack([np.random.uniform(-10, 50, (32, 1)),
+                     np.random.uniform(-5, 5, (32, 1)),
+                     np.random.uniform(-5, 5, (32, 1))])
+    for _ in range(200):
+      # some tracks move, some are replaced
+      moving = np.random.uniform(0, 1, len(ids)) < 0.5
+      pts[moving] += np.random.uniform(-0.25, 0.25, (moving.sum(), 3))
+      gone = np.random.uniform(0, 1, len(ids)) < 0.05
+      ids = np.where(gone, ids.max() + 1 + np.arange(len(ids)), ids)
+
+      self.assertEqual(engine.update(ids, pts), cluster_points_centroid(pts, 2.5))
+
 
 if __name__ == "__main__":
   unittest.main()
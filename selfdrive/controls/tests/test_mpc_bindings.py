@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+import unittest
+import numpy as np
+
+from selfdrive.controls.lib.lateral_mpc import libmpc_py as lateral_py
+from selfdrive.controls.lib.lateral_mpc.libmpc_impl import LateralMpc  # pylint: disable=no-name-in-module, import-error
+from selfdrive.controls.lib.longitudinal_mpc import libmpc_py as longitudinal_py
+from selfdrive.controls.lib.longitudinal_mpc.libmpc_impl import LongitudinalMpc  # pylint: disable=no-name-in-module, import-error
+from selfdrive.controls.lib.longitudinal_mpc_model import libmpc_py as model_py
+from selfdrive.controls.lib.longitudinal_mpc_model.libmpc_impl import LongitudinalMpcModel  # pylint: disable=no-name-in-module, import-error
+
+SOLVES = 50
+
+
+def lanes(i):
+  # a curve that slowly comes and goes
+  c = 0.002 * np.sin(0.1 * i)
+  l_poly = np.array([0., c, 0.01, 1.8])
+  r_poly = np.array([0., c, 0.01, -1.8])
+  d_poly = np.array([0., c, 0.01, 0.1 * np.cos(0.1 * i)])
+  return l_poly, r_poly, d_poly
+
+
+class TestMpcBindings(unittest.TestCase):
+
+  def test_lateral_same_as_cffi(self):
+    ffi, lib = lateral_py.ffi, lateral_py.libmpc
+    ctx = ffi.gc(lib.mpc_create(), lib.mpc_destroy)
+    lib.mpc_init(ctx, 1.0, 3.0, 1.0, 1.0)
+    state, solution = ffi.new("state_t *"), ffi.new("log_t *")
+
+    mpc = LateralMpc()
+    mpc.init(1.0, 3.0, 1.0, 1.0)
+
+    for i in range(SOLVES):
+      l_poly, r_poly, d_poly = lanes(i)
+      its = lib.mpc_run(ctx, state, solution, list(l_poly), list(r_poly), list(d_poly), 1.0, 1.0, 0.01, 20.0, 3.6)
+      self.assertEqual(mpc.run(l_poly, r_poly, d_poly, 1.0, 1.0, 0.01, 20.0, 3.6), its)
+      for field in ['x', 'y', 'psi', 'delta', 'rate']:
+        self.assertEqual(list(getattr(solution[0], field)), mpc.solution[0][field].tolist())
+      self.assertEqual(solution[0].cost, mpc.solution[0]['cost'])
+
+      state[0].delta = solution[0].delta[1]
+      mpc.state[0]['delta'] = mpc.solution[0]['delta'][1]
+
+  def test_longitudinal_same_as_cffi(self):
+    ffi, lib = longitudinal_py.ffi, longitudinal_py.libmpc
+    ctx = ffi.gc(lib.mpc_create(), lib.mpc_destroy)
+    lib.mpc_init(ctx, 5.0, 0.1, 10.0, 20.0)
+    lib.mpc_init_with_simulation(ctx, 20.0, 30.0, 18.0, 0.0, 1.5)
+    state, solution = ffi.new("state_t *"), ffi.new("log_t *")
+
+    mpc = LongitudinalMpc()
+    mpc.init(5.0, 0.1, 10.0, 20.0)
+    mpc.init_with_simulation(20.0, 30.0, 18.0, 0.0, 1.5)
+
+    state[0].v_ego, state[0].x_l, state[0].v_l = 20.0, 30.0, 18.0
+    mpc.state[0] = (0.0, 20.0, 0.0, 30.0, 18.0, 0.0)
+
+    for i in range(SOLVES):
+      a_lead = -0.5 * np.sin(0.1 * i)
+      its = lib.mpc_run(ctx, state, solution, 1.5, a_lead)
+      self.assertEqual(mpc.run(1.5, a_lead), its)
+      for field in ['x_ego', 'v_ego', 'a_ego', 'j_ego', 'x_l', 'v_l', 'a_l']:
+        self.assertEqual(list(getattr(solution[0], field)), mpc.solution[0][field].tolist())
+
+      state[0].a_ego = solution[0].a_ego[1]
+      mpc.state[0]['a_ego'] = mpc.solution[0]['a_ego'][1]
+
+  def test_model_same_as_cffi(self):
+    ffi, lib = model_py.ffi, model_py.libmpc
+    ctx = ffi.gc(lib.mpc_create(), lib.mpc_destroy)
+    lib.mpc_init(ctx, 1.0, 1.0, 1.0, 1.0, 1.0)
+    lib.mpc_init_with_simulation(ctx, 10.0)
+    state, solution = ffi.new("state_t *"), ffi.new("log_t *")
+
+    mpc = LongitudinalMpcModel()
+    mpc.init(1.0, 1.0, 1.0, 1.0, 1.0)
+    mpc.init_with_simulation(10.0)
+
+    state[0].v_ego = 10.0
+    mpc.state[0]['v_ego'] = 10.0
+    for i in range(SOLVES):
+      x_poly = np.array([0., 0., 10.0 + 0.5 * np.sin(0.1 * i), 0.])
+      v_poly = np.array([0., 0., 0.1, 10.0])
+      a_poly = np.array([0., 0., 0., 0.1])
+      lib.mpc_run(ctx, state, solution, list(x_poly), list(v_poly), list(a_poly))
+      mpc.run(x_poly, v_poly, a_poly)
+      self.assertEqual(list(solution[0].v_ego), mpc.solution[0]['v_ego'].tolist())
+
+      state[0].v_ego = solution[0].v_ego[1]
+      mpc.state[0]['v_ego'] = mpc.solution[0]['v_ego'][1]
+
+  def test_batch_same_as_single(self):
+    deltas = [-0.05, 0.0, 0.05, 0.1]
+    batch = LateralMpc(len(deltas))
+    batch.init(1.0, 3.0, 1.0, 1.0)
+    singles = [LateralMpc() for _ in deltas]
+    for mpc, delta in zip(singles, deltas):
+      mpc.init(1.0, 3.0, 1.0, 1.0)
+      mpc.state[0]['delta'] = delta
+    batch.state['delta'] = deltas
+
+    for i in range(SOLVES):
+      l_poly, r_poly, d_poly = lanes(i)
+      batch.run(l_poly, r_poly, d_poly, 1.0, 1.0, 0.01, 20.0, 3.6)
+      for k, mpc in enumerate(singles):
+        mpc.run(l_poly, r_poly, d_poly, 1.0, 1.0, 0.01, 20.0, 3.6)
+        self.assertEqual(batch.solution[k]['delta'].tolist(), mpc.solution[0]['delta'].tolist())
+        self.assertEqual(batch.qp_iterations[k], mpc.qp_iterations[0])
+
+    # different starts give different plans
+    self.assertNotEqual(batch.solution[0]['delta'].tolist(), batch.solution[-1]['delta'].tolist())
+
+  def test_solution_reused(self):
+    mpc = LateralMpc()
+    mpc.init(1.0, 3.0, 1.0, 1.0)
+    solution, address = mpc.solution, mpc.solution.__array_interface__['data'][0]
+    mpc.run(*lanes(0), 1.0, 1.0, 0.01, 20.0, 3.6)
+    self.assertIs(mpc.solution, solution)
+    self.assertEqual(mpc.solution.__array_interface__['data'][0], address)
+    self.assertNotEqual(solution[0]['cost'], 0.0)
+
+  def test_bad_polys(self):
+    mpc = LateralMpc()
+    l_poly, r_poly, d_poly = lanes(0)
+    with self.assertRaises(ValueError):
+      mpc.run(l_poly[:3], r_poly, d_poly, 1.0, 1.0, 0.01, 20.0, 3.6)
+    with self.assertRaises(ValueError):
+      mpc.run(l_poly.astype(np.float32), r_poly, d_poly, 1.0, 1.0, 0.01, 20.0, 3.6)
+
+
+if __name__ == "__main__":
+  unittest.main()
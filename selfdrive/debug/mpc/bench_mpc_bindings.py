@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+import math
+import time
+import numpy as np
+
+from selfdrive.controls.lib.lateral_mpc import libmpc_py
+from selfdrive.controls.lib.lateral_mpc.libmpc_impl import LateralMpc  # pylint: disable=no-name-in-module, import-error
+
+# Time the Python side of a lateral MPC solve: the wall time of a call less the time the
+# solver reports for itself (solve_us), with the cffi bindings and with libmpc_impl, and
+# a batched run against as many single runs.
+#   python3 bench_mpc_bindings.py [calls]
+
+BATCH = 4
+
+l_poly = np.array([0., 0.001, 0.01, 1.8])
+r_poly = np.array([0., 0.001, 0.01, -1.8])
+d_poly = np.array([0., 0.001, 0.01, 0.])
+
+
+def bench(name, run, solve_us, calls):
+  wall, solver = [], []
+  for _ in range(calls):
+    t = time.perf_counter()
+    run()
+    wall.append((time.perf_counter() - t) * 1e6)
+    solver.append(solve_us())
+
+  wall, solver = np.array(wall), np.array(solver)
+  overhead = wall - solver
+  print("%-32s %9.1f %9.1f %9.2f %9.2f" % (name, np.median(wall), np.median(solver),
+                                             np.median(overhead), np.percentile(overhead, 99)))
+
+
+def cffi_mpc():
+  ffi, lib = libmpc_py.ffi, libmpc_py.libmpc
+  ctx = ffi.gc(lib.mpc_create(), lib.mpc_destroy)
+  lib.mpc_init(ctx, 1.0, 3.0, 1.0, 1.0)
+  state, solution = ffi.new("state_t *"), ffi.new("log_t *")
+
+  # as the planner called it
+  def run():
+    lib.mpc_run(ctx, state, solution, list(l_poly), list(r_poly), list(d_poly), 1.0, 1.0, 0.01, 20.0, 3.6)
+    state[0].delta = solution[0].delta[1]
+    return any(math.isnan(x) for x in solution[0].delta)
+  return run, lambda: solution[0].solve_us
+
+
+def ext_mpc(n):
+  mpc = LateralMpc(n)
+  mpc.init(1.0, 3.0, 1.0, 1.0)
+
+  def run():
+    mpc.run(l_poly, r_poly, d_poly, 1.0, 1.0, 0.01, 20.0, 3.6)
+    mpc.state['delta'] = mpc.solution['delta'][:, 1]
+    return np.isnan(mpc.solution['delta']).any()
+  return run, lambda: mpc.solution['solve_us'].sum()
+
+
+def singles(n):
+  runs = [ext_mpc(1) for _ in range(n)]
+
+  def run():
+    for r, _ in runs:
+      r()
+  return run, lambda: sum(s() for _, s in runs)
+
+
+if __name__ == "__main__":
+  import sys
+  calls = int(sys.argv[1]) if len(sys.argv) > 1 else 5000
+
+  print("%-32s %9s %9s %9s %9s" % ("", "wall us", "solve us", "overhead", "p99"))
+  bench("cffi", *cffi_mpc(), calls)
+  bench("libmpc_impl", *ext_mpc(1), calls)
+  bench("libmpc_impl, %d single runs" % BATCH, *singles(BATCH), calls)
+  bench("libmpc_impl, batch of %d" % BATCH, *ext_mpc(BATCH), calls)
@@ -42,7 +42,7 @@ min_a_lead_tau = 0.0
 print(a_lead_tau, min_a_lead_tau)
 a_lead_tau = max(a_lead_tau, min_a_lead_tau)
 
-ffi, libmpc = libmpc_py.get_libmpc(1)
+ffi, libmpc = libmpc_py.ffi, libmpc_py.libmpc
 libmpc.init(MPC_COST_LONG.TTC, MPC_COST_LONG.DISTANCE, MPC_COST_LONG.ACCELERATION, MPC_COST_LONG.JERK)
 libmpc.init_with_simulation(v_ego, x_lead, v_lead, a_lead, a_lead_tau)
 
@@ -122,7 +122,7 @@ plt.show()
 # a_lead_tau = 1.5
 # a_lead_tau = max(a_lead_tau, -a_lead / (v_lead + 0.01))
 
-# ffi, libmpc = libmpc_py.get_libmpc(1)
+# ffi, libmpc = libmpc_py.ffi, libmpc_py.libmpc
 # libmpc.init(MPC_COST_LONG.TTC, MPC_COST_LONG.DISTANCE, MPC_COST_LONG.ACCELERATION, MPC_COST_LONG.JERK)
 # libmpc.init_with_simulation(v_ego, x_lead, v_lead, a_lead, a_lead_tau)
 
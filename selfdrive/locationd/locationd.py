@@ -22,6 +22,8 @@ from rednose.helpers.sympy_helpers import euler_rotate
 
 VISION_DECIMATION = 2
 SENSOR_DECIMATION = 10
+# the gyro and accelerometer are used at 10 Hz, whatever rate sensord reads them at
+SENSOR_PERIOD = 0.1
 POSENET_STD_HIST = 40
 
 
@@ -237,8 +239,9 @@ class Localizer():
     for sensor_reading in log:
       # Gyro Uncalibrated
       if sensor_reading.sensor == 5 and sensor_reading.type == 16:
-        self.gyro_counter += 1
-        if self.gyro_counter % SENSOR_DECIMATION == 0:
+        t = sensor_reading.timestamp * 1e-9
+        if t - self.gyro_t > SENSOR_PERIOD - 1e-3:
+          self.gyro_t = t
           v = sensor_reading.gyroUncalibrated.v
           self.update_kalman(current_time, ObservationKind.PHONE_GYRO, [-v[2], -v[1], -v[0]])
 
@@ -248,8 +251,9 @@ class Localizer():
         # 40m/s**2 is a good filter for falling detection, no false positives in 20k minutes of driving
         self.device_fell = self.device_fell or (np.linalg.norm(np.array(sensor_reading.acceleration.v) - np.array([10, 0, 0])) > 40)
 
-        self.acc_counter += 1
-        if self.acc_counter % SENSOR_DECIMATION == 0:
+        t = sensor_reading.timestamp * 1e-9
+        if t - self.acc_t > SENSOR_PERIOD - 1e-3:
+          self.acc_t = t
           v = sensor_reading.acceleration.v
           self.update_kalman(current_time, ObservationKind.PHONE_ACCEL, [-v[2], -v[1], -v[0]])
 
@@ -270,8 +274,8 @@ class Localizer():
 
     self.observation_buffer = []
 
-    self.gyro_counter = 0
-    self.acc_counter = 0
+    self.gyro_t = -np.inf
+    self.acc_t = -np.inf
     self.speed_counter = 0
     self.cam_counter = 0
 
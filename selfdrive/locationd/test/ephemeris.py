@@ -71,7 +71,7 @@ on of this parser
     i_0 = (GET_FIELD_S(subframes[3][2+2], 8, 6) << 24) | GET_FIELD_U(
       subframes[3][2+3], 24, 6)
     c_rc = GET_FIELD_S(subframes[3][2+4], 16, 14)
-    w = (GET_FIELD_S(subframes[3][2+4], 8, 6) << 24) | GET_FIELD_U(subframes[3][5], 24, 6)
+    w = (GET_FIELD_S(subframes[3][2+4], 8, 6) << 24) | GET_FIELD_U(subframes[3][2+5], 24, 6)
     omega_dot = GET_FIELD_S(subframes[3][2+6], 24, 6)
     idot = GET_FIELD_S(subframes[3][2+7], 14, 8)
 
@@ -115,9 +115,9 @@ on of this parser
     self.valid = (iode1 == iode2) and (iode1 == (iodc & 0xff))
     self.iode = iode1
 
-    if GET_FIELD_U(subframes[4][2+0], 6, 22) == 56 and \
-       GET_FIELD_U(subframes[4][2+0], 2, 28) == 1 and \
-       GET_FIELD_U(subframes[5][2+0], 2, 28) == 1:
+    if 4 in subframes and \
+       GET_FIELD_U(subframes[4][2+0], 6, 22) == 56 and \
+       GET_FIELD_U(subframes[4][2+0], 2, 28) == 1:
       a0 = GET_FIELD_S(subframes[4][2], 8, 14) * math.pow(2, -30)
       a1 = GET_FIELD_S(subframes[4][2], 8, 6) * math.pow(2, -27)
       a2 = GET_FIELD_S(subframes[4][3], 8, 22) * math.pow(2, -24)
@@ -155,6 +155,9 @@ def gen_solution(msg):
   }
   return log.Event.new_message(gpsLocationExternal=gps_fix)
 
+# word and bit of alpha0-3 and beta0-3 in page 18 of subframe 4
+IONO_FIELDS = ((2, 14), (2, 6), (3, 22), (3, 14), (3, 6), (4, 22), (4, 14), (4, 6))
+
 def gen_nav_data(msg, nav_frame_buffer):
   # TODO this stuff needs to be parsed and published.
   # refer to https://www.u-blox.com/sites/default/files/products/documents/u-blox8-M8_ReceiverDescrProtSpec_%28UBX-13003221%29.pdf
@@ -170,15 +173,39 @@ def gen_nav_data(msg, nav_frame_buffer):
     for m in measurements:
       words.append(m['dwrd'])
 
+    # like ubloxd, an ephemeris is sent when its IODC/IODE or the ionosphere parameters change
+    sat = nav_frame_buffer[gnssId][svId]
+    if subframeId == 4:
+      # page 18 has the ionosphere parameters
+      if GET_FIELD_U(words[2], 6, 22) != 56 or GET_FIELD_U(words[2], 2, 28) != 1:
+        return
+      iono = [GET_FIELD_U(words[w], 8, pos) for w, pos in IONO_FIELDS]
+      changed = sat.get('iono') != iono
+      sat['iono'] = iono
+      sat['iono_words'] = words
+      if 'sent' in sat and changed:
+        subframes = dict(sat['sent'])
+        subframes[4] = words
+        return gen_ephemeris(EphemerisData(svId, subframes))
+      return
+
     # parse from
     if subframeId == 1:
-      nav_frame_buffer[gnssId][svId] = {}
-      nav_frame_buffer[gnssId][svId][subframeId] = words
-    elif subframeId-1 in nav_frame_buffer[gnssId][svId]:
-      nav_frame_buffer[gnssId][svId][subframeId] = words
-    if len(nav_frame_buffer[gnssId][svId]) == 5:
-      ephem_data = EphemerisData(svId, nav_frame_buffer[gnssId][svId])
-      return gen_ephemeris(ephem_data)
+      sat['frames'] = {subframeId: words}
+    elif subframeId in (2, 3) and subframeId-1 in sat.get('frames', {}):
+      sat['frames'][subframeId] = words
+    if subframeId == 3 and 3 in sat.get('frames', {}):
+      frames = sat['frames']
+      iodc = (GET_FIELD_U(frames[1][2], 2, 6) << 8) | GET_FIELD_U(frames[1][7], 8, 22)
+      iode = GET_FIELD_U(frames[2][2], 8, 22)
+      if iode != GET_FIELD_U(frames[3][9], 8, 22) or iode != (iodc & 0xff) or sat.get('iod') == (iodc, iode):
+        return
+      sat['iod'] = (iodc, iode)
+      sat['sent'] = dict(frames)
+      subframes = dict(frames)
+      if 'iono_words' in sat:
+        subframes[4] = sat['iono_words']
+      return gen_ephemeris(EphemerisData(svId, subframes))
 
 
 def gen_raw(msg):
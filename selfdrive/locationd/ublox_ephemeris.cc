@@ -0,0 +1,343 @@
+#include <string.h>
+
+#include "ublox_ephemeris.h"
+
+#define GET_FIELD_U(w, nb, pos) (((w) >> (pos)) & ((1<<(nb))-1))
+
+namespace ublox {
+
+inline int twos_complement(uint32_t v, uint32_t nb) {
+  int sign = v >> (nb - 1);
+  int value = v;
+  if(sign != 0)
+    value = value - (1 << nb);
+  return value;
+}
+
+inline int GET_FIELD_S(uint32_t w, uint32_t nb, uint32_t pos) {
+  int v = GET_FIELD_U(w, nb, pos);
+  return twos_complement(v, nb);
+}
+
+// the value of pi of the GPS and Galileo ICDs, angles are sent in semicircles
+constexpr double GPS_PI = 3.1415926535898;
+
+constexpr double P2_5 = 1.0 / (1LL << 5);
+constexpr double P2_11 = 1.0 / (1LL << 11);
+constexpr double P2_19 = 1.0 / (1LL << 19);
+constexpr double P2_20 = 1.0 / (1LL << 20);
+constexpr double P2_24 = 1.0 / (1LL << 24);
+constexpr double P2_27 = 1.0 / (1LL << 27);
+constexpr double P2_29 = 1.0 / (1LL << 29);
+constexpr double P2_30 = 1.0 / (1LL << 30);
+constexpr double P2_31 = 1.0 / (1LL << 31);
+constexpr double P2_33 = 1.0 / (1LL << 33);
+constexpr double P2_34 = 1.0 / (1LL << 34);
+constexpr double P2_40 = 1.0 / (1LL << 40);
+constexpr double P2_43 = 1.0 / (1LL << 43);
+constexpr double P2_46 = 1.0 / (1LL << 46);
+constexpr double P2_55 = 1.0 / (1LL << 55);
+constexpr double P2_59 = 1.0 / (1LL << 59);
+
+// GPS subframe words have the 24 data bits at bit 6, the parity is in the low 6 bits
+struct GpsField {
+  uint8_t subframe, word, bits, pos;
+  bool is_signed;
+  // a 32 bit field, the low 24 bits are in the next word
+  bool split;
+  double scale;
+  double GpsEphemeris::*dst;
+};
+
+static const GpsField gps_fields[] = {
+  {1, 6, 8, 6, true, false, P2_31, &GpsEphemeris::Tgd},
+  {1, 7, 16, 6, false, false, 16, &GpsEphemeris::toc},
+  {1, 8, 8, 22, true, false, P2_55, &GpsEphemeris::af2},
+  {1, 8, 16, 6, true, false, P2_43, &GpsEphemeris::af1},
+  {1, 9, 22, 8, true, false, P2_31, &GpsEphemeris::af0},
+
+  {2, 2, 16, 6, true, false, P2_5, &GpsEphemeris::crs},
+  {2, 3, 16, 14, true, false, P2_43 * GPS_PI, &GpsEphemeris::deltaN},
+  {2, 3, 8, 6, true, true, P2_31 * GPS_PI, &GpsEphemeris::M0},
+  {2, 5, 16, 14, true, false, P2_29, &GpsEphemeris::cuc},
+  {2, 5, 8, 6, false, true, P2_33, &GpsEphemeris::ecc},
+  {2, 7, 16, 14, true, false, P2_29, &GpsEphemeris::cus},
+  // the square root of A
+  {2, 7, 8, 6, false, true, P2_19, &GpsEphemeris::A},
+  {2, 9, 16, 14, false, false, 16, &GpsEphemeris::toe},
+
+  {3, 2, 16, 14, true, false, P2_29, &GpsEphemeris::cic},
+  {3, 2, 8, 6, true, true, P2_31 * GPS_PI, &GpsEphemeris::omega0},
+  {3, 4, 16, 14, true, false, P2_29, &GpsEphemeris::cis},
+  {3, 4, 8, 6, true, true, P2_31 * GPS_PI, &GpsEphemeris::i0},
+  {3, 6, 16, 14, true, false, P2_5, &GpsEphemeris::crc},
+  {3, 6, 8, 6, true, true, P2_31 * GPS_PI, &GpsEphemeris::omega},
+  {3, 8, 24, 6, true, false, P2_43 * GPS_PI, &GpsEphemeris::omega_dot},
+  {3, 9, 14, 8, true, false, P2_43 * GPS_PI, &GpsEphemeris::idot},
+};
+
+// alpha0-3 and beta0-3 in page 18 of subframe 4, 8 bits each
+static const struct {
+  uint8_t word, pos;
+  double scale;
+} gps_iono_fields[8] = {
+  {2, 14, P2_30}, {2, 6, P2_27}, {3, 22, P2_24}, {3, 14, P2_24},
+  {3, 6, 1 << 11}, {4, 22, 1 << 14}, {4, 14, 1 << 16}, {4, 6, 1 << 16},
+};
+
+enum {
+  UNSIGNED,
+  TWOS_COMPLEMENT,
+  SIGN_MAGNITUDE,
+};
+
+// a field of the GLONASS strings or Galileo words, bit 0 is the most significant bit of the first word
+template <typename T>
+struct NavField {
+  // string number or word type
+  uint8_t page;
+  uint8_t start, bits, encoding;
+  double scale;
+  double T::*dst;
+};
+
+// GLONASS numbers are sign and magnitude. x, y and z are in km, km/s and km/s^2
+static const NavField<GlonassEphemeris> glonass_fields[] = {
+  {1, 21, 24, SIGN_MAGNITUDE, 1e3 * P2_20, &GlonassEphemeris::xVel},
+  {1, 45, 5, SIGN_MAGNITUDE, 1e3 * P2_30, &GlonassEphemeris::xAccel},
+  {1, 50, 27, SIGN_MAGNITUDE, 1e3 * P2_11, &GlonassEphemeris::x},
+  {2, 21, 24, SIGN_MAGNITUDE, 1e3 * P2_20, &GlonassEphemeris::yVel},
+  {2, 45, 5, SIGN_MAGNITUDE, 1e3 * P2_30, &GlonassEphemeris::yAccel},
+  {2, 50, 27, SIGN_MAGNITUDE, 1e3 * P2_11, &GlonassEphemeris::y},
+  {3, 6, 11, SIGN_MAGNITUDE, P2_40, &GlonassEphemeris::gammaN},
+  {3, 21, 24, SIGN_MAGNITUDE, 1e3 * P2_20, &GlonassEphemeris::zVel},
+  {3, 45, 5, SIGN_MAGNITUDE, 1e3 * P2_30, &GlonassEphemeris::zAccel},
+  {3, 50, 27, SIGN_MAGNITUDE, 1e3 * P2_11, &GlonassEphemeris::z},
+  {4, 5, 22, SIGN_MAGNITUDE, P2_30, &GlonassEphemeris::tauN},
+  {4, 27, 5, SIGN_MAGNITUDE, P2_30, &GlonassEphemeris::deltaTauN},
+};
+
+static const NavField<GalileoEphemeris> galileo_fields[] = {
+  {1, 16, 14, UNSIGNED, 60, &GalileoEphemeris::toe},
+  {1, 30, 32, TWOS_COMPLEMENT, P2_31 * GPS_PI, &GalileoEphemeris::M0},
+  {1, 62, 32, UNSIGNED, P2_33, &GalileoEphemeris::ecc},
+  // the square root of A
+  {1, 94, 32, UNSIGNED, P2_19, &GalileoEphemeris::A},
+
+  {2, 16, 32, TWOS_COMPLEMENT, P2_31 * GPS_PI, &GalileoEphemeris::omega0},
+  {2, 48, 32, TWOS_COMPLEMENT, P2_31 * GPS_PI, &GalileoEphemeris::i0},
+  {2, 80, 32, TWOS_COMPLEMENT, P2_31 * GPS_PI, &GalileoEphemeris::omega},
+  {2, 112, 14, TWOS_COMPLEMENT, P2_43 * GPS_PI, &GalileoEphemeris::iDot},
+
+  {3, 16, 24, TWOS_COMPLEMENT, P2_43 * GPS_PI, &GalileoEphemeris::omegaDot},
+  {3, 40, 16, TWOS_COMPLEMENT, P2_43 * GPS_PI, &GalileoEphemeris::deltaN},
+  {3, 56, 16, TWOS_COMPLEMENT, P2_29, &GalileoEphemeris::cuc},
+  {3, 72, 16, TWOS_COMPLEMENT, P2_29, &GalileoEphemeris::cus},
+  {3, 88, 16, TWOS_COMPLEMENT, P2_5, &GalileoEphemeris::crc},
+  {3, 104, 16, TWOS_COMPLEMENT, P2_5, &GalileoEphemeris::crs},
+
+  {4, 22, 16, TWOS_COMPLEMENT, P2_29, &GalileoEphemeris::cic},
+  {4, 38, 16, TWOS_COMPLEMENT, P2_29, &GalileoEphemeris::cis},
+  {4, 54, 14, UNSIGNED, 60, &GalileoEphemeris::toc},
+  {4, 68, 31, TWOS_COMPLEMENT, P2_34, &GalileoEphemeris::af0},
+  {4, 99, 21, TWOS_COMPLEMENT, P2_46, &GalileoEphemeris::af1},
+  {4, 120, 6, TWOS_COMPLEMENT, P2_59, &GalileoEphemeris::af2},
+};
+
+// up to 32 bits from a 4 word page
+static inline uint32_t bits_at(const uint32_t *w, int start, int bits) {
+  const int i = start / 32;
+  const uint64_t v = ((uint64_t)w[i] << 32) | (i < 3 ? w[i + 1] : 0);
+  return (v >> (64 - start % 32 - bits)) & ((1ULL << bits) - 1);
+}
+
+static inline int64_t field_value(uint32_t v, int bits, uint8_t encoding) {
+  const bool negative = (v >> (bits - 1)) & 1;
+  if(encoding == TWOS_COMPLEMENT && negative) {
+    return (int64_t)v - (1LL << bits);
+  } else if(encoding == SIGN_MAGNITUDE && negative) {
+    return -(int64_t)(v & ((1ULL << (bits - 1)) - 1));
+  }
+  return v;
+}
+
+template <typename T, size_t N>
+static void decode_fields(T &eph, const NavField<T> (&fields)[N], const uint32_t (*pages)[4]) {
+  for(const auto &f : fields) {
+    eph.*f.dst = field_value(bits_at(pages[f.page], f.start, f.bits), f.bits, f.encoding) * f.scale;
+  }
+}
+
+EphemerisStore::EphemerisStore() : complete_sets(0), decoded_sets(0) {
+  memset(gps_sats, 0, sizeof(gps_sats));
+  memset(glonass_sats, 0, sizeof(glonass_sats));
+  memset(galileo_sats, 0, sizeof(galileo_sats));
+}
+
+bool EphemerisStore::add_subframe(uint8_t gnss_id, uint8_t svid, uint8_t freq_id, const uint32_t *words, int num_words) {
+  switch(gnss_id) {
+  case GNSS_GPS:
+    return add_gps(svid, words, num_words);
+  case GNSS_GLONASS:
+    return add_glonass(svid, freq_id, words, num_words);
+  case GNSS_GALILEO:
+    return add_galileo(svid, words, num_words);
+  default:
+    return false;
+  }
+}
+
+const GpsEphemeris *EphemerisStore::gps(int svid) const {
+  if(svid < 1 || svid > GPS_SATS || !gps_sats[svid].valid) return NULL;
+  return &gps_sats[svid].eph;
+}
+
+const GlonassEphemeris *EphemerisStore::glonass(int svid) const {
+  if(svid < 1 || svid > GLONASS_SATS || !glonass_sats[svid].valid) return NULL;
+  return &glonass_sats[svid].eph;
+}
+
+const GalileoEphemeris *EphemerisStore::galileo(int svid) const {
+  if(svid < 1 || svid > GALILEO_SATS || !galileo_sats[svid].valid) return NULL;
+  return &galileo_sats[svid].eph;
+}
+
+bool EphemerisStore::add_gps(uint8_t svid, const uint32_t *words, int num_words) {
+  if(svid < 1 || svid > GPS_SATS || num_words != SFRBX_MAX_WORDS) return false;
+  auto &sat = gps_sats[svid];
+  GpsEphemeris &eph = sat.eph;
+  const int subframe = GET_FIELD_U(words[1], 3, 8);
+
+  if(subframe == 4) {
+    // page 18 has the ionosphere parameters
+    if(GET_FIELD_U(words[2], 6, 22) != 56 || GET_FIELD_U(words[2], 2, 28) != 1) return false;
+    double iono[8];
+    for(int i = 0; i < 8; i++) {
+      iono[i] = GET_FIELD_S(words[gps_iono_fields[i].word], 8, gps_iono_fields[i].pos) * gps_iono_fields[i].scale;
+    }
+    const bool changed = !eph.ionoCoeffsValid || memcmp(eph.ionoAlpha, &iono[0], sizeof(eph.ionoAlpha)) != 0 ||
+                         memcmp(eph.ionoBeta, &iono[4], sizeof(eph.ionoBeta)) != 0;
+    memcpy(eph.ionoAlpha, &iono[0], sizeof(eph.ionoAlpha));
+    memcpy(eph.ionoBeta, &iono[4], sizeof(eph.ionoBeta));
+    eph.ionoCoeffsValid = true;
+    return sat.valid && changed;
+  }
+
+  // an ephemeris starts with subframe 1, the others are only kept in order
+  if(subframe == 1) {
+    sat.received = 0;
+  } else if(subframe < 1 || subframe > 3 || !(sat.received & (1 << (subframe - 1)))) {
+    return false;
+  }
+  memcpy(sat.subframes[subframe], words, sizeof(sat.subframes[0]));
+  sat.received |= 1 << subframe;
+  if(subframe != 3) return false;
+
+  complete_sets++;
+  const uint32_t (*sf)[SFRBX_MAX_WORDS] = sat.subframes;
+  const uint16_t iodc = (GET_FIELD_U(sf[1][2], 2, 6) << 8) | GET_FIELD_U(sf[1][7], 8, 22);
+  const uint32_t iode = GET_FIELD_U(sf[2][2], 8, 22);
+  // subframes of different issues, while the ephemeris changes
+  if(iode != GET_FIELD_U(sf[3][9], 8, 22) || iode != (iodc & 0xffu)) return false;
+  if(sat.valid && eph.iodc == iodc && eph.iode == iode) return false;
+
+  for(const auto &f : gps_fields) {
+    int64_t v = f.is_signed ? (int64_t)GET_FIELD_S(sf[f.subframe][f.word], f.bits, f.pos) :
+                              (int64_t)GET_FIELD_U(sf[f.subframe][f.word], f.bits, f.pos);
+    if(f.split) {
+      v = v * (1 << 24) + GET_FIELD_U(sf[f.subframe][f.word + 1], 24, 6);
+    }
+    eph.*f.dst = v * f.scale;
+  }
+  eph.A *= eph.A;
+  eph.svId = svid;
+  eph.iodc = iodc;
+  eph.iode = iode;
+  eph.gpsWeek = GET_FIELD_U(sf[1][2], 10, 20);
+  eph.aodo = GET_FIELD_U(sf[2][9], 5, 8);
+  sat.valid = true;
+  decoded_sets++;
+  return true;
+}
+
+bool EphemerisStore::add_glonass(uint8_t svid, uint8_t freq_id, const uint32_t *words, int num_words) {
+  // svid is 255 while the receiver doesn't know the slot
+  if(svid < 1 || svid > GLONASS_SATS || num_words < 3) return false;
+  auto &sat = glonass_sats[svid];
+  const int string = bits_at(words, 1, 4);
+
+  // strings 1 to 4 come one after the other at the start of each frame
+  if(string == 1) {
+    sat.received = 0;
+  } else if(string < 1 || string > 4 || !(sat.received & (1 << (string - 1)))) {
+    return false;
+  }
+  memcpy(sat.strings[string], words, 3 * sizeof(uint32_t));
+  sat.strings[string][3] = 0;
+  sat.received |= 1 << string;
+  if(string != 4) return false;
+
+  complete_sets++;
+  const uint32_t (*s)[4] = sat.strings;
+  GlonassEphemeris &eph = sat.eph;
+  const uint8_t tb = bits_at(s[2], 9, 7);
+  const uint16_t nt = bits_at(s[4], 59, 11);
+  if(sat.valid && eph.tb == tb && eph.nt == nt) return false;
+
+  decode_fields(eph, glonass_fields, s);
+  const uint32_t tk = bits_at(s[1], 9, 12);
+  eph.svId = svid;
+  eph.freqNum = (int)freq_id - 7;
+  eph.tb = tb;
+  eph.nt = nt;
+  eph.tk = (tk >> 7) * 3600 + ((tk >> 1) & 0x3f) * 60 + (tk & 1) * 30;
+  eph.p1 = bits_at(s[1], 7, 2);
+  eph.health = bits_at(s[2], 5, 3);
+  eph.p2 = bits_at(s[2], 8, 1);
+  eph.p3 = bits_at(s[3], 5, 1);
+  eph.age = bits_at(s[4], 32, 5);
+  eph.p4 = bits_at(s[4], 51, 1);
+  eph.ft = bits_at(s[4], 52, 4);
+  eph.m = bits_at(s[4], 75, 2);
+  sat.valid = true;
+  decoded_sets++;
+  return true;
+}
+
+bool EphemerisStore::add_galileo(uint8_t svid, const uint32_t *words, int num_words) {
+  if(svid < 1 || svid > GALILEO_SATS || num_words < 8) return false;
+  // an even and an odd page, alert pages don't have navigation data
+  if((words[0] >> 31) != 0 || (words[4] >> 31) != 1 || ((words[0] >> 30) & 1) || ((words[4] >> 30) & 1)) {
+    return false;
+  }
+  // the 112 data bits of the even page and the first 16 of the odd one
+  uint32_t nav[4];
+  for(int i = 0; i < 3; i++) {
+    nav[i] = bits_at(words, 2 + 32 * i, 32);
+  }
+  nav[3] = (bits_at(words, 98, 16) << 16) | bits_at(&words[4], 2, 16);
+
+  const int type = nav[0] >> 26;
+  if(type < 1 || type > 4) return false;
+  auto &sat = galileo_sats[svid];
+  memcpy(sat.nav_words[type], nav, sizeof(nav));
+  sat.iod[type] = bits_at(nav, 6, 10);
+  sat.received |= 1 << type;
+
+  const uint16_t iod = sat.iod[1];
+  if(sat.received != 0x1e || sat.iod[2] != iod || sat.iod[3] != iod || sat.iod[4] != iod) return false;
+  complete_sets++;
+  GalileoEphemeris &eph = sat.eph;
+  if(sat.valid && eph.iodNav == iod) return false;
+
+  decode_fields(eph, galileo_fields, sat.nav_words);
+  eph.A *= eph.A;
+  eph.svId = svid;
+  eph.iodNav = iod;
+  eph.sisa = bits_at(sat.nav_words[3], 120, 8);
+  sat.valid = true;
+  decoded_sets++;
+  return true;
+}
+
+}
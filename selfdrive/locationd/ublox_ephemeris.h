@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace ublox {
+  // gnssId of RXM-SFRBX
+  const uint8_t GNSS_GPS = 0;
+  const uint8_t GNSS_GALILEO = 2;
+  const uint8_t GNSS_GLONASS = 6;
+
+  const int GPS_SATS = 32;
+  const int GALILEO_SATS = 36;
+  const int GLONASS_SATS = 24;
+
+  // the most words of a RXM-SFRBX message decoded here, a GPS subframe
+  const int SFRBX_MAX_WORDS = 10;
+
+  // GPS LNAV, IS-GPS-200 Table 20-III. Meters, seconds and radians
+  typedef struct {
+    uint16_t svId;
+    uint16_t iodc;
+    uint32_t iode, gpsWeek, aodo;
+    double Tgd, A, cic, cis, crc, crs, cuc, cus, deltaN, ecc, i0, idot, M0, omega, omega_dot, omega0, toe, toc;
+    double af0, af1, af2;
+    // from page 18 of subframe 4, the latest the satellite sent
+    bool ionoCoeffsValid;
+    double ionoAlpha[4], ionoBeta[4];
+  } GpsEphemeris;
+
+  // GLONASS immediate data of strings 1 to 4, GLONASS ICD 5.1 Table 4.5. PZ-90 meters and seconds
+  typedef struct {
+    uint16_t svId;
+    // frequency channel, -7 to 6
+    int8_t freqNum;
+    // tb is the 15 minute interval of the day (Moscow time) the data is for, nt the day in the four year period
+    uint8_t tb;
+    uint16_t nt;
+    // start of the frame the data came in, seconds of the day
+    uint32_t tk;
+    double x, y, z, xVel, yVel, zVel, xAccel, yAccel, zAccel;
+    double gammaN, tauN, deltaTauN;
+    uint8_t age, health, p1, p2, p3, p4, ft, m;
+  } GlonassEphemeris;
+
+  // Galileo I/NAV word types 1 to 4, Galileo OS SIS ICD Table 40. Meters, seconds and radians
+  typedef struct {
+    uint16_t svId;
+    uint16_t iodNav;
+    double toe, toc, M0, ecc, A, omega0, i0, omega, iDot, omegaDot, deltaN, cuc, cus, crc, crs, cic, cis;
+    double af0, af1, af2;
+    uint8_t sisa;
+  } GalileoEphemeris;
+
+  // Collects the navigation messages of RXM-SFRBX per satellite and decodes an ephemeris when
+  // a set is complete. A set with the issue of data of the stored ephemeris isn't decoded again:
+  // IODC/IODE for GPS, IODnav for Galileo, the day and tb for GLONASS.
+  class EphemerisStore {
+    public:
+      EphemerisStore();
+
+      // Adds the words of a RXM-SFRBX message. Returns true when the satellite has a new or
+      // changed ephemeris, in gps(), glonass() or galileo().
+      bool add_subframe(uint8_t gnss_id, uint8_t svid, uint8_t freq_id, const uint32_t *words, int num_words);
+
+      // NULL until the satellite has a complete ephemeris
+      const GpsEphemeris *gps(int svid) const;
+      const GlonassEphemeris *glonass(int svid) const;
+      const GalileoEphemeris *galileo(int svid) const;
+
+      // complete sets seen and how many of them were decoded
+      uint64_t complete_sets;
+      uint64_t decoded_sets;
+
+    private:
+      bool add_gps(uint8_t svid, const uint32_t *words, int num_words);
+      bool add_glonass(uint8_t svid, uint8_t freq_id, const uint32_t *words, int num_words);
+      bool add_galileo(uint8_t svid, const uint32_t *words, int num_words);
+
+      struct {
+        // subframes 1 to 3, received in order after a subframe 1
+        uint32_t subframes[4][SFRBX_MAX_WORDS];
+        uint8_t received;
+        bool valid;
+        GpsEphemeris eph;
+      } gps_sats[GPS_SATS + 1];
+
+      struct {
+        // strings 1 to 4, the 85 bits from the most significant bit of the first word
+        uint32_t strings[5][4];
+        uint8_t received;
+        bool valid;
+        GlonassEphemeris eph;
+      } glonass_sats[GLONASS_SATS + 1];
+
+      struct {
+        // word types 1 to 4, the 128 bits from the most significant bit of the first word
+        uint32_t nav_words[5][4];
+        uint16_t iod[5];
+        uint8_t received;
+        bool valid;
+        GalileoEphemeris eph;
+      } galileo_sats[GALILEO_SATS + 1];
+  };
+}
@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "common/util.h"
+#include "ublox_ephemeris.h"
+
+// Checks EphemerisStore against the GPS decoder ubloxd used before it, on the recorded stream:
+//   tar xzf test/ubloxRaw.tar.gz && ./ublox_ephemeris_test ubloxRaw.stream
+// The GLONASS ephemerides of the stream are checked to be physically sensible, Galileo
+// isn't in it and is checked with a synthetic page pair.
+
+using namespace ublox;
+
+#define GET_FIELD_U(w, nb, pos) (((w) >> (pos)) & ((1<<(nb))-1))
+
+inline int twos_complement(uint32_t v, uint32_t nb) {
+  int sign = v >> (nb - 1);
+  int value = v;
+  if(sign != 0)
+    value = value - (1 << nb);
+  return value;
+}
+
+inline int GET_FIELD_S(uint32_t w, uint32_t nb, uint32_t pos) {
+  int v = GET_FIELD_U(w, nb, pos);
+  return twos_complement(v, nb);
+}
+
+typedef uint32_t gps_subframe_words[6][SFRBX_MAX_WORDS];
+
+// the decoder of ublox_msg.cc, with the low bits of omega from word 8 of subframe 3
+class EphemerisData {
+  public:
+    EphemerisData(uint8_t svId, const gps_subframe_words &subframes) {
+      this->svId = svId;
+      int week_no = GET_FIELD_U(subframes[1][2+0], 10, 20);
+      int t_gd = GET_FIELD_S(subframes[1][2+4], 8, 6);
+      int iodc = (GET_FIELD_U(subframes[1][2+0], 2, 6) << 8) | GET_FIELD_U(
+        subframes[1][2+5], 8, 22);
+
+      int t_oc = GET_FIELD_U(subframes[1][2+5], 16, 6);
+      int a_f2 = GET_FIELD_S(subframes[1][2+6], 8, 22);
+      int a_f1 = GET_FIELD_S(subframes[1][2+6], 16, 6);
+      int a_f0 = GET_FIELD_S(subframes[1][2+7], 22, 8);
+
+      int c_rs = GET_FIELD_S(subframes[2][2+0], 16, 6);
+      int delta_n = GET_FIELD_S(subframes[2][2+1], 16, 14);
+      int m_0 = (GET_FIELD_S(subframes[2][2+1], 8, 6) << 24) | GET_FIELD_U(
+        subframes[2][2+2], 24, 6);
+      int c_uc = GET_FIELD_S(subframes[2][2+3], 16, 14);
+      int e = (GET_FIELD_U(subframes[2][2+3], 8, 6) << 24) | GET_FIELD_U(subframes[2][2+4], 24, 6);
+      int c_us = GET_FIELD_S(subframes[2][2+5], 16, 14);
+      uint32_t a_powhalf = (GET_FIELD_U(subframes[2][2+5], 8, 6) << 24) | GET_FIELD_U(
+        subframes[2][2+6], 24, 6);
+      int t_oe = GET_FIELD_U(subframes[2][2+7], 16, 14);
+
+      int c_ic = GET_FIELD_S(subframes[3][2+0], 16, 14);
+      int omega_0 = (GET_FIELD_S(subframes[3][2+0], 8, 6) << 24) | GET_FIELD_U(
+        subframes[3][2+1], 24, 6);
+      int c_is = GET_FIELD_S(subframes[3][2+2], 16, 14);
+      int i_0 = (GET_FIELD_S(subframes[3][2+2], 8, 6) << 24) | GET_FIELD_U(
+        subframes[3][2+3], 24, 6);
+      int c_rc = GET_FIELD_S(subframes[3][2+4], 16, 14);
+      int w = (GET_FIELD_S(subframes[3][2+4], 8, 6) << 24) | GET_FIELD_U(subframes[3][2+5], 24, 6);
+      int omega_dot = GET_FIELD_S(subframes[3][2+6], 24, 6);
+      int idot = GET_FIELD_S(subframes[3][2+7], 14, 8);
+
+      this->aodo = GET_FIELD_U(subframes[2][2+7], 5, 8);
+
+      double gpsPi = 3.1415926535898;
+
+      // now form variables in radians, meters and seconds etc
+      this->Tgd = t_gd * pow(2, -31);
+      this->A = pow(a_powhalf * pow(2, -19), 2.0);
+      this->cic = c_ic * pow(2, -29);
+      this->cis = c_is * pow(2, -29);
+      this->crc = c_rc * pow(2, -5);
+      this->crs = c_rs * pow(2, -5);
+      this->cuc = c_uc * pow(2, -29);
+      this->cus = c_us * pow(2, -29);
+      this->deltaN = delta_n * pow(2, -43) * gpsPi;
+      this->ecc = e * pow(2, -33);
+      this->i0 = i_0 * pow(2, -31) * gpsPi;
+      this->idot = idot * pow(2, -43) * gpsPi;
+      this->M0 = m_0 * pow(2, -31) * gpsPi;
+      this->omega = w * pow(2, -31) * gpsPi;
+      this->omega_dot = omega_dot * pow(2, -43) * gpsPi;
+      this->omega0 = omega_0 * pow(2, -31) * gpsPi;
+      this->toe = t_oe * pow(2, 4);
+
+      this->toc = t_oc * pow(2, 4);
+      this->gpsWeek = week_no;
+      this->af0 = a_f0 * pow(2, -31);
+      this->af1 = a_f1 * pow(2, -43);
+      this->af2 = a_f2 * pow(2, -55);
+
+      uint32_t iode1 = GET_FIELD_U(subframes[2][2+0], 8, 22);
+      uint32_t iode2 = GET_FIELD_U(subframes[3][2+7], 8, 22);
+      this->valid = (iode1 == iode2) && (iode1 == (iodc & 0xff));
+      this->iode = iode1;
+
+      if (GET_FIELD_U(subframes[4][2+0], 6, 22) == 56 &&
+        GET_FIELD_U(subframes[4][2+0], 2, 28) == 1 &&
+        GET_FIELD_U(subframes[5][2+0], 2, 28) == 1) {
+        double a0 = GET_FIELD_S(subframes[4][2], 8, 14) * pow(2, -30);
+        double a1 = GET_FIELD_S(subframes[4][2], 8, 6) * pow(2, -27);
+        double a2 = GET_FIELD_S(subframes[4][3], 8, 22) * pow(2, -24);
+        double a3 = GET_FIELD_S(subframes[4][3], 8, 14) * pow(2, -24);
+        double b0 = GET_FIELD_S(subframes[4][3], 8, 6) * pow(2, 11);
+        double b1 = GET_FIELD_S(subframes[4][4], 8, 22) * pow(2, 14);
+        double b2 = GET_FIELD_S(subframes[4][4], 8, 14) * pow(2, 16);
+        double b3 = GET_FIELD_S(subframes[4][4], 8, 6) * pow(2, 16);
+        this->ionoAlpha[0] = a0;this->ionoAlpha[1] = a1;this->ionoAlpha[2] = a2;this->ionoAlpha[3] = a3;
+        this->ionoBeta[0] = b0;this->ionoBeta[1] = b1;this->ionoBeta[2] = b2;this->ionoBeta[3] = b3;
+        this->ionoCoeffsValid = true;
+      } else {
+        this->ionoCoeffsValid = false;
+      }
+    }
+    uint16_t svId;
+    double Tgd, A, cic, cis, crc, crs, cuc, cus, deltaN, ecc, i0, idot, M0, omega, omega_dot, omega0, toe, toc;
+    uint32_t gpsWeek, iode, aodo;
+    double af0, af1, af2;
+    bool valid;
+    double ionoAlpha[4], ionoBeta[4];
+    bool ionoCoeffsValid;
+};
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { if(!(cond)) { printf(__VA_ARGS__); printf("\n"); failures++; } } while(0)
+
+static void compare_gps(const EphemerisData &ref, const GpsEphemeris *eph) {
+  CHECK(eph != NULL, "sv %d: no ephemeris in the store", ref.svId);
+  if(eph == NULL) return;
+  const double ref_fields[] = {ref.Tgd, ref.A, ref.cic, ref.cis, ref.crc, ref.crs, ref.cuc, ref.cus, ref.deltaN,
+                               ref.ecc, ref.i0, ref.idot, ref.M0, ref.omega, ref.omega_dot, ref.omega0, ref.toe,
+                               ref.toc, ref.af0, ref.af1, ref.af2};
+  const double fields[] = {eph->Tgd, eph->A, eph->cic, eph->cis, eph->crc, eph->crs, eph->cuc, eph->cus, eph->deltaN,
+                           eph->ecc, eph->i0, eph->idot, eph->M0, eph->omega, eph->omega_dot, eph->omega0, eph->toe,
+                           eph->toc, eph->af0, eph->af1, eph->af2};
+  for(size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    CHECK(fields[i] == ref_fields[i], "sv %d: field %zu is %.17g, %.17g before", ref.svId, i, fields[i], ref_fields[i]);
+  }
+  CHECK(eph->gpsWeek == ref.gpsWeek && eph->iode == ref.iode && eph->aodo == ref.aodo,
+        "sv %d: week %u iode %u aodo %u, %u %u %u before", ref.svId, eph->gpsWeek, eph->iode, eph->aodo,
+        ref.gpsWeek, ref.iode, ref.aodo);
+  if(ref.ionoCoeffsValid) {
+    CHECK(eph->ionoCoeffsValid && memcmp(eph->ionoAlpha, ref.ionoAlpha, sizeof(ref.ionoAlpha)) == 0 &&
+          memcmp(eph->ionoBeta, ref.ionoBeta, sizeof(ref.ionoBeta)) == 0, "sv %d: iono mismatch", ref.svId);
+  }
+}
+
+static void check_glonass(const GlonassEphemeris *eph) {
+  // the orbits are 25510 km from the center of the earth, at 3.95 km/s in an inertial frame
+  const double earth_rate = 7.292115e-5;
+  const double r = sqrt(eph->x * eph->x + eph->y * eph->y + eph->z * eph->z);
+  const double vx = eph->xVel - earth_rate * eph->y, vy = eph->yVel + earth_rate * eph->x;
+  const double v = sqrt(vx * vx + vy * vy + eph->zVel * eph->zVel);
+  CHECK(fabs(r - 25510e3) < 200e3, "glonass %d: r %.0f m", eph->svId, r);
+  CHECK(fabs(v - 3950) < 50, "glonass %d: v %.1f m/s", eph->svId, v);
+  CHECK(fabs(eph->xAccel) < 2e-5 && fabs(eph->yAccel) < 2e-5 && fabs(eph->zAccel) < 2e-5,
+        "glonass %d: acceleration %g %g %g", eph->svId, eph->xAccel, eph->yAccel, eph->zAccel);
+  CHECK(fabs(eph->tauN) < 1e-3 && fabs(eph->gammaN) < 1e-8, "glonass %d: tau %g gamma %g", eph->svId, eph->tauN, eph->gammaN);
+  CHECK(eph->tb >= 1 && eph->tb <= 96 && eph->tk < 86400, "glonass %d: tb %d tk %u", eph->svId, eph->tb, eph->tk);
+  CHECK(eph->freqNum >= -7 && eph->freqNum <= 6, "glonass %d: frequency %d", eph->svId, eph->freqNum);
+}
+
+// writes a field of the 128 bit I/NAV word, bit 0 is the most significant bit
+static void set_bits(uint32_t *w, int start, int bits, int64_t value) {
+  for(int i = 0; i < bits; i++) {
+    const int b = start + i;
+    const uint32_t bit = (value >> (bits - 1 - i)) & 1;
+    w[b / 32] = (w[b / 32] & ~(1u << (31 - b % 32))) | (bit << (31 - b % 32));
+  }
+}
+
+// the RXM-SFRBX words of an even and odd page carrying an I/NAV word
+static void galileo_pages(const uint32_t *nav, uint32_t *words) {
+  memset(words, 0, 8 * sizeof(uint32_t));
+  for(int i = 0; i < 112; i++) {
+    set_bits(words, 2 + i, 1, (nav[i / 32] >> (31 - i % 32)) & 1);
+  }
+  for(int i = 112; i < 128; i++) {
+    set_bits(&words[4], 2 + i - 112, 1, (nav[i / 32] >> (31 - i % 32)) & 1);
+  }
+  words[4] |= 1u << 31;
+}
+
+static void test_galileo() {
+  const int iod = 77;
+  uint32_t nav[5][4] = {};
+  for(int type = 1; type <= 4; type++) {
+    set_bits(nav[type], 0, 6, type);
+    set_bits(nav[type], 6, 10, iod);
+  }
+  set_bits(nav[1], 16, 14, 1234);           // toe
+  set_bits(nav[1], 30, 32, -123456789);     // M0
+  set_bits(nav[1], 62, 32, 0x00A00000);     // e
+  set_bits(nav[1], 94, 32, 0xA8A00000u);    // sqrt(A)
+  set_bits(nav[2], 112, 14, -100);          // iDot
+  set_bits(nav[3], 104, 16, -2000);         // crs
+  set_bits(nav[3], 120, 8, 107);            // SISA
+  set_bits(nav[4], 68, 31, -1000000);       // af0
+  set_bits(nav[4], 120, 6, -3);             // af2
+
+  EphemerisStore store;
+  uint32_t words[8];
+  for(int type = 1; type <= 4; type++) {
+    galileo_pages(nav[type], words);
+    const bool updated = store.add_subframe(GNSS_GALILEO, 11, 0, words, 8);
+    CHECK(updated == (type == 4), "galileo: updated after word type %d", type);
+  }
+  const GalileoEphemeris *eph = store.galileo(11);
+  CHECK(eph != NULL, "galileo: no ephemeris");
+  if(eph == NULL) return;
+  const double sqrt_a = 0xA8A00000u / 524288.0;
+  CHECK(eph->iodNav == iod && eph->sisa == 107, "galileo: iod %d sisa %d", eph->iodNav, eph->sisa);
+  CHECK(eph->toe == 1234 * 60, "galileo: toe %f", eph->toe);
+  CHECK(eph->M0 == -123456789 * pow(2, -31) * 3.1415926535898, "galileo: M0 %.17g", eph->M0);
+  CHECK(eph->ecc == 0x00A00000 * pow(2, -33), "galileo: ecc %.17g", eph->ecc);
+  CHECK(eph->A == sqrt_a * sqrt_a, "galileo: A %.17g", eph->A);
+  CHECK(eph->iDot == -100 * pow(2, -43) * 3.1415926535898, "galileo: iDot %.17g", eph->iDot);
+  CHECK(eph->crs == -2000 * pow(2, -5), "galileo: crs %f", eph->crs);
+  CHECK(eph->af0 == -1000000 * pow(2, -34), "galileo: af0 %.17g", eph->af0);
+  CHECK(eph->af2 == -3 * pow(2, -59), "galileo: af2 %.17g", eph->af2);
+
+  // the same issue again isn't an update
+  galileo_pages(nav[2], words);
+  CHECK(!store.add_subframe(GNSS_GALILEO, 11, 0, words, 8), "galileo: updated by the same IODnav");
+  CHECK(store.decoded_sets == 1, "galileo: decoded %llu times", (unsigned long long)store.decoded_sets);
+}
+
+int main(int argc, char** argv) {
+  if(argc < 2) {
+    printf("Format: ublox_ephemeris_test stream_file_path\n");
+    return 0;
+  }
+  size_t len = 0;
+  uint8_t *data = (uint8_t *)read_file(argv[1], &len);
+  if(data == NULL) {
+    printf("Read file %s failed\n", argv[1]);
+    return -1;
+  }
+
+  EphemerisStore store;
+  static gps_subframe_words ref_subframes[GPS_SATS + 1];
+  uint8_t ref_received[GPS_SATS + 1] = {};
+  int ref_events = 0, gps_updates = 0, glonass_updates = 0;
+
+  for(size_t i = 0; i + 8 <= len;) {
+    const uint8_t *p = data + i;
+    const size_t payload_len = p[4] | (p[5] << 8);
+    if(p[0] != 0xb5 || p[1] != 0x62 || i + 8 + payload_len > len) {
+      i++;
+      continue;
+    }
+    uint8_t ck_a = 0, ck_b = 0;
+    for(size_t j = 2; j < 6 + payload_len; j++) {
+      ck_a += p[j];
+      ck_b += ck_a;
+    }
+    if(ck_a != p[6 + payload_len] || ck_b != p[7 + payload_len]) {
+      i++;
+      continue;
+    }
+    i += 8 + payload_len;
+    // RXM-SFRBX
+    if(p[2] != 0x02 || p[3] != 0x13) continue;
+
+    const uint8_t *payload = p + 6;
+    const uint8_t gnss_id = payload[0], svid = payload[1], freq_id = payload[3];
+    const int num_words = payload[4];
+    if(payload_len != 8 + 4 * (size_t)num_words || num_words > SFRBX_MAX_WORDS) continue;
+    uint32_t words[SFRBX_MAX_WORDS] = {};
+    memcpy(words, payload + 8, 4 * num_words);
+
+    const bool updated = store.add_subframe(gnss_id, svid, freq_id, words, num_words);
+    if(gnss_id == GNSS_GPS && svid >= 1 && svid <= GPS_SATS) {
+      gps_updates += updated;
+      // the rule of the old decoder, an event for each subframe once 1 to 5 came in order
+      const int subframe = GET_FIELD_U(words[1], 3, 8);
+      if(subframe == 1) {
+        ref_received[svid] = 0;
+      }
+      if(subframe == 1 || (subframe > 1 && subframe < 6 && (ref_received[svid] & (1 << (subframe - 1))))) {
+        memcpy(ref_subframes[svid][subframe], words, sizeof(ref_subframes[0][0]));
+        ref_received[svid] |= 1 << subframe;
+      }
+      if(ref_received[svid] == 0x3e) {
+        ref_events++;
+        EphemerisData ref(svid, ref_subframes[svid]);
+        if(ref.valid) {
+          compare_gps(ref, store.gps(svid));
+        }
+      }
+    } else if(gnss_id == GNSS_GLONASS && updated) {
+      glonass_updates++;
+      check_glonass(store.glonass(svid));
+    }
+  }
+  free(data);
+
+  printf("%llu complete sets, %llu decoded\n", (unsigned long long)store.complete_sets,
+         (unsigned long long)store.decoded_sets);
+  printf("gps: %d events before, %d updates now\n", ref_events, gps_updates);
+  printf("glonass: %d updates\n", glonass_updates);
+  CHECK(ref_events > 0 && gps_updates > 0 && glonass_updates > 0, "no ephemerides in %s", argv[1]);
+  CHECK(gps_updates < ref_events, "gps: not fewer updates than before");
+
+  test_galileo();
+
+  if(failures > 0) {
+    printf("%d failures\n", failures);
+    return -1;
+  }
+  printf("ok\n");
+  return 0;
+}
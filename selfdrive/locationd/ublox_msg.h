@@ -1,7 +1,11 @@
 #pragma once
 
 #include <stdint.h>
+#include <map>
+#include <kj/io.h>
+#include <capnp/serialize.h>
 #include "messaging.hpp"
+#include "ublox_ephemeris.h"
 
 #define min(x, y) ((x) <= (y) ? (x) : (y))
 
@@ -130,27 +134,41 @@ namespace ublox {
   const int UBLOX_CHECKSUM_SIZE = 2;
   const int UBLOX_MAX_MSG_SIZE = 65536;
 
-  typedef std::map<uint8_t, std::vector<uint32_t>> subframes_map;
-
   class UbloxMsgParser {
     public:
 
       UbloxMsgParser();
-      kj::Array<capnp::word> gen_solution();
-      kj::Array<capnp::word> gen_raw();
-      kj::Array<capnp::word> gen_mon_hw();
 
-      kj::Array<capnp::word> gen_nav_data();
+      // Frames the next message out of incoming_data, whole packets are checked in place
+      // and only one that spans calls is copied. Returns true when a message with a valid
+      // checksum is ready, it stays readable through msg_class(), msg_id() and the gen_
+      // functions until the next call. bytes_consumed can be 0 then, when the message
+      // came out of data consumed earlier.
       bool add_data(const uint8_t *incoming_data, uint32_t incoming_data_len, size_t &bytes_consumed);
-      inline void reset() {bytes_in_parse_buf = 0;}
+      // drops the buffered partial message
+      inline void reset() {
+        bytes_in_parse_buf = 0;
+        buffered_msg_len = 0;
+      }
       inline uint8_t msg_class() {
-        return msg_parse_buf[2];
+        return msg[2];
       }
 
       inline uint8_t msg_id() {
-        return msg_parse_buf[3];
+        return msg[3];
       }
-      inline int needed_bytes();
+
+      // Builds the event of the current message and sets *service to where it goes, looked
+      // up by class and id. The returned bytes are in a buffer reused by the next call.
+      // Empty if the message doesn't make an event, unknown types are counted in unknown_msgs.
+      kj::ArrayPtr<const capnp::byte> gen_event(const char **service);
+      kj::ArrayPtr<const capnp::byte> gen_solution();
+      kj::ArrayPtr<const capnp::byte> gen_raw();
+      kj::ArrayPtr<const capnp::byte> gen_mon_hw();
+      kj::ArrayPtr<const capnp::byte> gen_nav_data();
+
+      // class << 8 | id of the messages without a handler, and how many came
+      std::map<uint16_t, uint64_t> unknown_msgs;
 
       void hexdump(uint8_t *d, int l) {
         for (int i = 0; i < l; i++) {
@@ -160,13 +178,23 @@ namespace ublox {
         printf("\n");
       }
     private:
-      inline bool valid_cheksum();
-      inline bool valid();
-      inline bool valid_so_far();
+      cereal::Event::Builder init_event(capnp::MallocMessageBuilder &msg_builder);
+      kj::ArrayPtr<const capnp::byte> to_bytes(capnp::MallocMessageBuilder &msg_builder);
+
+      // the current message, in msg_parse_buf or in the data passed to add_data
+      const uint8_t *msg;
+      size_t msg_len;
+
+      uint8_t msg_parse_buf[UBLOX_HEADER_SIZE + UBLOX_MAX_MSG_SIZE + UBLOX_CHECKSUM_SIZE];
+      size_t bytes_in_parse_buf;
+      // the current message is the start of msg_parse_buf, dropped on the next add_data
+      size_t buffered_msg_len;
+
+      // first segment of the events, zeroed by capnp after each
+      kj::Array<capnp::word> builder_buf;
+      kj::Array<capnp::word> output_buf;
 
-      uint8_t msg_parse_buf[UBLOX_HEADER_SIZE + UBLOX_MAX_MSG_SIZE];
-      int bytes_in_parse_buf;
-      std::map<uint8_t, std::map<uint8_t, subframes_map>> nav_frame_buffer;
+      EphemerisStore ephemerides;
   };
 
 }
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <new>
+
+#include "common/timing.h"
+#include "common/util.h"
+#include "ublox_msg.h"
+
+// Parses a raw ublox stream and builds the events ubloxd would publish, to measure the
+// throughput of UbloxMsgParser. The stream is in test/ubloxRaw.tar.gz:
+//   tar xzf test/ubloxRaw.tar.gz && ./ubloxd_bench ubloxRaw.stream [chunk size] [passes]
+// The data is fed in chunks like ubloxRaw messages. Heap allocations are counted after
+// the first pass, the parser shouldn't make any once it's warmed up.
+
+using namespace ublox;
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+int main(int argc, char** argv) {
+  if(argc < 2) {
+    printf("Format: ubloxd_bench stream_file_path [chunk size] [passes]\n");
+    return 0;
+  }
+  size_t len = 0;
+  uint8_t *data = (uint8_t *)read_file(argv[1], &len);
+  if(data == NULL) {
+    printf("Read file %s failed\n", argv[1]);
+    return -1;
+  }
+  const size_t chunk = argc > 2 ? atoi(argv[2]) : 128;
+  const int passes = argc > 3 ? atoi(argv[3]) : 20;
+  assert(chunk > 0 && passes > 1);
+
+  UbloxMsgParser parser;
+  size_t msgs = 0, events = 0, event_bytes = 0, warm_allocations = 0;
+  double t_start = 0;
+  for(int pass = 0; pass < passes; pass++) {
+    if(pass == 1) {
+      // the first pass warms up the buffers
+      msgs = events = event_bytes = 0;
+      warm_allocations = allocations;
+      t_start = millis_since_boot();
+    }
+    for(size_t off = 0; off < len; off += chunk) {
+      const uint8_t *p = data + off;
+      const size_t n = min(chunk, len - off);
+      size_t consumed = 0;
+      while(consumed < n) {
+        size_t consumed_this_time = 0;
+        if(parser.add_data(p + consumed, n - consumed, consumed_this_time)) {
+          msgs++;
+          const char *service = NULL;
+          auto bytes = parser.gen_event(&service);
+          if(bytes.size() > 0) {
+            events++;
+            event_bytes += bytes.size();
+          }
+        }
+        consumed += consumed_this_time;
+      }
+    }
+  }
+  const double dt = (millis_since_boot() - t_start) * 1e-3;
+  const int timed = passes - 1;
+
+  printf("%zu bytes in %zu byte chunks, %d passes\n", len, chunk, timed);
+  printf("%zu msgs, %zu events (%zu bytes) per pass\n", msgs / timed, events / timed, event_bytes / timed);
+  printf("%.1f MB/s, %.0f msgs/s, %.0f events/s\n", len * timed / dt / 1e6, msgs / dt, events / dt);
+  printf("%zu heap allocations after the first pass\n", allocations - warm_allocations);
+  for(auto &it : parser.unknown_msgs) {
+    printf("unknown class 0x%02X id 0x%02X: %llu\n", it.first >> 8, it.first & 0xff, (unsigned long long)it.second);
+  }
+  free(data);
+  return 0;
+}
@@ -42,6 +42,11 @@ int ubloxd_main(poll_ubloxraw_msg_func poll_func, send_gps_event_func send_func)
 
   PubMaster pm({"ubloxGnss", "gpsLocationExternal"});
 
+  // messages that aren't word aligned are copied here, it only grows
+  kj::Array<capnp::word> aligned_buf;
+  uint64_t unknown_logged = 0, unknown_count = 0;
+  double last_unknown_log = 0;
+
   while (!do_exit) {
     Message * msg = subscriber->receive();
     if (!msg){
@@ -51,10 +56,17 @@ int ubloxd_main(poll_ubloxraw_msg_func poll_func, send_gps_event_func send_func)
       continue;
     }
 
-    auto amsg = kj::heapArray<capnp::word>((msg->getSize() / sizeof(capnp::word)) + 1);
-    memcpy(amsg.begin(), msg->getData(), msg->getSize());
+    kj::ArrayPtr<const capnp::word> words((const capnp::word *)msg->getData(), msg->getSize() / sizeof(capnp::word));
+    if (((uintptr_t)msg->getData() % sizeof(capnp::word)) != 0) {
+      const size_t size = msg->getSize() / sizeof(capnp::word) + 1;
+      if (aligned_buf.size() < size) {
+        aligned_buf = kj::heapArray<capnp::word>(size);
+      }
+      memcpy(aligned_buf.begin(), msg->getData(), msg->getSize());
+      words = aligned_buf.slice(0, size);
+    }
 
-    capnp::FlatArrayMessageReader cmsg(amsg);
+    capnp::FlatArrayMessageReader cmsg(words);
     cereal::Event::Reader event = cmsg.getRoot<cereal::Event>();
     auto ubloxRaw = event.getUbloxRaw();
 
@@ -65,51 +77,26 @@ int ubloxd_main(poll_ubloxraw_msg_func poll_func, send_gps_event_func send_func)
       size_t bytes_consumed_this_time = 0U;
       if(parser.add_data(data + bytes_consumed, (uint32_t)(len - bytes_consumed), bytes_consumed_this_time)) {
         // New message available
-        if(parser.msg_class() == CLASS_NAV) {
-          if(parser.msg_id() == MSG_NAV_PVT) {
-            //LOGD("MSG_NAV_PVT");
-            auto words = parser.gen_solution();
-            if(words.size() > 0) {
-              auto bytes = words.asBytes();
-              pm.send("gpsLocationExternal", bytes.begin(), bytes.size());
-            }
-          } else
-            LOGW("Unknown nav msg id: 0x%02X", parser.msg_id());
-        } else if(parser.msg_class() == CLASS_RXM) {
-          if(parser.msg_id() == MSG_RXM_RAW) {
-            //LOGD("MSG_RXM_RAW");
-            auto words = parser.gen_raw();
-            if(words.size() > 0) {
-              auto bytes = words.asBytes();
-              pm.send("ubloxGnss", bytes.begin(), bytes.size());
-            }
-          } else if(parser.msg_id() == MSG_RXM_SFRBX) {
-            //LOGD("MSG_RXM_SFRBX");
-            auto words = parser.gen_nav_data();
-            if(words.size() > 0) {
-              auto bytes = words.asBytes();
-              pm.send("ubloxGnss", bytes.begin(), bytes.size());
-            }
-          } else
-            LOGW("Unknown rxm msg id: 0x%02X", parser.msg_id());
-        } else if(parser.msg_class() == CLASS_MON) {
-          if(parser.msg_id() == MSG_MON_HW) {
-            //LOGD("MSG_MON_HW");
-            auto words = parser.gen_mon_hw();
-            if(words.size() > 0) {
-              auto bytes = words.asBytes();
-              pm.send("ubloxGnss", bytes.begin(), bytes.size());
-            }
-          } else {
-            LOGW("Unknown mon msg id: 0x%02X", parser.msg_id());
-          }
-        } else
-          LOGW("Unknown msg class: 0x%02X", parser.msg_class());
-        parser.reset();
+        const char *service = NULL;
+        auto bytes = parser.gen_event(&service);
+        if(bytes.size() > 0) {
+          pm.send(service, (uint8_t *)bytes.begin(), bytes.size());
+        } else if(service == NULL) {
+          unknown_count++;
+        }
       }
       bytes_consumed += bytes_consumed_this_time;
     }
     delete msg;
+
+    // unknown messages are summed up instead of logged one by one
+    if (unknown_count != unknown_logged && millis_since_boot() - last_unknown_log > 10000) {
+      for (auto &it : parser.unknown_msgs) {
+        LOGW("Unknown ublox msg class 0x%02X id 0x%02X: %llu", it.first >> 8, it.first & 0xff, (unsigned long long)it.second);
+      }
+      unknown_logged = unknown_count;
+      last_unknown_log = millis_since_boot();
+    }
   }
 
   delete subscriber;
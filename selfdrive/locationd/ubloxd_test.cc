@@ -75,7 +75,7 @@ int main(int argc, char** argv) {
     printf("Format: ubloxd_test stream_file_path save_prefix\n");
     return 0;
   }
-  // Parse 11360 msgs, generate 9452 events
+  // Parse 11360 msgs, generate 9405 events
   data = (uint8_t *)read_file(argv[1], &len);
   if(data == NULL) {
     LOGE("Read file %s failed\n", argv[1]);
@@ -85,7 +85,7 @@ int main(int argc, char** argv) {
   ubloxd_main(poll_ubloxraw_msg, send_gps_event);
   free(data);
   printf("Generated %d cereal events\n", save_idx);
-  if(save_idx != 9452) {
+  if(save_idx != 9405) {
     printf("Event count error: %d\n", save_idx);
     return -1;
   }
@@ -199,6 +199,20 @@ void logger_log(LoggerState *s, uint8_t* data, size_t data_size, bool in_qlog) {
   pthread_mutex_unlock(&s->lock);
 }
 
+void logger_log_qlog(LoggerState *s, uint8_t* data, size_t data_size) {
+  pthread_mutex_lock(&s->lock);
+  LoggerHandle* h = s->cur_handle;
+  if (h) {
+    pthread_mutex_lock(&h->lock);
+    if (h->bz_qlog != NULL) {
+      int bzerror;
+      BZ2_bzWrite(&bzerror, h->bz_qlog, data, data_size);
+    }
+    pthread_mutex_unlock(&h->lock);
+  }
+  pthread_mutex_unlock(&s->lock);
+}
+
 void logger_close(LoggerState *s) {
   log_sentinel(s, cereal::Sentinel::SentinelType::END_OF_ROUTE);
 
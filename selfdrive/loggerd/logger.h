@@ -48,6 +48,8 @@ int logger_next(LoggerState *s, const char* root_path,
 LoggerHandle* logger_get_handle(LoggerState *s);
 void logger_close(LoggerState *s);
 void logger_log(LoggerState *s, uint8_t* data, size_t data_size, bool in_qlog);
+// only in the qlog, for a message that goes in it changed
+void logger_log_qlog(LoggerState *s, uint8_t* data, size_t data_size);
 
 void lh_log(LoggerHandle* h, uint8_t* data, size_t data_size, bool in_qlog);
 void lh_close(LoggerHandle* h);
@@ -20,6 +20,9 @@
 #include <mutex>
 #include <condition_variable>
 #include <random>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
 
 #include <ftw.h>
 #include <zmq.h>
@@ -34,8 +37,10 @@
 #include "common/visionipc.h"
 #include "common/utilpp.h"
 #include "common/util.h"
+#include "json11.hpp"
 
 #include "logger.h"
+#include "qlog_policy.h"
 #include "messaging.hpp"
 #include "services.h"
 
@@ -68,6 +73,10 @@
 
 #define LOG_ROOT "/data/media/0/realdata"
 
+// most a socket is drained per wakeup, before the others get their turn
+#define DRAIN_MSG_BUDGET 100
+#define DRAIN_BYTES_BUDGET (1024 * 1024)
+
 #define RAW_CLIP_LENGTH 100 // 5 seconds at 20fps
 #define RAW_CLIP_FREQUENCY (randrange(61, 8*60)) // once every ~4 minutes
 
@@ -105,6 +114,97 @@ struct LoggerdState {
 };
 LoggerdState s;
 
+// State of a subscribed socket in the main loop
+struct SocketState {
+  SubSocket *sock;
+  std::string name;
+  int decimation;   // of the service list, when the qlog policy doesn't set one
+  QlogFilter qlog;
+
+  bool pending;     // has messages left from the last wakeup
+  double ready_ts;  // when it was found with messages waiting
+
+  // since the last report
+  uint64_t msg_count;
+  uint64_t bytes_count;
+  int drains;
+  int deferred;     // wakeups that used up the budget
+  double latency_sum; // from ready to drained
+  double latency_max;
+};
+
+// Loads the qlog policy file and applies it to the sockets, if it changed since last_json.
+// An invalid policy is ignored, no file is the service list's decimation.
+static void load_qlog_policy(const std::string &path, std::string &last_json,
+                             std::vector<SocketState> &sock_states, QlogSegment &qlog_segment) {
+  std::string json = util::read_file(path);
+  if (json == last_json) return;
+  last_json = json;
+
+  QlogPolicy policy;
+  if (!json.empty()) {
+    std::string err;
+    if (!qlog_policy_parse(json, policy, err)) {
+      LOGE("invalid qlog policy %s: %s", path.c_str(), err.c_str());
+      return;
+    }
+    LOGW("qlog policy %s: %zu services, %zu bytes per segment", path.c_str(), policy.services.size(), policy.segment_bytes);
+  }
+
+  for (auto &ss : sock_states) {
+    ss.qlog = QlogFilter(policy.rule(ss.name, ss.decimation));
+  }
+  qlog_segment.cap = policy.segment_bytes;
+}
+
+// Writes the counters of every socket since the last report into the segment's rlog and qlog,
+// as a logMessage event in the form of a cloudlog event, logs the sockets that fell behind,
+// and resets the counters
+static void report_sockets(LoggerState *logger, std::vector<SocketState> &sock_states, double dt) {
+  json11::Json::object services_j;
+  for (auto &ss : sock_states) {
+    if (ss.drains > 0 || ss.deferred > 0) {
+      double latency_avg = ss.drains > 0 ? ss.latency_sum / ss.drains : 0;
+      services_j[ss.name] = json11::Json::object {
+        {"msgs", (double)ss.msg_count},
+        {"bytes", (double)ss.bytes_count},
+        {"drains", ss.drains},
+        {"backlogged", ss.deferred},
+        {"pending", ss.pending},
+        {"latency_avg_ms", latency_avg * 1e3},
+        {"latency_max_ms", ss.latency_max * 1e3},
+      };
+
+      if (ss.deferred > 0 || ss.pending) {
+        LOGW("%s falling behind: %d backlogged wakeups, latency %.1f ms avg %.1f ms max, %.1f msg/sec %.2f KB/sec",
+             ss.name.c_str(), ss.deferred, latency_avg * 1e3, ss.latency_max * 1e3,
+             ss.msg_count / dt, ss.bytes_count * 0.001 / dt);
+      }
+    }
+    ss.msg_count = ss.bytes_count = 0;
+    ss.drains = ss.deferred = 0;
+    ss.latency_sum = ss.latency_max = 0;
+  }
+
+  json11::Json log_j = json11::Json::object {
+    {"msg", json11::Json::object {
+      {"event", "loggerd_sockets"},
+      {"seconds", dt},
+      {"services", services_j},
+    }},
+    {"levelnum", CLOUDLOG_INFO},
+    {"filename", __FILE__},
+    {"lineno", __LINE__},
+    {"funcname", __func__},
+    {"created", seconds_since_epoch()}
+  };
+
+  MessageBuilder msg;
+  msg.initEvent().setLogMessage(log_j.dump());
+  auto bytes = msg.toBytes();
+  logger_log(logger, bytes.begin(), bytes.size(), true);
+}
+
 #ifndef DISABLE_ENCODER
 void encoder_thread(bool is_streaming, bool raw_clips, int cam_idx) {
   int err;
@@ -549,10 +649,9 @@ int main(int argc, char** argv) {
   // subscribe to all services
 
   SubSocket *frame_sock = NULL;
-  std::vector<SubSocket*> socks;
-
-  std::map<SubSocket*, int> qlog_counter;
-  std::map<SubSocket*, int> qlog_freqs;
+  std::vector<SocketState> sock_states;
+  // only used to find the ready sockets the poller returns, once per wakeup
+  std::unordered_map<SubSocket*, int> sock_idx;
 
   for (const auto& it : services) {
     std::string name = it.name;
@@ -562,17 +661,28 @@ int main(int argc, char** argv) {
       assert(sock != NULL);
 
       poller->registerSocket(sock);
-      socks.push_back(sock);
+      sock_idx[sock] = sock_states.size();
 
       if (name == "frame") {
         frame_sock = sock;
       }
 
-      qlog_counter[sock] = (it.decimation == -1) ? -1 : 0;
-      qlog_freqs[sock] = it.decimation;
+      sock_states.emplace_back();
+      SocketState &ss = sock_states.back();
+      ss.sock = sock;
+      ss.name = name;
+      ss.decimation = it.decimation;
+      // until a policy file sets another
+      ss.qlog = QlogFilter(QlogPolicy().rule(name, it.decimation));
     }
   }
 
+  const char* qlog_policy_env = getenv("QLOG_POLICY");
+  std::string qlog_policy_path = qlog_policy_env ? qlog_policy_env : QLOG_POLICY_PATH;
+  std::string qlog_policy_json;
+  QlogSegment qlog_segment;
+  load_qlog_policy(qlog_policy_path, qlog_policy_json, sock_states, qlog_segment);
+
 
   {
     auto words = gen_init_data();
@@ -619,25 +729,54 @@ int main(int argc, char** argv) {
   uint64_t msg_count = 0;
   uint64_t bytes_count = 0;
 
+  double last_report_ts = start_ts;
+  // the socket drained first, moves on every wakeup
+  size_t rr_start = 0;
+  bool backlog = false;
+
   while (!do_exit) {
-    for (auto sock : poller->poll(100 * 1000)) {
-      while (true) {
-        Message * msg = sock->receive(true);
+    // sockets with messages left don't wait for the poll
+    auto ready = poller->poll(backlog ? 0 : 100 * 1000);
+    // after the wait, which isn't backlog
+    double poll_ts = seconds_since_boot();
+    for (auto sock : ready) {
+      SocketState &ss = sock_states[sock_idx[sock]];
+      if (!ss.pending) {
+        ss.pending = true;
+        ss.ready_ts = poll_ts;
+      }
+    }
+
+    // each ready socket in turn, up to its budget, so a burst on one doesn't hold up the others
+    backlog = false;
+    for (size_t i = 0; i < sock_states.size(); i++) {
+      SocketState &ss = sock_states[(rr_start + i) % sock_states.size()];
+      if (!ss.pending) continue;
+
+      int msgs = 0;
+      size_t bytes = 0;
+      while (msgs < DRAIN_MSG_BUDGET && bytes < DRAIN_BYTES_BUDGET) {
+        Message * msg = ss.sock->receive(true);
         if (msg == NULL){
+          ss.pending = false;
           break;
         }
 
         uint8_t* data = (uint8_t*)msg->getData();
         size_t len = msg->getSize();
 
-        if (sock == frame_sock) {
-          // track camera frames to sync to encoder
+        // interval decimation goes by when the message was sent, not when it was drained
+        double log_ts = 0;
+        if (ss.sock == frame_sock || ss.qlog.timed()) {
           auto amsg = kj::heapArray<capnp::word>((len / sizeof(capnp::word)) + 1);
           memcpy(amsg.begin(), data, len);
 
           capnp::FlatArrayMessageReader cmsg(amsg);
           cereal::Event::Reader event = cmsg.getRoot<cereal::Event>();
-          if (event.isFrame()) {
+          log_ts = event.getLogMonoTime() * 1e-9;
+
+          // track camera frames to sync to encoder
+          if (ss.sock == frame_sock && event.isFrame()) {
             std::unique_lock<std::mutex> lk(s.lock);
             s.last_frame_id = event.getFrame().getFrameId();
             lk.unlock();
@@ -645,19 +784,38 @@ int main(int argc, char** argv) {
           }
         }
 
-        logger_log(&s.logger, data, len, qlog_counter[sock] == 0);
+        bool in_qlog = ss.qlog.keep(log_ts);
+        if (in_qlog && ss.qlog.strips()) {
+          logger_log(&s.logger, data, len, false);
+          kj::ArrayPtr<const uint8_t> qlog_data = ss.qlog.strip(data, len);
+          if (qlog_segment.add(qlog_data.size())) {
+            logger_log_qlog(&s.logger, (uint8_t*)qlog_data.begin(), qlog_data.size());
+          }
+        } else {
+          logger_log(&s.logger, data, len, in_qlog && qlog_segment.add(len));
+        }
         delete msg;
 
-        if (qlog_counter[sock] != -1) {
-          //printf("%p: %d/%d\n", socks[i], qlog_counter[socks[i]], qlog_freqs[socks[i]]);
-          qlog_counter[sock]++;
-          qlog_counter[sock] %= qlog_freqs[sock];
-        }
+        msgs++;
+        bytes += len;
+      }
 
-        bytes_count += len;
-        msg_count++;
+      ss.msg_count += msgs;
+      ss.bytes_count += bytes;
+      msg_count += msgs;
+      bytes_count += bytes;
+
+      if (ss.pending) {
+        ss.deferred++;
+        backlog = true;
+      } else {
+        double latency = seconds_since_boot() - ss.ready_ts;
+        ss.drains++;
+        ss.latency_sum += latency;
+        ss.latency_max = std::max(ss.latency_max, latency);
       }
     }
+    rr_start = (rr_start + 1) % sock_states.size();
 
     double ts = seconds_since_boot();
     if (ts - last_rotate_ts > segment_length) {
@@ -665,6 +823,14 @@ int main(int argc, char** argv) {
 
       last_rotate_ts += segment_length;
 
+      // in the segment it's about, before the rotation
+      report_sockets(&s.logger, sock_states, ts - last_report_ts);
+      last_report_ts = ts;
+
+      // the new segment starts an empty qlog, with the policy file as it is now
+      load_qlog_policy(qlog_policy_path, qlog_policy_json, sock_states, qlog_segment);
+      qlog_segment.bytes = 0;
+
       std::lock_guard<std::mutex> guard(s.lock);
       s.rotate_last_frame_id = s.last_frame_id;
 
@@ -695,8 +861,8 @@ int main(int argc, char** argv) {
 
   logger_close(&s.logger);
 
-  for (auto s : socks){
-    delete s;
+  for (auto &ss : sock_states){
+    delete ss.sock;
   }
 
   delete poller;
@@ -0,0 +1,175 @@
+#include <string.h>
+
+#include <capnp/dynamic.h>
+#include <capnp/serialize.h>
+
+#include "json11.hpp"
+#include "cereal/gen/cpp/log.capnp.h"
+
+#include "qlog_policy.h"
+
+static std::vector<std::string> split_path(const std::string &path) {
+  std::vector<std::string> parts;
+  size_t start = 0;
+  while (true) {
+    size_t dot = path.find('.', start);
+    parts.push_back(path.substr(start, dot - start));
+    if (dot == std::string::npos) return parts;
+    start = dot + 1;
+  }
+}
+
+static bool check_path(const std::string &path, std::string &err) {
+  capnp::StructSchema schema = capnp::Schema::from<cereal::Event>();
+  std::vector<std::string> parts = split_path(path);
+
+  for (size_t i = 0; i < parts.size(); i++) {
+    KJ_IF_MAYBE(field, schema.findFieldByName(parts[i].c_str())) {
+      if (i + 1 == parts.size()) return true;
+
+      capnp::Type type = field->getType();
+      if (!type.isStruct()) {
+        err = "strip path " + path + ": " + parts[i] + " isn't a struct";
+        return false;
+      }
+      schema = type.asStruct();
+    } else {
+      err = "strip path " + path + ": no field " + parts[i];
+      return false;
+    }
+  }
+  return false;
+}
+
+// Clears the field at path, false if it isn't set
+static bool clear_path(capnp::DynamicStruct::Builder s, const std::vector<std::string> &parts) {
+  for (size_t i = 0; i < parts.size(); i++) {
+    KJ_IF_MAYBE(field, s.getSchema().findFieldByName(parts[i].c_str())) {
+      // not set, or not the member of a union that is
+      if (!s.has(*field)) return false;
+
+      if (i + 1 == parts.size()) {
+        s.clear(*field);
+        return true;
+      }
+      s = s.get(*field).as<capnp::DynamicStruct>();
+    } else {
+      return false;
+    }
+  }
+  return false;
+}
+
+QlogRule QlogPolicy::rule(const std::string &service, int decimation) const {
+  QlogRule r;
+  r.decimation = decimation;
+
+  auto it = services.find(service);
+  if (it != services.end()) {
+    // a rule that only strips keeps the service list's decimation
+    bool decimates = it->second.decimation != 0 || it->second.interval > 0;
+    r = it->second;
+    if (!decimates) r.decimation = decimation;
+  }
+  return r;
+}
+
+bool qlog_policy_parse(const std::string &json, QlogPolicy &policy, std::string &err) {
+  err.clear();
+  json11::Json j = json11::Json::parse(json, err);
+  if (!err.empty()) return false;
+  if (!j.is_object()) {
+    err = "policy isn't an object";
+    return false;
+  }
+
+  QlogPolicy p;
+  const json11::Json &segment_bytes = j["segment_bytes"];
+  if (!segment_bytes.is_null()) {
+    if (!segment_bytes.is_number() || segment_bytes.number_value() < 0) {
+      err = "segment_bytes isn't a size";
+      return false;
+    }
+    p.segment_bytes = segment_bytes.number_value();
+  }
+
+  for (const auto &it : j["services"].object_items()) {
+    const json11::Json &r = it.second;
+    if (!r.is_object()) {
+      err = it.first + " isn't an object";
+      return false;
+    }
+
+    // unset, until QlogPolicy::rule fills in the service list's
+    QlogRule rule;
+    rule.decimation = 0;
+
+    if (!r["decimation"].is_null()) {
+      rule.decimation = r["decimation"].int_value();
+      if (!r["decimation"].is_number() || (rule.decimation < 1 && rule.decimation != -1)) {
+        err = it.first + ": decimation must be -1 or at least 1";
+        return false;
+      }
+    }
+    if (!r["interval"].is_null()) {
+      rule.interval = r["interval"].number_value();
+      if (!r["interval"].is_number() || rule.interval <= 0) {
+        err = it.first + ": interval must be more than 0";
+        return false;
+      }
+    }
+    for (const auto &path : r["strip"].array_items()) {
+      if (!path.is_string() || !check_path(path.string_value(), err)) {
+        if (err.empty()) err = it.first + ": strip paths must be strings";
+        return false;
+      }
+      rule.strip.push_back(path.string_value());
+    }
+    p.services[it.first] = rule;
+  }
+
+  policy = p;
+  return true;
+}
+
+QlogFilter::QlogFilter(const QlogRule &rule) : rule(rule) {}
+
+bool QlogFilter::keep(double ts) {
+  if (rule.interval > 0) {
+    if (ts < next_ts) return false;
+    // on the same grid, unless the service was quiet for more than an interval
+    next_ts = (ts - next_ts < rule.interval) ? next_ts + rule.interval : ts + rule.interval;
+    return true;
+  }
+
+  if (rule.decimation < 1) return false;
+  bool in = counter == 0;
+  counter = (counter + 1) % rule.decimation;
+  return in;
+}
+
+kj::ArrayPtr<const uint8_t> QlogFilter::strip(const uint8_t *data, size_t len) {
+  size_t words = (len / sizeof(capnp::word)) + 1;
+  if (buf.size() < words) {
+    buf = kj::heapArray<capnp::word>(words);
+  }
+  memcpy(buf.begin(), data, len);
+
+  capnp::FlatArrayMessageReader reader(buf.slice(0, words));
+  capnp::MallocMessageBuilder copy;
+  copy.setRoot(reader.getRoot<cereal::Event>());
+
+  bool stripped = false;
+  for (const auto &path : rule.strip) {
+    stripped |= clear_path(capnp::toDynamic(copy.getRoot<cereal::Event>()), split_path(path));
+  }
+  if (!stripped) {
+    return kj::arrayPtr(data, len);
+  }
+
+  // the cleared fields still take up their space in copy, a second copy leaves it behind
+  capnp::MallocMessageBuilder compact;
+  compact.setRoot(copy.getRoot<cereal::Event>().asReader());
+  out = capnp::messageToFlatArray(compact);
+  return out.asBytes();
+}
@@ -0,0 +1,86 @@
+#ifndef QLOG_POLICY_H
+#define QLOG_POLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <kj/array.h>
+#include <capnp/message.h>
+
+// What goes in the qlog, set at runtime by a JSON file:
+//
+// {
+//   "segment_bytes": 4000000,
+//   "services": {
+//     "can": {"interval": 0.5},
+//     "frame": {"decimation": 20, "strip": ["frame.image"]},
+//     "model": {"decimation": 20, "strip": ["model.path.points"]},
+//     "sensorEvents": {"decimation": -1}
+//   }
+// }
+//
+// segment_bytes caps the qlog of a segment, counted before compression, 0 for no cap.
+// A service keeps every nth message with "decimation" (-1 for none), or a message every
+// "interval" seconds. The paths in "strip" are fields of the Event that are cleared in the
+// qlog copy of the message, the rlog keeps them. Services not in the file keep the
+// decimation of the service list.
+
+#define QLOG_POLICY_PATH "/data/qlog_policy.json"
+
+struct QlogRule {
+  int decimation = -1;
+  double interval = 0;
+  std::vector<std::string> strip;
+};
+
+struct QlogPolicy {
+  size_t segment_bytes = 0;
+  std::map<std::string, QlogRule> services;
+
+  // the rule of a service, decimation is the service list's
+  QlogRule rule(const std::string &service, int decimation) const;
+};
+
+// Returns false, with the reason in err, if the json isn't a valid policy.
+// Strip paths are checked against the Event schema.
+bool qlog_policy_parse(const std::string &json, QlogPolicy &policy, std::string &err);
+
+// Which messages of a service go in the qlog, and what's left of them
+class QlogFilter {
+public:
+  QlogFilter(const QlogRule &rule = QlogRule());
+
+  // whether a message with a logMonoTime of ts seconds goes in the qlog,
+  // ts only matters to interval rules
+  bool keep(double ts);
+  bool timed() const { return rule.interval > 0; }
+
+  bool strips() const { return !rule.strip.empty(); }
+  // the message with the rule's fields cleared, valid until the next call
+  kj::ArrayPtr<const uint8_t> strip(const uint8_t *data, size_t len);
+
+private:
+  QlogRule rule;
+  int counter = 0;
+  double next_ts = 0;
+  kj::Array<capnp::word> buf;
+  kj::Array<capnp::word> out;
+};
+
+// The qlog bytes of a segment, under the policy's cap
+struct QlogSegment {
+  size_t cap = 0;
+  size_t bytes = 0;
+
+  bool add(size_t len) {
+    if (cap > 0 && bytes + len > cap) return false;
+    bytes += len;
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <bzlib.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <capnp/serialize.h>
+
+#include "common/timing.h"
+#include "cereal/gen/cpp/log.capnp.h"
+
+#include "qlog_policy.h"
+
+// qlog size and CPU cost of a segment of can, frame and model messages under a few policies.
+// The filter time is what loggerd spends deciding and stripping, compression is bzip2 at the
+// logger's level on what's left.
+//   ./bench_qlog_policy [seconds]
+
+struct Message {
+  std::string service;
+  double ts;
+  kj::Array<capnp::word> words;
+};
+
+static std::vector<Message> make_segment(int seconds) {
+  std::mt19937 gen(0);
+  std::vector<Message> msgs;
+
+  for (int t = 0; t < seconds * 100; t++) {
+    double ts = t * 0.01;
+
+    capnp::MallocMessageBuilder can;
+    auto frames = can.initRoot<cereal::Event>().initCan(40);
+    for (int i = 0; i < 40; i++) {
+      frames[i].setAddress(0x100 + i);
+      frames[i].setSrc(i % 3);
+      auto dat = frames[i].initDat(8);
+      for (int k = 0; k < 8; k++) dat[k] = gen() & 0xff;
+    }
+    msgs.push_back({"can", ts, capnp::messageToFlatArray(can)});
+
+    if (t % 5 == 0) {
+      capnp::MallocMessageBuilder frame;
+      auto f = frame.initRoot<cereal::Event>().initFrame();
+      f.setFrameId(t / 5);
+      auto image = f.initImage(64 * 1024);
+      for (size_t k = 0; k < image.size(); k++) image[k] = gen() & 0xff;
+      msgs.push_back({"frame", ts, capnp::messageToFlatArray(frame)});
+
+      capnp::MallocMessageBuilder model;
+      auto m = model.initRoot<cereal::Event>().initModel();
+      m.setFrameId(t / 5);
+      auto points = m.initPath().initPoints(192);
+      for (int k = 0; k < 192; k++) points.set(k, std::uniform_real_distribution<float>(-2, 2)(gen));
+      msgs.push_back({"model", ts, capnp::messageToFlatArray(model)});
+    }
+  }
+  return msgs;
+}
+
+static void run(const char *name, const char *json, const std::vector<Message> &msgs) {
+  QlogPolicy policy;
+  std::string err;
+  if (!qlog_policy_parse(json, policy, err)) {
+    printf("%s: %s\n", name, err.c_str());
+    exit(1);
+  }
+
+  std::vector<std::string> services = {"can", "frame", "model"};
+  std::vector<QlogFilter> filters;
+  for (const auto &service : services) {
+    filters.emplace_back(policy.rule(service, 1));
+  }
+  QlogSegment segment;
+  segment.cap = policy.segment_bytes;
+
+  std::string qlog;
+  size_t rlog_bytes = 0;
+  uint64_t t = nanos_since_boot();
+  for (const Message &msg : msgs) {
+    QlogFilter &filter = filters[std::find(services.begin(), services.end(), msg.service) - services.begin()];
+    kj::ArrayPtr<const uint8_t> data = msg.words.asBytes();
+    rlog_bytes += data.size();
+
+    if (filter.keep(msg.ts)) {
+      if (filter.strips()) {
+        data = filter.strip(data.begin(), data.size());
+      }
+      if (segment.add(data.size())) {
+        qlog.append((const char *)data.begin(), data.size());
+      }
+    }
+  }
+  double filter_us = (nanos_since_boot() - t) * 1e-3;
+
+  std::vector<char> compressed(qlog.size() * 1.02 + 600);
+  unsigned int compressed_len = compressed.size();
+  t = nanos_since_boot();
+  int err_bz = BZ2_bzBuffToBuffCompress(compressed.data(), &compressed_len, (char *)qlog.data(), qlog.size(), 9, 0, 30);
+  double compress_us = (nanos_since_boot() - t) * 1e-3;
+  if (err_bz != BZ_OK) {
+    printf("%s: bzip2 error %d\n", name, err_bz);
+    exit(1);
+  }
+
+  printf("%-12s %12zu %12zu %12u %14.2f %14.1f\n", name, rlog_bytes, qlog.size(), compressed_len,
+         filter_us / msgs.size(), compress_us * 1e-3);
+}
+
+int main(int argc, char *argv[]) {
+  int seconds = argc > 1 ? atoi(argv[1]) : 60;
+  std::vector<Message> msgs = make_segment(seconds);
+  printf("%d s, %zu messages\n", seconds, msgs.size());
+  printf("%-12s %12s %12s %12s %14s %14s\n", "policy", "rlog B", "qlog B", "qlog.bz2 B", "filter us/msg", "compress ms");
+
+  run("all", R"({"services": {"can": {"decimation": 1}, "frame": {"decimation": 1}, "model": {"decimation": 1}}})", msgs);
+  run("count", R"({"services": {"can": {"decimation": 100}, "frame": {"decimation": 20}, "model": {"decimation": 20}}})", msgs);
+  run("interval", R"({"services": {"can": {"interval": 1.0}, "frame": {"interval": 1.0}, "model": {"interval": 1.0}}})", msgs);
+  run("strip", R"({"services": {"can": {"decimation": 100},
+                                "frame": {"decimation": 20, "strip": ["frame.image"]},
+                                "model": {"decimation": 20, "strip": ["model.path.points"]}}})", msgs);
+  run("capped", R"({"segment_bytes": 100000,
+                    "services": {"can": {"decimation": 1}, "frame": {"decimation": 1}, "model": {"decimation": 1}}})", msgs);
+  return 0;
+}
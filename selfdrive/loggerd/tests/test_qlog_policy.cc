@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <capnp/serialize.h>
+
+#include "cereal/gen/cpp/log.capnp.h"
+
+#include "qlog_policy.h"
+
+// Checks what a qlog policy keeps of a service's messages: the parsed rules, decimation by
+// count and by interval, the fields stripped from the qlog copy and the segment cap.
+//   ./test_qlog_policy
+
+static std::vector<int> kept(QlogFilter filter, const std::vector<double> &ts) {
+  std::vector<int> idx;
+  for (size_t i = 0; i < ts.size(); i++) {
+    if (filter.keep(ts[i])) idx.push_back(i);
+  }
+  return idx;
+}
+
+static kj::Array<capnp::word> frame_event(uint32_t frame_id, size_t image_size) {
+  capnp::MallocMessageBuilder msg;
+  auto frame = msg.initRoot<cereal::Event>().initFrame();
+  frame.setFrameId(frame_id);
+  memset(frame.initImage(image_size).begin(), 0xab, image_size);
+  return capnp::messageToFlatArray(msg);
+}
+
+static void test_parse() {
+  const char *json = R"({
+    "segment_bytes": 1000,
+    "services": {
+      "can": {"interval": 0.5},
+      "frame": {"strip": ["frame.image"]},
+      "model": {"decimation": 20, "strip": ["model.path.points"]},
+      "sensorEvents": {"decimation": -1}
+    }
+  })";
+  QlogPolicy policy;
+  std::string err;
+  assert(qlog_policy_parse(json, policy, err));
+  assert(policy.segment_bytes == 1000);
+  assert(policy.services.size() == 4);
+
+  QlogRule can = policy.rule("can", 100);
+  assert(can.interval == 0.5);
+  // a rule that only strips keeps the service list's decimation
+  QlogRule frame = policy.rule("frame", 10);
+  assert(frame.decimation == 10 && frame.strip == std::vector<std::string>{"frame.image"});
+  assert(policy.rule("model", 10).decimation == 20);
+  assert(policy.rule("sensorEvents", 10).decimation == -1);
+  // services not in the policy
+  QlogRule gps = policy.rule("gpsLocation", 5);
+  assert(gps.decimation == 5 && gps.interval == 0 && gps.strip.empty());
+
+  const char *invalid[] = {
+    "",
+    "[]",
+    R"({"segment_bytes": -1})",
+    R"({"services": {"can": 1}})",
+    R"({"services": {"can": {"decimation": 0}}})",
+    R"({"services": {"can": {"interval": -1}}})",
+    R"({"services": {"frame": {"strip": ["frame.notAField"]}}})",
+    R"({"services": {"frame": {"strip": ["frame.frameId.x"]}}})",
+    R"({"services": {"frame": {"strip": [1]}}})",
+  };
+  for (const char *j : invalid) {
+    QlogPolicy p;
+    p.segment_bytes = 7;
+    assert(!qlog_policy_parse(j, p, err));
+    assert(!err.empty());
+    // left as it was
+    assert(p.segment_bytes == 7);
+  }
+}
+
+static void test_decimation() {
+  QlogRule rule;
+  std::vector<double> ts;
+  for (int i = 0; i < 20; i++) ts.push_back(i * 0.125);
+
+  rule.decimation = 3;
+  assert((kept(QlogFilter(rule), ts) == std::vector<int>{0, 3, 6, 9, 12, 15, 18}));
+  rule.decimation = 1;
+  assert(kept(QlogFilter(rule), ts).size() == ts.size());
+  rule.decimation = -1;
+  assert(kept(QlogFilter(rule), ts).empty());
+
+  // one every 0.5s, whatever the decimation
+  rule.decimation = 3;
+  rule.interval = 0.5;
+  assert((kept(QlogFilter(rule), ts) == std::vector<int>{0, 4, 8, 12, 16}));
+
+  // the same grid through jitter, a new one after a pause
+  ts = {10.0, 10.3, 10.49, 10.51, 10.9, 11.02, 20.0, 20.2, 20.5};
+  assert((kept(QlogFilter(rule), ts) == std::vector<int>{0, 3, 5, 6, 8}));
+}
+
+static void test_strip() {
+  QlogRule rule;
+  rule.decimation = 1;
+  rule.strip = {"frame.image"};
+  QlogFilter filter(rule);
+
+  kj::Array<capnp::word> event = frame_event(42, 100000);
+  kj::ArrayPtr<const uint8_t> data = event.asBytes();
+  kj::ArrayPtr<const uint8_t> stripped = filter.strip(data.begin(), data.size());
+  assert(stripped.size() < 1000);
+
+  kj::Array<capnp::word> words = kj::heapArray<capnp::word>(stripped.size() / sizeof(capnp::word));
+  memcpy(words.begin(), stripped.begin(), stripped.size());
+  capnp::FlatArrayMessageReader reader(words);
+  cereal::Event::Reader e = reader.getRoot<cereal::Event>();
+  assert(e.isFrame());
+  assert(e.getFrame().getFrameId() == 42);
+  assert(!e.getFrame().hasImage());
+
+  // nothing to strip in other services, the message goes in as it is
+  capnp::MallocMessageBuilder can;
+  can.initRoot<cereal::Event>().initCan(3);
+  kj::Array<capnp::word> can_event = capnp::messageToFlatArray(can);
+  data = can_event.asBytes();
+  stripped = filter.strip(data.begin(), data.size());
+  assert(stripped.begin() == data.begin() && stripped.size() == data.size());
+}
+
+static void test_segment_cap() {
+  QlogSegment segment;
+  segment.cap = 100;
+  assert(segment.add(60));
+  assert(!segment.add(60));
+  assert(segment.add(40));
+  assert(!segment.add(1));
+  assert(segment.bytes == 100);
+
+  QlogSegment uncapped;
+  assert(uncapped.add(1 << 30) && uncapped.add(1 << 30));
+}
+
+int main() {
+  test_parse();
+  test_decimation();
+  test_strip();
+  test_segment_cap();
+  printf("qlog policy ok\n");
+  return 0;
+}
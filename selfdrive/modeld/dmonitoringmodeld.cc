@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
+#include <string.h>
 #include <cassert>
 
 #include "common/visionbuf.h"
@@ -9,11 +10,15 @@
 #include "common/swaglog.h"
 
 #include "models/dmonitoring.h"
+#include "models/dmonitoring_rate.h"
 
 #ifndef PATH_MAX
 #include <linux/limits.h>
 #endif
 
+// how often the rate controller reports what it's doing
+#define RATE_REPORT_MS 60000.
+
 
 volatile sig_atomic_t do_exit = 0;
 
@@ -33,11 +38,19 @@ int main(int argc, char **argv) {
   signal(SIGTERM, (sighandler_t)set_do_exit);
 
   PubMaster pm({"driverState"});
+  SubMaster sm({"carState"});
 
   // init the models
   DMonitoringModelState dmonitoringmodel;
   dmonitoring_init(&dmonitoringmodel);
 
+  DMRateState rate;
+  dm_rate_init(&rate);
+  float v_ego = 0;
+
+  double last_report = millis_since_boot();
+  DMRateState reported = rate;
+
   // loop
   VisionStream stream;
   while (!do_exit) {
@@ -60,20 +73,44 @@ int main(int argc, char **argv) {
         break;
       }
 
+      if (sm.update(0) > 0 && sm.updated("carState")) {
+        v_ego = sm["carState"].getCarState().getVEgo();
+      }
+
+      // frames that aren't due yet or went stale are dropped, never queued up
       double t1 = millis_since_boot();
+      if (!dm_rate_frame_due(&rate, t1, extra.timestamp_eof / 1e6)) {
+        continue;
+      }
+
       DMonitoringResult res = dmonitoring_eval_frame(&dmonitoringmodel, buf->addr, buf_info.width, buf_info.height);
       double t2 = millis_since_boot();
 
+      DMRateInput rate_input;
+      rate_input.face_prob = res.face_prob;
+      memcpy(rate_input.face_orientation, res.face_orientation, sizeof(rate_input.face_orientation));
+      rate_input.left_eye_prob = res.left_eye_prob;
+      rate_input.right_eye_prob = res.right_eye_prob;
+      rate_input.left_blink_prob = res.left_blink_prob;
+      rate_input.right_blink_prob = res.right_blink_prob;
+      rate_input.sg_prob = res.sg_prob;
+      rate_input.v_ego = v_ego;
+      dm_rate_update(&rate, t1, t2-t1, rate_input);
+
       // send dm packet
       dmonitoring_publish(pm, extra.frame_id, res);
 
       LOGD("dmonitoring process: %.2fms, from last %.2fms", t2-t1, t1-last);
       last = t1;
-#if defined(QCOM2) || defined(NEOS)
-      // this makes it run at about 2.7Hz on tici CPU to deal with modeld lags
-      // TODO: DSP needs to be freed (again)
-      usleep(250000);
-#endif
+
+      if (t2 - last_report >= RATE_REPORT_MS) {
+        const double dt = (t2 - last_report) / 1000.;
+        LOGW("dmonitoring rate_hz %.2f, evaluated_hz %.2f, latency_ms %.1f, skipped %llu, stale %llu in %.0fs",
+             rate.rate_hz, (rate.evaluated - reported.evaluated) / dt, rate.latency_ms,
+             (unsigned long long)(rate.skipped - reported.skipped), (unsigned long long)(rate.stale - reported.stale), dt);
+        last_report = t2;
+        reported = rate;
+      }
     }
     visionstream_destroy(&stream);
   }
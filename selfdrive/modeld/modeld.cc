@@ -120,6 +120,7 @@ int main(int argc, char **argv) {
 #endif
 
   // cl init
+  clu_init();
   cl_device_id device_id = cl_get_device_id(device_type);
   cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
   assert(err == 0);
@@ -130,6 +131,7 @@ int main(int argc, char **argv) {
   // init the models
   ModelState model;
   model_init(&model, device_id, context, true);
+  clu_print_stats("modeld");
   LOGW("models loaded, modeld starting");
 
   // loop
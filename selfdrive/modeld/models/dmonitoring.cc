@@ -3,48 +3,31 @@
 #include "common/mat.h"
 #include "common/timing.h"
 #include "common/params.h"
-
-#include <libyuv.h>
+#include "common/swaglog.h"
 
 #define MODEL_WIDTH 320
 #define MODEL_HEIGHT 640
-#define FULL_W 852 // should get these numbers from camerad
 
-#if defined(QCOM) || defined(QCOM2) || defined(NEOS)
-#define input_lambda(x) (x - 128.f) * 0.0078125f
+// the buffers are sized for this at init, anything else reallocates on the first frame
+#ifdef QCOM2
+#define FRONT_WIDTH 1928
+#define FRONT_HEIGHT 1208
 #else
-#define input_lambda(x) x // for non SNPE running platforms, assume keras model instead has lambda layer
+#define FRONT_WIDTH 1632
+#define FRONT_HEIGHT 1224
 #endif
 
-void dmonitoring_init(DMonitoringModelState* s) {
 #if defined(QCOM) || defined(QCOM2) || defined(NEOS)
-  const char* model_path = "../../models/dmonitoring_model_q.dlc";
+// (x - 128) / 128
+#define INPUT_OFFSET 128.f
+#define INPUT_SCALE 0.0078125f
 #else
-  const char* model_path = "../../models/dmonitoring_model.dlc";
-#endif
-#ifdef QCOM2
-  int runtime = USE_CPU_RUNTIME;
-#else // Assume Oneplus6 blobs workings, test after
-  int runtime = USE_DSP_RUNTIME;
+// for non SNPE running platforms, assume keras model instead has lambda layer
+#define INPUT_OFFSET 0.f
+#define INPUT_SCALE 1.f
 #endif
-  s->m = new DefaultRunModel(model_path, (float*)&s->output, OUTPUT_SIZE, runtime);
-  s->is_rhd = read_db_bool("IsRHD");
-}
-
-template <class T>
-static inline T *get_buffer(std::vector<T> &buf, const size_t size) {
-  if (buf.size() < size) {
-    buf.resize(size);
-  }
-  return buf.data();
-}
-
-DMonitoringResult dmonitoring_eval_frame(DMonitoringModelState* s, void* stream_buf, int width, int height) {
-  uint8_t *raw_buf = (uint8_t*) stream_buf;
-  uint8_t *raw_y_buf = raw_buf;
-  uint8_t *raw_u_buf = raw_y_buf + (width * height);
-  uint8_t *raw_v_buf = raw_u_buf + ((width/2) * (height/2));
 
+static void preprocess_init(DMonitoringModelState* s, int width, int height) {
 #ifndef QCOM2
   const int cropped_width = height/2;
   const int cropped_height = height;
@@ -65,84 +48,38 @@ DMonitoringResult dmonitoring_eval_frame(DMonitoringModelState* s, void* stream_
   const int crop_y_offset = 0;
 #endif
 
-  int resized_width = MODEL_WIDTH;
-  int resized_height = MODEL_HEIGHT;
-
-  uint8_t *cropped_y_buf = get_buffer(s->cropped_buf, cropped_width*cropped_height*3/2);
-  uint8_t *cropped_u_buf = cropped_y_buf + (cropped_width * cropped_height);
-  uint8_t *cropped_v_buf = cropped_u_buf + ((cropped_width/2) * (cropped_height/2));
-
-  if (!s->is_rhd) {
-    for (int r = 0; r < cropped_height/2; r++) {
-      memcpy(cropped_y_buf + 2*r*cropped_width, raw_y_buf + (2*r + global_y_offset + crop_y_offset)*width + global_x_offset + crop_x_offset, cropped_width);
-      memcpy(cropped_y_buf + (2*r+1)*cropped_width, raw_y_buf + (2*r + global_y_offset + crop_y_offset + 1)*width + global_x_offset + crop_x_offset, cropped_width);
-      memcpy(cropped_u_buf + r*cropped_width/2, raw_u_buf + (r + (global_y_offset + crop_y_offset)/2)*width/2 + (global_x_offset + crop_x_offset)/2, cropped_width/2);
-      memcpy(cropped_v_buf + r*cropped_width/2, raw_v_buf + (r + (global_y_offset + crop_y_offset)/2)*width/2 + (global_x_offset + crop_x_offset)/2, cropped_width/2);
-    }
-  } else {
-    uint8_t *premirror_cropped_y_buf = get_buffer(s->premirror_cropped_buf, cropped_width*cropped_height*3/2);
-    uint8_t *premirror_cropped_u_buf = premirror_cropped_y_buf + (cropped_width * cropped_height);
-    uint8_t *premirror_cropped_v_buf = premirror_cropped_u_buf + ((cropped_width/2) * (cropped_height/2));
-    for (int r = 0; r < cropped_height/2; r++) {
-      memcpy(premirror_cropped_y_buf + (2*r)*cropped_width, raw_y_buf + (2*r + global_y_offset + crop_y_offset)*width + global_x_offset, cropped_width);
-      memcpy(premirror_cropped_y_buf + (2*r+1)*cropped_width, raw_y_buf + (2*r + global_y_offset + crop_y_offset + 1)*width + global_x_offset, cropped_width);
-      memcpy(premirror_cropped_u_buf + r*cropped_width/2, raw_u_buf + (r + (global_y_offset + crop_y_offset)/2)*width/2 + global_x_offset/2, cropped_width/2);
-      memcpy(premirror_cropped_v_buf + r*cropped_width/2, raw_v_buf + (r + (global_y_offset + crop_y_offset)/2)*width/2 + global_x_offset/2, cropped_width/2);
-    }
-    libyuv::I420Mirror(premirror_cropped_y_buf, cropped_width,
-                       premirror_cropped_u_buf, cropped_width/2,
-                       premirror_cropped_v_buf, cropped_width/2,
-                       cropped_y_buf, cropped_width,
-                       cropped_u_buf, cropped_width/2,
-                       cropped_v_buf, cropped_width/2,
-                       cropped_width, cropped_height);
-  }
-
-  uint8_t *resized_buf = get_buffer(s->resized_buf, resized_width*resized_height*3/2);
-  uint8_t *resized_y_buf = resized_buf;
-  uint8_t *resized_u_buf = resized_y_buf + (resized_width * resized_height);
-  uint8_t *resized_v_buf = resized_u_buf + ((resized_width/2) * (resized_height/2));
+  // RHD drivers sit on the left of the image, that crop is mirrored
+  const int crop_x = global_x_offset + (s->is_rhd ? 0 : crop_x_offset);
+  const int crop_y = global_y_offset + crop_y_offset;
+  dm_preprocess_init(&s->preprocess, width, height, crop_x, crop_y, cropped_width, cropped_height,
+                     MODEL_WIDTH, MODEL_HEIGHT, s->is_rhd, INPUT_OFFSET, INPUT_SCALE);
+}
 
-  libyuv::FilterMode mode = libyuv::FilterModeEnum::kFilterBilinear;
-  libyuv::I420Scale(cropped_y_buf, cropped_width,
-                    cropped_u_buf, cropped_width/2,
-                    cropped_v_buf, cropped_width/2,
-                    cropped_width, cropped_height,
-                    resized_y_buf, resized_width,
-                    resized_u_buf, resized_width/2,
-                    resized_v_buf, resized_width/2,
-                    resized_width, resized_height,
-                    mode);
+void dmonitoring_init(DMonitoringModelState* s) {
+#if defined(QCOM) || defined(QCOM2) || defined(NEOS)
+  const char* model_path = "../../models/dmonitoring_model_q.dlc";
+#else
+  const char* model_path = "../../models/dmonitoring_model.dlc";
+#endif
+#ifdef QCOM2
+  int runtime = USE_CPU_RUNTIME;
+#else // Assume Oneplus6 blobs workings, test after
+  int runtime = USE_DSP_RUNTIME;
+#endif
+  s->m = new DefaultRunModel(model_path, (float*)&s->output, OUTPUT_SIZE, runtime);
+  s->is_rhd = read_db_bool("IsRHD");
+  preprocess_init(s, FRONT_WIDTH, FRONT_HEIGHT);
+}
 
-  int yuv_buf_len = (MODEL_WIDTH/2) * (MODEL_HEIGHT/2) * 6; // Y|u|v -> y|y|y|y|u|v
-  float *net_input_buf = get_buffer(s->net_input_buf, yuv_buf_len);
-  // one shot conversion, O(n) anyway
-  // yuvframe2tensor, normalize
-  for (int r = 0; r < MODEL_HEIGHT/2; r++) {
-    for (int c = 0; c < MODEL_WIDTH/2; c++) {
-      // Y_ul
-      net_input_buf[(c*MODEL_HEIGHT/2) + r] = input_lambda(resized_buf[(2*r*resized_width) + (2*c)]);
-      // Y_ur
-      net_input_buf[(c*MODEL_HEIGHT/2) + r + (2*(MODEL_WIDTH/2)*(MODEL_HEIGHT/2))] = input_lambda(resized_buf[(2*r*resized_width) + (2*c+1)]);
-      // Y_dl
-      net_input_buf[(c*MODEL_HEIGHT/2) + r + ((MODEL_WIDTH/2)*(MODEL_HEIGHT/2))] = input_lambda(resized_buf[(2*r*resized_width+1) + (2*c)]);
-      // Y_dr
-      net_input_buf[(c*MODEL_HEIGHT/2) + r + (3*(MODEL_WIDTH/2)*(MODEL_HEIGHT/2))] = input_lambda(resized_buf[(2*r*resized_width+1) + (2*c+1)]);
-      // U
-      net_input_buf[(c*MODEL_HEIGHT/2) + r + (4*(MODEL_WIDTH/2)*(MODEL_HEIGHT/2))] = input_lambda(resized_buf[(resized_width*resized_height) + (r*resized_width/2) + c]);
-      // V
-      net_input_buf[(c*MODEL_HEIGHT/2) + r + (5*(MODEL_WIDTH/2)*(MODEL_HEIGHT/2))] = input_lambda(resized_buf[(resized_width*resized_height) + ((resized_width/2)*(resized_height/2)) + (r*resized_width/2) + c]);
-    }
+DMonitoringResult dmonitoring_eval_frame(DMonitoringModelState* s, void* stream_buf, int width, int height) {
+  if (width != s->preprocess.width || height != s->preprocess.height) {
+    LOGW("dmonitoring: frame is %dx%d, reallocating", width, height);
+    preprocess_init(s, width, height);
   }
 
-  //printf("preprocess completed. %d \n", yuv_buf_len);
-  //FILE *dump_yuv_file = fopen("/tmp/rawdump.yuv", "wb");
-  //fwrite(raw_buf, height*width*3/2, sizeof(uint8_t), dump_yuv_file);
-  //fclose(dump_yuv_file);
-
-  //FILE *dump_yuv_file2 = fopen("/tmp/inputdump.yuv", "wb");
-  //fwrite(net_input_buf, MODEL_HEIGHT*MODEL_WIDTH*3/2, sizeof(float), dump_yuv_file2);
-  //fclose(dump_yuv_file2);
+  // crop, mirror for RHD, scale and space to depth into Y|u|v -> y|y|y|y|u|v, see dmpreprocess.cc
+  float *net_input_buf = dm_preprocess(&s->preprocess, (const uint8_t*)stream_buf);
+  const int yuv_buf_len = s->preprocess.net_input_buf.size();
 
   s->m->execute(net_input_buf, yuv_buf_len);
 
@@ -3,6 +3,7 @@
 #include "common/util.h"
 #include "commonmodel.h"
 #include "runners/run.h"
+#include "transforms/dmpreprocess.h"
 #include "messaging.hpp"
 
 #ifdef __cplusplus
@@ -28,10 +29,7 @@ typedef struct DMonitoringModelState {
   RunModel *m;
   bool is_rhd;
   float output[OUTPUT_SIZE];
-  std::vector<uint8_t> resized_buf;
-  std::vector<uint8_t> cropped_buf;
-  std::vector<uint8_t> premirror_cropped_buf;
-  std::vector<float> net_input_buf;
+  DMPreprocessState preprocess;
 } DMonitoringModelState;
 
 void dmonitoring_init(DMonitoringModelState* s);
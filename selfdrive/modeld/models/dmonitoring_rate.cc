@@ -0,0 +1,96 @@
+#include <math.h>
+#include <algorithm>
+
+#include "dmonitoring_rate.h"
+
+// same as selfdrive/monitoring/driver_monitor.py
+#define FACE_THRESHOLD 0.6
+#define EYE_THRESHOLD 0.6
+#define SG_THRESHOLD 0.5
+#define BLINK_THRESHOLD 0.5
+#define METRIC_THRESHOLD 0.4
+#define PITCH_NATURAL_OFFSET 0.02
+#define YAW_NATURAL_OFFSET 0.08
+
+// frames a little early for their slot still count, the camera only delivers every 50ms
+#define DUE_SLACK_MS 10.0
+// a frame "older" than this is from another clock (replayed), not stale
+#define MAX_FRAME_AGE_MS 5000.0
+
+static double interp(double x, const double *xp, const double *fp, int n) {
+  if (x <= xp[0]) return fp[0];
+  for (int i = 1; i < n; i++) {
+    if (x < xp[i]) {
+      return fp[i-1] + (fp[i] - fp[i-1]) * (x - xp[i-1]) / (xp[i] - xp[i-1]);
+    }
+  }
+  return fp[n-1];
+}
+
+void dm_rate_init(DMRateState *s, double cpu_budget) {
+  *s = {};
+  s->cpu_budget = cpu_budget;
+  s->rate_hz = DM_RATE_MAX_HZ;
+}
+
+float dm_rate_distraction(const DMRateInput &in) {
+  // driver_monitor.py without the calibration, good enough to decide how closely to watch.
+  // the net's yaw is in device frame, so flipped
+  const float pitch_error = in.face_orientation[0] - PITCH_NATURAL_OFFSET;
+  const float yaw_error = -in.face_orientation[1] - YAW_NATURAL_OFFSET;
+  const float pose_metric = sqrtf(pitch_error*pitch_error + yaw_error*yaw_error);
+
+  const bool sg = in.sg_prob >= SG_THRESHOLD;
+  const float left_blink = (in.left_eye_prob > EYE_THRESHOLD && !sg) ? in.left_blink_prob : 0.f;
+  const float right_blink = (in.right_eye_prob > EYE_THRESHOLD && !sg) ? in.right_blink_prob : 0.f;
+  const float blink = (left_blink + right_blink) * 0.5f;
+
+  return std::min(1.f, std::max(pose_metric / (float)METRIC_THRESHOLD, blink / (float)BLINK_THRESHOLD));
+}
+
+bool dm_rate_frame_due(DMRateState *s, double now_ms, double frame_ms) {
+  if (now_ms < s->next_ms - DUE_SLACK_MS) {
+    s->skipped++;
+    return false;
+  }
+  // a frame that sat in the queue while the last one was evaluated, the next one is fresher
+  const double age = now_ms - frame_ms;
+  if (age > DM_RATE_STALE_MS && age < MAX_FRAME_AGE_MS) {
+    s->stale++;
+    return false;
+  }
+  return true;
+}
+
+void dm_rate_update(DMRateState *s, double start_ms, double latency_ms, const DMRateInput &in) {
+  s->latency_ms = s->evaluated == 0 ? latency_ms : s->latency_ms + 0.2 * (latency_ms - s->latency_ms);
+  s->distraction = dm_rate_distraction(in);
+
+  double target = DM_RATE_MAX_HZ;
+  if (in.face_prob >= FACE_THRESHOLD) {
+    // slowest when stopped, closer to the max the faster the car goes
+    const double speed_bp[] = {0.5, 10., 30.};
+    const double speed_hz[] = {DM_RATE_MIN_HZ, 3., 4.};
+    const double base = interp(in.v_ego, speed_bp, speed_hz, 3);
+    // and up to the max as the driver looks more distracted
+    const double f = std::min(1.0, std::max(0.0, (s->distraction - 0.5) / 0.5));
+    target = base + (DM_RATE_MAX_HZ - base) * f;
+  }
+
+  const double dt = s->evaluated == 0 ? 0. : (start_ms - s->last_update_ms) / 1000.;
+  if (target >= s->rate_hz) {
+    s->rate_hz = target;
+  } else {
+    s->rate_hz = target + (s->rate_hz - target) * exp(-dt / DM_RATE_DECAY_S);
+  }
+
+  // the budget wins over the driver state, but never below the minimum
+  if (s->latency_ms > 0) {
+    s->rate_hz = std::min(s->rate_hz, s->cpu_budget * 1000. / s->latency_ms);
+  }
+  s->rate_hz = std::max(s->rate_hz, DM_RATE_MIN_HZ);
+
+  s->next_ms = start_ms + 1000. / s->rate_hz;
+  s->last_update_ms = start_ms;
+  s->evaluated++;
+}
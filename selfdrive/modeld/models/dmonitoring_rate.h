@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+// Picks how often dmonitoringmodeld evaluates a frame. Fast when the driver can't be
+// seen or looks distracted, slow when parked and attentive, and never more than
+// the CPU budget allows given the measured inference latency.
+
+// dmonitoringd only publishes dMonitoringState when a driverState comes in, and
+// controlsd raises commIssue when it's been quiet for a second
+#define DM_RATE_MIN_HZ 2.0
+#define DM_RATE_MAX_HZ 10.0
+
+// time constant the rate falls back with once the driver looks attentive again, it rises immediately
+#define DM_RATE_DECAY_S 2.0
+
+// frames older than this when they arrive are dropped instead of evaluated
+#define DM_RATE_STALE_MS 100.0
+
+// fraction of a core the model may use
+#if defined(QCOM2) || defined(NEOS)
+#define DM_RATE_CPU_BUDGET 0.35
+#else
+#define DM_RATE_CPU_BUDGET 1.0
+#endif
+
+// the driverState fields the decision is based on
+typedef struct DMRateInput {
+  float face_prob;
+  float face_orientation[3];
+  float left_eye_prob, right_eye_prob;
+  float left_blink_prob, right_blink_prob;
+  float sg_prob;
+  float v_ego;
+} DMRateInput;
+
+typedef struct DMRateState {
+  double cpu_budget;
+  double rate_hz;
+  // exponential average of the inference time
+  double latency_ms;
+  // absolute time the next frame is due, so the inference time counts towards the period
+  double next_ms;
+  double last_update_ms;
+  float distraction;
+
+  uint64_t evaluated, skipped, stale;
+} DMRateState;
+
+void dm_rate_init(DMRateState *s, double cpu_budget = DM_RATE_CPU_BUDGET);
+
+// 0 when attentive, 1 at or over the thresholds driver_monitor.py alerts on
+float dm_rate_distraction(const DMRateInput &in);
+
+// whether the frame that just arrived should be evaluated. frame_ms is its end of
+// frame timestamp, on the same clock as now_ms
+bool dm_rate_frame_due(DMRateState *s, double now_ms, double frame_ms);
+
+// after an evaluation that started at start_ms and took latency_ms
+void dm_rate_update(DMRateState *s, double start_ms, double latency_ms, const DMRateInput &in);
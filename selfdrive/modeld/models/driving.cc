@@ -1,25 +1,19 @@
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <fcntl.h>
 #include <unistd.h>
-#include <eigen3/Eigen/Dense>
 
 #include "common/timing.h"
 #include "common/params.h"
 #include "driving.h"
+#include "polyfit.h"
+
+#include <capnp/serialize.h>
+#include <kj/io.h>
 
-#define PATH_IDX 0
-#define LL_IDX PATH_IDX + MODEL_PATH_DISTANCE*2 + 1
-#define RL_IDX LL_IDX + MODEL_PATH_DISTANCE*2 + 2
-#define LEAD_IDX RL_IDX + MODEL_PATH_DISTANCE*2 + 2
-#define LONG_X_IDX LEAD_IDX + MDN_GROUP_SIZE*LEAD_MDN_N + SELECTION
-#define LONG_V_IDX LONG_X_IDX + TIME_DISTANCE*2
-#define LONG_A_IDX LONG_V_IDX + TIME_DISTANCE*2
-#define DESIRE_STATE_IDX LONG_A_IDX + TIME_DISTANCE*2
-#define META_IDX DESIRE_STATE_IDX + DESIRE_LEN
-#define POSE_IDX META_IDX + OTHER_META_SIZE + DESIRE_PRED_SIZE
-#define OUTPUT_SIZE  POSE_IDX + POSE_SIZE
 #ifdef TEMPORAL
   #define TEMPORAL_SIZE 512
 #else
@@ -28,7 +22,22 @@
 
 // #define DUMP_YUV
 
-Eigen::Matrix<float, MODEL_PATH_DISTANCE, POLYFIT_DEGREE - 1> vander;
+// the model and cameraOdometry messages are built in the first segment and serialized
+// to out, both reused every frame so publishing doesn't allocate
+#define PUBLISH_ARENA_WORDS 4096
+
+static struct {
+  // DEBUG, the points and stds of the paths are sent as well
+  bool debug;
+  // DUMP_MODEL_OUTPUTS, the raw outputs of every frame are appended to it
+  FILE *dump;
+
+  ModelDecoded model;
+  PoseDecoded pose;
+  capnp::word model_arena[PUBLISH_ARENA_WORDS];
+  capnp::word posenet_arena[PUBLISH_ARENA_WORDS];
+  capnp::word out[PUBLISH_ARENA_WORDS + 64];
+} publish;
 
 void model_init(ModelState* s, cl_device_id device_id, cl_context context, int temporal) {
   frame_init(&s->frame, MODEL_WIDTH, MODEL_HEIGHT, device_id, context);
@@ -62,12 +71,8 @@ void model_init(ModelState* s, cl_device_id device_id, cl_context context, int t
   }
 #endif
 
-  // Build Vandermonde matrix
-  for(int i = 0; i < MODEL_PATH_DISTANCE; i++) {
-    for(int j = 0; j < POLYFIT_DEGREE - 1; j++) {
-      vander(i, j) = pow(i, POLYFIT_DEGREE-j-1);
-    }
-  }
+  poly_init();
+  model_publish_init();
 }
 
 ModelDataRaw model_eval_frame(ModelState* s, cl_command_queue q,
@@ -126,109 +131,80 @@ void model_free(ModelState* s) {
   delete s->m;
 }
 
-void poly_fit(float *in_pts, float *in_stds, float *out, int valid_len) {
-  // References to inputs
-  Eigen::Map<Eigen::Matrix<float, Eigen::Dynamic, 1> > pts(in_pts, valid_len);
-  Eigen::Map<Eigen::Matrix<float, Eigen::Dynamic, 1> > std(in_stds, valid_len);
-  Eigen::Map<Eigen::Matrix<float, POLYFIT_DEGREE - 1, 1> > p(out, POLYFIT_DEGREE - 1);
-
-  float y0 = pts[0];
-  pts = pts.array() - y0;
-
-  // Build Least Squares equations
-  Eigen::Matrix<float, Eigen::Dynamic, POLYFIT_DEGREE - 1> lhs = vander.topRows(valid_len).array().colwise() / std.array();
-  Eigen::Matrix<float, Eigen::Dynamic, 1> rhs = pts.array() / std.array();
-
-  // Improve numerical stability
-  Eigen::Matrix<float, POLYFIT_DEGREE - 1, 1> scale = 1. / (lhs.array()*lhs.array()).sqrt().colwise().sum();
-  lhs = lhs * scale.asDiagonal();
-
-  // Solve inplace
-  p = lhs.colPivHouseholderQr().solve(rhs);
+void model_publish_init() {
+  publish.debug = getenv("DEBUG") != NULL;
+  const char *dump_path = getenv("DUMP_MODEL_OUTPUTS");
+  if (dump_path != NULL && publish.dump == NULL) {
+    publish.dump = fopen(dump_path, "wb");
+  }
+}
 
-  // Apply scale to output
-  p = p.transpose() * scale.asDiagonal();
-  out[3] = y0;
+static cereal::Event::Builder init_event(capnp::MallocMessageBuilder &msg, bool valid) {
+  cereal::Event::Builder event = msg.initRoot<cereal::Event>();
+  event.setLogMonoTime(nanos_since_boot());
+  event.setValid(valid);
+  return event;
 }
 
-void fill_path(cereal::ModelData::PathData::Builder path, const float * data, bool has_prob, const float offset) {
-  float points_arr[MODEL_PATH_DISTANCE];
-  float stds_arr[MODEL_PATH_DISTANCE];
-  float poly_arr[POLYFIT_DEGREE];
-  float std;
-  float prob;
-  float valid_len;
-
-  // clamp to 5 and MODEL_PATH_DISTANCE
-  valid_len = fmin(MODEL_PATH_DISTANCE, fmax(5, data[MODEL_PATH_DISTANCE*2]));
-  for (int i=0; i<MODEL_PATH_DISTANCE; i++) {
-    points_arr[i] = data[i] + offset;
-    stds_arr[i] = softplus(data[MODEL_PATH_DISTANCE + i]) + 1e-6;
-  }
-  if (has_prob) {
-    prob =  sigmoid(data[MODEL_PATH_DISTANCE*2 + 1]);
-  } else {
-    prob = 1.0;
+static void send(PubMaster &pm, const char *name, capnp::MallocMessageBuilder &msg) {
+  // only a message that outgrew its arena needs the heap
+  if (capnp::computeSerializedSizeInWords(msg) > ARRAYSIZE(publish.out)) {
+    auto words = capnp::messageToFlatArray(msg);
+    auto bytes = words.asBytes();
+    pm.send(name, bytes.begin(), bytes.size());
+    return;
   }
-  std = softplus(data[MODEL_PATH_DISTANCE]) + 1e-6;
-  poly_fit(points_arr, stds_arr, poly_arr, valid_len);
+  kj::ArrayOutputStream stream(kj::arrayPtr((kj::byte *)publish.out, sizeof(publish.out)));
+  capnp::writeMessage(stream, msg);
+  auto bytes = stream.getArray();
+  pm.send(name, bytes.begin(), bytes.size());
+}
 
-  if (std::getenv("DEBUG")){
-    kj::ArrayPtr<const float> stds(&stds_arr[0], ARRAYSIZE(stds_arr));
+void fill_path(cereal::ModelData::PathData::Builder path, const ModelDecoded &d, int idx) {
+  if (publish.debug) {
+    kj::ArrayPtr<const float> stds(&d.stds[idx][0], ARRAYSIZE(d.stds[idx]));
     path.setStds(stds);
 
-    kj::ArrayPtr<const float> points(&points_arr[0], ARRAYSIZE(points_arr));
+    kj::ArrayPtr<const float> points(&d.points[idx][0], ARRAYSIZE(d.points[idx]));
     path.setPoints(points);
   }
 
-  kj::ArrayPtr<const float> poly(&poly_arr[0], ARRAYSIZE(poly_arr));
+  kj::ArrayPtr<const float> poly(&d.poly[idx][0], ARRAYSIZE(d.poly[idx]));
   path.setPoly(poly);
-  path.setProb(prob);
-  path.setStd(std);
-  path.setValidLen(valid_len);
+  path.setProb(d.path_prob[idx]);
+  path.setStd(d.path_std[idx]);
+  path.setValidLen(d.valid_len[idx]);
 }
 
-void fill_lead(cereal::ModelData::LeadData::Builder lead, const float * data, int mdn_max_idx, int t_offset) {
-  const double x_scale = 10.0;
-  const double y_scale = 10.0;
-
-  lead.setProb(sigmoid(data[LEAD_MDN_N*MDN_GROUP_SIZE + t_offset]));
-  lead.setDist(x_scale * data[mdn_max_idx*MDN_GROUP_SIZE]);
-  lead.setStd(x_scale * softplus(data[mdn_max_idx*MDN_GROUP_SIZE + MDN_VALS]));
-  lead.setRelY(y_scale * data[mdn_max_idx*MDN_GROUP_SIZE + 1]);
-  lead.setRelYStd(y_scale * softplus(data[mdn_max_idx*MDN_GROUP_SIZE + MDN_VALS + 1]));
-  lead.setRelVel(data[mdn_max_idx*MDN_GROUP_SIZE + 2]);
-  lead.setRelVelStd(softplus(data[mdn_max_idx*MDN_GROUP_SIZE + MDN_VALS + 2]));
-  lead.setRelA(data[mdn_max_idx*MDN_GROUP_SIZE + 3]);
-  lead.setRelAStd(softplus(data[mdn_max_idx*MDN_GROUP_SIZE + MDN_VALS + 3]));
+void fill_lead(cereal::ModelData::LeadData::Builder lead, const ModelLeadDecoded &ld) {
+  lead.setProb(ld.prob);
+  lead.setDist(ld.dist);
+  lead.setStd(ld.std);
+  lead.setRelY(ld.rel_y);
+  lead.setRelYStd(ld.rel_y_std);
+  lead.setRelVel(ld.rel_vel);
+  lead.setRelVelStd(ld.rel_vel_std);
+  lead.setRelA(ld.rel_a);
+  lead.setRelAStd(ld.rel_a_std);
 }
 
-void fill_meta(cereal::ModelData::MetaData::Builder meta, const float * meta_data) {
-  kj::ArrayPtr<const float> desire_state(&meta_data[0], DESIRE_LEN);
+void fill_meta(cereal::ModelData::MetaData::Builder meta, const ModelDecoded &d) {
+  kj::ArrayPtr<const float> desire_state(d.desire_state, DESIRE_LEN);
   meta.setDesireState(desire_state);
-  meta.setEngagedProb(meta_data[DESIRE_LEN]);
-  meta.setGasDisengageProb(meta_data[DESIRE_LEN + 1]);
-  meta.setBrakeDisengageProb(meta_data[DESIRE_LEN + 2]);
-  meta.setSteerOverrideProb(meta_data[DESIRE_LEN + 3]);
-  kj::ArrayPtr<const float> desire_pred(&meta_data[DESIRE_LEN + OTHER_META_SIZE], DESIRE_PRED_SIZE);
+  meta.setEngagedProb(d.engaged_prob);
+  meta.setGasDisengageProb(d.gas_disengage_prob);
+  meta.setBrakeDisengageProb(d.brake_disengage_prob);
+  meta.setSteerOverrideProb(d.steer_override_prob);
+  kj::ArrayPtr<const float> desire_pred(d.desire_pred, DESIRE_PRED_SIZE);
   meta.setDesirePrediction(desire_pred);
 }
 
-void fill_longi(cereal::ModelData::LongitudinalData::Builder longi, const float * long_x_data, const float * long_v_data, const float * long_a_data) {
-  // just doing 10 vals, 1 every sec for now
-  float dist_arr[TIME_DISTANCE/10];
-  float speed_arr[TIME_DISTANCE/10];
-  float accel_arr[TIME_DISTANCE/10];
-  for (int i=0; i<TIME_DISTANCE/10; i++) {
-    dist_arr[i] = long_x_data[i*10];
-    speed_arr[i] = long_v_data[i*10];
-    accel_arr[i] = long_a_data[i*10];
-  }
-  kj::ArrayPtr<const float> dist(&dist_arr[0], ARRAYSIZE(dist_arr));
+void fill_longi(cereal::ModelData::LongitudinalData::Builder longi, const ModelDecoded &d) {
+  kj::ArrayPtr<const float> dist(&d.long_dist[0], ARRAYSIZE(d.long_dist));
   longi.setDistances(dist);
-  kj::ArrayPtr<const float> speed(&speed_arr[0], ARRAYSIZE(speed_arr));
+  kj::ArrayPtr<const float> speed(&d.long_speed[0], ARRAYSIZE(d.long_speed));
   longi.setSpeeds(speed);
-  kj::ArrayPtr<const float> accel(&accel_arr[0], ARRAYSIZE(accel_arr));
+  kj::ArrayPtr<const float> accel(&d.long_accel[0], ARRAYSIZE(d.long_accel));
   longi.setAccelerations(accel);
 }
 
@@ -236,69 +212,49 @@ void model_publish(PubMaster &pm, uint32_t vipc_frame_id, uint32_t frame_id,
                    uint32_t vipc_dropped_frames, float frame_drop, const ModelDataRaw &net_outputs, uint64_t timestamp_eof) {
   uint32_t frame_age = (frame_id > vipc_frame_id) ? (frame_id - vipc_frame_id) : 0;
 
-  MessageBuilder msg;
-  auto framed = msg.initEvent(frame_drop < MAX_FRAME_DROP).initModel();
+  if (publish.dump != NULL) {
+    // the outputs are contiguous from the path on
+    fwrite(net_outputs.path, sizeof(float), OUTPUT_SIZE, publish.dump);
+  }
+  ModelDecoded &d = publish.model;
+  model_decode(&d, net_outputs);
+
+  capnp::MallocMessageBuilder msg(kj::arrayPtr(publish.model_arena, PUBLISH_ARENA_WORDS));
+  auto framed = init_event(msg, frame_drop < MAX_FRAME_DROP).initModel();
   framed.setFrameId(vipc_frame_id);
   framed.setFrameAge(frame_age);
   framed.setFrameDropPerc(frame_drop * 100);
   framed.setTimestampEof(timestamp_eof);
 
-  fill_path(framed.initPath(), net_outputs.path, false, 0);
-  fill_path(framed.initLeftLane(), net_outputs.left_lane, true, 1.8);
-  fill_path(framed.initRightLane(), net_outputs.right_lane, true, -1.8);
-  fill_longi(framed.initLongitudinal(), net_outputs.long_x, net_outputs.long_v, net_outputs.long_a);
-
-  // Find the distribution that corresponds to the current lead
-  int mdn_max_idx = 0;
-  int t_offset = 0;
-  for (int i=1; i<LEAD_MDN_N; i++) {
-    if (net_outputs.lead[i*MDN_GROUP_SIZE + 8 + t_offset] > net_outputs.lead[mdn_max_idx*MDN_GROUP_SIZE + 8 + t_offset]) {
-      mdn_max_idx = i;
-    }
-  }
-  fill_lead(framed.initLead(), net_outputs.lead, mdn_max_idx, t_offset);
-  // Find the distribution that corresponds to the lead in 2s
-  mdn_max_idx = 0;
-  t_offset = 1;
-  for (int i=1; i<LEAD_MDN_N; i++) {
-    if (net_outputs.lead[i*MDN_GROUP_SIZE + 8 + t_offset] > net_outputs.lead[mdn_max_idx*MDN_GROUP_SIZE + 8 + t_offset]) {
-      mdn_max_idx = i;
-    }
-  }
-  fill_lead(framed.initLeadFuture(), net_outputs.lead, mdn_max_idx, t_offset);
-  fill_meta(framed.initMeta(), net_outputs.meta);
+  fill_path(framed.initPath(), d, 0);
+  fill_path(framed.initLeftLane(), d, 1);
+  fill_path(framed.initRightLane(), d, 2);
+  fill_longi(framed.initLongitudinal(), d);
+  fill_lead(framed.initLead(), d.leads[0]);
+  fill_lead(framed.initLeadFuture(), d.leads[1]);
+  fill_meta(framed.initMeta(), d);
 
-  pm.send("model", msg);
+  send(pm, "model", msg);
 }
 
 void posenet_publish(PubMaster &pm, uint32_t vipc_frame_id, uint32_t frame_id,
                      uint32_t vipc_dropped_frames, float frame_drop, const ModelDataRaw &net_outputs, uint64_t timestamp_eof) {
-  float trans_arr[3];
-  float trans_std_arr[3];
-  float rot_arr[3];
-  float rot_std_arr[3];
-
-  for (int i =0; i < 3; i++) {
-    trans_arr[i] = net_outputs.pose[i];
-    trans_std_arr[i] = softplus(net_outputs.pose[6 + i]) + 1e-6;
-
-    rot_arr[i] = M_PI * net_outputs.pose[3 + i] / 180.0;
-    rot_std_arr[i] = M_PI * (softplus(net_outputs.pose[9 + i]) + 1e-6) / 180.0;
-  }
+  PoseDecoded &d = publish.pose;
+  pose_decode(&d, net_outputs);
 
-  MessageBuilder msg;
-  auto posenetd = msg.initEvent(vipc_dropped_frames < 1).initCameraOdometry();
-  kj::ArrayPtr<const float> trans_vs(&trans_arr[0], 3);
+  capnp::MallocMessageBuilder msg(kj::arrayPtr(publish.posenet_arena, PUBLISH_ARENA_WORDS));
+  auto posenetd = init_event(msg, vipc_dropped_frames < 1).initCameraOdometry();
+  kj::ArrayPtr<const float> trans_vs(&d.trans[0], 3);
   posenetd.setTrans(trans_vs);
-  kj::ArrayPtr<const float> rot_vs(&rot_arr[0], 3);
+  kj::ArrayPtr<const float> rot_vs(&d.rot[0], 3);
   posenetd.setRot(rot_vs);
-  kj::ArrayPtr<const float> trans_std_vs(&trans_std_arr[0], 3);
+  kj::ArrayPtr<const float> trans_std_vs(&d.trans_std[0], 3);
   posenetd.setTransStd(trans_std_vs);
-  kj::ArrayPtr<const float> rot_std_vs(&rot_std_arr[0], 3);
+  kj::ArrayPtr<const float> rot_std_vs(&d.rot_std[0], 3);
   posenetd.setRotStd(rot_std_vs);
 
   posenetd.setTimestampEof(timestamp_eof);
   posenetd.setFrameId(vipc_frame_id);
 
-  pm.send("cameraOdometry", msg);
+  send(pm, "cameraOdometry", msg);
 }
@@ -0,0 +1,201 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "driving_decode.h"
+#include "polyfit.h"
+
+// expf and logf from cephes, four at a time with the compiler's vector extensions,
+// which become SSE on x86 and NEON on arm
+typedef float f32x4 __attribute__((vector_size(16)));
+typedef int32_t i32x4 __attribute__((vector_size(16)));
+
+static inline f32x4 splat(float v) {
+  return (f32x4){v, v, v, v};
+}
+
+// mask ? a : b
+static inline f32x4 blend(i32x4 mask, f32x4 a, f32x4 b) {
+  return (f32x4)(((i32x4)a & mask) | ((i32x4)b & ~mask));
+}
+
+static inline f32x4 exp_approx(f32x4 x) {
+  x = blend(x < splat(-87.3f), splat(-87.3f), x);
+  x = blend(x > splat(88.3f), splat(88.3f), x);
+  // round to nearest
+  const f32x4 n = (x * splat(1.44269504088896341f) + splat(12582912.f)) - splat(12582912.f);
+  const f32x4 r = x - n * splat(0.693359375f) + n * splat(2.12194440e-4f);
+  f32x4 p = splat(1.9875691500E-4f);
+  p = p * r + splat(1.3981999507E-3f);
+  p = p * r + splat(8.3334519073E-3f);
+  p = p * r + splat(4.1665795894E-2f);
+  p = p * r + splat(1.6666665459E-1f);
+  p = p * r + splat(5.0000001201E-1f);
+  const f32x4 y = p * r * r + r + splat(1.f);
+
+  const i32x4 bits = (__builtin_convertvector(n, i32x4) + 127) << 23;
+  return y * (f32x4)bits;
+}
+
+// only for x in [1, 2]
+static inline f32x4 log_approx(f32x4 x) {
+  i32x4 bits = (i32x4)x;
+  f32x4 e = __builtin_convertvector((bits >> 23) - 126, f32x4);
+  bits = (bits & 0x007fffff) | 0x3f000000;
+  f32x4 m = (f32x4)bits;
+  // m in [0.5, 1), move it around 1
+  const i32x4 small = m < splat(0.707106781186547524f);
+  e = blend(small, e - splat(1.f), e);
+  m = blend(small, m + m, m) - splat(1.f);
+
+  const f32x4 z = m * m;
+  f32x4 p = splat(7.0376836292E-2f);
+  p = p * m - splat(1.1514610310E-1f);
+  p = p * m + splat(1.1676998740E-1f);
+  p = p * m - splat(1.2420140846E-1f);
+  p = p * m + splat(1.4249322787E-1f);
+  p = p * m - splat(1.6668057665E-1f);
+  p = p * m + splat(2.0000714765E-1f);
+  p = p * m - splat(2.4999993993E-1f);
+  p = p * m + splat(3.3333331174E-1f);
+  f32x4 y = p * m * z;
+  y += e * splat(-2.12194440e-4f);
+  y -= splat(0.5f) * z;
+  return m + y + e * splat(0.693359375f);
+}
+
+static inline f32x4 sigmoid4(f32x4 x) {
+  return splat(1.f) / (splat(1.f) + exp_approx(-x));
+}
+
+static inline f32x4 softplus4(f32x4 x) {
+  // log1p(exp(x)) = max(x, 0) + log1p(exp(-|x|)), which doesn't overflow.
+  // log1p(e) as log(1+e) * e / ((1+e) - 1) keeps the precision of small e
+  const f32x4 ax = (f32x4)((i32x4)x & 0x7fffffff);
+  const f32x4 e = exp_approx(-ax);
+  const f32x4 u = splat(1.f) + e;
+  const f32x4 d = u - splat(1.f);
+  const i32x4 exact = d == splat(0.f);
+  const f32x4 l = blend(exact, e, log_approx(u) * (e / blend(exact, splat(1.f), d)));
+  return blend(x > splat(0.f), x, splat(0.f)) + l;
+}
+
+template <f32x4 (*F)(f32x4)>
+static inline void apply_array(const float *src, float *dst, int n) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    f32x4 v;
+    memcpy(&v, &src[i], sizeof(v));
+    v = F(v);
+    memcpy(&dst[i], &v, sizeof(v));
+  }
+  if (i < n) {
+    f32x4 v = splat(0.f);
+    memcpy(&v, &src[i], (n - i) * sizeof(float));
+    v = F(v);
+    memcpy(&dst[i], &v, (n - i) * sizeof(float));
+  }
+}
+
+void sigmoid_array(const float *src, float *dst, int n) {
+  apply_array<sigmoid4>(src, dst, n);
+}
+
+void softplus_array(const float *src, float *dst, int n) {
+  apply_array<softplus4>(src, dst, n);
+}
+
+static int lead_mdn_max_idx(const float *lead, int t_offset) {
+  // Find the distribution that corresponds to the lead at t_offset
+  int mdn_max_idx = 0;
+  for (int i=1; i<LEAD_MDN_N; i++) {
+    if (lead[i*MDN_GROUP_SIZE + 8 + t_offset] > lead[mdn_max_idx*MDN_GROUP_SIZE + 8 + t_offset]) {
+      mdn_max_idx = i;
+    }
+  }
+  return mdn_max_idx;
+}
+
+void model_decode(ModelDecoded *d, const ModelDataRaw &net_outputs) {
+  const float *path_data[MODEL_PATHS] = {net_outputs.path, net_outputs.left_lane, net_outputs.right_lane};
+  const float path_offset[MODEL_PATHS] = {0, 1.8, -1.8};
+
+  for (int l = 0; l < MODEL_PATHS; l++) {
+    const float *data = path_data[l];
+    // clamp to 5 and MODEL_PATH_DISTANCE
+    d->valid_len[l] = fmin(MODEL_PATH_DISTANCE, fmax(5, data[MODEL_PATH_DISTANCE*2]));
+    d->fit_len[l] = d->valid_len[l];
+    for (int i = 0; i < MODEL_PATH_DISTANCE; i++) {
+      d->points[l][i] = data[i] + path_offset[l];
+    }
+    softplus_array(&data[MODEL_PATH_DISTANCE], d->stds[l], MODEL_PATH_DISTANCE);
+    for (int i = 0; i < MODEL_PATH_DISTANCE; i++) {
+      d->stds[l][i] += 1e-6;
+    }
+    d->path_std[l] = d->stds[l][0];
+  }
+  poly_fit(MODEL_PATHS, &d->points[0][0], &d->stds[0][0], d->fit_len, &d->poly[0][0]);
+
+  // the remaining activations are few, gather them into one pass each
+  int lead_idx[MODEL_LEADS];
+  float sig_in[2 + MODEL_LEADS], sig_out[2 + MODEL_LEADS];
+  float sp_in[MODEL_LEADS*MDN_VALS], sp_out[MODEL_LEADS*MDN_VALS];
+
+  sig_in[0] = net_outputs.left_lane[MODEL_PATH_DISTANCE*2 + 1];
+  sig_in[1] = net_outputs.right_lane[MODEL_PATH_DISTANCE*2 + 1];
+  for (int k = 0; k < MODEL_LEADS; k++) {
+    lead_idx[k] = lead_mdn_max_idx(net_outputs.lead, k) * MDN_GROUP_SIZE;
+    sig_in[2 + k] = net_outputs.lead[LEAD_MDN_N*MDN_GROUP_SIZE + k];
+    for (int j = 0; j < MDN_VALS; j++) {
+      sp_in[k*MDN_VALS + j] = net_outputs.lead[lead_idx[k] + MDN_VALS + j];
+    }
+  }
+  sigmoid_array(sig_in, sig_out, 2 + MODEL_LEADS);
+  softplus_array(sp_in, sp_out, MODEL_LEADS*MDN_VALS);
+
+  d->path_prob[0] = 1.0;
+  d->path_prob[1] = sig_out[0];
+  d->path_prob[2] = sig_out[1];
+
+  const double x_scale = 10.0;
+  const double y_scale = 10.0;
+  for (int k = 0; k < MODEL_LEADS; k++) {
+    const float *lead = &net_outputs.lead[lead_idx[k]];
+    const float *std = &sp_out[k*MDN_VALS];
+    ModelLeadDecoded &ld = d->leads[k];
+    ld.prob = sig_out[2 + k];
+    ld.dist = x_scale * lead[0];
+    ld.std = x_scale * std[0];
+    ld.rel_y = y_scale * lead[1];
+    ld.rel_y_std = y_scale * std[1];
+    ld.rel_vel = lead[2];
+    ld.rel_vel_std = std[2];
+    ld.rel_a = lead[3];
+    ld.rel_a_std = std[3];
+  }
+
+  for (int i = 0; i < LONGI_POINTS; i++) {
+    d->long_dist[i] = net_outputs.long_x[i*10];
+    d->long_speed[i] = net_outputs.long_v[i*10];
+    d->long_accel[i] = net_outputs.long_a[i*10];
+  }
+
+  d->desire_state = &net_outputs.meta[0];
+  d->engaged_prob = net_outputs.meta[DESIRE_LEN];
+  d->gas_disengage_prob = net_outputs.meta[DESIRE_LEN + 1];
+  d->brake_disengage_prob = net_outputs.meta[DESIRE_LEN + 2];
+  d->steer_override_prob = net_outputs.meta[DESIRE_LEN + 3];
+  d->desire_pred = &net_outputs.meta[DESIRE_LEN + OTHER_META_SIZE];
+}
+
+void pose_decode(PoseDecoded *d, const ModelDataRaw &net_outputs) {
+  // trans and rot stds are next to each other
+  float std[6];
+  softplus_array(&net_outputs.pose[6], std, 6);
+  for (int i = 0; i < 3; i++) {
+    d->trans[i] = net_outputs.pose[i];
+    d->trans_std[i] = std[i] + 1e-6;
+    d->rot[i] = M_PI * net_outputs.pose[3 + i] / 180.0;
+    d->rot_std[i] = M_PI * (std[3 + i] + 1e-6) / 180.0;
+  }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "common/modeldata.h"
+
+// Layout of the supercombo outputs and the decoded values model_publish and
+// posenet_publish send. Kept apart from driving.h, no messaging or OpenCL needed.
+
+#define DESIRE_LEN 8
+#define TRAFFIC_CONVENTION_LEN 2
+#define LEAD_MDN_N 5 // probs for 5 groups
+#define MDN_VALS 4 // output xyva for each lead group
+#define SELECTION 3 //output 3 group (lead now, in 2s and 6s)
+#define MDN_GROUP_SIZE 11
+#define TIME_DISTANCE 100
+#define POSE_SIZE 12
+
+#define PATH_IDX 0
+#define LL_IDX (PATH_IDX + MODEL_PATH_DISTANCE*2 + 1)
+#define RL_IDX (LL_IDX + MODEL_PATH_DISTANCE*2 + 2)
+#define LEAD_IDX (RL_IDX + MODEL_PATH_DISTANCE*2 + 2)
+#define LONG_X_IDX (LEAD_IDX + MDN_GROUP_SIZE*LEAD_MDN_N + SELECTION)
+#define LONG_V_IDX (LONG_X_IDX + TIME_DISTANCE*2)
+#define LONG_A_IDX (LONG_V_IDX + TIME_DISTANCE*2)
+#define DESIRE_STATE_IDX (LONG_A_IDX + TIME_DISTANCE*2)
+#define META_IDX (DESIRE_STATE_IDX + DESIRE_LEN)
+#define POSE_IDX (META_IDX + OTHER_META_SIZE + DESIRE_PRED_SIZE)
+#define OUTPUT_SIZE (POSE_IDX + POSE_SIZE)
+
+// path, left lane and right lane
+#define MODEL_PATHS 3
+// lead now and in 2s
+#define MODEL_LEADS 2
+// just doing 10 vals, 1 every sec for now
+#define LONGI_POINTS (TIME_DISTANCE/10)
+
+struct ModelDataRaw {
+    float *path;
+    float *left_lane;
+    float *right_lane;
+    float *lead;
+    float *long_x;
+    float *long_v;
+    float *long_a;
+    float *desire_state;
+    float *meta;
+    float *pose;
+  };
+
+typedef struct ModelLeadDecoded {
+  float prob;
+  float dist, std;
+  float rel_y, rel_y_std;
+  float rel_vel, rel_vel_std;
+  float rel_a, rel_a_std;
+} ModelLeadDecoded;
+
+typedef struct ModelDecoded {
+  float points[MODEL_PATHS][MODEL_PATH_DISTANCE];
+  float stds[MODEL_PATHS][MODEL_PATH_DISTANCE];
+  float poly[MODEL_PATHS][POLYFIT_DEGREE];
+  float valid_len[MODEL_PATHS];
+  // valid_len truncated, the points fitted
+  int fit_len[MODEL_PATHS];
+  float path_std[MODEL_PATHS];
+  float path_prob[MODEL_PATHS];
+
+  ModelLeadDecoded leads[MODEL_LEADS];
+
+  float long_dist[LONGI_POINTS], long_speed[LONGI_POINTS], long_accel[LONGI_POINTS];
+
+  // the meta outputs are sent as they are
+  const float *desire_state;
+  float engaged_prob, gas_disengage_prob, brake_disengage_prob, steer_override_prob;
+  const float *desire_pred;
+} ModelDecoded;
+
+typedef struct PoseDecoded {
+  float trans[3], trans_std[3];
+  float rot[3], rot_std[3];
+} PoseDecoded;
+
+void model_decode(ModelDecoded *d, const ModelDataRaw &net_outputs);
+void pose_decode(PoseDecoded *d, const ModelDataRaw &net_outputs);
+
+// dst[i] = activation(src[i]), four at a time.
+// within a few ulp of the libm based sigmoid and softplus in commonmodel.c
+void sigmoid_array(const float *src, float *dst, int n);
+void softplus_array(const float *src, float *dst, int n);
@@ -0,0 +1,69 @@
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <eigen3/Eigen/Dense>
+
+#include "polyfit.h"
+
+// terms fitted, the constant is y0
+#define POLY_TERMS (POLYFIT_DEGREE - 1)
+// x^1 to x^(2*POLY_TERMS), the normal equations need all of them
+#define POLY_POWERS (2 * POLY_TERMS)
+
+// powers of every point index
+static Eigen::Matrix<double, MODEL_PATH_DISTANCE, POLY_POWERS> powers;
+
+void poly_init() {
+  for (int i = 0; i < MODEL_PATH_DISTANCE; i++) {
+    for (int j = 0; j < POLY_POWERS; j++) {
+      powers(i, j) = pow(i, j + 1);
+    }
+  }
+}
+
+void poly_fit(int n, const float *pts, const float *stds, const int *valid_len, float *out) {
+  assert(n <= POLYFIT_MAX_LINES);
+
+  // two columns per line, the weights and the weighted points past y0. zero past valid_len,
+  // rows past the longest line don't take part at all
+  Eigen::Matrix<double, MODEL_PATH_DISTANCE, 2 * POLYFIT_MAX_LINES> rhs;
+  int rows = 0;
+  for (int l = 0; l < n; l++) rows = std::max(rows, valid_len[l]);
+  for (int l = 0; l < n; l++) {
+    const float *line_pts = &pts[l * MODEL_PATH_DISTANCE];
+    const float *line_stds = &stds[l * MODEL_PATH_DISTANCE];
+    const float y0 = line_pts[0];
+    for (int i = 0; i < rows; i++) {
+      const double w = i < valid_len[l] ? 1. / ((double)line_stds[i] * line_stds[i]) : 0.;
+      rhs(i, 2*l) = w;
+      rhs(i, 2*l + 1) = w * (line_pts[i] - y0);
+    }
+  }
+
+  // sum(w * x^p) and sum(w * y * x^p) of every line
+  Eigen::Matrix<double, POLY_POWERS, 2 * POLYFIT_MAX_LINES> moments;
+  moments.leftCols(2*n).noalias() = powers.topRows(rows).transpose() * rhs.topLeftCorner(rows, 2*n);
+
+  for (int l = 0; l < n; l++) {
+    // coefficient a is of x^(POLY_TERMS - a), its moments are at the power minus one
+    Eigen::Matrix<double, POLY_TERMS, POLY_TERMS> lhs;
+    Eigen::Matrix<double, POLY_TERMS, 1> b;
+    for (int a = 0; a < POLY_TERMS; a++) {
+      for (int c = 0; c < POLY_TERMS; c++) {
+        lhs(a, c) = moments((POLY_TERMS - a) + (POLY_TERMS - c) - 1, 2*l);
+      }
+      b(a) = moments(POLY_TERMS - a - 1, 2*l + 1);
+    }
+
+    // the powers span many orders of magnitude, scale to a unit diagonal before solving
+    Eigen::Matrix<double, POLY_TERMS, 1> scale = lhs.diagonal().cwiseSqrt().cwiseInverse();
+    lhs = scale.asDiagonal() * lhs * scale.asDiagonal();
+    Eigen::Matrix<double, POLY_TERMS, 1> p = scale.asDiagonal() * lhs.ldlt().solve(scale.asDiagonal() * b);
+
+    float *line_out = &out[l * POLYFIT_DEGREE];
+    for (int a = 0; a < POLY_TERMS; a++) {
+      line_out[a] = p(a);
+    }
+    line_out[POLY_TERMS] = pts[l * MODEL_PATH_DISTANCE];
+  }
+}
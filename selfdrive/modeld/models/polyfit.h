@@ -0,0 +1,16 @@
+#pragma once
+
+#include "common/modeldata.h"
+
+// Weighted least squares fit of the model's polylines to x^3 + x^2 + x + y0, with x the
+// point index and y0 the first point. The powers of x are the same every frame, so
+// all lines are reduced to their normal equations with one matrix product and each
+// of those is solved in closed form.
+
+#define POLYFIT_MAX_LINES 4
+
+void poly_init();
+
+// pts and stds are n lines of MODEL_PATH_DISTANCE, only the first valid_len[i] points of
+// line i are fitted. out is n lines of POLYFIT_DEGREE coefficients, highest power first
+void poly_fit(int n, const float *pts, const float *stds, const int *valid_len, float *out);
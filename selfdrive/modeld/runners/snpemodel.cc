@@ -144,7 +144,9 @@ void SNPEModel::execute(float *net_input_buf, int buf_size) {
         PrintErrorStringAndExit();
       }
       memset(recurrent, 0, recurrent_size*sizeof(float));
-      thneed = new Thneed();
+      // THNEED_SAVE=<path> also records a portable kernel graph for replay off device
+      const char *thneed_save = getenv("THNEED_SAVE");
+      thneed = new Thneed(thneed_save != NULL);
       if (!snpe->execute(inputMap, outputMap)) {
         PrintErrorStringAndExit();
       }
@@ -160,6 +162,9 @@ void SNPEModel::execute(float *net_input_buf, int buf_size) {
 
       if (memcmp(output, outputs_golden, output_size*sizeof(float)) == 0) {
         printf("thneed selftest passed\n");
+        if (thneed_save != NULL) {
+          printf("thneed graph saved to %s: %d\n", thneed_save, thneed->save(thneed_save));
+        }
       } else {
         for (int i = 0; i < output_size; i++) {
           printf("mismatch %3d: %f %f\n", i, output[i], outputs_golden[i]);
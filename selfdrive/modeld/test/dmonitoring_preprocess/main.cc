@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include <libyuv.h>
+
+#include "transforms/dmpreprocess.h"
+
+// checks dm_preprocess against the libyuv pipeline dmonitoring_eval_frame used before,
+// and times both. ./main bench for timings
+
+#define MODEL_WIDTH 320
+#define MODEL_HEIGHT 640
+
+static double millis() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000.0 + t.tv_nsec * 1e-6;
+}
+
+// the preprocessing from dmonitoring_eval_frame before the fused kernel, for a
+// crop at (crop_x, crop_y). mirror and the normalization as on device
+struct Legacy {
+  std::vector<uint8_t> cropped_buf, premirror_cropped_buf, resized_buf;
+  std::vector<float> net_input_buf;
+};
+
+static float *legacy_preprocess(Legacy *s, const uint8_t *raw_buf, int width, int height, int crop_x, int crop_y,
+                                int cropped_width, int cropped_height, bool is_rhd, float offset, float scale) {
+  const uint8_t *raw_y_buf = raw_buf;
+  const uint8_t *raw_u_buf = raw_y_buf + (width * height);
+  const uint8_t *raw_v_buf = raw_u_buf + ((width/2) * (height/2));
+
+  const int resized_width = MODEL_WIDTH;
+  const int resized_height = MODEL_HEIGHT;
+
+  s->cropped_buf.resize(cropped_width*cropped_height*3/2);
+  uint8_t *cropped_y_buf = s->cropped_buf.data();
+  uint8_t *cropped_u_buf = cropped_y_buf + (cropped_width * cropped_height);
+  uint8_t *cropped_v_buf = cropped_u_buf + ((cropped_width/2) * (cropped_height/2));
+
+  uint8_t *dst_y = cropped_y_buf, *dst_u = cropped_u_buf, *dst_v = cropped_v_buf;
+  if (is_rhd) {
+    s->premirror_cropped_buf.resize(cropped_width*cropped_height*3/2);
+    dst_y = s->premirror_cropped_buf.data();
+    dst_u = dst_y + (cropped_width * cropped_height);
+    dst_v = dst_u + ((cropped_width/2) * (cropped_height/2));
+  }
+  for (int r = 0; r < cropped_height/2; r++) {
+    memcpy(dst_y + 2*r*cropped_width, raw_y_buf + (2*r + crop_y)*width + crop_x, cropped_width);
+    memcpy(dst_y + (2*r+1)*cropped_width, raw_y_buf + (2*r + crop_y + 1)*width + crop_x, cropped_width);
+    memcpy(dst_u + r*cropped_width/2, raw_u_buf + (r + crop_y/2)*width/2 + crop_x/2, cropped_width/2);
+    memcpy(dst_v + r*cropped_width/2, raw_v_buf + (r + crop_y/2)*width/2 + crop_x/2, cropped_width/2);
+  }
+  if (is_rhd) {
+    libyuv::I420Mirror(dst_y, cropped_width, dst_u, cropped_width/2, dst_v, cropped_width/2,
+                       cropped_y_buf, cropped_width, cropped_u_buf, cropped_width/2, cropped_v_buf, cropped_width/2,
+                       cropped_width, cropped_height);
+  }
+
+  s->resized_buf.resize(resized_width*resized_height*3/2);
+  uint8_t *resized_buf = s->resized_buf.data();
+  uint8_t *resized_y_buf = resized_buf;
+  uint8_t *resized_u_buf = resized_y_buf + (resized_width * resized_height);
+  uint8_t *resized_v_buf = resized_u_buf + ((resized_width/2) * (resized_height/2));
+  libyuv::I420Scale(cropped_y_buf, cropped_width, cropped_u_buf, cropped_width/2, cropped_v_buf, cropped_width/2,
+                    cropped_width, cropped_height,
+                    resized_y_buf, resized_width, resized_u_buf, resized_width/2, resized_v_buf, resized_width/2,
+                    resized_width, resized_height, libyuv::kFilterBilinear);
+
+#define input_lambda(x) (((float)(x) - offset) * scale)
+  s->net_input_buf.resize((MODEL_WIDTH/2) * (MODEL_HEIGHT/2) * 6);
+  float *net_input_buf = s->net_input_buf.data();
+  for (int r = 0; r < MODEL_HEIGHT/2; r++) {
+    for (int c = 0; c < MODEL_WIDTH/2; c++) {
+      net_input_buf[(c*MODEL_HEIGHT/2) + r] = input_lambda(resized_buf[(2*r*resized_width) + (2*c)]);
+      net_input_buf[(c*MODEL_HEIGHT/2) + r + (2*(MODEL_WIDTH/2)*(MODEL_HEIGHT/2))] = input_lambda(resized_buf[(2*r*resized_width) + (2*c+1)]);
+      net_input_buf[(c*MODEL_HEIGHT/2) + r + ((MODEL_WIDTH/2)*(MODEL_HEIGHT/2))] = input_lambda(resized_buf[(2*r*resized_width+1) + (2*c)]);
+      net_input_buf[(c*MODEL_HEIGHT/2) + r + (3*(MODEL_WIDTH/2)*(MODEL_HEIGHT/2))] = input_lambda(resized_buf[(2*r*resized_width+1) + (2*c+1)]);
+      net_input_buf[(c*MODEL_HEIGHT/2) + r + (4*(MODEL_WIDTH/2)*(MODEL_HEIGHT/2))] = input_lambda(resized_buf[(resized_width*resized_height) + (r*resized_width/2) + c]);
+      net_input_buf[(c*MODEL_HEIGHT/2) + r + (5*(MODEL_WIDTH/2)*(MODEL_HEIGHT/2))] = input_lambda(resized_buf[(resized_width*resized_height) + ((resized_width/2)*(resized_height/2)) + (r*resized_width/2) + c]);
+    }
+  }
+#undef input_lambda
+  return net_input_buf;
+}
+
+struct Case {
+  const char *name;
+  int width, height;
+  int crop_x, crop_y, crop_w, crop_h;
+};
+
+// the eon crops dmonitoring.cc uses, one that scales up like tici and odd offsets.
+// the old pipeline only handled even crop sizes
+static const Case cases[] = {
+  {"eon lhd", 1152, 864, 1152 - 432, 0, 432, 864},
+  {"eon rhd", 1152, 864, 0, 0, 432, 864},
+  {"upscale", 1928, 1208, 560 + 504, 300, 304, 608},
+  {"odd rhd", 1000, 700, 123, 41, 458, 658},
+};
+
+static const DMPreprocessImpl impls[] = {DM_PREPROCESS_SCALAR, DM_PREPROCESS_SSE2, DM_PREPROCESS_AVX2, DM_PREPROCESS_NEON};
+
+int main(int argc, char **argv) {
+  bool bench = argc > 1 && strcmp(argv[1], "bench") == 0;
+  int failures = 0;
+
+  for (const Case &c : cases) {
+    std::vector<uint8_t> frame(c.width * c.height * 3 / 2);
+    srand(1337);
+    for (auto &p : frame) p = rand();
+    // something smooth as well, random noise doesn't exercise the rounding much
+    for (int y = 0; y < c.height; y++) {
+      for (int x = 0; x < c.width / 2; x++) frame[y * c.width + x] = (x * 3 + y) & 0xff;
+    }
+
+    for (int normalize = 0; normalize < 2; normalize++) {
+      const float offset = normalize ? 128.f : 0.f;
+      const float scale = normalize ? 0.0078125f : 1.f;
+      const bool rhd = strstr(c.name, "rhd") != NULL;
+
+      Legacy legacy;
+      const float *golden = legacy_preprocess(&legacy, frame.data(), c.width, c.height, c.crop_x, c.crop_y,
+                                              c.crop_w, c.crop_h, rhd, offset, scale);
+      const size_t n = legacy.net_input_buf.size();
+
+      for (auto impl : impls) {
+        if (!dm_preprocess_impl_available(impl)) continue;
+        DMPreprocessState s;
+        dm_preprocess_init(&s, c.width, c.height, c.crop_x, c.crop_y, c.crop_w, c.crop_h,
+                           MODEL_WIDTH, MODEL_HEIGHT, rhd, offset, scale, impl);
+        const float *out = dm_preprocess(&s, frame.data());
+        // run twice, the row cache must not leak between frames
+        out = dm_preprocess(&s, frame.data());
+
+        size_t mismatches = 0, first = 0;
+        for (size_t i = 0; i < n; i++) {
+          if (memcmp(&out[i], &golden[i], sizeof(float)) != 0) {
+            if (mismatches++ == 0) first = i;
+          }
+        }
+        printf("%-8s %-9s %-6s: %s", c.name, normalize ? "normalize" : "raw", dm_preprocess_impl_name(impl),
+               mismatches == 0 ? "bit exact\n" : "FAILED");
+        if (mismatches != 0) {
+          printf(", %zu mismatches, first at %zu: %f != %f\n", mismatches, first, out[first], golden[first]);
+          failures++;
+        }
+      }
+    }
+  }
+
+  if (bench) {
+    const Case &c = cases[0];
+    const int iters = 500;
+    std::vector<uint8_t> frame(c.width * c.height * 3 / 2);
+    for (auto &p : frame) p = rand();
+
+    Legacy legacy;
+    double t1 = millis();
+    for (int i = 0; i < iters; i++) {
+      legacy_preprocess(&legacy, frame.data(), c.width, c.height, c.crop_x, c.crop_y, c.crop_w, c.crop_h,
+                        false, 128.f, 0.0078125f);
+    }
+    double legacy_ms = (millis() - t1) / iters;
+    printf("\n%s, %d iterations\n%-8s %.3f ms/frame\n", c.name, iters, "libyuv", legacy_ms);
+
+    for (auto impl : impls) {
+      if (!dm_preprocess_impl_available(impl)) continue;
+      DMPreprocessState s;
+      dm_preprocess_init(&s, c.width, c.height, c.crop_x, c.crop_y, c.crop_w, c.crop_h,
+                         MODEL_WIDTH, MODEL_HEIGHT, false, 128.f, 0.0078125f, impl);
+      t1 = millis();
+      for (int i = 0; i < iters; i++) {
+        dm_preprocess(&s, frame.data());
+      }
+      double ms = (millis() - t1) / iters;
+      printf("%-8s %.3f ms/frame, %.2fx\n", dm_preprocess_impl_name(impl), ms, legacy_ms / ms);
+    }
+  }
+
+  return failures != 0;
+}
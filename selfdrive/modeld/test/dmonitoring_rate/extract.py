@@ -0,0 +1,18 @@
+#!/usr/bin/env python3
+# dumps the driverState of a log, with the latest vEgo, in the format ./main reads
+# usage: ./extract.py <rlog> > drive.csv && ./main drive.csv
+import sys
+from tools.lib.logreader import LogReader
+
+if __name__ == "__main__":
+  v_ego = 0.
+  t0 = None
+  print("t,faceProb,faceOrientation0,faceOrientation1,faceOrientation2,leftEyeProb,rightEyeProb,leftBlinkProb,rightBlinkProb,sgProb,vEgo")
+  for msg in LogReader(sys.argv[1]):
+    if msg.which() == 'carState':
+      v_ego = msg.carState.vEgo
+    elif msg.which() == 'driverState':
+      ds = msg.driverState
+      t0 = msg.logMonoTime if t0 is None else t0
+      print("%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f" % ((msg.logMonoTime - t0) / 1e9, ds.faceProb,
+            *ds.faceOrientation, ds.leftEyeProb, ds.rightEyeProb, ds.leftBlinkProb, ds.rightBlinkProb, ds.sgProb, v_ego))
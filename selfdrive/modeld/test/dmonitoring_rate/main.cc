@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "models/dmonitoring_rate.h"
+
+// drives the dmonitoringmodeld rate controller with a driverState sequence as if the
+// frames came from the camera, and checks it watches closely when it has to and
+// stays within the CPU budget otherwise
+// usage: ./main [driver_state.csv], extract.py dumps one from a log
+
+#define FACE_THRESHOLD 0.6
+// how long a state has to last before its rate is judged
+#define SETTLE_S 5.0
+// consecutive frames that make the driver distracted or not visible
+#define ALERT_FRAMES 3
+
+enum Category { PARKED, DRIVING, ALERT, NUM_CATEGORIES };
+static const char *category_names[] = {"parked", "driving", "alert"};
+
+struct Row {
+  double t;
+  DMRateInput in;
+  Category category;
+};
+
+struct Platform {
+  const char *name;
+  double cpu_budget;
+  double latency_ms;
+};
+
+static const Platform platforms[] = {
+  {"pc", 1.0, 40.},
+  {"tici", 0.35, 120.},
+};
+
+static bool load(const char *path, std::vector<Row> &rows) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return false;
+  char header[512];
+  if (fgets(header, sizeof(header), f) == NULL) return false;
+  Row r = {};
+  int alert_frames = 0;
+  while (fscanf(f, "%lf,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f", &r.t, &r.in.face_prob,
+                &r.in.face_orientation[0], &r.in.face_orientation[1], &r.in.face_orientation[2],
+                &r.in.left_eye_prob, &r.in.right_eye_prob, &r.in.left_blink_prob, &r.in.right_blink_prob,
+                &r.in.sg_prob, &r.in.v_ego) == 11) {
+    r.category = r.in.v_ego < 0.5 ? PARKED : DRIVING;
+    rows.push_back(r);
+    alert_frames = (r.in.face_prob < FACE_THRESHOLD || dm_rate_distraction(r.in) >= 1.f) ? alert_frames + 1 : 0;
+    // a normal blink isn't a distraction
+    if (alert_frames >= ALERT_FRAMES) {
+      for (int i = 0; i < ALERT_FRAMES; i++) rows[rows.size() - 1 - i].category = ALERT;
+    }
+  }
+  fclose(f);
+  return rows.size() > 1;
+}
+
+static int simulate(const std::vector<Row> &rows, const Platform &p) {
+  int failures = 0;
+  DMRateState s;
+  dm_rate_init(&s, p.cpu_budget);
+
+  // evaluations and time per category, only once the state has settled
+  double settled_time[NUM_CATEGORIES] = {}, settled_evals[NUM_CATEGORIES] = {};
+  // what the budget allowed at the latency measured so far, a slow evaluation lowers it for a while
+  double settled_cap = 0;
+  double busy_until = 0, busy = 0, max_reaction = 0;
+  double state_start = rows[0].t, alert_start = -1;
+  const double frame_dt = rows[1].t - rows[0].t;
+
+  for (int i = 0; i < (int)rows.size(); i++) {
+    const Row &r = rows[i];
+    if (i > 0 && r.category != rows[i-1].category) {
+      state_start = r.t;
+      alert_start = r.category == ALERT ? r.t : -1;
+    }
+    // a single blink or glance speeds it up too, it only has to slow down again afterwards
+    if (r.category != ALERT && dm_rate_distraction(r.in) >= 1.f) {
+      state_start = r.t;
+    }
+    const bool settled = r.t - state_start >= SETTLE_S;
+    if (settled) settled_time[r.category] += frame_dt;
+    if (settled && r.category == ALERT) {
+      const double latency_ms = s.evaluated > 0 ? s.latency_ms : p.latency_ms;
+      settled_cap += frame_dt * std::max(DM_RATE_MIN_HZ, std::min(DM_RATE_MAX_HZ, p.cpu_budget * 1000. / latency_ms));
+    }
+
+    // frames that come in while the model runs are picked up when it's done
+    const double frame_ms = r.t * 1000.;
+    const double now = std::max(frame_ms, busy_until);
+    if (!dm_rate_frame_due(&s, now, frame_ms)) continue;
+
+    if (now - frame_ms > DM_RATE_STALE_MS) {
+      printf("%s: evaluated a frame %.0fms old at %.2fs\n", p.name, now - frame_ms, r.t);
+      failures++;
+    }
+
+    // some jitter, and a slow one every now and then
+    double latency = p.latency_ms * (1. + 0.1 * sin(i));
+    if (i % 97 == 0) latency *= 5;
+
+    dm_rate_update(&s, now, latency, r.in);
+    busy_until = now + latency;
+    busy += latency;
+    if (settled) settled_evals[r.category]++;
+
+    // how long the driver went unwatched before the controller reacted
+    if (alert_start >= 0 && s.rate_hz >= std::min(DM_RATE_MAX_HZ, p.cpu_budget * 1000. / s.latency_ms) - 1e-6) {
+      max_reaction = std::max(max_reaction, r.t - alert_start);
+      alert_start = -1;
+    }
+  }
+
+  const double duration = rows.back().t - rows[0].t + frame_dt;
+  const double duty = busy / (duration * 1000.);
+  const double cap = settled_time[ALERT] > 0 ? settled_cap / settled_time[ALERT] : DM_RATE_MAX_HZ;
+  double settled_hz[NUM_CATEGORIES];
+  printf("%s: %llu evaluated, %llu not due, %llu stale, duty cycle %.3f of %.2f, slowest reaction %.2fs\n",
+         p.name, (unsigned long long)s.evaluated, (unsigned long long)s.skipped, (unsigned long long)s.stale,
+         duty, p.cpu_budget, max_reaction);
+  for (int c = 0; c < NUM_CATEGORIES; c++) {
+    settled_hz[c] = settled_time[c] > 0 ? settled_evals[c] / settled_time[c] : NAN;
+    printf("  %-8s %6.1fs %6.2f Hz\n", category_names[c], settled_time[c], settled_hz[c]);
+  }
+
+  // allow for the slow evaluations the budget only catches up with afterwards
+  if (duty > p.cpu_budget * 1.1) {
+    printf("%s: over the cpu budget\n", p.name);
+    failures++;
+  }
+  if (settled_time[PARKED] > 0 && settled_hz[PARKED] > DM_RATE_MIN_HZ * 1.5) {
+    printf("%s: too fast while parked\n", p.name);
+    failures++;
+  }
+  if (settled_time[DRIVING] > 0 && settled_hz[DRIVING] > 5.) {
+    printf("%s: too fast while driving attentive\n", p.name);
+    failures++;
+  }
+  if (settled_time[ALERT] > 0 && settled_hz[ALERT] < cap * 0.8) {
+    printf("%s: too slow while the driver can't be seen or is distracted\n", p.name);
+    failures++;
+  }
+  // worst case it sees the change on the next evaluation at the slowest rate
+  if (max_reaction > 1. / DM_RATE_MIN_HZ + 2 * frame_dt) {
+    printf("%s: reacted too late\n", p.name);
+    failures++;
+  }
+  return failures;
+}
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : "driver_state.csv";
+  std::vector<Row> rows;
+  if (!load(path, rows)) {
+    printf("couldn't load %s\n", path);
+    return 1;
+  }
+  printf("%s: %zu frames, %.1fs\n", path, rows.size(), rows.back().t - rows[0].t);
+
+  int failures = 0;
+  for (const Platform &p : platforms) {
+    failures += simulate(rows, p);
+  }
+  printf("%s\n", failures == 0 ? "passed" : "FAILED");
+  return failures != 0;
+}
@@ -0,0 +1,267 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "models/driving_decode.h"
+#include "models/polyfit.h"
+
+// checks model_decode and pose_decode against the scalar decoding model_publish and
+// posenet_publish did before, on raw outputs recorded with DUMP_MODEL_OUTPUTS=<file>
+// or generated ones. ./main [file] [bench]
+
+static double millis() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000.0 + t.tv_nsec * 1e-6;
+}
+
+// from commonmodel.c
+static float sigmoid(float input) {
+  return 1 / (1 + expf(-input));
+}
+
+static float softplus(float input) {
+  return log1p(expf(input));
+}
+
+// the fill_* functions of driving.cc before, writing to the decoded struct instead of the builders
+static void legacy_path(ModelDecoded *d, int idx, const float * data, bool has_prob, const float offset) {
+  d->valid_len[idx] = fmin(MODEL_PATH_DISTANCE, fmax(5, data[MODEL_PATH_DISTANCE*2]));
+  d->fit_len[idx] = d->valid_len[idx];
+  for (int i=0; i<MODEL_PATH_DISTANCE; i++) {
+    d->points[idx][i] = data[i] + offset;
+    d->stds[idx][i] = softplus(data[MODEL_PATH_DISTANCE + i]) + 1e-6;
+  }
+  if (has_prob) {
+    d->path_prob[idx] = sigmoid(data[MODEL_PATH_DISTANCE*2 + 1]);
+  } else {
+    d->path_prob[idx] = 1.0;
+  }
+  d->path_std[idx] = softplus(data[MODEL_PATH_DISTANCE]) + 1e-6;
+}
+
+static void legacy_lead(ModelLeadDecoded *lead, const float * data, int mdn_max_idx, int t_offset) {
+  const double x_scale = 10.0;
+  const double y_scale = 10.0;
+
+  lead->prob = sigmoid(data[LEAD_MDN_N*MDN_GROUP_SIZE + t_offset]);
+  lead->dist = x_scale * data[mdn_max_idx*MDN_GROUP_SIZE];
+  lead->std = x_scale * softplus(data[mdn_max_idx*MDN_GROUP_SIZE + MDN_VALS]);
+  lead->rel_y = y_scale * data[mdn_max_idx*MDN_GROUP_SIZE + 1];
+  lead->rel_y_std = y_scale * softplus(data[mdn_max_idx*MDN_GROUP_SIZE + MDN_VALS + 1]);
+  lead->rel_vel = data[mdn_max_idx*MDN_GROUP_SIZE + 2];
+  lead->rel_vel_std = softplus(data[mdn_max_idx*MDN_GROUP_SIZE + MDN_VALS + 2]);
+  lead->rel_a = data[mdn_max_idx*MDN_GROUP_SIZE + 3];
+  lead->rel_a_std = softplus(data[mdn_max_idx*MDN_GROUP_SIZE + MDN_VALS + 3]);
+}
+
+static void legacy_decode(ModelDecoded *d, PoseDecoded *p, const ModelDataRaw &net_outputs) {
+  legacy_path(d, 0, net_outputs.path, false, 0);
+  legacy_path(d, 1, net_outputs.left_lane, true, 1.8);
+  legacy_path(d, 2, net_outputs.right_lane, true, -1.8);
+  poly_fit(MODEL_PATHS, &d->points[0][0], &d->stds[0][0], d->fit_len, &d->poly[0][0]);
+
+  for (int i=0; i<LONGI_POINTS; i++) {
+    d->long_dist[i] = net_outputs.long_x[i*10];
+    d->long_speed[i] = net_outputs.long_v[i*10];
+    d->long_accel[i] = net_outputs.long_a[i*10];
+  }
+
+  for (int t_offset = 0; t_offset < MODEL_LEADS; t_offset++) {
+    int mdn_max_idx = 0;
+    for (int i=1; i<LEAD_MDN_N; i++) {
+      if (net_outputs.lead[i*MDN_GROUP_SIZE + 8 + t_offset] > net_outputs.lead[mdn_max_idx*MDN_GROUP_SIZE + 8 + t_offset]) {
+        mdn_max_idx = i;
+      }
+    }
+    legacy_lead(&d->leads[t_offset], net_outputs.lead, mdn_max_idx, t_offset);
+  }
+
+  d->desire_state = &net_outputs.meta[0];
+  d->engaged_prob = net_outputs.meta[DESIRE_LEN];
+  d->gas_disengage_prob = net_outputs.meta[DESIRE_LEN + 1];
+  d->brake_disengage_prob = net_outputs.meta[DESIRE_LEN + 2];
+  d->steer_override_prob = net_outputs.meta[DESIRE_LEN + 3];
+  d->desire_pred = &net_outputs.meta[DESIRE_LEN + OTHER_META_SIZE];
+
+  for (int i =0; i < 3; i++) {
+    p->trans[i] = net_outputs.pose[i];
+    p->trans_std[i] = softplus(net_outputs.pose[6 + i]) + 1e-6;
+    p->rot[i] = M_PI * net_outputs.pose[3 + i] / 180.0;
+    p->rot_std[i] = M_PI * (softplus(net_outputs.pose[9 + i]) + 1e-6) / 180.0;
+  }
+}
+
+static ModelDataRaw raw_outputs(float *output) {
+  ModelDataRaw net_outputs;
+  net_outputs.path = &output[PATH_IDX];
+  net_outputs.left_lane = &output[LL_IDX];
+  net_outputs.right_lane = &output[RL_IDX];
+  net_outputs.lead = &output[LEAD_IDX];
+  net_outputs.long_x = &output[LONG_X_IDX];
+  net_outputs.long_v = &output[LONG_V_IDX];
+  net_outputs.long_a = &output[LONG_A_IDX];
+  net_outputs.meta = &output[DESIRE_STATE_IDX];
+  net_outputs.pose = &output[POSE_IDX];
+  return net_outputs;
+}
+
+// outputs shaped roughly like the net's: smooth lines, stds around softplus(-2..2)
+static void generate_outputs(std::vector<float> &outputs, int frames) {
+  srand(1337);
+  outputs.resize((size_t)frames * OUTPUT_SIZE);
+  for (int f = 0; f < frames; f++) {
+    float *o = &outputs[(size_t)f * OUTPUT_SIZE];
+    for (int i = 0; i < OUTPUT_SIZE; i++) {
+      o[i] = (rand() / (float)RAND_MAX - 0.5f) * 8.f;
+    }
+    const int lines[] = {PATH_IDX, LL_IDX, RL_IDX};
+    for (int l : lines) {
+      const float c = (rand() / (float)RAND_MAX - 0.5f) * 4.f, k = (rand() / (float)RAND_MAX - 0.5f) * 1e-4f;
+      for (int i = 0; i < MODEL_PATH_DISTANCE; i++) {
+        o[l + i] = c + k * i * i + (rand() / (float)RAND_MAX - 0.5f) * 0.1f;
+      }
+      o[l + MODEL_PATH_DISTANCE*2] = rand() % 220;
+    }
+  }
+  // and the extremes
+  float *o = &outputs[0];
+  const float extremes[] = {-100.f, -88.f, -30.f, -1e-4f, 0.f, 1e-4f, 15.f, 30.f, 88.f, 100.f};
+  for (int i = 0; i < (int)(sizeof(extremes) / sizeof(extremes[0])); i++) {
+    o[PATH_IDX + MODEL_PATH_DISTANCE + i] = extremes[i];
+    o[POSE_IDX + 6 + (i % 6)] = extremes[i];
+  }
+}
+
+static int failures = 0;
+static double max_err = 0;
+
+// relative, or absolute below floor
+static void check(const char *name, int frame, double got, double expected, double floor = 1e-3) {
+  // softplus used to overflow to inf for large inputs, the decoded value is the limit
+  if (isinf(expected) && expected > 0 && isfinite(got)) return;
+  const double err = fabs(got - expected) / std::max(fabs(expected), floor);
+  max_err = std::max(max_err, err);
+  if (!(err <= 2e-6)) {
+    if (failures++ < 10) printf("frame %d %s: %.9g != %.9g\n", frame, name, got, expected);
+  }
+}
+
+static void check_frame(int f, const ModelDecoded &d, const PoseDecoded &p, const ModelDecoded &e, const PoseDecoded &ep) {
+  for (int l = 0; l < MODEL_PATHS; l++) {
+    for (int i = 0; i < MODEL_PATH_DISTANCE; i++) {
+      check("points", f, d.points[l][i], e.points[l][i]);
+      check("stds", f, d.stds[l][i], e.stds[l][i]);
+    }
+    // the fits only differ by the stds, a 0.1mm difference is nothing
+    for (int i = 0; i < d.fit_len[l]; i++) {
+      const double x = i;
+      const double a = ((d.poly[l][0] * x + d.poly[l][1]) * x + d.poly[l][2]) * x + d.poly[l][3];
+      const double b = ((e.poly[l][0] * x + e.poly[l][1]) * x + e.poly[l][2]) * x + e.poly[l][3];
+      check("poly", f, a, b, 50.);
+    }
+    check("valid_len", f, d.valid_len[l], e.valid_len[l]);
+    check("path std", f, d.path_std[l], e.path_std[l]);
+    check("path prob", f, d.path_prob[l], e.path_prob[l]);
+  }
+  for (int k = 0; k < MODEL_LEADS; k++) {
+    const ModelLeadDecoded &a = d.leads[k], &b = e.leads[k];
+    check("lead prob", f, a.prob, b.prob);
+    check("lead dist", f, a.dist, b.dist);
+    check("lead std", f, a.std, b.std);
+    check("lead rel_y", f, a.rel_y, b.rel_y);
+    check("lead rel_y_std", f, a.rel_y_std, b.rel_y_std);
+    check("lead rel_vel", f, a.rel_vel, b.rel_vel);
+    check("lead rel_vel_std", f, a.rel_vel_std, b.rel_vel_std);
+    check("lead rel_a", f, a.rel_a, b.rel_a);
+    check("lead rel_a_std", f, a.rel_a_std, b.rel_a_std);
+  }
+  for (int i = 0; i < LONGI_POINTS; i++) {
+    check("long dist", f, d.long_dist[i], e.long_dist[i]);
+    check("long speed", f, d.long_speed[i], e.long_speed[i]);
+    check("long accel", f, d.long_accel[i], e.long_accel[i]);
+  }
+  check("engaged", f, d.engaged_prob, e.engaged_prob);
+  check("desire state", f, d.desire_state == e.desire_state, 1);
+  check("desire pred", f, d.desire_pred == e.desire_pred, 1);
+  for (int i = 0; i < 3; i++) {
+    check("trans", f, p.trans[i], ep.trans[i]);
+    check("trans std", f, p.trans_std[i], ep.trans_std[i]);
+    check("rot", f, p.rot[i], ep.rot[i]);
+    check("rot std", f, p.rot_std[i], ep.rot_std[i]);
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  bool bench = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "bench") == 0) bench = true;
+    else path = argv[i];
+  }
+  poly_init();
+
+  std::vector<float> outputs;
+  if (path != NULL) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+      printf("couldn't open %s\n", path);
+      return 1;
+    }
+    float frame[OUTPUT_SIZE];
+    while (fread(frame, sizeof(float), OUTPUT_SIZE, f) == OUTPUT_SIZE) {
+      outputs.insert(outputs.end(), frame, frame + OUTPUT_SIZE);
+    }
+    fclose(f);
+  } else {
+    generate_outputs(outputs, 200);
+  }
+  const int frames = outputs.size() / OUTPUT_SIZE;
+
+  // the activations alone, over the range that matters, against double precision
+  double max_sigmoid = 0, max_softplus = 0;
+  for (float x = -60.f; x <= 60.f; x += 0.001f) {
+    float s, sp;
+    sigmoid_array(&x, &s, 1);
+    softplus_array(&x, &sp, 1);
+    max_sigmoid = std::max(max_sigmoid, fabs(s - 1. / (1. + exp(-(double)x))) / (1. / (1. + exp(-(double)x))));
+    max_softplus = std::max(max_softplus, fabs(sp - log1p(exp((double)x))) / log1p(exp((double)x)));
+  }
+  printf("relative error, sigmoid %e, softplus %e\n", max_sigmoid, max_softplus);
+  if (max_sigmoid > 1e-6 || max_softplus > 1e-6) failures++;
+
+  ModelDecoded d, e;
+  PoseDecoded p, ep;
+  for (int f = 0; f < frames; f++) {
+    const ModelDataRaw net_outputs = raw_outputs(&outputs[(size_t)f * OUTPUT_SIZE]);
+    model_decode(&d, net_outputs);
+    pose_decode(&p, net_outputs);
+    legacy_decode(&e, &ep, net_outputs);
+    check_frame(f, d, p, e, ep);
+  }
+  printf("%s: %d frames, max relative difference %e\n", path != NULL ? path : "generated", frames, max_err);
+
+  if (bench) {
+    const int iters = 20000;
+    double t1 = millis();
+    for (int i = 0; i < iters; i++) {
+      legacy_decode(&e, &ep, raw_outputs(&outputs[(size_t)(i % frames) * OUTPUT_SIZE]));
+    }
+    const double legacy_us = (millis() - t1) * 1000. / iters;
+    t1 = millis();
+    for (int i = 0; i < iters; i++) {
+      const ModelDataRaw net_outputs = raw_outputs(&outputs[(size_t)(i % frames) * OUTPUT_SIZE]);
+      model_decode(&d, net_outputs);
+      pose_decode(&p, net_outputs);
+    }
+    const double us = (millis() - t1) * 1000. / iters;
+    printf("\ndecode, %d iterations\nscalar  %8.2f us/frame\nbatched %8.2f us/frame, %.2fx\n", iters, legacy_us, us, legacy_us / us);
+  }
+
+  printf("%s\n", failures == 0 ? "passed" : "FAILED");
+  return failures != 0;
+}
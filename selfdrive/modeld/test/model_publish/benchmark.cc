@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include "common/timing.h"
+#include "models/driving.h"
+#include "models/polyfit.h"
+
+// times decoding and model_publish/posenet_publish on random net outputs
+// usage: model_publish_benchmark [iterations]
+
+static void report(const char *name, std::vector<double> &times) {
+  std::sort(times.begin(), times.end());
+  double total = 0;
+  for (double t : times) total += t;
+  printf("%-16s mean %.3f ms, median %.3f ms, max %.3f ms\n",
+         name, total / times.size(), times[times.size()/2], times.back());
+}
+
+int main(int argc, char **argv) {
+  const int iters = argc > 1 ? atoi(argv[1]) : 1000;
+
+  poly_init();
+  model_publish_init();
+  PubMaster pm({"model", "cameraOdometry"});
+
+  std::vector<float> output(OUTPUT_SIZE);
+  srand(1337);
+  for (auto &v : output) v = (rand() / (float)RAND_MAX - 0.5f) * 4.f;
+
+  // as model_eval_frame lays them out
+  ModelDataRaw net_outputs;
+  net_outputs.path = &output[PATH_IDX];
+  net_outputs.left_lane = &output[LL_IDX];
+  net_outputs.right_lane = &output[RL_IDX];
+  net_outputs.lead = &output[LEAD_IDX];
+  net_outputs.long_x = &output[LONG_X_IDX];
+  net_outputs.long_v = &output[LONG_V_IDX];
+  net_outputs.long_a = &output[LONG_A_IDX];
+  net_outputs.meta = &output[DESIRE_STATE_IDX];
+  net_outputs.pose = &output[POSE_IDX];
+  // fit most of the lines, as when driving
+  net_outputs.path[MODEL_PATH_DISTANCE*2] = 150;
+  net_outputs.left_lane[MODEL_PATH_DISTANCE*2] = 120;
+  net_outputs.right_lane[MODEL_PATH_DISTANCE*2] = 100;
+
+  printf("%d iterations\n", iters);
+  std::vector<double> decode_times, model_times, posenet_times;
+  ModelDecoded decoded;
+  for (int i = 0; i < iters; i++) {
+    double t1 = millis_since_boot();
+    model_decode(&decoded, net_outputs);
+    double t2 = millis_since_boot();
+    model_publish(pm, i, i, 0, 0, net_outputs, 0);
+    double t3 = millis_since_boot();
+    posenet_publish(pm, i, i, 0, 0, net_outputs, 0);
+    double t4 = millis_since_boot();
+    decode_times.push_back(t2 - t1);
+    model_times.push_back(t3 - t2);
+    posenet_times.push_back(t4 - t3);
+  }
+  report("decode", decode_times);
+  report("model_publish", model_times);
+  report("posenet_publish", posenet_times);
+  return 0;
+}
@@ -1,52 +1,182 @@
 #include <iostream>
 #include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include <eigen3/Eigen/Dense>
 
 #include "data.h"
+#include "models/polyfit.h"
 
-Eigen::Matrix<float, MODEL_PATH_DISTANCE, POLYFIT_DEGREE> vander;
+// checks the batched poly_fit against the per line QR solve driving.cc used before,
+// and times both for the three lines model_publish fits. ./main bench for timings
 
-void poly_init(){
+Eigen::Matrix<float, MODEL_PATH_DISTANCE, POLYFIT_DEGREE - 1> vander;
+
+void poly_init_qr() {
   // Build Vandermonde matrix
   for(int i = 0; i < MODEL_PATH_DISTANCE; i++) {
-    for(int j = 0; j < POLYFIT_DEGREE; j++) {
+    for(int j = 0; j < POLYFIT_DEGREE - 1; j++) {
       vander(i, j) = pow(i, POLYFIT_DEGREE-j-1);
     }
   }
 }
 
-void poly_fit(float *in_pts, float *in_stds, float *out) {
+void poly_fit_qr(float *in_pts, float *in_stds, float *out, int valid_len) {
   // References to inputs
-  Eigen::Map<Eigen::Matrix<float, MODEL_PATH_DISTANCE, 1> > pts(in_pts, MODEL_PATH_DISTANCE);
-  Eigen::Map<Eigen::Matrix<float, MODEL_PATH_DISTANCE, 1> > std(in_stds, MODEL_PATH_DISTANCE);
-  Eigen::Map<Eigen::Matrix<float, POLYFIT_DEGREE, 1> > p(out, POLYFIT_DEGREE);
+  Eigen::Map<Eigen::Matrix<float, Eigen::Dynamic, 1> > pts(in_pts, valid_len);
+  Eigen::Map<Eigen::Matrix<float, Eigen::Dynamic, 1> > std(in_stds, valid_len);
+  Eigen::Map<Eigen::Matrix<float, POLYFIT_DEGREE - 1, 1> > p(out, POLYFIT_DEGREE - 1);
+
+  float y0 = pts[0];
+  pts = pts.array() - y0;
 
   // Build Least Squares equations
-  Eigen::Matrix<float, MODEL_PATH_DISTANCE, POLYFIT_DEGREE> lhs = vander.array().colwise() / std.array();
-  Eigen::Matrix<float, MODEL_PATH_DISTANCE, 1> rhs = pts.array() / std.array();
+  Eigen::Matrix<float, Eigen::Dynamic, POLYFIT_DEGREE - 1> lhs = vander.topRows(valid_len).array().colwise() / std.array();
+  Eigen::Matrix<float, Eigen::Dynamic, 1> rhs = pts.array() / std.array();
 
-  Eigen::Matrix<float, POLYFIT_DEGREE, 1> scale = 1. / (lhs.array()*lhs.array()).sqrt().colwise().sum();
+  // Improve numerical stability
+  Eigen::Matrix<float, POLYFIT_DEGREE - 1, 1> scale = 1. / (lhs.array()*lhs.array()).sqrt().colwise().sum();
   lhs = lhs * scale.asDiagonal();
 
   // Solve inplace
-  Eigen::ColPivHouseholderQR<Eigen::Ref<Eigen::MatrixXf> > qr(lhs);
-  p = qr.solve(rhs);
+  p = lhs.colPivHouseholderQr().solve(rhs);
 
+  // Apply scale to output
   p = p.transpose() * scale.asDiagonal();
+  out[3] = y0;
+}
+
+static double millis() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000.0 + t.tv_nsec * 1e-6;
 }
 
-int main(void) {
+static double poly_eval(const float *p, double x) {
+  return ((p[0] * x + p[1]) * x + p[2]) * x + p[3];
+}
+
+// weighted squared error of a fit, the quantity both solvers minimize
+static double fit_cost(const float *p, const float *pts, const float *stds, int valid_len) {
+  double cost = 0;
+  for (int i = 0; i < valid_len; i++) {
+    const double e = (poly_eval(p, i) - pts[i]) / stds[i];
+    cost += e * e;
+  }
+  return cost;
+}
+
+// a lane like line with noise, and stds growing with distance like the model's
+static void random_line(float *pts, float *stds) {
+  const double c0 = (rand() / (double)RAND_MAX - 0.5) * 4.;
+  const double c1 = (rand() / (double)RAND_MAX - 0.5) * 0.05;
+  const double c2 = (rand() / (double)RAND_MAX - 0.5) * 2e-4;
+  const double c3 = (rand() / (double)RAND_MAX - 0.5) * 2e-6;
+  for (int i = 0; i < MODEL_PATH_DISTANCE; i++) {
+    stds[i] = 0.05 + i * 0.01 * (rand() / (double)RAND_MAX) + 1e-6;
+    pts[i] = c0 + c1 * i + c2 * i * i + c3 * i * i * i + stds[i] * (rand() / (double)RAND_MAX - 0.5);
+  }
+}
+
+int main(int argc, char **argv) {
+  bool bench = argc > 1 && strcmp(argv[1], "bench") == 0;
+  poly_init_qr();
   poly_init();
 
+  const int lines = 1000;
+  float *all_pts = new float[lines * MODEL_PATH_DISTANCE];
+  float *all_stds = new float[lines * MODEL_PATH_DISTANCE];
+  int *all_valid_len = new int[lines];
+
+  // the recorded line at every length, then random ones
+  srand(1337);
+  for (int l = 0; l < lines; l++) {
+    float *line_pts = &all_pts[l * MODEL_PATH_DISTANCE];
+    float *line_stds = &all_stds[l * MODEL_PATH_DISTANCE];
+    if (l < MODEL_PATH_DISTANCE - 4) {
+      memcpy(line_pts, pts, sizeof(pts));
+      memcpy(line_stds, stds, sizeof(stds));
+      all_valid_len[l] = 5 + l;
+    } else {
+      random_line(line_pts, line_stds);
+      all_valid_len[l] = 5 + rand() % (MODEL_PATH_DISTANCE - 4);
+    }
+  }
+
+  // the same solution up to float rounding: the curves agree over the fitted range,
+  // and the batched fit is never meaningfully worse in the cost both minimize
+  double max_diff = 0, max_rel_cost = 0;
+  int failures = 0;
+  for (int l = 0; l < lines; l += POLYFIT_MAX_LINES) {
+    const int n = std::min(POLYFIT_MAX_LINES, lines - l);
+    float batched[POLYFIT_MAX_LINES * POLYFIT_DEGREE];
+    poly_fit(n, &all_pts[l * MODEL_PATH_DISTANCE], &all_stds[l * MODEL_PATH_DISTANCE], &all_valid_len[l], batched);
+
+    for (int k = 0; k < n; k++) {
+      float *line_pts = &all_pts[(l + k) * MODEL_PATH_DISTANCE];
+      float *line_stds = &all_stds[(l + k) * MODEL_PATH_DISTANCE];
+      const int valid_len = all_valid_len[l + k];
+      float qr_pts[MODEL_PATH_DISTANCE], qr[POLYFIT_DEGREE];
+      // the QR solve offsets its input in place
+      memcpy(qr_pts, line_pts, sizeof(qr_pts));
+      poly_fit_qr(qr_pts, line_stds, qr, valid_len);
+
+      const float *p = &batched[k * POLYFIT_DEGREE];
+      double diff = 0;
+      for (int i = 0; i < valid_len; i++) {
+        diff = std::max(diff, fabs(poly_eval(p, i) - poly_eval(qr, i)));
+      }
+      const double cost = fit_cost(p, line_pts, line_stds, valid_len);
+      const double qr_cost = fit_cost(qr, line_pts, line_stds, valid_len);
+      const double rel_cost = (cost - qr_cost) / std::max(qr_cost, 1e-6);
+      max_diff = std::max(max_diff, diff);
+      max_rel_cost = std::max(max_rel_cost, rel_cost);
+      if (diff > 1e-3 || rel_cost > 1e-4) {
+        if (failures++ < 10) {
+          printf("line %d, valid_len %d: %f %f %f %f != %f %f %f %f, diff %e, cost %e vs %e\n", l + k, valid_len,
+                 p[0], p[1], p[2], p[3], qr[0], qr[1], qr[2], qr[3], diff, cost, qr_cost);
+        }
+      }
+    }
+  }
+  printf("%d lines: max curve difference %e, max relative cost difference %e\n", lines, max_diff, max_rel_cost);
 
-  float poly[4];
-  poly_fit(pts, stds, poly);
+  // the recorded line, all points fitted
+  float p[POLYFIT_DEGREE];
+  int full = MODEL_PATH_DISTANCE;
+  poly_fit(1, pts, stds, &full, p);
+  std::cout << "[" << p[0] << "," << p[1] << "," << p[2] << "," << p[3] << "]" << std::endl;
+
+  if (bench) {
+    // what model_publish does every frame: path, left lane and right lane
+    const int iters = 10000;
+    float out[3 * POLYFIT_DEGREE];
+    float qr_pts[3 * MODEL_PATH_DISTANCE];
+    int valid_len[3] = {MODEL_PATH_DISTANCE, 120, 80};
+
+    double t1 = millis();
+    for (int i = 0; i < iters; i++) {
+      memcpy(qr_pts, all_pts, sizeof(qr_pts));
+      for (int k = 0; k < 3; k++) {
+        poly_fit_qr(&qr_pts[k * MODEL_PATH_DISTANCE], &all_stds[k * MODEL_PATH_DISTANCE], &out[k * POLYFIT_DEGREE], valid_len[k]);
+      }
+    }
+    const double qr_us = (millis() - t1) * 1000. / iters;
+
+    t1 = millis();
+    for (int i = 0; i < iters; i++) {
+      poly_fit(3, all_pts, all_stds, valid_len, out);
+    }
+    const double batched_us = (millis() - t1) * 1000. / iters;
+    printf("\n3 lines, %d iterations\nqr      %8.2f us/frame\nbatched %8.2f us/frame, %.2fx\n",
+           iters, qr_us, batched_us, qr_us / batched_us);
+  }
 
-  std::cout << "[";
-  std::cout << poly[0] << ",";
-  std::cout << poly[1] << ",";
-  std::cout << poly[2] << ",";
-  std::cout << poly[3];
-  std::cout << "]" << std::endl;
+  delete[] all_pts;
+  delete[] all_stds;
+  delete[] all_valid_len;
+  return failures != 0;
 }
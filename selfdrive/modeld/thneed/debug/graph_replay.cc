@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "common/clutil.h"
+#include "../graph.h"
+
+// replays a graph saved with THNEED_SAVE on any OpenCL device (pocl works)
+// usage: graph_replay <graph> [runs]
+
+static inline uint64_t nanos_since_boot() {
+  struct timespec t;
+  clock_gettime(CLOCK_BOOTTIME, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: %s <graph> [runs]\n", argv[0]);
+    return 1;
+  }
+  int runs = argc > 2 ? atoi(argv[2]) : 100;
+
+  clu_init();
+  cl_device_id device_id = cl_get_device_id(CL_DEVICE_TYPE_DEFAULT);
+  int err;
+  cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &err);
+  cl_check_error(err);
+
+  ThneedGraph graph;
+  uint64_t tb = nanos_since_boot();
+  if (!graph.load(argv[1])) {
+    printf("couldn't load %s\n", argv[1]);
+    return 1;
+  }
+  uint64_t tl = nanos_since_boot();
+  if (!graph.init(device_id, context)) {
+    printf("couldn't init %s\n", argv[1]);
+    return 1;
+  }
+  uint64_t ti = nanos_since_boot();
+  printf("%zu kernels, %zu inputs, %zu bytes output\n", graph.numKernels(), graph.numInputs(), graph.outputSize());
+  printf("load %.2f ms, init %.2f ms\n", (tl-tb)/1e6, (ti-tl)/1e6);
+
+  // the first run also checks against the recording
+  float max_diff = graph.check();
+  printf("max diff from recorded output: %e\n", max_diff);
+
+  std::vector<std::vector<float> > inputs;
+  std::vector<float *> finputs;
+  for (int i = 0; i < graph.numInputs(); i++) {
+    inputs.push_back(std::vector<float>(graph.inputSize(i) / sizeof(float)));
+  }
+  for (auto &in : inputs) finputs.push_back(in.data());
+  std::vector<float> output(graph.outputSize() / sizeof(float));
+
+  std::vector<double> times;
+  for (int i = 0; i < runs; i++) {
+    uint64_t t1 = nanos_since_boot();
+    graph.execute(finputs.data(), output.data());
+    uint64_t t2 = nanos_since_boot();
+    times.push_back((t2-t1)/1e6);
+  }
+  if (runs > 0) {
+    std::sort(times.begin(), times.end());
+    double total = 0;
+    for (double t : times) total += t;
+    printf("%d runs: mean %.3f ms, min %.3f ms, median %.3f ms, max %.3f ms\n",
+           runs, total / runs, times[0], times[runs/2], times[runs-1]);
+  }
+
+  // nonzero exit for CI if the replay drifted
+  const char *tol = getenv("THNEED_TOLERANCE");
+  return max_diff <= (tol != NULL ? atof(tol) : 1e-3) ? 0 : 2;
+}
@@ -0,0 +1,497 @@
+#include "graph.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "json11.hpp"
+#include "common/clutil.h"
+
+using namespace std;
+using json11::Json;
+
+ThneedGraph::~ThneedGraph() {
+  // only release what replay created, recorded handles belong to the recorder
+  if (command_queue == NULL) return;
+  for (auto &k : kernels) if (k.kernel) clReleaseKernel(k.kernel);
+  for (auto &s : samplers) if (s.sampler) clReleaseSampler(s.sampler);
+  for (int i = buffers.size()-1; i >= 0; i--) if (buffers[i].mem) clReleaseMemObject(buffers[i].mem);
+  for (auto &p : programs) if (p.program) clReleaseProgram(p.program);
+  clReleaseCommandQueue(command_queue);
+}
+
+// ****** recording
+
+int ThneedGraph::programId(cl_program program) {
+  auto it = program_ids.find(program);
+  if (it != program_ids.end()) return it->second;
+
+  Program p;
+  size_t sz = 0;
+  clGetProgramInfo(program, CL_PROGRAM_SOURCE, 0, NULL, &sz);
+  if (sz > 1) {
+    p.source.resize(sz);
+    clGetProgramInfo(program, CL_PROGRAM_SOURCE, sz, &p.source[0], NULL);
+    p.source.resize(sz-1);
+  }
+
+  cl_device_id device_id;
+  clGetProgramInfo(program, CL_PROGRAM_DEVICES, sizeof(device_id), &device_id, NULL);
+  clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_OPTIONS, 0, NULL, &sz);
+  if (sz > 1) {
+    p.options.resize(sz);
+    clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_OPTIONS, sz, &p.options[0], NULL);
+    p.options.resize(sz-1);
+  }
+
+  if (p.source.empty()) {
+    // created from a binary, this graph will only replay on the same device
+    printf("thneed graph: program %p has no source, saving the binary\n", program);
+    size_t bin_size;
+    clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(bin_size), &bin_size, NULL);
+    p.binary.resize(bin_size);
+    unsigned char *bin = (unsigned char *)&p.binary[0];
+    clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(bin), &bin, NULL);
+  }
+
+  programs.push_back(p);
+  program_ids[program] = programs.size()-1;
+  return programs.size()-1;
+}
+
+int ThneedGraph::bufferId(cl_mem mem) {
+  auto it = buffer_ids.find(mem);
+  if (it != buffer_ids.end()) return it->second;
+
+  Buffer b;
+  clGetMemObjectInfo(mem, CL_MEM_TYPE, sizeof(b.type), &b.type, NULL);
+  clGetMemObjectInfo(mem, CL_MEM_FLAGS, sizeof(b.flags), &b.flags, NULL);
+  clGetMemObjectInfo(mem, CL_MEM_SIZE, sizeof(b.size), &b.size, NULL);
+  // host pointers don't survive a save
+  b.flags &= ~(CL_MEM_USE_HOST_PTR | CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR);
+
+  cl_mem parent = NULL;
+  clGetMemObjectInfo(mem, CL_MEM_ASSOCIATED_MEMOBJECT, sizeof(parent), &parent, NULL);
+
+  if (b.type != CL_MEM_OBJECT_BUFFER) {
+    clGetImageInfo(mem, CL_IMAGE_FORMAT, sizeof(b.format), &b.format, NULL);
+    clGetImageInfo(mem, CL_IMAGE_WIDTH, sizeof(b.width), &b.width, NULL);
+    clGetImageInfo(mem, CL_IMAGE_HEIGHT, sizeof(b.height), &b.height, NULL);
+    clGetImageInfo(mem, CL_IMAGE_ROW_PITCH, sizeof(b.row_pitch), &b.row_pitch, NULL);
+  } else if (parent != NULL) {
+    clGetMemObjectInfo(mem, CL_MEM_OFFSET, sizeof(b.offset), &b.offset, NULL);
+  }
+
+  // the parent has to exist first on replay
+  if (parent != NULL) b.parent = bufferId(parent);
+
+  buffers.push_back(b);
+  buffer_ids[mem] = buffers.size()-1;
+  buffers.back().mem = mem;
+  return buffers.size()-1;
+}
+
+int ThneedGraph::samplerId(cl_sampler sampler) {
+  auto it = sampler_ids.find(sampler);
+  if (it != sampler_ids.end()) return it->second;
+
+  Sampler s;
+  clGetSamplerInfo(sampler, CL_SAMPLER_NORMALIZED_COORDS, sizeof(s.normalized_coords), &s.normalized_coords, NULL);
+  clGetSamplerInfo(sampler, CL_SAMPLER_ADDRESSING_MODE, sizeof(s.addressing_mode), &s.addressing_mode, NULL);
+  clGetSamplerInfo(sampler, CL_SAMPLER_FILTER_MODE, sizeof(s.filter_mode), &s.filter_mode, NULL);
+  samplers.push_back(s);
+  sampler_ids[sampler] = samplers.size()-1;
+  return samplers.size()-1;
+}
+
+void ThneedGraph::recordKernel(cl_kernel kernel, cl_uint work_dim, const size_t *global_work_size,
+                               const size_t *local_work_size, const vector<pair<string, size_t> > &args) {
+  assert(work_dim <= 3);
+
+  Kernel k;
+  cl_program program;
+  clGetKernelInfo(kernel, CL_KERNEL_PROGRAM, sizeof(program), &program, NULL);
+  k.program = programId(program);
+
+  char name[0x100];
+  clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+  k.name = name;
+
+  k.work_dim = work_dim;
+  k.has_local_work_size = local_work_size != NULL;
+  for (int i = 0; i < work_dim; i++) {
+    k.global_work_size[i] = global_work_size[i];
+    k.local_work_size[i] = local_work_size != NULL ? local_work_size[i] : 0;
+  }
+
+  for (int i = 0; i < args.size(); i++) {
+    Arg a;
+    char arg_type[0x100];
+    clGetKernelArgInfo(kernel, i, CL_KERNEL_ARG_TYPE_NAME, sizeof(arg_type), arg_type, NULL);
+    cl_kernel_arg_address_qualifier aq;
+    clGetKernelArgInfo(kernel, i, CL_KERNEL_ARG_ADDRESS_QUALIFIER, sizeof(aq), &aq, NULL);
+
+    a.type_name = arg_type;
+    a.value = args[i].first;
+    a.size = args[i].second;
+
+    bool is_image = strncmp(arg_type, "image", 5) == 0;
+    bool is_pointer = strchr(arg_type, '*') != NULL;
+    if (aq == CL_KERNEL_ARG_ADDRESS_LOCAL) {
+      // only a size
+      a.value.clear();
+    } else if (strcmp(arg_type, "sampler_t") == 0) {
+      cl_sampler s;
+      memcpy(&s, a.value.data(), sizeof(s));
+      a.sampler = samplerId(s);
+      a.value.clear();
+    } else if ((is_image || is_pointer) && a.value.size() == sizeof(cl_mem)) {
+      cl_mem mem;
+      memcpy(&mem, a.value.data(), sizeof(mem));
+      if (mem != NULL) a.buffer = bufferId(mem);
+      a.value.clear();
+    }
+    k.args.push_back(a);
+  }
+
+  kernels.push_back(k);
+}
+
+void ThneedGraph::markInput(cl_mem mem) {
+  inputs.push_back(bufferId(mem));
+}
+
+void ThneedGraph::markOutput(cl_mem mem) {
+  output = bufferId(mem);
+}
+
+static Json image_format_json(const cl_image_format &f) {
+  return Json::array {(int)f.image_channel_order, (int)f.image_channel_data_type};
+}
+
+bool ThneedGraph::save(const char *path, cl_command_queue q) {
+  string blob;
+
+  // ****** buffer contents, this includes the weights and the current inputs
+  Json::array jbuffers;
+  for (auto &b : buffers) {
+    size_t offset = blob.size();
+    size_t sz = 0;
+    if (b.parent == -1) {
+      sz = b.type == CL_MEM_OBJECT_BUFFER ? b.size : b.row_pitch * b.height;
+      blob.resize(offset + sz);
+      if (b.type == CL_MEM_OBJECT_BUFFER) {
+        clEnqueueReadBuffer(q, b.mem, CL_TRUE, 0, sz, &blob[offset], 0, NULL, NULL);
+      } else {
+        size_t origin[3] = {0, 0, 0};
+        size_t region[3] = {b.width, b.height, 1};
+        clEnqueueReadImage(q, b.mem, CL_TRUE, origin, region, b.row_pitch, 0, &blob[offset], 0, NULL, NULL);
+      }
+    }
+    jbuffers.push_back(Json::object {
+      {"type", (int)b.type},
+      {"flags", (double)b.flags},
+      {"size", (double)b.size},
+      {"format", image_format_json(b.format)},
+      {"width", (double)b.width},
+      {"height", (double)b.height},
+      {"row_pitch", (double)b.row_pitch},
+      {"parent", b.parent},
+      {"offset", (double)b.offset},
+      {"data_offset", (double)offset},
+      {"data_size", (double)sz},
+    });
+  }
+
+  size_t golden_offset = blob.size();
+  if (output >= 0) {
+    blob.resize(golden_offset + buffers[output].size);
+    clEnqueueReadBuffer(q, buffers[output].mem, CL_TRUE, 0, buffers[output].size, &blob[golden_offset], 0, NULL, NULL);
+  }
+
+  Json::array jprograms;
+  for (auto &p : programs) {
+    size_t offset = blob.size();
+    blob += p.binary;
+    jprograms.push_back(Json::object {
+      {"source", p.source},
+      {"options", p.options},
+      {"binary_offset", (double)offset},
+      {"binary_size", (double)p.binary.size()},
+    });
+  }
+
+  Json::array jsamplers;
+  for (auto &s : samplers) {
+    jsamplers.push_back(Json::array {(int)s.normalized_coords, (int)s.addressing_mode, (int)s.filter_mode});
+  }
+
+  Json::array jkernels;
+  for (auto &k : kernels) {
+    Json::array jargs;
+    for (auto &a : k.args) {
+      size_t offset = blob.size();
+      blob += a.value;
+      jargs.push_back(Json::object {
+        {"type_name", a.type_name},
+        {"size", (double)a.size},
+        {"buffer", a.buffer},
+        {"sampler", a.sampler},
+        {"value_offset", (double)offset},
+        {"value_size", (double)a.value.size()},
+      });
+    }
+    Json::array gws, lws;
+    for (int i = 0; i < k.work_dim; i++) {
+      gws.push_back((double)k.global_work_size[i]);
+      lws.push_back((double)k.local_work_size[i]);
+    }
+    jkernels.push_back(Json::object {
+      {"program", k.program},
+      {"name", k.name},
+      {"global_work_size", gws},
+      {"local_work_size", k.has_local_work_size ? Json(lws) : Json()},
+      {"args", jargs},
+    });
+  }
+
+  Json j = Json::object {
+    {"version", 1},
+    {"programs", jprograms},
+    {"buffers", jbuffers},
+    {"samplers", jsamplers},
+    {"kernels", jkernels},
+    {"inputs", inputs},
+    {"output", output},
+    {"golden_output_offset", (double)golden_offset},
+  };
+  string header = j.dump();
+
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) return false;
+  uint32_t header_len = header.size();
+  bool ok = fwrite(&header_len, sizeof(header_len), 1, f) == 1 &&
+            fwrite(header.data(), 1, header.size(), f) == header.size() &&
+            fwrite(blob.data(), 1, blob.size(), f) == blob.size();
+  ok = (fclose(f) == 0) && ok;
+
+  printf("thneed graph: saved %zu kernels, %zu programs, %zu buffers (%.2f MB) to %s\n",
+         kernels.size(), programs.size(), buffers.size(), blob.size() / 1e6, path);
+  return ok;
+}
+
+// ****** replay
+
+bool ThneedGraph::load(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return false;
+  fseek(f, 0, SEEK_END);
+  size_t file_size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  string dat(file_size, '\0');
+  bool ok = fread(&dat[0], 1, file_size, f) == file_size;
+  fclose(f);
+  if (!ok || file_size < sizeof(uint32_t)) return false;
+
+  uint32_t header_len;
+  memcpy(&header_len, dat.data(), sizeof(header_len));
+  if (sizeof(header_len) + header_len > file_size) return false;
+
+  string err;
+  Json j = Json::parse(dat.substr(sizeof(header_len), header_len), err);
+  if (!err.empty() || j["version"].int_value() != 1) {
+    printf("thneed graph: bad header in %s: %s\n", path, err.c_str());
+    return false;
+  }
+  const char *blob = dat.data() + sizeof(header_len) + header_len;
+
+  for (auto &jp : j["programs"].array_items()) {
+    Program p;
+    p.source = jp["source"].string_value();
+    p.options = jp["options"].string_value();
+    p.binary = string(blob + (size_t)jp["binary_offset"].number_value(), (size_t)jp["binary_size"].number_value());
+    programs.push_back(p);
+  }
+
+  for (auto &jb : j["buffers"].array_items()) {
+    Buffer b;
+    b.type = jb["type"].int_value();
+    b.flags = jb["flags"].number_value();
+    b.size = jb["size"].number_value();
+    b.format.image_channel_order = jb["format"][0].int_value();
+    b.format.image_channel_data_type = jb["format"][1].int_value();
+    b.width = jb["width"].number_value();
+    b.height = jb["height"].number_value();
+    b.row_pitch = jb["row_pitch"].number_value();
+    b.parent = jb["parent"].int_value();
+    b.offset = jb["offset"].number_value();
+    b.data = string(blob + (size_t)jb["data_offset"].number_value(), (size_t)jb["data_size"].number_value());
+    buffers.push_back(b);
+  }
+
+  for (auto &js : j["samplers"].array_items()) {
+    Sampler s;
+    s.normalized_coords = js[0].int_value();
+    s.addressing_mode = js[1].int_value();
+    s.filter_mode = js[2].int_value();
+    samplers.push_back(s);
+  }
+
+  for (auto &jk : j["kernels"].array_items()) {
+    Kernel k;
+    k.program = jk["program"].int_value();
+    k.name = jk["name"].string_value();
+    k.work_dim = jk["global_work_size"].array_items().size();
+    k.has_local_work_size = !jk["local_work_size"].is_null();
+    for (int i = 0; i < k.work_dim; i++) {
+      k.global_work_size[i] = jk["global_work_size"][i].number_value();
+      k.local_work_size[i] = k.has_local_work_size ? jk["local_work_size"][i].number_value() : 0;
+    }
+    for (auto &ja : jk["args"].array_items()) {
+      Arg a;
+      a.type_name = ja["type_name"].string_value();
+      a.size = ja["size"].number_value();
+      a.buffer = ja["buffer"].int_value();
+      a.sampler = ja["sampler"].int_value();
+      a.value = string(blob + (size_t)ja["value_offset"].number_value(), (size_t)ja["value_size"].number_value());
+      k.args.push_back(a);
+    }
+    kernels.push_back(k);
+  }
+
+  for (auto &ji : j["inputs"].array_items()) {
+    inputs.push_back(ji.int_value());
+  }
+  output = j["output"].int_value();
+  if (output >= 0) {
+    golden_output = string(blob + (size_t)j["golden_output_offset"].number_value(), buffers[output].size);
+  }
+  return true;
+}
+
+bool ThneedGraph::createBuffer(int idx, cl_context context) {
+  Buffer &b = buffers[idx];
+  int err;
+  if (b.type == CL_MEM_OBJECT_BUFFER && b.parent == -1) {
+    b.mem = clCreateBuffer(context, b.flags, b.size, NULL, &err);
+  } else if (b.type == CL_MEM_OBJECT_BUFFER) {
+    cl_buffer_region region = {b.offset, b.size};
+    b.mem = clCreateSubBuffer(buffers[b.parent].mem, b.flags & (CL_MEM_READ_WRITE | CL_MEM_READ_ONLY | CL_MEM_WRITE_ONLY),
+                              CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+  } else {
+    cl_image_desc desc = {0};
+    desc.image_type = b.type;
+    desc.image_width = b.width;
+    desc.image_height = b.height;
+    if (b.parent != -1) {
+      // needs cl_khr_image2d_from_buffer for 2d images
+      desc.image_row_pitch = b.row_pitch;
+      desc.buffer = buffers[b.parent].mem;
+    }
+    b.mem = clCreateImage(context, b.flags, &b.format, &desc, NULL, &err);
+  }
+  if (err != CL_SUCCESS) {
+    printf("thneed graph: failed to create buffer %d: %s\n", idx, cl_get_error_string(err));
+    return false;
+  }
+  return true;
+}
+
+bool ThneedGraph::init(cl_device_id device_id, cl_context context_) {
+  int err;
+  context = context_;
+  command_queue = clCreateCommandQueue(context, device_id, 0, &err);
+  if (err != CL_SUCCESS) return false;
+
+  // ****** programs, compiled once per device and then loaded from the cl cache
+  for (auto &p : programs) {
+    if (!p.source.empty()) {
+      p.program = cl_cached_program_from_string(context, device_id, p.source.c_str(), p.options.c_str(), NULL);
+    } else {
+      const unsigned char *bin = (const unsigned char *)p.binary.data();
+      size_t bin_size = p.binary.size();
+      p.program = clCreateProgramWithBinary(context, 1, &device_id, &bin_size, &bin, NULL, &err);
+      if (p.program != NULL) clBuildProgram(p.program, 1, &device_id, p.options.c_str(), NULL, NULL);
+    }
+    if (p.program == NULL) return false;
+  }
+
+  // ****** buffers, with the recorded contents
+  for (int i = 0; i < buffers.size(); i++) {
+    if (!createBuffer(i, context)) return false;
+    Buffer &b = buffers[i];
+    if (b.data.empty()) continue;
+    if (b.type == CL_MEM_OBJECT_BUFFER) {
+      clEnqueueWriteBuffer(command_queue, b.mem, CL_FALSE, 0, b.data.size(), b.data.data(), 0, NULL, NULL);
+    } else {
+      size_t origin[3] = {0, 0, 0};
+      size_t region[3] = {b.width, b.height, 1};
+      clEnqueueWriteImage(command_queue, b.mem, CL_FALSE, origin, region, b.row_pitch, 0, b.data.data(), 0, NULL, NULL);
+    }
+  }
+  clFinish(command_queue);
+
+  for (auto &s : samplers) {
+    s.sampler = clCreateSampler(context, s.normalized_coords, s.addressing_mode, s.filter_mode, &err);
+    if (err != CL_SUCCESS) return false;
+  }
+
+  // ****** kernels, the arguments never change so they are set once here
+  for (auto &k : kernels) {
+    k.kernel = clCreateKernel(programs[k.program].program, k.name.c_str(), &err);
+    if (err != CL_SUCCESS) {
+      printf("thneed graph: failed to create kernel %s: %s\n", k.name.c_str(), cl_get_error_string(err));
+      return false;
+    }
+    for (int i = 0; i < k.args.size(); i++) {
+      Arg &a = k.args[i];
+      if (a.buffer != -1) {
+        err = clSetKernelArg(k.kernel, i, sizeof(cl_mem), &buffers[a.buffer].mem);
+      } else if (a.sampler != -1) {
+        err = clSetKernelArg(k.kernel, i, sizeof(cl_sampler), &samplers[a.sampler].sampler);
+      } else if (a.value.empty()) {
+        // __local or a NULL buffer
+        err = clSetKernelArg(k.kernel, i, a.size, NULL);
+      } else {
+        err = clSetKernelArg(k.kernel, i, a.value.size(), a.value.data());
+      }
+      if (err != CL_SUCCESS) {
+        printf("thneed graph: failed to set arg %d of %s: %s\n", i, k.name.c_str(), cl_get_error_string(err));
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void ThneedGraph::execute(float **finputs, float *foutput) {
+  for (int i = 0; i < inputs.size(); i++) {
+    Buffer &b = buffers[inputs[i]];
+    clEnqueueWriteBuffer(command_queue, b.mem, CL_FALSE, 0, b.size, finputs[i], 0, NULL, NULL);
+  }
+
+  // no waits between kernels, the whole model goes out in one flush
+  for (auto &k : kernels) {
+    clEnqueueNDRangeKernel(command_queue, k.kernel, k.work_dim, NULL, k.global_work_size,
+                           k.has_local_work_size ? k.local_work_size : NULL, 0, NULL, NULL);
+  }
+
+  Buffer &o = buffers[output];
+  clEnqueueReadBuffer(command_queue, o.mem, CL_TRUE, 0, o.size, foutput, 0, NULL, NULL);
+}
+
+float ThneedGraph::check() {
+  vector<float *> finputs;
+  for (int i : inputs) finputs.push_back((float *)buffers[i].data.data());
+
+  vector<float> out(outputSize() / sizeof(float));
+  execute(finputs.data(), out.data());
+
+  const float *golden = (const float *)golden_output.data();
+  float max_diff = 0;
+  for (int i = 0; i < out.size(); i++) {
+    max_diff = fmax(max_diff, fabs(out[i] - golden[i]));
+  }
+  return max_diff;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+// A kernel level recording of a model run. Where Thneed caches the raw kgsl
+// commands, this keeps the program sources, kernel arguments and buffer
+// contents, so it can be saved and replayed on any OpenCL implementation.
+class ThneedGraph {
+  public:
+    ~ThneedGraph();
+
+    // ****** recording
+    // args are the (value, size) pairs passed to clSetKernelArg, value is empty for __local args
+    void recordKernel(cl_kernel kernel, cl_uint work_dim, const size_t *global_work_size,
+                      const size_t *local_work_size, const std::vector<std::pair<std::string, size_t> > &args);
+    void markInput(cl_mem mem);
+    void markOutput(cl_mem mem);
+    // snapshots all the buffers through q, the current inputs and output become the golden run
+    bool save(const char *path, cl_command_queue q);
+
+    // ****** replay
+    bool load(const char *path);
+    // builds the programs through the cl cache and creates all buffers and kernels up front
+    bool init(cl_device_id device_id, cl_context context);
+    // copies in the inputs, queues every kernel and does a single blocking read of the output
+    void execute(float **finputs, float *foutput);
+    // runs the recorded inputs and returns the largest difference from the recorded output
+    float check();
+
+    size_t numInputs() { return inputs.size(); }
+    size_t inputSize(int idx) { return buffers[inputs[idx]].size; }
+    size_t outputSize() { return output >= 0 ? buffers[output].size : 0; }
+    size_t numKernels() { return kernels.size(); }
+
+  private:
+    struct Program {
+      std::string source;
+      std::string options;
+      // only used when the source isn't available
+      std::string binary;
+      cl_program program = NULL;
+    };
+
+    struct Buffer {
+      cl_mem_object_type type = CL_MEM_OBJECT_BUFFER;
+      cl_mem_flags flags = CL_MEM_READ_WRITE;
+      size_t size = 0;
+      // images
+      cl_image_format format = {0, 0};
+      size_t width = 0, height = 0, row_pitch = 0;
+      // images made from a buffer and sub buffers
+      int parent = -1;
+      size_t offset = 0;
+      std::string data;
+      cl_mem mem = NULL;
+    };
+
+    struct Sampler {
+      cl_bool normalized_coords;
+      cl_addressing_mode addressing_mode;
+      cl_filter_mode filter_mode;
+      cl_sampler sampler = NULL;
+    };
+
+    struct Arg {
+      std::string type_name;
+      std::string value;
+      size_t size = 0;
+      int buffer = -1;
+      int sampler = -1;
+    };
+
+    struct Kernel {
+      int program;
+      std::string name;
+      cl_uint work_dim;
+      size_t global_work_size[3];
+      size_t local_work_size[3];
+      bool has_local_work_size;
+      std::vector<Arg> args;
+      cl_kernel kernel = NULL;
+    };
+
+    int programId(cl_program program);
+    int bufferId(cl_mem mem);
+    int samplerId(cl_sampler sampler);
+    bool createBuffer(int idx, cl_context context);
+
+    std::vector<Program> programs;
+    std::vector<Buffer> buffers;
+    std::vector<Sampler> samplers;
+    std::vector<Kernel> kernels;
+    std::vector<int> inputs;
+    int output = -1;
+    std::string golden_output;
+
+    std::map<cl_program, int> program_ids;
+    std::map<cl_mem, int> buffer_ids;
+    std::map<cl_sampler, int> sampler_ids;
+
+    cl_context context = NULL;
+    cl_command_queue command_queue = NULL;
+};
@@ -9,6 +9,7 @@
 Thneed *g_thneed = NULL;
 int g_fd = -1;
 map<pair<cl_kernel, int>, string> g_args;
+map<pair<cl_kernel, int>, size_t> g_arg_sizes;
 
 static inline uint64_t nanos_since_boot() {
   struct timespec t;
@@ -167,11 +168,15 @@ void CachedCommand::exec(bool wait) {
   assert(ret == 0);
 }
 
-Thneed::Thneed() {
+Thneed::Thneed(bool record_graph) {
   assert(g_fd != -1);
   fd = g_fd;
   ram = make_unique<GPUMalloc>(0x40000, fd);
-  record = 1;
+  record = THNEED_RECORD;
+  if (record_graph) {
+    record |= THNEED_RECORD_GRAPH;
+    graph = make_unique<ThneedGraph>();
+  }
   timestamp = -1;
   g_thneed = this;
 }
@@ -180,6 +185,11 @@ void Thneed::stop() {
   record = 0;
 }
 
+bool Thneed::save(const char *path) {
+  if (graph == NULL) return false;
+  return graph->save(path, command_queue);
+}
+
 //#define SAVE_LOG
 
 void Thneed::execute(float **finputs, float *foutput, bool slow) {
@@ -274,9 +284,9 @@ void Thneed::execute(float **finputs, float *foutput, bool slow) {
 cl_int (*my_clSetKernelArg)(cl_kernel kernel, cl_uint arg_index, size_t arg_size, const void *arg_value) = NULL;
 cl_int thneed_clSetKernelArg(cl_kernel kernel, cl_uint arg_index, size_t arg_size, const void *arg_value) {
   if (my_clSetKernelArg == NULL) my_clSetKernelArg = reinterpret_cast<decltype(my_clSetKernelArg)>(dlsym(RTLD_NEXT, "REAL_clSetKernelArg"));
-  if (arg_value != NULL) {
-    g_args[make_pair(kernel, arg_index)] = string((char*)arg_value, arg_size);
-  }
+  // NULL is a __local arg (or a NULL buffer), the graph still needs its size
+  g_args[make_pair(kernel, arg_index)] = arg_value != NULL ? string((char*)arg_value, arg_size) : string();
+  g_arg_sizes[make_pair(kernel, arg_index)] = arg_size;
   cl_int ret = my_clSetKernelArg(kernel, arg_index, arg_size, arg_value);
   return ret;
 }
@@ -316,15 +326,25 @@ cl_int thneed_clEnqueueNDRangeKernel(cl_command_queue command_queue,
         cl_mem mem;
         memcpy(&mem, (void*)arg.data(), sizeof(mem));
         thneed->inputs.push_back(mem);
+        if (thneed->record & THNEED_RECORD_GRAPH) thneed->graph->markInput(mem);
       }
 
       if (strcmp(arg_name, "output") == 0 && strcmp(name, "image2d_to_buffer_float") == 0) {
         cl_mem mem;
         memcpy(&mem, (void*)arg.data(), sizeof(mem));
         thneed->output = mem;
+        if (thneed->record & THNEED_RECORD_GRAPH) thneed->graph->markOutput(mem);
       }
     }
   }
+  if (thneed != NULL && thneed->record & THNEED_RECORD_GRAPH) {
+    vector<pair<string, size_t> > args;
+    for (int i = 0; i < num_args; i++) {
+      auto key = make_pair(kernel, i);
+      args.push_back(make_pair(g_args[key], g_arg_sizes[key]));
+    }
+    thneed->graph->recordKernel(kernel, work_dim, global_work_size, local_work_size, args);
+  }
   if (thneed != NULL && thneed->record & 2) {
     printf("%p %56s -- ", kernel, name);
     for (int i = 0; i < work_dim; i++) {
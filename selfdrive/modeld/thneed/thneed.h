@@ -3,7 +3,16 @@
 #include <stdint.h>
 #include "include/msm_kgsl.h"
 #include <vector>
+#include <memory>
 #include <CL/cl.h>
+#include "graph.h"
+
+// record bits
+#define THNEED_RECORD 1
+#define THNEED_DEBUG 2
+#define THNEED_VERBOSE_DEBUG 4
+// also capture the kernels as a portable ThneedGraph
+#define THNEED_RECORD_GRAPH 8
 
 using namespace std;
 
@@ -33,9 +42,11 @@ class CachedCommand {
 
 class Thneed {
   public:
-    Thneed();
+    Thneed(bool record_graph=false);
     void stop();
     void execute(float **finputs, float *foutput, bool slow=false);
+    // needs THNEED_RECORD_GRAPH, the current inputs and output are saved as the golden run
+    bool save(const char *path);
 
     vector<cl_mem> inputs;
     cl_mem output;
@@ -50,5 +61,7 @@ class Thneed {
     vector<unique_ptr<CachedCommand> > cmds;
     vector<string> syncobjs;
     int fd;
+
+    unique_ptr<ThneedGraph> graph;
 };
 
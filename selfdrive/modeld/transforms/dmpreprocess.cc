@@ -0,0 +1,424 @@
+#include "dmpreprocess.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DM_X86
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#define TILE_ROWS DM_PREPROCESS_TILE_ROWS
+
+// ****** libyuv's bilinear arithmetic
+
+static inline int fixed_div(int num, int div) {
+  return (int)(((int64_t)num << 16) / div);
+}
+
+static inline int fixed_div1(int num, int div) {
+  return (int)((((int64_t)num << 16) - 0x00010001) / (div - 1));
+}
+
+// ScaleSlope for kFilterBilinear, 16.16 fixed point
+static void scale_slope(int src, int dst, int *start, int *step) {
+  if (dst <= src) {
+    *step = fixed_div(src, dst);
+    // centered, half a pixel to the left
+    *start = (*step >> 1) - 32768;
+  } else {
+    *step = fixed_div1(src, dst);
+    *start = 0;
+  }
+}
+
+// ScaleFilterCols, 7 bit weights
+static inline uint8_t blend(int a, int b, int f) {
+  return a + ((f * (b - a) + 0x40) >> 7);
+}
+
+// InterpolateRow, 8 bit weights
+static inline uint8_t interp(int a, int b, int f) {
+  return (a * (256 - f) + b * f + 128) >> 8;
+}
+
+// ****** row interpolation and output conversion
+
+static void interp_row_scalar(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n, int f) {
+  if (f == 0) {
+    memcpy(dst, a, n);
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    dst[i] = interp(a[i], b[i], f);
+  }
+}
+
+// plane p of the output is column major, (out_w/2) columns of (out_h/2) rows. planes are
+// Y[2r][2c], Y[2r][2c+1] twice, Y[2r][2c+2], U[r][c] and V[r][c]. those are flat indices into
+// the scaled Y plane, so the last column of the fourth plane is the first pixel of row 2r+1
+#define EMIT_TILE(NAME, SETUP, CONVERT8)                                                  \
+  static void NAME(DMPreprocessState *s, int r0) {                                        \
+    SETUP                                                                                 \
+    const int rows = s->out_h / 2;                                                        \
+    const int plane_size = (s->out_w / 2) * rows;                                         \
+    float *out = s->net_input_buf.data() + r0;                                            \
+    const uint8_t *ty = s->tile_y.data(), *tu = s->tile_u.data(), *tv = s->tile_v.data(); \
+    for (int c = 0; c < s->out_w / 2; c++) {                                              \
+      float *o = out + c * rows;                                                          \
+      CONVERT8(ty + (2*c) * TILE_ROWS, o);                                                \
+      CONVERT8(ty + (2*c+1) * TILE_ROWS, o + plane_size);                                 \
+      CONVERT8(ty + (2*c+1) * TILE_ROWS, o + 2*plane_size);                               \
+      CONVERT8(ty + (2*c+2) * TILE_ROWS, o + 3*plane_size);                               \
+      CONVERT8(tu + c * TILE_ROWS, o + 4*plane_size);                                     \
+      CONVERT8(tv + c * TILE_ROWS, o + 5*plane_size);                                     \
+    }                                                                                     \
+  }
+
+#define CONVERT8_SCALAR(src, dst)                             \
+  for (int k = 0; k < TILE_ROWS; k++) {                       \
+    (dst)[k] = ((float)(src)[k] - s->offset) * s->scale;      \
+  }
+EMIT_TILE(emit_tile_scalar, , CONVERT8_SCALAR)
+
+#ifdef __SSE2__
+static void interp_row_sse2(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n, int f) {
+  if (f == 0) {
+    memcpy(dst, a, n);
+    return;
+  }
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i w0 = _mm_set1_epi16(256 - f), w1 = _mm_set1_epi16(f), rnd = _mm_set1_epi16(128);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+    // at most 255*256 + 128, fits unsigned 16 bit
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), w0),
+                               _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), w1));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), w0),
+                               _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), w1));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, rnd), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, rnd), 8);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+  }
+  for (; i < n; i++) {
+    dst[i] = interp(a[i], b[i], f);
+  }
+}
+
+#define SETUP_SSE2                                \
+  const __m128i zero = _mm_setzero_si128();       \
+  const __m128 offset = _mm_set1_ps(s->offset);   \
+  const __m128 scale = _mm_set1_ps(s->scale);
+#define CONVERT8_SSE2(src, dst) {                                                  \
+    __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src)), zero);  \
+    __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));                      \
+    __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));                      \
+    _mm_storeu_ps((dst), _mm_mul_ps(_mm_sub_ps(lo, offset), scale));               \
+    _mm_storeu_ps((dst) + 4, _mm_mul_ps(_mm_sub_ps(hi, offset), scale));           \
+  }
+EMIT_TILE(emit_tile_sse2, SETUP_SSE2, CONVERT8_SSE2)
+#endif
+
+#ifdef DM_X86
+// AVX2 isn't in the build flags, these are picked at runtime
+__attribute__((target("avx2")))
+static void interp_row_avx2(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n, int f) {
+  if (f == 0) {
+    memcpy(dst, a, n);
+    return;
+  }
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i w0 = _mm256_set1_epi16(256 - f), w1 = _mm256_set1_epi16(f), rnd = _mm256_set1_epi16(128);
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+    // unpack and pack both work within 128 bit lanes, so the byte order comes back unchanged
+    __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), w0),
+                                  _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), w1));
+    __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), w0),
+                                  _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), w1));
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, rnd), 8);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, rnd), 8);
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+  }
+  for (; i < n; i++) {
+    dst[i] = interp(a[i], b[i], f);
+  }
+}
+
+#define SETUP_AVX2                                   \
+  const __m256 offset = _mm256_set1_ps(s->offset);   \
+  const __m256 scale = _mm256_set1_ps(s->scale);
+#define CONVERT8_AVX2(src, dst) {                                                               \
+    __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src)));                   \
+    _mm256_storeu_ps((dst), _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(v), offset), scale)); \
+  }
+__attribute__((target("avx2")))
+EMIT_TILE(emit_tile_avx2, SETUP_AVX2, CONVERT8_AVX2)
+#endif
+
+#ifdef __ARM_NEON
+static void interp_row_neon(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n, int f) {
+  if (f == 0) {
+    memcpy(dst, a, n);
+    return;
+  }
+  // 256 - f fits in 8 bits once f == 0 is out of the way
+  const uint8x8_t w0 = vdup_n_u8(256 - f), w1 = vdup_n_u8(f);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t va = vld1q_u8(a + i), vb = vld1q_u8(b + i);
+    uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(va), w0), vget_low_u8(vb), w1);
+    uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(va), w0), vget_high_u8(vb), w1);
+    // rounding narrow is (x + 128) >> 8
+    vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+  }
+  for (; i < n; i++) {
+    dst[i] = interp(a[i], b[i], f);
+  }
+}
+
+#define SETUP_NEON                                     \
+  const float32x4_t offset = vdupq_n_f32(s->offset);   \
+  const float32x4_t scale = vdupq_n_f32(s->scale);
+#define CONVERT8_NEON(src, dst) {                                    \
+    uint16x8_t v = vmovl_u8(vld1_u8(src));                           \
+    float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(v)));      \
+    float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(v)));     \
+    vst1q_f32((dst), vmulq_f32(vsubq_f32(lo, offset), scale));       \
+    vst1q_f32((dst) + 4, vmulq_f32(vsubq_f32(hi, offset), scale));   \
+  }
+EMIT_TILE(emit_tile_neon, SETUP_NEON, CONVERT8_NEON)
+#endif
+
+// ****** scaling
+
+static void plane_init(DMPreprocessPlane *p, int src_x, int src_y, int src_w, int src_h, int src_stride,
+                       int dst_w, int dst_h, bool mirror) {
+  assert(src_w > 1 && src_h > 1);
+  p->src_x = src_x;
+  p->src_y = src_y;
+  p->src_w = src_w;
+  p->src_h = src_h;
+  p->src_stride = src_stride;
+  p->dst_w = dst_w;
+  p->dst_h = dst_h;
+  p->rows_first = dst_h <= src_h;
+
+  int x, dx;
+  scale_slope(src_w, dst_w, &x, &dx);
+  p->col0.resize(dst_w);
+  p->col1.resize(dst_w);
+  p->col_f.resize(dst_w);
+  for (int j = 0; j < dst_w; j++, x += dx) {
+    int xi = x >> 16;
+    assert(xi >= 0 && xi + 1 < src_w);
+    // mirroring the crop first is the same as sampling it from the right
+    p->col0[j] = mirror ? src_w - 1 - xi : xi;
+    p->col1[j] = mirror ? src_w - 2 - xi : xi + 1;
+    p->col_f[j] = (x & 0xffff) >> 9;
+  }
+
+  int y, dy;
+  scale_slope(src_h, dst_h, &y, &dy);
+  const int max_y = (src_h - 1) << 16;
+  p->row_i.resize(dst_h);
+  p->row_f.resize(dst_h);
+  for (int i = 0; i < dst_h; i++, y += dy) {
+    if (y > max_y) y = max_y;
+    p->row_i[i] = y >> 16;
+    p->row_f[i] = (y >> 8) & 255;
+  }
+
+  if (p->rows_first) {
+    p->tmp.resize(src_w);
+  } else {
+    p->cached[0].resize(dst_w);
+    p->cached[1].resize(dst_w);
+    p->line.resize(dst_w);
+  }
+  p->cached_row[0] = p->cached_row[1] = -1;
+}
+
+static inline const uint8_t *src_row(const DMPreprocessPlane *p, const uint8_t *src, int row) {
+  return src + (p->src_y + row) * p->src_stride + p->src_x;
+}
+
+static void filter_cols(const DMPreprocessPlane *p, const uint8_t *row, uint8_t *out, int out_stride) {
+  const int32_t *col0 = p->col0.data(), *col1 = p->col1.data();
+  const uint8_t *col_f = p->col_f.data();
+  for (int j = 0; j < p->dst_w; j++) {
+    out[j * out_stride] = blend(row[col0[j]], row[col1[j]], col_f[j]);
+  }
+}
+
+// columns first keeps the last two filtered source rows around
+static const uint8_t *cached_cols(DMPreprocessPlane *p, const uint8_t *src, int row) {
+  for (int k = 0; k < 2; k++) {
+    if (p->cached_row[k] == row) return p->cached[k].data();
+  }
+  // replace the one that isn't the row before
+  int k = p->cached_row[0] == row - 1 ? 1 : 0;
+  filter_cols(p, src_row(p, src, row), p->cached[k].data(), 1);
+  p->cached_row[k] = row;
+  return p->cached[k].data();
+}
+
+// one scaled output row, written with a stride so it lands transposed in the tile
+static void scale_row(DMPreprocessState *s, DMPreprocessPlane *p, const uint8_t *src, int row,
+                      uint8_t *out, int out_stride) {
+  const int yi = p->row_i[row], yf = p->row_f[row];
+  if (p->rows_first) {
+    const uint8_t *r0 = src_row(p, src, yi);
+    const uint8_t *r1 = yf != 0 ? r0 + p->src_stride : r0;
+    s->interp_row(p->tmp.data(), r0, r1, p->src_w, yf);
+    filter_cols(p, p->tmp.data(), out, out_stride);
+  } else {
+    const uint8_t *h0 = cached_cols(p, src, yi);
+    const uint8_t *h1 = yf != 0 ? cached_cols(p, src, yi + 1) : h0;
+    s->interp_row(p->line.data(), h0, h1, p->dst_w, yf);
+    const uint8_t *line = p->line.data();
+    for (int j = 0; j < p->dst_w; j++) {
+      out[j * out_stride] = line[j];
+    }
+  }
+}
+
+static uint8_t scale_pixel(const DMPreprocessPlane *p, const uint8_t *src, int row, int col) {
+  const int yi = p->row_i[row], yf = p->row_f[row];
+  const uint8_t *r0 = src_row(p, src, yi);
+  const uint8_t *r1 = yf != 0 ? r0 + p->src_stride : r0;
+  const int c0 = p->col0[col], c1 = p->col1[col], cf = p->col_f[col];
+  if (p->rows_first) {
+    return blend(interp(r0[c0], r1[c0], yf), interp(r0[c1], r1[c1], yf), cf);
+  } else {
+    return interp(blend(r0[c0], r0[c1], cf), blend(r1[c0], r1[c1], cf), yf);
+  }
+}
+
+// ****** public
+
+bool dm_preprocess_impl_available(DMPreprocessImpl impl) {
+  switch (impl) {
+  case DM_PREPROCESS_BEST:
+  case DM_PREPROCESS_SCALAR:
+    return true;
+#ifdef __SSE2__
+  case DM_PREPROCESS_SSE2:
+    return true;
+#endif
+#ifdef DM_X86
+  case DM_PREPROCESS_AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+#ifdef __ARM_NEON
+  case DM_PREPROCESS_NEON:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+const char *dm_preprocess_impl_name(DMPreprocessImpl impl) {
+  switch (impl) {
+  case DM_PREPROCESS_BEST: return "best";
+  case DM_PREPROCESS_SCALAR: return "scalar";
+  case DM_PREPROCESS_SSE2: return "sse2";
+  case DM_PREPROCESS_AVX2: return "avx2";
+  case DM_PREPROCESS_NEON: return "neon";
+  default: return "unknown";
+  }
+}
+
+void dm_preprocess_init(DMPreprocessState *s, int width, int height,
+                        int crop_x, int crop_y, int crop_w, int crop_h,
+                        int out_w, int out_h, bool mirror, float offset, float scale,
+                        DMPreprocessImpl impl) {
+  assert(crop_x >= 0 && crop_y >= 0 && crop_x + crop_w <= width && crop_y + crop_h <= height);
+  assert(out_w % 2 == 0 && (out_h / 2) % TILE_ROWS == 0);
+
+  s->width = width;
+  s->height = height;
+  s->out_w = out_w;
+  s->out_h = out_h;
+  s->mirror = mirror;
+  s->offset = offset;
+  s->scale = scale;
+
+  if (impl == DM_PREPROCESS_BEST) {
+    const DMPreprocessImpl order[] = {DM_PREPROCESS_NEON, DM_PREPROCESS_AVX2, DM_PREPROCESS_SSE2, DM_PREPROCESS_SCALAR};
+    for (auto i : order) {
+      if (dm_preprocess_impl_available(i)) {
+        impl = i;
+        break;
+      }
+    }
+  }
+  assert(dm_preprocess_impl_available(impl));
+  s->impl = impl;
+  s->interp_row = interp_row_scalar;
+  s->emit_tile = emit_tile_scalar;
+#ifdef __SSE2__
+  if (impl == DM_PREPROCESS_SSE2) {
+    s->interp_row = interp_row_sse2;
+    s->emit_tile = emit_tile_sse2;
+  }
+#endif
+#ifdef DM_X86
+  if (impl == DM_PREPROCESS_AVX2) {
+    s->interp_row = interp_row_avx2;
+    s->emit_tile = emit_tile_avx2;
+  }
+#endif
+#ifdef __ARM_NEON
+  if (impl == DM_PREPROCESS_NEON) {
+    s->interp_row = interp_row_neon;
+    s->emit_tile = emit_tile_neon;
+  }
+#endif
+
+  // same chroma rounding as I420Scale
+  plane_init(&s->planes[0], crop_x, crop_y, crop_w, crop_h, width, out_w, out_h, mirror);
+  for (int i = 1; i < 3; i++) {
+    plane_init(&s->planes[i], crop_x / 2, crop_y / 2, (crop_w + 1) / 2, (crop_h + 1) / 2, width / 2,
+               out_w / 2, out_h / 2, mirror);
+  }
+
+  // Y needs one extra column for the wrap into the next row
+  s->tile_y.resize((out_w + 1) * TILE_ROWS);
+  s->tile_u.resize((out_w / 2) * TILE_ROWS);
+  s->tile_v.resize((out_w / 2) * TILE_ROWS);
+  s->net_input_buf.resize((out_w / 2) * (out_h / 2) * 6);
+}
+
+float *dm_preprocess(DMPreprocessState *s, const uint8_t *yuv) {
+  const uint8_t *src[3];
+  src[0] = yuv;
+  src[1] = src[0] + s->width * s->height;
+  src[2] = src[1] + (s->width / 2) * (s->height / 2);
+
+  for (int i = 0; i < 3; i++) {
+    s->planes[i].cached_row[0] = s->planes[i].cached_row[1] = -1;
+  }
+
+  uint8_t *ty = s->tile_y.data(), *tu = s->tile_u.data(), *tv = s->tile_v.data();
+  for (int r0 = 0; r0 < s->out_h / 2; r0 += TILE_ROWS) {
+    for (int k = 0; k < TILE_ROWS; k++) {
+      const int r = r0 + k;
+      // the odd Y rows only contribute their first pixel, see emit_tile
+      scale_row(s, &s->planes[0], src[0], 2*r, ty + k, TILE_ROWS);
+      ty[s->out_w * TILE_ROWS + k] = scale_pixel(&s->planes[0], src[0], 2*r + 1, 0);
+      scale_row(s, &s->planes[1], src[1], r, tu + k, TILE_ROWS);
+      scale_row(s, &s->planes[2], src[2], r, tv + k, TILE_ROWS);
+    }
+    s->emit_tile(s, r0);
+  }
+  return s->net_input_buf.data();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Crop, optional mirror, bilinear downscale and conversion to the dmonitoring
+// model layout in a single pass over an I420 frame. The scaling matches
+// libyuv::I420Scale(kFilterBilinear) bit for bit, which is what fed the model before.
+
+#define DM_PREPROCESS_TILE_ROWS 8
+
+typedef enum {
+  DM_PREPROCESS_BEST = 0,
+  DM_PREPROCESS_SCALAR,
+  DM_PREPROCESS_SSE2,
+  DM_PREPROCESS_AVX2,
+  DM_PREPROCESS_NEON,
+} DMPreprocessImpl;
+
+typedef struct DMPreprocessPlane {
+  // crop of the source plane
+  int src_x, src_y, src_w, src_h, src_stride;
+  int dst_w, dst_h;
+  // like libyuv, rows are filtered first when shrinking and columns first when growing
+  bool rows_first;
+  // for every output column, the two source columns blended (mirror applied) and the 7 bit weight of the second
+  std::vector<int32_t> col0, col1;
+  std::vector<uint8_t> col_f;
+  // for every output row, the source row and the 8 bit weight of the one after it
+  std::vector<int32_t> row_i;
+  std::vector<uint8_t> row_f;
+  // rows_first: one vertically filtered source row
+  // columns first: two horizontally filtered source rows and the output row
+  std::vector<uint8_t> tmp, cached[2], line;
+  int cached_row[2];
+} DMPreprocessPlane;
+
+typedef struct DMPreprocessState {
+  int width, height;
+  int out_w, out_h;
+  bool mirror;
+  // the model input is (x - offset) * scale
+  float offset, scale;
+  DMPreprocessImpl impl;
+  void (*interp_row)(uint8_t *dst, const uint8_t *a, const uint8_t *b, int n, int f);
+  void (*emit_tile)(struct DMPreprocessState *s, int r0);
+
+  DMPreprocessPlane planes[3];
+  // output rows are gathered transposed, TILE_ROWS at a time, so every output column is a contiguous store
+  std::vector<uint8_t> tile_y, tile_u, tile_v;
+  std::vector<float> net_input_buf;
+} DMPreprocessState;
+
+// crop is in luma pixels. out_w and out_h are the model input size before the 2x2 space to depth
+void dm_preprocess_init(DMPreprocessState *s, int width, int height,
+                        int crop_x, int crop_y, int crop_w, int crop_h,
+                        int out_w, int out_h, bool mirror, float offset, float scale,
+                        DMPreprocessImpl impl = DM_PREPROCESS_BEST);
+bool dm_preprocess_impl_available(DMPreprocessImpl impl);
+const char *dm_preprocess_impl_name(DMPreprocessImpl impl);
+
+// returns net_input_buf, (out_w/2) * (out_h/2) * 6 floats
+float *dm_preprocess(DMPreprocessState *s, const uint8_t *yuv);
@@ -40,6 +40,8 @@ _HI_STD_TIMEOUT = 5
 _HI_STD_FALLBACK_TIME = 10  # fall back to wheel touch if model is uncertain for a long time
 _DISTRACTED_FILTER_TS = 0.25  # 0.6Hz
 
+_MAX_DT = 2.  # dmonitoringmodeld runs at 2Hz at the slowest, longer gaps only count this much
+
 _POSE_CALIB_MIN_SPEED = 13  # 30 mph
 _POSE_OFFSET_MIN_COUNT = 600  # valid data counts before calibration completes, 1 seg is 600 counts
 _POSE_OFFSET_MAX_COUNT = 3600  # stop deweighting new data after 6 min, aka "short term memory"
@@ -48,7 +50,7 @@ _RECOVERY_FACTOR_MAX = 5.  # relative to minus step change
 _RECOVERY_FACTOR_MIN = 1.25  # relative to minus step change
 
 MAX_TERMINAL_ALERTS = 3  # not allowed to engage after 3 terminal alerts
-MAX_TERMINAL_DURATION = 300  # 30s
+MAX_TERMINAL_DURATION = 30  # s
 
 # model output refers to center of cropped image, so need to apply the x displacement offset
 RESIZED_FOCAL = 320.0
@@ -112,22 +114,27 @@ class DriverStatus():
     self.driver_distraction_filter = FirstOrderFilter(0., _DISTRACTED_FILTER_TS, DT_DMON)
     self.face_detected = False
     self.terminal_alert_cnt = 0
-    self.terminal_time = 0
+    self.terminal_time = 0.
     self.step_change = 0.
     self.active_monitoring_mode = True
     self.hi_stds = 0
+    self.hi_std_time = 0.
     self.hi_std_alert_enabled = True
     self.threshold_prompt = _DISTRACTED_PROMPT_TIME_TILL_TERMINAL / _DISTRACTED_TIME
 
     self.is_rhd_region = False
     self.is_rhd_region_checked = False
 
+    # the model rate varies, timers advance by the time between driverState messages
+    self.dt = DT_DMON
+    self.last_pose_t = None
+
     self._set_timers(active_monitoring=True)
 
   def _set_timers(self, active_monitoring):
     if self.active_monitoring_mode and self.awareness <= self.threshold_prompt:
       if active_monitoring:
-        self.step_change = DT_DMON / _DISTRACTED_TIME
+        self.step_change = self.dt / _DISTRACTED_TIME
       else:
         self.step_change = 0.
       return  # no exploit after orange alert
@@ -142,7 +149,7 @@ class DriverStatus():
 
       self.threshold_pre = _DISTRACTED_PRE_TIME_TILL_TERMINAL / _DISTRACTED_TIME
       self.threshold_prompt = _DISTRACTED_PROMPT_TIME_TILL_TERMINAL / _DISTRACTED_TIME
-      self.step_change = DT_DMON / _DISTRACTED_TIME
+      self.step_change = self.dt / _DISTRACTED_TIME
       self.active_monitoring_mode = True
     else:
       if self.active_monitoring_mode:
@@ -151,7 +158,7 @@ class DriverStatus():
 
       self.threshold_pre = _AWARENESS_PRE_TIME_TILL_TERMINAL / _AWARENESS_TIME
       self.threshold_prompt = _AWARENESS_PROMPT_TIME_TILL_TERMINAL / _AWARENESS_TIME
-      self.step_change = DT_DMON / _AWARENESS_TIME
+      self.step_change = self.dt / _AWARENESS_TIME
       self.active_monitoring_mode = False
 
   def _is_driver_distracted(self, pose, blink):
@@ -180,8 +187,20 @@ class DriverStatus():
     self.pose.cfactor = interp(ep, [0, 0.5, 1], [_METRIC_THRESHOLD_STRICT, _METRIC_THRESHOLD, _METRIC_THRESHOLD_SLACK])/_METRIC_THRESHOLD
     self.blink.cfactor = interp(ep, [0, 0.5, 1], [_BLINK_THRESHOLD_STRICT, _BLINK_THRESHOLD, _BLINK_THRESHOLD_SLACK])/_BLINK_THRESHOLD
 
-  def get_pose(self, driver_state, cal_rpy, car_speed, op_engaged):
-    # 10 Hz
+  def _update_dt(self, t):
+    if t is None:
+      self.dt = DT_DMON
+    elif self.last_pose_t is None:
+      self.dt = DT_DMON
+      self.last_pose_t = t
+    else:
+      self.dt = min(max(t - self.last_pose_t, 0.), _MAX_DT)
+      self.last_pose_t = t
+    self.driver_distraction_filter.update_dt(self.dt)
+
+  def get_pose(self, driver_state, cal_rpy, car_speed, op_engaged, t=None):
+    # 1 to 10 Hz, t is the time of driver_state in seconds, None for 10Hz
+    self._update_dt(t)
     if len(driver_state.faceOrientation) == 0 or len(driver_state.facePosition) == 0 or len(driver_state.faceOrientationStd) == 0 or len(driver_state.facePositionStd) == 0:
       return
 
@@ -209,14 +228,16 @@ class DriverStatus():
     self.pose_calibrated = self.pose.pitch_offseter.filtered_stat.n > _POSE_OFFSET_MIN_COUNT and \
                             self.pose.yaw_offseter.filtered_stat.n > _POSE_OFFSET_MIN_COUNT
 
-    is_model_uncertain = self.hi_stds * DT_DMON > _HI_STD_FALLBACK_TIME
+    is_model_uncertain = self.hi_std_time > _HI_STD_FALLBACK_TIME
     self._set_timers(self.face_detected and not is_model_uncertain)
     if self.face_detected and not self.pose.low_std:
       if not is_model_uncertain:
         self.step_change *= min(1.0, max(0.6, 1.6*(model_std_max-0.5)*(model_std_max-2)))
       self.hi_stds += 1
+      self.hi_std_time += self.dt
     elif self.face_detected and self.pose.low_std:
       self.hi_stds = 0
+      self.hi_std_time = 0.
 
   def update(self, events, driver_engaged, ctrl_active, standstill):
     if (driver_engaged and self.awareness > 0) or not ctrl_active:
@@ -229,7 +250,7 @@ class DriverStatus():
     driver_attentive = self.driver_distraction_filter.x < 0.37
     awareness_prev = self.awareness
 
-    if self.face_detected and self.hi_stds * DT_DMON > _HI_STD_TIMEOUT and self.hi_std_alert_enabled:
+    if self.face_detected and self.hi_std_time > _HI_STD_TIMEOUT and self.hi_std_alert_enabled:
       events.add(EventName.driverMonitorLowAcc)
       self.hi_std_alert_enabled = False # only showed once until orange prompt resets it
 
@@ -243,7 +264,7 @@ class DriverStatus():
         return
 
     # should always be counting if distracted unless at standstill and reaching orange
-    if (not (self.face_detected and self.hi_stds * DT_DMON <= _HI_STD_FALLBACK_TIME) or (self.driver_distraction_filter.x > 0.63 and self.driver_distracted and self.face_detected)) and \
+    if (not (self.face_detected and self.hi_std_time <= _HI_STD_FALLBACK_TIME) or (self.driver_distraction_filter.x > 0.63 and self.driver_distracted and self.face_detected)) and \
        not (standstill and self.awareness - self.step_change <= self.threshold_prompt):
       self.awareness = max(self.awareness - self.step_change, -0.1)
 
@@ -251,7 +272,7 @@ class DriverStatus():
     if self.awareness <= 0.:
       # terminal red alert: disengagement required
       alert = EventName.driverDistracted if self.active_monitoring_mode else EventName.driverUnresponsive
-      self.terminal_time += 1
+      self.terminal_time += self.dt
       if awareness_prev > 0.:
         self.terminal_alert_cnt += 1
     elif self.awareness <= self.threshold_prompt:
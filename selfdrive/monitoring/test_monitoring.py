@@ -61,13 +61,13 @@ always_distracted = [msg_DISTRACTED] * int(_TEST_TIMESPAN/DT_DMON)
 always_true = [True] * int(_TEST_TIMESPAN/DT_DMON)
 always_false = [False] * int(_TEST_TIMESPAN/DT_DMON)
 
-def run_DState_seq(driver_state_msgs, driver_car_interaction, openpilot_status, car_standstill_status):
-  # inputs are all 10Hz
+def run_DState_seq(driver_state_msgs, driver_car_interaction, openpilot_status, car_standstill_status, ts=None):
+  # inputs are all 10Hz, or at the times in ts as dmonitoringd passes them from logMonoTime
   DS = DriverStatus()
   events_from_DM = []
   for idx in range(len(driver_state_msgs)):
     e = Events()
-    DS.get_pose(driver_state_msgs[idx], [0, 0, 0], 0, openpilot_status[idx])
+    DS.get_pose(driver_state_msgs[idx], [0, 0, 0], 0, openpilot_status[idx], None if ts is None else ts[idx])
     # cal_rpy and car_speed don't matter here
 
     # evaluate events at 10Hz for tests
@@ -76,6 +76,19 @@ def run_DState_seq(driver_state_msgs, driver_car_interaction, openpilot_status,
   assert len(events_from_DM) == len(driver_state_msgs), 'somethings wrong'
   return events_from_DM, DS
 
+def first_event_time(events_output, ts, name):
+  for e, t in zip(events_output, ts):
+    if name in e.names:
+      return t
+  return None
+
+def run_DState_rate(driver_state_msg, rate):
+  # the same driver at another model rate, with some jitter on the message times
+  n = int(_TEST_TIMESPAN*rate)
+  ts = [1000. + (i + 0.2*np.random.uniform(-1, 1))/rate for i in range(n)]
+  events_output = run_DState_seq([driver_state_msg]*n, [False]*n, [True]*n, [False]*n, ts)[0]
+  return events_output, [t - ts[0] for t in ts]
+
 class TestMonitoring(unittest.TestCase):
   # 0. op engaged, driver is doing fine all the time
   def test_fully_aware_driver(self):
@@ -221,6 +234,23 @@ class TestMonitoring(unittest.TestCase):
     self.assertEqual(events_output[int((_DISTRACTED_TIME+1)/DT_DMON)].names[1], EventName.promptDriverDistracted)
     self.assertEqual(events_output[int((_DISTRACTED_TIME*2.5)/DT_DMON)].names[1], EventName.promptDriverDistracted)  # set_timer blocked
 
+  # 11. op engaged, dmonitoringmodeld runs slower than 10Hz, as it does while the driver is attentive
+  #  - alerts come at the same times as at 10Hz, within a model period
+  def test_model_rate(self):
+    cases = [(msg_DISTRACTED, [EventName.preDriverDistracted, EventName.promptDriverDistracted, EventName.driverDistracted]),
+             (msg_NO_FACE_DETECTED, [EventName.preDriverUnresponsive, EventName.promptDriverUnresponsive, EventName.driverUnresponsive]),
+             (msg_ATTENTIVE_UNCERTAIN, [EventName.driverMonitorLowAcc])]
+    for msg, alerts in cases:
+      events_10hz, ts_10hz = run_DState_rate(msg, 1/DT_DMON)
+      for rate in [1., 2.9, 5.]:
+        events_output, ts = run_DState_rate(msg, rate)
+        for alert in alerts:
+          t_10hz = first_event_time(events_10hz, ts_10hz, alert)
+          t = first_event_time(events_output, ts, alert)
+          self.assertIsNotNone(t_10hz)
+          self.assertIsNotNone(t, (rate, alert))
+          self.assertLess(abs(t - t_10hz), 1.5/rate, (rate, alert, t, t_10hz))
+
 if __name__ == "__main__":
   print('MAX_TERMINAL_ALERTS', MAX_TERMINAL_ALERTS)
   unittest.main()
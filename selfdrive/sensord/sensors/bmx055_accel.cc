@@ -1,6 +1,5 @@
-#include <cassert>
+#include <algorithm>
 #include "common/swaglog.h"
-#include "common/timing.h"
 
 #include "bmx055_accel.hpp"
 
@@ -39,33 +38,64 @@ int BMX055_Accel::init(){
     goto fail;
   }
 
+  // also clears the FIFO
+  ret = set_register(BMX055_ACCEL_I2C_REG_FIFO_CONFIG_1, BMX055_ACCEL_FIFO_MODE_STREAM);
+  if (ret < 0){
+    goto fail;
+  }
+
 fail:
   return ret;
 }
 
-void BMX055_Accel::get_event(cereal::SensorEventData::Builder &event){
-  uint64_t start_time = nanos_since_boot();
-  uint8_t buffer[6];
-  int len = read_register(BMX055_ACCEL_I2C_REG_FIFO, buffer, sizeof(buffer));
-  assert(len == 6);
+int BMX055_Accel::read_samples(SensorSample *samples, int max, uint64_t now){
+  uint64_t overruns_before = overruns;
+  int frames = read_fifo(BMX055_ACCEL_I2C_REG_FIFO_STATUS, BMX055_ACCEL_I2C_REG_FIFO, fifo, BMX055_ACCEL_FRAME_SIZE,
+                         std::min(max, BMX055_ACCEL_FIFO_DEPTH));
+  if(overruns != overruns_before){
+    // the overrun flag stays set until the FIFO is configured again
+    set_register(BMX055_ACCEL_I2C_REG_FIFO_CONFIG_1, BMX055_ACCEL_FIFO_MODE_STREAM);
+  }
+  if(frames <= 0){
+    return frames;
+  }
 
   // 12 bit = +-2g
   float scale = 9.81 * 2.0f / (1 << 11);
-  float x = -read_12_bit(buffer[0], buffer[1]) * scale;
-  float y = -read_12_bit(buffer[2], buffer[3]) * scale;
-  float z = read_12_bit(buffer[4], buffer[5]) * scale;
-
-  event.setSource(cereal::SensorEventData::SensorSource::BMX055);
-  event.setVersion(1);
-  event.setSensor(SENSOR_ACCELEROMETER);
-  event.setType(SENSOR_TYPE_ACCELEROMETER);
-  event.setTimestamp(start_time);
+  for(int i = 0; i < frames; i++){
+    const uint8_t *buffer = &fifo[i * BMX055_ACCEL_FRAME_SIZE];
+    SensorSample &s = samples[i];
+    s.sensor = SENSOR_ACCELEROMETER;
+    s.type = SENSOR_TYPE_ACCELEROMETER;
+    // the last frame is the newest, one sample period apart
+    s.timestamp = now - (frames - 1 - i) * BMX055_ACCEL_SAMPLE_PERIOD_NS;
+    s.v[0] = -read_12_bit(buffer[0], buffer[1]) * scale;
+    s.v[1] = -read_12_bit(buffer[2], buffer[3]) * scale;
+    s.v[2] = read_12_bit(buffer[4], buffer[5]) * scale;
+  }
+  return frames;
+}
 
-  float xyz[] = {x, y, z};
-  kj::ArrayPtr<const float> vs(&xyz[0], 3);
+int BMX055_Accel::enable_interrupt(int samples){
+  int ret = 0;
+  if(samples < 1 || samples > BMX055_ACCEL_FIFO_DEPTH){
+    return -1;
+  }
 
-  auto svec = event.initAcceleration();
-  svec.setV(vs);
-  svec.setStatus(true);
+  // INT1 is active high push-pull after reset
+  ret = set_register(BMX055_ACCEL_I2C_REG_FIFO_CONFIG_0, samples);
+  if (ret < 0){
+    goto fail;
+  }
+  ret = set_register(BMX055_ACCEL_I2C_REG_INT_MAP_1, BMX055_ACCEL_INT_MAP_1_INT1_FWM);
+  if (ret < 0){
+    goto fail;
+  }
+  ret = set_register(BMX055_ACCEL_I2C_REG_INT_EN_1, BMX055_ACCEL_INT_EN_1_FWM);
+  if (ret < 0){
+    goto fail;
+  }
 
+fail:
+  return ret;
 }
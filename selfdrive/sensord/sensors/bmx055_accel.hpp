@@ -7,8 +7,13 @@
 
 // Registers of the chip
 #define BMX055_ACCEL_I2C_REG_ID     0x00
+#define BMX055_ACCEL_I2C_REG_FIFO_STATUS 0x0E
 #define BMX055_ACCEL_I2C_REG_BW     0x10
 #define BMX055_ACCEL_I2C_REG_HBW    0x13
+#define BMX055_ACCEL_I2C_REG_INT_EN_1  0x17
+#define BMX055_ACCEL_I2C_REG_INT_MAP_1 0x1A
+#define BMX055_ACCEL_I2C_REG_FIFO_CONFIG_0 0x30
+#define BMX055_ACCEL_I2C_REG_FIFO_CONFIG_1 0x3E
 #define BMX055_ACCEL_I2C_REG_FIFO   0x3F
 
 // Constants
@@ -26,10 +31,25 @@
 #define BMX055_ACCEL_BW_500HZ   0b01110
 #define BMX055_ACCEL_BW_1000HZ  0b01111
 
+// stream mode keeps the newest frames when full, x, y and z in each
+#define BMX055_ACCEL_FIFO_MODE_STREAM 0b10000000
+#define BMX055_ACCEL_FIFO_DEPTH       32
+#define BMX055_ACCEL_FRAME_SIZE       6
+
+// the FIFO watermark interrupt, on INT1
+#define BMX055_ACCEL_INT_EN_1_FWM     0b01000000
+#define BMX055_ACCEL_INT_MAP_1_INT1_FWM 0b00000010
+
+// the output data rate is twice the bandwidth, 250 Hz with BMX055_ACCEL_BW_125HZ
+#define BMX055_ACCEL_SAMPLE_PERIOD_NS 4000000ULL
+
 class BMX055_Accel : public I2CSensor {
   uint8_t get_device_address() {return BMX055_ACCEL_I2C_ADDR;}
+  uint8_t fifo[BMX055_ACCEL_FIFO_DEPTH * BMX055_ACCEL_FRAME_SIZE];
 public:
   BMX055_Accel(I2CBus *bus);
   int init();
-  void get_event(cereal::SensorEventData::Builder &event);
+  int read_samples(SensorSample *samples, int max, uint64_t now);
+  int enable_interrupt(int samples);
+  uint64_t sample_period() const { return BMX055_ACCEL_SAMPLE_PERIOD_NS; }
 };
@@ -1,4 +1,4 @@
-#include <cassert>
+#include <algorithm>
 #include <cmath>
 #include "common/swaglog.h"
 
@@ -49,33 +49,71 @@ int BMX055_Gyro::init(){
     goto fail;
   }
 
+  // also clears the FIFO
+  ret = set_register(BMX055_GYRO_I2C_REG_FIFO_CONFIG_1, BMX055_GYRO_FIFO_MODE_STREAM);
+  if (ret < 0){
+    goto fail;
+  }
+
 fail:
   return ret;
 }
 
-void BMX055_Gyro::get_event(cereal::SensorEventData::Builder &event){
-  uint64_t start_time = nanos_since_boot();
-  uint8_t buffer[6];
-  int len = read_register(BMX055_GYRO_I2C_REG_FIFO, buffer, sizeof(buffer));
-  assert(len == 6);
+int BMX055_Gyro::read_samples(SensorSample *samples, int max, uint64_t now){
+  uint64_t overruns_before = overruns;
+  int frames = read_fifo(BMX055_GYRO_I2C_REG_FIFO_STATUS, BMX055_GYRO_I2C_REG_FIFO, fifo, BMX055_GYRO_FRAME_SIZE,
+                         std::min(max, BMX055_GYRO_FIFO_DEPTH));
+  if(overruns != overruns_before){
+    // the overrun flag stays set until the FIFO is configured again
+    set_register(BMX055_GYRO_I2C_REG_FIFO_CONFIG_1, BMX055_GYRO_FIFO_MODE_STREAM);
+  }
+  if(frames <= 0){
+    return frames;
+  }
 
   // 16 bit = +- 125 deg/s
   float scale = 125.0f / (1 << 15);
-  float x = -DEG2RAD(read_16_bit(buffer[0], buffer[1]) * scale);
-  float y = -DEG2RAD(read_16_bit(buffer[2], buffer[3]) * scale);
-  float z = DEG2RAD(read_16_bit(buffer[4], buffer[5]) * scale);
-
-  event.setSource(cereal::SensorEventData::SensorSource::BMX055);
-  event.setVersion(1);
-  event.setSensor(SENSOR_GYRO_UNCALIBRATED);
-  event.setType(SENSOR_TYPE_GYROSCOPE_UNCALIBRATED);
-  event.setTimestamp(start_time);
+  for(int i = 0; i < frames; i++){
+    const uint8_t *buffer = &fifo[i * BMX055_GYRO_FRAME_SIZE];
+    SensorSample &s = samples[i];
+    s.sensor = SENSOR_GYRO_UNCALIBRATED;
+    s.type = SENSOR_TYPE_GYROSCOPE_UNCALIBRATED;
+    // the last frame is the newest, one sample period apart
+    s.timestamp = now - (frames - 1 - i) * BMX055_GYRO_SAMPLE_PERIOD_NS;
+    s.v[0] = -DEG2RAD(read_16_bit(buffer[0], buffer[1]) * scale);
+    s.v[1] = -DEG2RAD(read_16_bit(buffer[2], buffer[3]) * scale);
+    s.v[2] = DEG2RAD(read_16_bit(buffer[4], buffer[5]) * scale);
+  }
+  return frames;
+}
 
-  float xyz[] = {x, y, z};
-  kj::ArrayPtr<const float> vs(&xyz[0], 3);
+int BMX055_Gyro::enable_interrupt(int samples){
+  int ret = 0;
+  if(samples < 1 || samples > BMX055_GYRO_FIFO_DEPTH){
+    return -1;
+  }
 
-  auto svec = event.initGyroUncalibrated();
-  svec.setV(vs);
-  svec.setStatus(true);
+  ret = set_register(BMX055_GYRO_I2C_REG_FIFO_CONFIG_0, samples);
+  if (ret < 0){
+    goto fail;
+  }
+  ret = set_register(BMX055_GYRO_I2C_REG_FIFO_WM_EN, BMX055_GYRO_FIFO_WM_ENABLE);
+  if (ret < 0){
+    goto fail;
+  }
+  ret = set_register(BMX055_GYRO_I2C_REG_INT_EN_1, BMX055_GYRO_INT_EN_1_INT1_ACTIVE_HIGH);
+  if (ret < 0){
+    goto fail;
+  }
+  ret = set_register(BMX055_GYRO_I2C_REG_INT_MAP_1, BMX055_GYRO_INT_MAP_1_INT1_FIFO);
+  if (ret < 0){
+    goto fail;
+  }
+  ret = set_register(BMX055_GYRO_I2C_REG_INT_EN_0, BMX055_GYRO_INT_EN_0_FIFO);
+  if (ret < 0){
+    goto fail;
+  }
 
+fail:
+  return ret;
 }
@@ -7,9 +7,16 @@
 
 // Registers of the chip
 #define BMX055_GYRO_I2C_REG_ID      0x00
+#define BMX055_GYRO_I2C_REG_FIFO_STATUS 0x0E
 #define BMX055_GYRO_I2C_REG_RANGE   0x0F
 #define BMX055_GYRO_I2C_REG_BW      0x10
 #define BMX055_GYRO_I2C_REG_HBW     0x13
+#define BMX055_GYRO_I2C_REG_INT_EN_0  0x15
+#define BMX055_GYRO_I2C_REG_INT_EN_1  0x16
+#define BMX055_GYRO_I2C_REG_INT_MAP_1 0x18
+#define BMX055_GYRO_I2C_REG_FIFO_WM_EN 0x1E
+#define BMX055_GYRO_I2C_REG_FIFO_CONFIG_0 0x3D
+#define BMX055_GYRO_I2C_REG_FIFO_CONFIG_1 0x3E
 #define BMX055_GYRO_I2C_REG_FIFO    0x3F
 
 // Constants
@@ -24,13 +31,29 @@
 #define BMX055_GYRO_RANGE_250       0b011
 #define BMX055_GYRO_RANGE_125       0b100
 
+// 116 Hz filter at an output data rate of 1000 Hz
 #define BMX055_GYRO_BW_116HZ 0b0010
+#define BMX055_GYRO_SAMPLE_PERIOD_NS 1000000ULL
+
+// stream mode keeps the newest frames when full, x, y and z in each
+#define BMX055_GYRO_FIFO_MODE_STREAM 0b10000000
+#define BMX055_GYRO_FIFO_DEPTH       100
+#define BMX055_GYRO_FRAME_SIZE       6
+
+// the FIFO watermark interrupt on INT1, active high push-pull
+#define BMX055_GYRO_INT_EN_0_FIFO    0b01000000
+#define BMX055_GYRO_INT_EN_1_INT1_ACTIVE_HIGH 0b00000001
+#define BMX055_GYRO_INT_MAP_1_INT1_FIFO 0b00000100
+#define BMX055_GYRO_FIFO_WM_ENABLE   0b10000000
 
 
 class BMX055_Gyro : public I2CSensor {
   uint8_t get_device_address() {return BMX055_GYRO_I2C_ADDR;}
+  uint8_t fifo[BMX055_GYRO_FIFO_DEPTH * BMX055_GYRO_FRAME_SIZE];
 public:
   BMX055_Gyro(I2CBus *bus);
   int init();
-  void get_event(cereal::SensorEventData::Builder &event);
+  int read_samples(SensorSample *samples, int max, uint64_t now);
+  int enable_interrupt(int samples);
+  uint64_t sample_period() const { return BMX055_GYRO_SAMPLE_PERIOD_NS; }
 };
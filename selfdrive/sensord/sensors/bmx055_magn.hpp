@@ -17,5 +17,5 @@ class BMX055_Magn : public I2CSensor{
 public:
   BMX055_Magn(I2CBus *bus);
   int init();
-  void get_event(cereal::SensorEventData::Builder &event){};
+  int read_samples(SensorSample *samples, int max, uint64_t now){ return 0; };
 };
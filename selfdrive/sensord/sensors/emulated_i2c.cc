@@ -0,0 +1,163 @@
+#include "emulated_i2c.hpp"
+
+#include <cstring>
+
+#include "bmx055_accel.hpp"
+#include "bmx055_gyro.hpp"
+
+// a byte and its acknowledge at 400 kHz
+#define I2C_BYTE_NS 22500ULL
+// the SMBus block reads of read_register
+#define I2C_SMBUS_BLOCK_MAX 32
+
+void EmulatedI2CBus::attach(uint8_t device_address, EmulatedI2CDevice *device){
+  devices[device_address] = device;
+}
+
+int EmulatedI2CBus::transfer(uint8_t device_address, uint register_address, uint8_t *buffer, size_t len){
+  auto it = devices.find(device_address);
+  if (it == devices.end()){
+    return -1;
+  }
+
+  // the address with the write bit, the register, the address with the read bit and the data
+  transfers++;
+  bytes += len;
+  wire_ns += (3 + len) * I2C_BYTE_NS;
+  return it->second->read(register_address, buffer, len, now);
+}
+
+int EmulatedI2CBus::read_register(uint8_t device_address, uint register_address, uint8_t *buffer, uint8_t len){
+  if (len > I2C_SMBUS_BLOCK_MAX){
+    return -1;
+  }
+  return transfer(device_address, register_address, buffer, len);
+}
+
+int EmulatedI2CBus::read_burst(uint8_t device_address, uint register_address, uint8_t *buffer, size_t len){
+  return transfer(device_address, register_address, buffer, len);
+}
+
+int EmulatedI2CBus::set_register(uint8_t device_address, uint register_address, uint8_t data){
+  auto it = devices.find(device_address);
+  if (it == devices.end()){
+    return -1;
+  }
+
+  transfers++;
+  bytes += 1;
+  wire_ns += 3 * I2C_BYTE_NS;
+  return it->second->write(register_address, data, now);
+}
+
+
+EmulatedBMX055::EmulatedBMX055(Kind kind) : kind(kind) {
+  regs[BMX055_ACCEL_I2C_REG_ID] = kind == ACCEL ? BMX055_ACCEL_CHIP_ID : BMX055_GYRO_CHIP_ID;
+  regs[BMX055_ACCEL_I2C_REG_BW] = kind == ACCEL ? BMX055_ACCEL_BW_1000HZ : 0;
+}
+
+uint64_t EmulatedBMX055::sample_period() const {
+  if (kind == ACCEL){
+    // twice the bandwidth, 7.81 Hz to 1 kHz
+    int code = regs[BMX055_ACCEL_I2C_REG_BW] & 0x1F;
+    if (code < BMX055_ACCEL_BW_7_81HZ) code = BMX055_ACCEL_BW_7_81HZ;
+    if (code > BMX055_ACCEL_BW_1000HZ) code = BMX055_ACCEL_BW_1000HZ;
+    return 64000000ULL >> (code - BMX055_ACCEL_BW_7_81HZ);
+  } else {
+    static const uint64_t odr_hz[] = {2000, 2000, 1000, 400, 200, 100, 200, 100};
+    return 1000000000ULL / odr_hz[regs[BMX055_GYRO_I2C_REG_BW] & 0x7];
+  }
+}
+
+int EmulatedBMX055::depth() const {
+  if (!stream){
+    // bypass mode only holds the latest sample
+    return 1;
+  }
+  return kind == ACCEL ? BMX055_ACCEL_FIFO_DEPTH : BMX055_GYRO_FIFO_DEPTH;
+}
+
+uint64_t EmulatedBMX055::next_interrupt() const {
+  int watermark;
+  if (kind == ACCEL){
+    if (!(regs[BMX055_ACCEL_I2C_REG_INT_EN_1] & BMX055_ACCEL_INT_EN_1_FWM) ||
+        !(regs[BMX055_ACCEL_I2C_REG_INT_MAP_1] & BMX055_ACCEL_INT_MAP_1_INT1_FWM)){
+      return UINT64_MAX;
+    }
+    watermark = regs[BMX055_ACCEL_I2C_REG_FIFO_CONFIG_0] & 0x3F;
+  } else {
+    if (!(regs[BMX055_GYRO_I2C_REG_INT_EN_0] & BMX055_GYRO_INT_EN_0_FIFO) ||
+        !(regs[BMX055_GYRO_I2C_REG_INT_MAP_1] & BMX055_GYRO_INT_MAP_1_INT1_FIFO) ||
+        !(regs[BMX055_GYRO_I2C_REG_FIFO_WM_EN] & BMX055_GYRO_FIFO_WM_ENABLE)){
+      return UINT64_MAX;
+    }
+    watermark = regs[BMX055_GYRO_I2C_REG_FIFO_CONFIG_0] & 0x7F;
+  }
+  if (!stream || watermark == 0){
+    return UINT64_MAX;
+  }
+  // sample next_sample + watermark - 1 fills the FIFO up to the watermark
+  return start + (next_sample + watermark) * sample_period();
+}
+
+int16_t EmulatedBMX055::raw_value(uint64_t n, int axis) const {
+  int16_t v = (int16_t)(n * 37 + axis * 1000 - 2000);
+  return kind == ACCEL ? v & ~0xF : v;
+}
+
+void EmulatedBMX055::update(uint64_t now){
+  measured = now > start ? (now - start) / sample_period() : 0;
+  if (measured - next_sample > (uint64_t)depth()){
+    // stream mode drops the oldest samples
+    uint64_t lost = measured - next_sample - depth();
+    dropped += lost;
+    next_sample += lost;
+    overrun = stream;
+  }
+}
+
+int EmulatedBMX055::read(uint register_address, uint8_t *buffer, size_t len, uint64_t now){
+  update(now);
+  for (size_t i = 0; i < len; i++){
+    // reads past the end of the block continue in the next registers, except FIFO_DATA
+    uint reg = register_address == BMX055_ACCEL_I2C_REG_FIFO ? register_address : register_address + i;
+    uint8_t value = 0;
+    if (reg == BMX055_ACCEL_I2C_REG_FIFO_STATUS){
+      value = (overrun ? 0x80 : 0) | (uint8_t)(measured - next_sample);
+    } else if (reg == BMX055_ACCEL_I2C_REG_FIFO){
+      if (measured > next_sample){
+        // a frame is x, y and z, LSB first. Reading an empty FIFO gives zeros
+        int byte = i % 6;
+        uint16_t raw = raw_value(next_sample, byte / 2);
+        value = byte % 2 ? raw >> 8 : raw & 0xFF;
+        if (byte == 5){
+          next_sample++;
+        }
+      }
+    } else if (reg < sizeof(regs)){
+      value = regs[reg];
+    }
+    buffer[i] = value;
+  }
+  return len;
+}
+
+int EmulatedBMX055::write(uint register_address, uint8_t data, uint64_t now){
+  update(now);
+  if (register_address >= sizeof(regs) || register_address == BMX055_ACCEL_I2C_REG_ID){
+    return -1;
+  }
+  regs[register_address] = data;
+
+  if (register_address == BMX055_ACCEL_I2C_REG_BW){
+    // the samples are counted again at the new rate
+    start = now;
+    measured = next_sample = 0;
+  } else if (register_address == BMX055_ACCEL_I2C_REG_FIFO_CONFIG_1){
+    // clears the FIFO and the overrun flag
+    stream = (data >> 6) == 0b10;
+    overrun = false;
+    next_sample = measured;
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+#include "common/i2c.h"
+
+// A device on an EmulatedI2CBus, now is the bus clock in nanoseconds
+class EmulatedI2CDevice {
+public:
+  virtual ~EmulatedI2CDevice() {}
+  virtual int read(uint register_address, uint8_t *buffer, size_t len, uint64_t now) = 0;
+  virtual int write(uint register_address, uint8_t data, uint64_t now) = 0;
+};
+
+// An I2C bus in memory, to run the sensors without hardware. It counts the transfers
+// and how long they would keep a 400 kHz bus busy.
+class EmulatedI2CBus : public I2CBus {
+public:
+  EmulatedI2CBus() {}
+  void attach(uint8_t device_address, EmulatedI2CDevice *device);
+
+  int read_register(uint8_t device_address, uint register_address, uint8_t *buffer, uint8_t len);
+  int set_register(uint8_t device_address, uint register_address, uint8_t data);
+  int read_burst(uint8_t device_address, uint register_address, uint8_t *buffer, size_t len);
+
+  // set by the caller, the time the devices see
+  uint64_t now = 0;
+
+  uint64_t transfers = 0;
+  uint64_t bytes = 0;
+  uint64_t wire_ns = 0;
+
+private:
+  std::map<uint8_t, EmulatedI2CDevice *> devices;
+  int transfer(uint8_t device_address, uint register_address, uint8_t *buffer, size_t len);
+};
+
+// The accelerometer or gyroscope of a BMX055: the chip ID, the output data rate set by
+// the bandwidth register, the FIFO in bypass or stream mode and its watermark interrupt.
+// Sample n is measured n + 1 sample periods after the bandwidth was set, its values are
+// raw_value(n, axis).
+class EmulatedBMX055 : public EmulatedI2CDevice {
+public:
+  enum Kind { ACCEL, GYRO };
+
+  EmulatedBMX055(Kind kind);
+  int read(uint register_address, uint8_t *buffer, size_t len, uint64_t now);
+  int write(uint register_address, uint8_t data, uint64_t now);
+
+  uint64_t sample_period() const;
+  int depth() const;
+  // When the FIFO level reaches the watermark and the interrupt line rises, UINT64_MAX if the
+  // interrupt isn't enabled. A time before now means the line is still high, there's no new
+  // edge before the FIFO is read.
+  uint64_t next_interrupt() const;
+  // the 16 bit value in the data registers, the accelerometer's has 12 bits in bits 15:4
+  int16_t raw_value(uint64_t n, int axis) const;
+
+  // the next sample to be read and how many were dropped
+  uint64_t next_sample = 0;
+  uint64_t dropped = 0;
+
+private:
+  Kind kind;
+  uint8_t regs[0x40] = {};
+  bool stream = false;
+  bool overrun = false;
+  uint64_t start = 0;
+
+  // samples measured so far
+  uint64_t measured = 0;
+  void update(uint64_t now);
+};
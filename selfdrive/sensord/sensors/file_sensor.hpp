@@ -3,7 +3,6 @@
 #include <fstream>
 #include <string>
 
-#include "cereal/gen/cpp/log.capnp.h"
 #include "sensors/sensor.hpp"
 
 
@@ -15,5 +14,5 @@ public:
   FileSensor(std::string filename);
   ~FileSensor();
   int init();
-  virtual void get_event(cereal::SensorEventData::Builder &event) = 0;
+  virtual int read_samples(SensorSample *samples, int max, uint64_t now) = 0;
 };
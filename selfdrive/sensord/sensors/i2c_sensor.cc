@@ -22,3 +22,28 @@ int I2CSensor::read_register(uint register_address, uint8_t *buffer, uint8_t len
 int I2CSensor::set_register(uint register_address, uint8_t data){
   return bus->set_register(get_device_address(), register_address, data);
 }
+
+int I2CSensor::read_fifo(uint status_register, uint data_register, uint8_t *buffer, int frame_size, int max_frames){
+  uint8_t status;
+  int ret = read_register(status_register, &status, 1);
+  if(ret < 0){
+    return ret;
+  }
+  if(status & 0x80){
+    overruns++;
+  }
+
+  int frames = status & 0x7F;
+  if(frames > max_frames){
+    frames = max_frames;
+  }
+  if(frames == 0){
+    return 0;
+  }
+  // the frames come out of the data register one after the other, in one transfer
+  ret = bus->read_burst(get_device_address(), data_register, buffer, frames * frame_size);
+  if(ret < 0){
+    return ret;
+  }
+  return frames;
+}
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <cstdint>
-#include "cereal/gen/cpp/log.capnp.h"
 #include "common/i2c.h"
 #include "sensors/sensor.hpp"
 #include "sensors/constants.hpp"
@@ -19,6 +18,9 @@ public:
   I2CSensor(I2CBus *bus);
   int read_register(uint register_address, uint8_t *buffer, uint8_t len);
   int set_register(uint register_address, uint8_t data);
+  // Reads the frames in a BMX055 style FIFO, the frame count in bits 6:0 of status_register
+  // and the overrun flag in bit 7. Returns how many frames, at most max_frames, < 0 on error.
+  int read_fifo(uint status_register, uint data_register, uint8_t *buffer, int frame_size, int max_frames);
   virtual int init() = 0;
-  virtual void get_event(cereal::SensorEventData::Builder &event) = 0;
+  virtual int read_samples(SensorSample *samples, int max, uint64_t now) = 0;
 };
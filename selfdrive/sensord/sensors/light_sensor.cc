@@ -1,23 +1,27 @@
 #include <iostream>
 #include <string>
 
-#include "common/timing.h"
-
 #include "light_sensor.hpp"
 #include "constants.hpp"
 
-void LightSensor::get_event(cereal::SensorEventData::Builder &event){
-  uint64_t start_time = nanos_since_boot();
+int LightSensor::read_samples(SensorSample *samples, int max, uint64_t now){
+  if(max < 1){
+    return 0;
+  }
   file.clear();
   file.seekg(0);
 
   int value;
   file >> value;
+  if(file.fail()){
+    return -1;
+  }
 
-  event.setSource(cereal::SensorEventData::SensorSource::RPR0521);
-  event.setVersion(1);
-  event.setSensor(SENSOR_LIGHT);
-  event.setType(SENSOR_TYPE_LIGHT);
-  event.setTimestamp(start_time);
-  event.setLight(value);
+  SensorSample &s = samples[0];
+  s.sensor = SENSOR_LIGHT;
+  s.type = SENSOR_TYPE_LIGHT;
+  s.timestamp = now;
+  s.v[0] = value;
+  s.v[1] = s.v[2] = 0;
+  return 1;
 }
@@ -4,5 +4,5 @@
 class LightSensor : public FileSensor {
 public:
   LightSensor(std::string filename) : FileSensor(filename){};
-  void get_event(cereal::SensorEventData::Builder &event);
+  int read_samples(SensorSample *samples, int max, uint64_t now);
 };
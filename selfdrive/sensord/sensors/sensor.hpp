@@ -1,9 +1,30 @@
 #pragma once
 
-#include "cereal/gen/cpp/log.capnp.h"
+#include <stdint.h>
+
+// A reading, sensord puts it in a SensorEventData
+struct SensorSample {
+  int sensor;
+  int type;
+  // when it was measured, nanos_since_boot
+  uint64_t timestamp;
+  // x, y, z, or the value of a light sensor in v[0]
+  float v[3];
+};
 
 class Sensor {
 public:
+  virtual ~Sensor() {}
   virtual int init() = 0;
-  virtual void get_event(cereal::SensorEventData::Builder &event) = 0;
+  // Puts the samples measured since the last call in samples, at most max, at time now.
+  // Returns how many, < 0 if reading failed.
+  virtual int read_samples(SensorSample *samples, int max, uint64_t now) = 0;
+  // Makes the sensor raise its data ready interrupt line once it has the given number of
+  // samples. Returns < 0 if it can't, it's then read on a timer.
+  virtual int enable_interrupt(int samples) { return -1; }
+  // time between the samples it measures on its own, 0 if it's measured when read
+  virtual uint64_t sample_period() const { return 0; }
+
+  // times the sensor's buffer was full and samples were lost
+  uint64_t overruns = 0;
 };
@@ -0,0 +1,138 @@
+#include "sensor_loop.hpp"
+
+#include <ctime>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "common/gpio.h"
+
+SensorLoop::SensorLoop(){
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  timer_fd = timerfd_create(CLOCK_BOOTTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = timer_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+}
+
+SensorLoop::~SensorLoop(){
+  close(timer_fd);
+  close(epoll_fd);
+}
+
+void SensorLoop::add(Sensor *sensor, uint64_t period_ns, uint64_t start){
+  entries.push_back({sensor, period_ns, start + period_ns, -1});
+}
+
+int SensorLoop::add_interrupt(Sensor *sensor, int fd, uint64_t timeout_ns, uint64_t start){
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0){
+    return -1;
+  }
+  entries.push_back({sensor, timeout_ns, start + timeout_ns, fd});
+  return 0;
+}
+
+uint64_t SensorLoop::next_deadline() const {
+  uint64_t deadline = UINT64_MAX;
+  for (const Entry &e : entries){
+    if (e.deadline < deadline){
+      deadline = e.deadline;
+    }
+  }
+  return deadline;
+}
+
+int SensorLoop::wait(int timeout_ms){
+  uint64_t deadline = next_deadline();
+  if (deadline != UINT64_MAX){
+    // absolute, the time spent reading doesn't add up
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = deadline / 1000000000ULL;
+    spec.it_value.tv_nsec = deadline % 1000000000ULL;
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+  }
+
+  struct epoll_event events[16];
+  int n = epoll_wait(epoll_fd, events, 16, timeout_ms);
+
+  uint64_t expirations;
+  while (read(timer_fd, &expirations, sizeof(expirations)) > 0) {}
+  return n;
+}
+
+int SensorLoop::poll(uint64_t now, SensorSample *samples, int max){
+  int n = 0;
+  for (Entry &e : entries){
+    uint64_t t = now;
+    bool ready = e.deadline <= now;
+
+    if (e.fd >= 0){
+      // one read takes all the samples, however many edges there were
+      uint64_t edge, first = now, last = 0;
+      bool edges = false;
+      while (gpio_read_edge(e.fd, &edge) == 0){
+        edge = std::min(edge, now);
+        first = std::min(first, edge);
+        last = std::max(last, edge);
+        edges = true;
+        interrupts++;
+      }
+      if (edges){
+        // the newest sample came with the last edge, unless the sensor measured more after it
+        uint64_t period = e.sensor->sample_period();
+        t = (period > 0 && now - last >= period) ? now : last;
+        // latency is from the first
+        if (first_edge == 0 || first < first_edge){
+          first_edge = first;
+        }
+      } else if (ready){
+        interrupt_timeouts++;
+      }
+      ready = ready || edges;
+    }
+
+    if (!ready){
+      continue;
+    }
+
+    int ret = e.sensor->read_samples(samples + n, max - n, t);
+    if (ret < 0){
+      read_errors++;
+    } else {
+      n += ret;
+    }
+
+    if (e.fd >= 0){
+      e.deadline = now + e.period;
+      continue;
+    }
+
+    // the next deadline after now, a late wake up doesn't make the following reads bunch up
+    e.deadline += e.period;
+    if (e.deadline <= now){
+      uint64_t skipped = (now - e.deadline) / e.period + 1;
+      missed_deadlines += skipped;
+      e.deadline += skipped * e.period;
+    }
+  }
+  return n;
+}
+
+void SensorLoop::published(uint64_t now){
+  if (first_edge == 0){
+    return;
+  }
+  uint64_t dt = now > first_edge ? now - first_edge : 0;
+  latency.count++;
+  latency.total_ns += dt;
+  if (dt > latency.max_ns){
+    latency.max_ns = dt;
+  }
+  first_edge = 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "sensors/sensor.hpp"
+
+// Reads each sensor when its data ready interrupt fires, or at its own period on absolute
+// deadlines for sensors without one. wait() blocks on the interrupt fds and a timer for the
+// next deadline in a single epoll, poll() then reads the sensors that are ready.
+class SensorLoop {
+public:
+  SensorLoop();
+  ~SensorLoop();
+
+  void add(Sensor *sensor, uint64_t period_ns, uint64_t start);
+  // Reads the sensor on the edges of fd, from gpio_get_edge_fd, stamping its newest sample
+  // with the time of the last edge, or of the read if the sensor measured more since. A
+  // timeout after the last edge reads it anyway, in case an edge was missed. Returns < 0
+  // if fd can't be waited on.
+  int add_interrupt(Sensor *sensor, int fd, uint64_t timeout_ns, uint64_t start);
+  // the earliest deadline, UINT64_MAX without sensors
+  uint64_t next_deadline() const;
+  // Blocks until an interrupt or the next deadline, at most timeout_ms (-1 for no limit).
+  // Returns how many fds are ready, < 0 on error.
+  int wait(int timeout_ms);
+  // Reads the sensors whose interrupt fired or whose deadline is at or before now into
+  // samples, at most max. Returns how many samples.
+  int poll(uint64_t now, SensorSample *samples, int max);
+  // Call when the samples of the last poll are sent, for the interrupt to publish latency
+  void published(uint64_t now);
+
+  // deadlines skipped because the loop woke up too late
+  uint64_t missed_deadlines = 0;
+  uint64_t read_errors = 0;
+  // reads of interrupt sensors after a timeout instead of an edge
+  uint64_t interrupt_timeouts = 0;
+  uint64_t interrupts = 0;
+
+  // from the first edge serviced by a poll until published
+  struct {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+  } latency;
+
+private:
+  struct Entry {
+    Sensor *sensor;
+    uint64_t period;
+    uint64_t deadline;
+    int fd;
+  };
+  std::vector<Entry> entries;
+  int epoll_fd;
+  int timer_fd;
+  // the earliest edge since the last published(), 0 for none
+  uint64_t first_edge = 0;
+};
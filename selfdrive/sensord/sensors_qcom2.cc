@@ -1,11 +1,11 @@
 #include <vector>
 #include <csignal>
-#include <chrono>
-#include <thread>
+#include <unistd.h>
 #include <sys/resource.h>
 
 #include "messaging.hpp"
 #include "common/i2c.h"
+#include "common/gpio.h"
 #include "common/timing.h"
 #include "common/swaglog.h"
 
@@ -15,16 +15,79 @@
 #include "sensors/bmx055_gyro.hpp"
 #include "sensors/bmx055_magn.hpp"
 #include "sensors/light_sensor.hpp"
+#include "sensors/sensor_loop.hpp"
 
 volatile sig_atomic_t do_exit = 0;
 
 #define I2C_BUS_IMU 1
 
+// how often each sensor is read, the IMUs buffer their samples in the FIFO in between
+#define ACCEL_PERIOD_NS 20000000ULL
+#define GYRO_PERIOD_NS  20000000ULL
+#define LIGHT_PERIOD_NS 100000000ULL
+
+// The INT1 lines of the IMU on /dev/gpiochip<GPIO_CHIP_IMU>, -1 where they aren't wired to
+// the SoC. A sensor without one is read at its period.
+#define GPIO_CHIP_IMU 0
+#define GPIO_BMX055_ACCEL_INT1 -1
+#define GPIO_BMX055_GYRO_INT1  -1
+// samples per interrupt, as many as a period
+#define ACCEL_INT_SAMPLES 5
+#define GYRO_INT_SAMPLES  20
+// an interrupt sensor is read anyway after this long without an edge
+#define INTERRUPT_TIMEOUT_NS 100000000ULL
+
+// more than a full accelerometer and gyroscope FIFO and a light reading
+#define MAX_SAMPLES 256
+
 
 void set_do_exit(int sig) {
   do_exit = 1;
 }
 
+void fill_event(cereal::SensorEventData::Builder event, const SensorSample &s){
+  event.setVersion(1);
+  event.setSensor(s.sensor);
+  event.setType(s.type);
+  event.setTimestamp(s.timestamp);
+
+  kj::ArrayPtr<const float> vs(&s.v[0], 3);
+  switch (s.sensor){
+  case SENSOR_ACCELEROMETER: {
+    event.setSource(cereal::SensorEventData::SensorSource::BMX055);
+    auto svec = event.initAcceleration();
+    svec.setV(vs);
+    svec.setStatus(true);
+    break;
+  }
+  case SENSOR_GYRO_UNCALIBRATED: {
+    event.setSource(cereal::SensorEventData::SensorSource::BMX055);
+    auto svec = event.initGyroUncalibrated();
+    svec.setV(vs);
+    svec.setStatus(true);
+    break;
+  }
+  case SENSOR_LIGHT:
+    event.setSource(cereal::SensorEventData::SensorSource::RPR0521);
+    event.setLight(s.v[0]);
+    break;
+  }
+}
+
+void add_sensor(SensorLoop &loop, Sensor *sensor, int line, int samples, uint64_t period, uint64_t start){
+  if (line >= 0 && sensor->enable_interrupt(samples) == 0){
+    int fd = gpio_get_edge_fd(GPIO_CHIP_IMU, line);
+    if (fd >= 0 && loop.add_interrupt(sensor, fd, INTERRUPT_TIMEOUT_NS, start) == 0){
+      return;
+    }
+    if (fd >= 0){
+      close(fd);
+    }
+    LOGW("Interrupt on GPIO line %d failed, reading at %llu ns", line, (unsigned long long)period);
+  }
+  loop.add(sensor, period, start);
+}
+
 int sensor_loop() {
   I2CBus *i2c_bus_imu;
 
@@ -56,24 +119,43 @@ int sensor_loop() {
     }
   }
 
+  uint64_t start = nanos_since_boot();
+  SensorLoop loop;
+  add_sensor(loop, &accel, GPIO_BMX055_ACCEL_INT1, ACCEL_INT_SAMPLES, ACCEL_PERIOD_NS, start);
+  add_sensor(loop, &gyro, GPIO_BMX055_GYRO_INT1, GYRO_INT_SAMPLES, GYRO_PERIOD_NS, start);
+  loop.add(&light, LIGHT_PERIOD_NS, start);
+
   PubMaster pm({"sensorEvents"});
+  SensorSample samples[MAX_SAMPLES];
+  uint64_t last_stats = start;
 
   while (!do_exit){
-    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-
-    const int num_events = sensors.size();
-    MessageBuilder msg;
-    auto sensor_events = msg.initEvent().initSensorEvents(num_events);
-
-    for (int i = 0; i < num_events; i++){
-      auto event = sensor_events[i];
-      sensors[i]->get_event(event);
+    loop.wait(-1);
+
+    uint64_t now = nanos_since_boot();
+    int n = loop.poll(now, samples, MAX_SAMPLES);
+    if (n > 0){
+      MessageBuilder msg;
+      auto sensor_events = msg.initEvent().initSensorEvents(n);
+      for (int i = 0; i < n; i++){
+        fill_event(sensor_events[i], samples[i]);
+      }
+      pm.send("sensorEvents", msg);
+      loop.published(nanos_since_boot());
     }
 
-    pm.send("sensorEvents", msg);
-
-    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-    std::this_thread::sleep_for(std::chrono::milliseconds(10) - (end - begin));
+    if (now - last_stats > 10000000000ULL){
+      LOGD("sensord: accel overruns %llu, gyro overruns %llu, missed deadlines %llu, read errors %llu",
+           (unsigned long long)accel.overruns, (unsigned long long)gyro.overruns,
+           (unsigned long long)loop.missed_deadlines, (unsigned long long)loop.read_errors);
+      if (loop.latency.count > 0){
+        LOGD("sensord: %llu interrupts, %llu timeouts, interrupt to publish %.3f ms mean %.3f ms max",
+             (unsigned long long)loop.interrupts, (unsigned long long)loop.interrupt_timeouts,
+             loop.latency.total_ns * 1e-6 / loop.latency.count, loop.latency.max_ns * 1e-6);
+        loop.latency.count = loop.latency.total_ns = loop.latency.max_ns = 0;
+      }
+      last_stats = now;
+    }
   }
   return 0;
 }
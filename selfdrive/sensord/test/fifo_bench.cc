@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "common/timing.h"
+#include "sensors/constants.hpp"
+#include "sensors/bmx055_accel.hpp"
+#include "sensors/bmx055_gyro.hpp"
+#include "sensors/sensor_loop.hpp"
+#include "sensors/emulated_i2c.hpp"
+
+// Compares reading one sample from the accelerometer and gyroscope data registers, every
+// 10 ms like sensord did or at their data rates, with draining their FIFOs in a burst every
+// 20 ms. On emulated devices at the configured rates:
+//   ./fifo_bench [seconds of data]
+
+#define MAX_SAMPLES 256
+
+struct Result {
+  uint64_t samples;
+  uint64_t measured;
+  uint64_t polls;
+  double cpu_us;
+};
+
+static void print(const char *name, const Result &r, const EmulatedI2CBus &bus, double seconds){
+  printf("%s:\n", name);
+  printf("  %.0f samples/s of %.0f measured, %.0f transfers/s, %.0f bytes/s\n",
+         r.samples / seconds, r.measured / seconds, bus.transfers / seconds, bus.bytes / seconds);
+  printf("  bus busy %.1f%% at 400 kHz, %.2f us of CPU per poll\n",
+         100.0 * bus.wire_ns / (seconds * 1e9), r.cpu_us / r.polls);
+}
+
+static void run_single(const char *name, double seconds, uint64_t accel_period, uint64_t gyro_period){
+  // bypass mode, the data registers hold the latest sample
+  EmulatedI2CBus bus;
+  EmulatedBMX055 accel_dev(EmulatedBMX055::ACCEL), gyro_dev(EmulatedBMX055::GYRO);
+  bus.attach(BMX055_ACCEL_I2C_ADDR, &accel_dev);
+  bus.attach(BMX055_GYRO_I2C_ADDR, &gyro_dev);
+  bus.set_register(BMX055_ACCEL_I2C_ADDR, BMX055_ACCEL_I2C_REG_BW, BMX055_ACCEL_BW_125HZ);
+  bus.set_register(BMX055_GYRO_I2C_ADDR, BMX055_GYRO_I2C_REG_BW, BMX055_GYRO_BW_116HZ);
+  bus.transfers = bus.bytes = bus.wire_ns = 0;
+
+  Result r = {};
+  uint8_t buffer[6];
+  const uint64_t end = seconds * 1e9;
+  uint64_t accel_deadline = accel_period, gyro_deadline = gyro_period;
+  while(std::min(accel_deadline, gyro_deadline) <= end) {
+    bus.now = std::min(accel_deadline, gyro_deadline);
+    uint64_t t = nanos_since_boot();
+    if(accel_deadline == bus.now) {
+      if(bus.read_register(BMX055_ACCEL_I2C_ADDR, BMX055_ACCEL_I2C_REG_FIFO, buffer, sizeof(buffer)) == 6) r.samples++;
+      accel_deadline += accel_period;
+    }
+    if(gyro_deadline == bus.now) {
+      if(bus.read_register(BMX055_GYRO_I2C_ADDR, BMX055_GYRO_I2C_REG_FIFO, buffer, sizeof(buffer)) == 6) r.samples++;
+      gyro_deadline += gyro_period;
+    }
+    r.cpu_us += (nanos_since_boot() - t) * 1e-3;
+    r.polls++;
+  }
+  r.measured = end / accel_dev.sample_period() + end / gyro_dev.sample_period();
+  print(name, r, bus, seconds);
+}
+
+static void run_fifo(double seconds){
+  EmulatedI2CBus bus;
+  EmulatedBMX055 accel_dev(EmulatedBMX055::ACCEL), gyro_dev(EmulatedBMX055::GYRO);
+  bus.attach(BMX055_ACCEL_I2C_ADDR, &accel_dev);
+  bus.attach(BMX055_GYRO_I2C_ADDR, &gyro_dev);
+  BMX055_Accel accel(&bus);
+  BMX055_Gyro gyro(&bus);
+  accel.init();
+  gyro.init();
+  bus.transfers = bus.bytes = bus.wire_ns = 0;
+
+  SensorLoop loop;
+  loop.add(&accel, 20000000ULL, 0);
+  loop.add(&gyro, 20000000ULL, 0);
+
+  Result r = {};
+  SensorSample samples[MAX_SAMPLES];
+  const uint64_t end = seconds * 1e9;
+  while(loop.next_deadline() <= end) {
+    bus.now = loop.next_deadline();
+    uint64_t t = nanos_since_boot();
+    r.samples += loop.poll(bus.now, samples, MAX_SAMPLES);
+    r.cpu_us += (nanos_since_boot() - t) * 1e-3;
+    r.polls++;
+  }
+  r.measured = end / accel_dev.sample_period() + end / gyro_dev.sample_period();
+  print("FIFO bursts every 20 ms", r, bus, seconds);
+}
+
+int main(int argc, char** argv) {
+  const double seconds = argc > 1 ? atof(argv[1]) : 600;
+  run_single("one sample per sensor every 10 ms", seconds, 10000000ULL, 10000000ULL);
+  run_single("one sample per sensor at its data rate", seconds,
+             BMX055_ACCEL_SAMPLE_PERIOD_NS, BMX055_GYRO_SAMPLE_PERIOD_NS);
+  run_fifo(seconds);
+  return 0;
+}
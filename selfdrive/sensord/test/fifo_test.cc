@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "sensors/constants.hpp"
+#include "sensors/bmx055_accel.hpp"
+#include "sensors/bmx055_gyro.hpp"
+#include "sensors/light_sensor.hpp"
+#include "sensors/sensor_loop.hpp"
+#include "sensors/emulated_i2c.hpp"
+
+// Runs the BMX055 FIFO reads and the SensorLoop against emulated devices: every sample
+// measured comes out once with its values, in order and timestamped within a sample period,
+// also after the loop stalled long enough for the FIFOs to overflow.
+//   ./fifo_test
+
+#define PERIOD_NS 20000000ULL
+#define LIGHT_PERIOD_NS 100000000ULL
+#define MAX_SAMPLES 256
+
+struct Expected {
+  EmulatedBMX055 *dev;
+  uint64_t n;
+  uint64_t dropped;
+  uint64_t last_timestamp;
+};
+
+static float expected_value(const EmulatedBMX055 &dev, int sensor, uint64_t n, int axis){
+  float sign = axis == 2 ? 1 : -1;
+  if(sensor == SENSOR_ACCELEROMETER){
+    return sign * (dev.raw_value(n, axis) / (1 << 4)) * 9.81 * 2.0f / (1 << 11);
+  }
+  return sign * (dev.raw_value(n, axis) * 125.0f / (1 << 15)) * M_PI / 180.0;
+}
+
+static void check(Expected &e, int sensor, const SensorSample &s){
+  for(int axis = 0; axis < 3; axis++){
+    float v = expected_value(*e.dev, sensor, e.n, axis);
+    if(fabs(s.v[axis] - v) > 1e-4){
+      printf("sensor %d sample %llu axis %d: %f, expected %f\n", sensor, (unsigned long long)e.n, axis, s.v[axis], v);
+      exit(1);
+    }
+  }
+  // sample n is measured n + 1 sample periods after init at time 0
+  uint64_t period = e.dev->sample_period();
+  uint64_t measured = (e.n + 1) * period;
+  assert(s.timestamp >= measured && s.timestamp - measured < period);
+  assert(s.timestamp > e.last_timestamp);
+  e.last_timestamp = s.timestamp;
+  e.n++;
+}
+
+int main(int argc, char** argv) {
+  EmulatedI2CBus bus;
+  EmulatedBMX055 accel_dev(EmulatedBMX055::ACCEL), gyro_dev(EmulatedBMX055::GYRO);
+  bus.attach(BMX055_ACCEL_I2C_ADDR, &accel_dev);
+  bus.attach(BMX055_GYRO_I2C_ADDR, &gyro_dev);
+
+  char path[] = "/tmp/fifo_test_light_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  assert(write(fd, "123\n", 4) == 4);
+  close(fd);
+
+  BMX055_Accel accel(&bus);
+  BMX055_Gyro gyro(&bus);
+  LightSensor light(path);
+  assert(accel.init() == 0);
+  assert(gyro.init() == 0);
+  assert(light.init() == 0);
+  assert(accel_dev.sample_period() == BMX055_ACCEL_SAMPLE_PERIOD_NS);
+  assert(gyro_dev.sample_period() == BMX055_GYRO_SAMPLE_PERIOD_NS);
+
+  SensorLoop loop;
+  assert(loop.next_deadline() == UINT64_MAX);
+  loop.add(&accel, PERIOD_NS, 0);
+  loop.add(&gyro, PERIOD_NS, 0);
+  loop.add(&light, LIGHT_PERIOD_NS, 0);
+
+  Expected accel_e = {&accel_dev, 0, 0, 0}, gyro_e = {&gyro_dev, 0, 0, 0};
+  SensorSample samples[MAX_SAMPLES];
+  int light_samples = 0;
+  const uint64_t stall_start = 1000000000ULL, stall_end = 1300000000ULL, end = 2000000000ULL;
+  while(loop.next_deadline() <= end) {
+    bus.now = loop.next_deadline();
+    if(bus.now > stall_start && bus.now < stall_end) {
+      // longer than both FIFOs hold
+      bus.now = stall_end;
+    }
+    int n = loop.poll(bus.now, samples, MAX_SAMPLES);
+    assert(n >= 0);
+
+    // the samples dropped from a full FIFO are the oldest
+    accel_e.n += accel_dev.dropped - accel_e.dropped;
+    accel_e.dropped = accel_dev.dropped;
+    gyro_e.n += gyro_dev.dropped - gyro_e.dropped;
+    gyro_e.dropped = gyro_dev.dropped;
+
+    for(int i = 0; i < n; i++) {
+      const SensorSample &s = samples[i];
+      if(s.sensor == SENSOR_ACCELEROMETER) {
+        assert(s.type == SENSOR_TYPE_ACCELEROMETER);
+        check(accel_e, s.sensor, s);
+      } else if(s.sensor == SENSOR_GYRO_UNCALIBRATED) {
+        assert(s.type == SENSOR_TYPE_GYROSCOPE_UNCALIBRATED);
+        check(gyro_e, s.sensor, s);
+      } else {
+        assert(s.sensor == SENSOR_LIGHT && s.v[0] == 123 && s.timestamp == bus.now);
+        light_samples++;
+      }
+    }
+  }
+
+  // every sample measured until the last poll was read or dropped
+  assert(accel_dev.next_sample == accel_e.n && gyro_dev.next_sample == gyro_e.n);
+  assert(accel_e.n == end / BMX055_ACCEL_SAMPLE_PERIOD_NS);
+  assert(gyro_e.n == end / BMX055_GYRO_SAMPLE_PERIOD_NS);
+
+  // one overflow each, and the loop carried on at its period after the stall
+  assert(accel.overruns == 1 && gyro.overruns == 1);
+  assert(accel_e.dropped == (stall_end - stall_start) / BMX055_ACCEL_SAMPLE_PERIOD_NS - BMX055_ACCEL_FIFO_DEPTH);
+  assert(gyro_e.dropped == (stall_end - stall_start) / BMX055_GYRO_SAMPLE_PERIOD_NS - BMX055_GYRO_FIFO_DEPTH);
+  assert(loop.missed_deadlines == 2 * ((stall_end - stall_start) / PERIOD_NS - 1) + 2);
+  assert(loop.read_errors == 0);
+  assert(light_samples == (int)(end / LIGHT_PERIOD_NS) - 2);
+
+  // the SMBus block reads stop at 32 bytes, a FIFO needs I2C_RDWR
+  uint8_t buffer[BMX055_GYRO_FIFO_DEPTH * BMX055_GYRO_FRAME_SIZE];
+  assert(bus.read_register(BMX055_GYRO_I2C_ADDR, BMX055_GYRO_I2C_REG_FIFO, buffer, 33) < 0);
+  assert(bus.read_burst(BMX055_GYRO_I2C_ADDR, BMX055_GYRO_I2C_REG_FIFO, buffer, sizeof(buffer)) == sizeof(buffer));
+
+  unlink(path);
+  printf("accel %llu samples, gyro %llu samples, %d light samples\n", (unsigned long long)(accel_e.n - accel_e.dropped),
+         (unsigned long long)(gyro_e.n - gyro_e.dropped), light_samples);
+  printf("ok\n");
+  return 0;
+}
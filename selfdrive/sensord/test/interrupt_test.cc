@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/gpio.h>
+
+#include "common/timing.h"
+#include "sensors/constants.hpp"
+#include "sensors/bmx055_accel.hpp"
+#include "sensors/bmx055_gyro.hpp"
+#include "sensors/light_sensor.hpp"
+#include "sensors/sensor_loop.hpp"
+#include "sensors/emulated_i2c.hpp"
+
+// Runs the BMX055 watermark interrupts through SensorLoop with pipes as the GPIO edge fds:
+// the samples are read when an edge comes, stamped with its time, and an interrupt sensor
+// is still read after a missed edge. The light sensor stays on its timer. Also checks that
+// wait() wakes up on an edge and on a deadline, and the time a read is stamped with after a
+// late wakeup.
+//   ./interrupt_test
+
+#define ACCEL_WATERMARK 5
+#define GYRO_WATERMARK 20
+#define TIMEOUT_NS 100000000ULL
+#define LIGHT_PERIOD_NS 100000000ULL
+// from reading the sensors to publishing, in the simulation
+#define PUBLISH_NS 100000ULL
+#define MAX_SAMPLES 256
+
+struct Expected {
+  EmulatedBMX055 *dev;
+  int fd[2];
+  uint64_t n;
+  uint64_t last_timestamp;
+  int edges;
+};
+
+class NullSensor : public Sensor {
+public:
+  int reads = 0;
+  uint64_t read_at = 0;
+  uint64_t period = 0;
+  int init() { return 0; }
+  int read_samples(SensorSample *samples, int max, uint64_t now) { reads++; read_at = now; return 0; }
+  uint64_t sample_period() const { return period; }
+};
+
+static void edge(int fd){
+  struct gpioevent_data event = {};
+  struct timespec t;
+  clock_gettime(CLOCK_REALTIME, &t);
+  event.timestamp = t.tv_sec * 1000000000ULL + t.tv_nsec;
+  event.id = GPIOEVENT_EVENT_RISING_EDGE;
+  assert(write(fd, &event, sizeof(event)) == sizeof(event));
+}
+
+static void check(Expected &e, int sensor, const SensorSample &s){
+  for(int axis = 0; axis < 3; axis++){
+    float sign = axis == 2 ? 1 : -1;
+    float v = sensor == SENSOR_ACCELEROMETER ?
+      sign * (e.dev->raw_value(e.n, axis) / (1 << 4)) * 9.81 * 2.0f / (1 << 11) :
+      sign * (e.dev->raw_value(e.n, axis) * 125.0f / (1 << 15)) * M_PI / 180.0;
+    assert(fabs(s.v[axis] - v) < 1e-4);
+  }
+  // stamped with the edge, sample n is measured n + 1 sample periods after init at time 0
+  uint64_t period = e.dev->sample_period();
+  uint64_t measured = (e.n + 1) * period;
+  assert(s.timestamp >= measured && s.timestamp - measured < period);
+  assert(s.timestamp > e.last_timestamp);
+  e.last_timestamp = s.timestamp;
+  e.n++;
+}
+
+static void test_wait(){
+  SensorLoop loop;
+  NullSensor sensor;
+  int fd[2];
+  assert(pipe2(fd, O_NONBLOCK) == 0);
+  assert(loop.add_interrupt(&sensor, fd[0], TIMEOUT_NS, nanos_since_boot()) == 0);
+  assert(loop.add_interrupt(&sensor, -1, TIMEOUT_NS, 0) < 0);
+
+  // nothing ready
+  assert(loop.wait(0) == 0);
+
+  // an edge
+  edge(fd[1]);
+  uint64_t t = nanos_since_boot();
+  assert(loop.wait(1000) == 1);
+  assert(nanos_since_boot() - t < 500000000ULL);
+  assert(loop.poll(nanos_since_boot(), NULL, 0) == 0);
+  assert(sensor.reads == 1 && loop.interrupts == 1);
+
+  // the timeout of the interrupt sensor, on the timer
+  t = nanos_since_boot();
+  assert(loop.wait(1000) == 1);
+  uint64_t now = nanos_since_boot();
+  assert(now >= loop.next_deadline() && now - t >= TIMEOUT_NS - 1000000ULL && now - t < 500000000ULL);
+  loop.poll(now, NULL, 0);
+  assert(sensor.reads == 2 && loop.interrupt_timeouts == 1);
+
+  close(fd[0]);
+  close(fd[1]);
+}
+
+static void test_late_wakeup(){
+  SensorLoop loop;
+  NullSensor sensor;
+  sensor.period = 10000000ULL;
+  int fd[2];
+  assert(pipe2(fd, O_NONBLOCK) == 0);
+  assert(loop.add_interrupt(&sensor, fd[0], TIMEOUT_NS, nanos_since_boot()) == 0);
+
+  // two edges before the read, the newest sample came with the last one
+  uint64_t first = nanos_since_boot();
+  edge(fd[1]);
+  usleep(20000);
+  uint64_t last = nanos_since_boot();
+  edge(fd[1]);
+  uint64_t now = nanos_since_boot();
+  loop.poll(now, NULL, 0);
+  assert(sensor.read_at >= last - 1000000ULL && sensor.read_at <= now);
+  assert(loop.interrupts == 2);
+  // latency from the first
+  loop.published(now);
+  assert(loop.latency.max_ns >= now - last + 15000000ULL && now - first + 1000000ULL >= loop.latency.max_ns);
+
+  // read more than a sample period after the edge, the sensor measured more since
+  edge(fd[1]);
+  usleep(20000);
+  now = nanos_since_boot();
+  loop.poll(now, NULL, 0);
+  assert(sensor.read_at == now);
+
+  close(fd[0]);
+  close(fd[1]);
+}
+
+int main(int argc, char** argv) {
+  test_wait();
+  test_late_wakeup();
+
+  EmulatedI2CBus bus;
+  EmulatedBMX055 accel_dev(EmulatedBMX055::ACCEL), gyro_dev(EmulatedBMX055::GYRO);
+  bus.attach(BMX055_ACCEL_I2C_ADDR, &accel_dev);
+  bus.attach(BMX055_GYRO_I2C_ADDR, &gyro_dev);
+
+  char path[] = "/tmp/interrupt_test_light_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  assert(write(fd, "7\n", 2) == 2);
+  close(fd);
+
+  BMX055_Accel accel(&bus);
+  BMX055_Gyro gyro(&bus);
+  LightSensor light(path);
+  assert(accel.init() == 0 && gyro.init() == 0 && light.init() == 0);
+  assert(accel_dev.next_interrupt() == UINT64_MAX && gyro_dev.next_interrupt() == UINT64_MAX);
+  assert(accel.enable_interrupt(BMX055_ACCEL_FIFO_DEPTH + 1) < 0);
+  assert(accel.enable_interrupt(ACCEL_WATERMARK) == 0);
+  assert(gyro.enable_interrupt(GYRO_WATERMARK) == 0);
+  assert(accel_dev.next_interrupt() == ACCEL_WATERMARK * BMX055_ACCEL_SAMPLE_PERIOD_NS);
+  assert(gyro_dev.next_interrupt() == GYRO_WATERMARK * BMX055_GYRO_SAMPLE_PERIOD_NS);
+
+  Expected accel_e = {&accel_dev}, gyro_e = {&gyro_dev};
+  assert(pipe2(accel_e.fd, O_NONBLOCK) == 0 && pipe2(gyro_e.fd, O_NONBLOCK) == 0);
+
+  SensorLoop loop;
+  assert(loop.add_interrupt(&accel, accel_e.fd[0], TIMEOUT_NS, 0) == 0);
+  assert(loop.add_interrupt(&gyro, gyro_e.fd[0], TIMEOUT_NS, 0) == 0);
+  loop.add(&light, LIGHT_PERIOD_NS, 0);
+
+  SensorSample samples[MAX_SAMPLES];
+  int light_samples = 0, polls_with_edges = 0;
+  bool missed = false;
+  const uint64_t miss_at = 1000000000ULL, end = 2000000000ULL;
+  while(true) {
+    // the next edge or deadline. An interrupt time before now is a line that is still high
+    uint64_t t = loop.next_deadline();
+    for(Expected *e : {&accel_e, &gyro_e}) {
+      uint64_t irq = e->dev->next_interrupt();
+      if(irq > bus.now && irq < t) t = irq;
+    }
+    if(t > end) break;
+    bus.now = t;
+
+    bool edges = false;
+    for(Expected *e : {&accel_e, &gyro_e}) {
+      if(e->dev->next_interrupt() != t) continue;
+      if(e == &accel_e && t >= miss_at && !missed) {
+        // the edge is lost, the timeout reads the accelerometer
+        missed = true;
+        continue;
+      }
+      edge(e->fd[1]);
+      e->edges++;
+      edges = true;
+    }
+
+    int n = loop.poll(bus.now, samples, MAX_SAMPLES);
+    for(int i = 0; i < n; i++) {
+      const SensorSample &s = samples[i];
+      if(s.sensor == SENSOR_ACCELEROMETER) {
+        check(accel_e, s.sensor, s);
+      } else if(s.sensor == SENSOR_GYRO_UNCALIBRATED) {
+        check(gyro_e, s.sensor, s);
+      } else {
+        assert(s.sensor == SENSOR_LIGHT && s.v[0] == 7 && s.timestamp == bus.now);
+        light_samples++;
+      }
+    }
+    loop.published(bus.now + PUBLISH_NS);
+    polls_with_edges += edges;
+  }
+
+  // nothing dropped, all but the samples since the last edge were read
+  assert(accel_dev.dropped == 0 && gyro_dev.dropped == 0);
+  assert(accel_e.n == accel_dev.next_sample && gyro_e.n == gyro_dev.next_sample);
+  assert(accel_e.n >= end / BMX055_ACCEL_SAMPLE_PERIOD_NS - ACCEL_WATERMARK);
+  assert(gyro_e.n == end / BMX055_GYRO_SAMPLE_PERIOD_NS);
+  assert(accel.overruns == 0 && gyro.overruns == 0);
+
+  assert(missed && loop.interrupt_timeouts == 1);
+  assert(loop.interrupts == (uint64_t)(accel_e.edges + gyro_e.edges));
+  assert(loop.latency.count == (uint64_t)polls_with_edges);
+  assert(loop.latency.max_ns == PUBLISH_NS && loop.latency.total_ns == polls_with_edges * PUBLISH_NS);
+  assert(loop.missed_deadlines == 0 && loop.read_errors == 0);
+  assert(light_samples == (int)(end / LIGHT_PERIOD_NS));
+
+  unlink(path);
+  printf("accel %d edges, gyro %d edges, %llu timeouts, %d light samples\n", accel_e.edges, gyro_e.edges,
+         (unsigned long long)loop.interrupt_timeouts, light_samples);
+  printf("ok\n");
+  return 0;
+}
@@ -31,7 +31,7 @@ static void enable_event_processing(bool yes) {
 static void set_awake(UIState *s, bool awake) {
   if (awake) {
     // 30 second timeout
-    s->awake_timeout = 30*UI_FREQ;
+    s->awake_until = millis_since_boot() + 30e3;
   }
   if (s->awake != awake) {
     s->awake = awake;
@@ -74,13 +74,11 @@ static void handle_sidebar_touch(UIState *s, int touch_x, int touch_y) {
 }
 
 static void update_offroad_layout_state(UIState *s, PubMaster *pm) {
-  static int timeout = 0;
+  static double last_sent = 0;
   static bool prev_collapsed = false;
   static cereal::UiLayoutState::App prev_app = cereal::UiLayoutState::App::NONE;
-  if (timeout > 0) {
-    timeout--;
-  }
-  if (prev_collapsed != s->scene.uilayout_sidebarcollapsed || prev_app != s->active_app || timeout == 0) {
+  const double now = millis_since_boot();
+  if (prev_collapsed != s->scene.uilayout_sidebarcollapsed || prev_app != s->active_app || (now - last_sent) > 2e3) {
     MessageBuilder msg;
     auto layout = msg.initEvent().initUiLayoutState();
     layout.setActiveApp(s->active_app);
@@ -89,7 +87,7 @@ static void update_offroad_layout_state(UIState *s, PubMaster *pm) {
     LOGD("setting active app to %d with sidebar %d", (int)s->active_app, s->scene.uilayout_sidebarcollapsed);
     prev_collapsed = s->scene.uilayout_sidebarcollapsed;
     prev_app = s->active_app;
-    timeout = 2 * UI_FREQ;
+    last_sent = now;
   }
 }
 
@@ -128,14 +126,14 @@ int main(int argc, char* argv[]) {
   const int MIN_VOLUME = LEON ? 12 : 9;
   const int MAX_VOLUME = LEON ? 15 : 12;
 
+  bool first_frame = true;
   while (!do_exit) {
     if (!s->started || !s->vision_connected) {
       // Delay a while to avoid 9% cpu usage while car is not started and user is keeping touching on the screen.
       usleep(30 * 1000);
     }
-    double u1 = millis_since_boot();
 
-    ui_update(s);
+    const bool changed = ui_update(s);
 
     // poll for touch events
     int touch_x = -1, touch_y = -1;
@@ -151,9 +149,7 @@ int main(int argc, char* argv[]) {
       set_awake(s, true);
     }
 
-    if (s->awake_timeout > 0) {
-      s->awake_timeout--;
-    } else {
+    if (millis_since_boot() > s->awake_until) {
       set_awake(s, false);
     }
 
@@ -166,18 +162,23 @@ int main(int argc, char* argv[]) {
 
     update_offroad_layout_state(s, pm);
 
-    ui_draw(s);
-    double u2 = millis_since_boot();
-    if (!s->scene.frontview && (u2-u1 > 66)) {
-      // warn on sub 15fps
-      LOGW("slow frame(%llu) time: %.2f", (s->sm)->frame, u2-u1);
+    // only draw when there is something new, the vision poll already waited for a frame
+    if (!changed && touched != 1 && !first_frame) {
+      if (!s->vision_connected) {
+        ui_wait(s, 1000 / UI_FREQ);
+      }
+      continue;
     }
+
+    ui_draw(s);
     framebuffer_swap(s->fb);
+    ui_frame_drawn(s);
+    first_frame = false;
   }
 
   set_awake(s, true);
 
-  delete s->sm;
+  delete s->ingest;
   delete pm;
   return 0;
 }
@@ -0,0 +1,81 @@
+#include <assert.h>
+#include <string.h>
+
+#include "common/timing.h"
+#include "draw_stats.hpp"
+
+// from EXT_disjoint_timer_query and ARB_timer_query, the same value
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+
+const char *draw_stage_names[DRAW_STAGE_COUNT] = {
+  "background", "sidebar", "frame", "world", "hud", "alert", "flush",
+};
+
+static bool has_timer_query() {
+  GLint n = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+  for (int i = 0; i < n; i++) {
+    const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+    if (strcmp(ext, "GL_EXT_disjoint_timer_query") == 0 || strcmp(ext, "GL_ARB_timer_query") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void draw_stats_init(DrawStats *st) {
+  memset(st, 0, sizeof(*st));
+  st->stage = -1;
+  st->gpu_timing = has_timer_query();
+  if (st->gpu_timing) {
+    glGenQueries(DRAW_STAGE_COUNT, st->queries);
+  }
+}
+
+void draw_stats_destroy(DrawStats *st) {
+  if (st->gpu_timing) {
+    glDeleteQueries(DRAW_STAGE_COUNT, st->queries);
+  }
+}
+
+void draw_stats_reset(DrawStats *st) {
+  st->frames = 0;
+  memset(st->cpu_ms, 0, sizeof(st->cpu_ms));
+  memset(st->gpu_ms, 0, sizeof(st->gpu_ms));
+}
+
+void draw_stats_begin(DrawStats *st, DrawStage stage) {
+  // stages don't nest, a single timer query can be active
+  assert(st->stage < 0);
+  st->stage = stage;
+  if (st->gpu_timing) {
+    glBeginQuery(GL_TIME_ELAPSED_EXT, st->queries[stage]);
+    st->queried[stage] = true;
+  }
+  st->stage_start = millis_since_boot();
+}
+
+void draw_stats_end(DrawStats *st) {
+  assert(st->stage >= 0);
+  st->cpu_ms[st->stage] += millis_since_boot() - st->stage_start;
+  if (st->gpu_timing) {
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+  }
+  st->stage = -1;
+}
+
+void draw_stats_frame_done(DrawStats *st) {
+  st->frames++;
+  if (!st->gpu_timing) return;
+
+  for (int i = 0; i < DRAW_STAGE_COUNT; i++) {
+    if (!st->queried[i]) continue;
+    // blocks until the GPU is done with the stage
+    GLuint ns = 0;
+    glGetQueryObjectuiv(st->queries[i], GL_QUERY_RESULT, &ns);
+    st->gpu_ms[i] += ns * 1e-6;
+    st->queried[i] = false;
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GLES3/gl3.h>
+#endif
+
+// Per stage frame times of ui_draw. Only set up by the headless renderer in test/render,
+// UIState.draw_stats is NULL otherwise and the marks in paint.cc do nothing.
+// nanovg records paths and issues the GL calls for all of them in nvgEndFrame, so the
+// GPU time of the nanovg stages shows up under DRAW_STAGE_FLUSH.
+
+typedef enum DrawStage {
+  DRAW_STAGE_BACKGROUND,
+  DRAW_STAGE_SIDEBAR,
+  DRAW_STAGE_FRAME,
+  DRAW_STAGE_WORLD,
+  DRAW_STAGE_HUD,
+  DRAW_STAGE_ALERT,
+  DRAW_STAGE_FLUSH,
+  DRAW_STAGE_COUNT,
+} DrawStage;
+
+extern const char *draw_stage_names[DRAW_STAGE_COUNT];
+
+typedef struct DrawStats {
+  // totals over all frames since draw_stats_reset
+  int frames;
+  double cpu_ms[DRAW_STAGE_COUNT];
+  double gpu_ms[DRAW_STAGE_COUNT];
+
+  // timer queries, if the driver has them
+  bool gpu_timing;
+  GLuint queries[DRAW_STAGE_COUNT];
+  bool queried[DRAW_STAGE_COUNT];
+
+  int stage;
+  double stage_start;
+} DrawStats;
+
+void draw_stats_init(DrawStats *st);
+void draw_stats_destroy(DrawStats *st);
+void draw_stats_reset(DrawStats *st);
+void draw_stats_begin(DrawStats *st, DrawStage stage);
+void draw_stats_end(DrawStats *st);
+// waits for the timer queries of the frame and adds them up
+void draw_stats_frame_done(DrawStats *st);
+
+static inline void draw_stage_begin(DrawStats *st, DrawStage stage) {
+  if (st) draw_stats_begin(st, stage);
+}
+
+static inline void draw_stage_end(DrawStats *st) {
+  if (st) draw_stats_end(st);
+}
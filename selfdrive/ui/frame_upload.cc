@@ -0,0 +1,95 @@
+#include <assert.h>
+#include <string.h>
+
+#include "frame_upload.hpp"
+
+static GLuint create_texture(GLenum internal_format, GLenum format, int width, int height) {
+  GLuint tex = 0;
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, GL_UNSIGNED_BYTE, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  return tex;
+}
+
+void frame_upload_init(FrameUpload *u, FrameFormat format, int width, int height, int stride) {
+  memset(u, 0, sizeof(*u));
+  u->format = format;
+  u->width = width;
+  u->height = height;
+  u->stride = stride;
+
+  if (format == FRAME_FORMAT_BGR) {
+    u->size = (size_t)stride * height;
+    u->texs[0] = create_texture(GL_RGB8, GL_RGB, width, height);
+    // BGR
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    u->num_texs = 1;
+  } else {
+    u->size = (size_t)stride * height * 3 / 2;
+    u->texs[0] = create_texture(GL_R8, GL_RED, width, height);
+    u->texs[1] = create_texture(GL_R8, GL_RED, width / 2, height / 2);
+    u->texs[2] = create_texture(GL_R8, GL_RED, width / 2, height / 2);
+    u->num_texs = 3;
+  }
+
+  glGenBuffers(FRAME_UPLOAD_PBOS, u->pbos);
+  for (int i = 0; i < FRAME_UPLOAD_PBOS; i++) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, u->pbos[i]);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, u->size, NULL, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  assert(glGetError() == GL_NO_ERROR);
+}
+
+void frame_upload_destroy(FrameUpload *u) {
+  if (u->num_texs == 0) return;
+  glDeleteTextures(u->num_texs, u->texs);
+  glDeleteBuffers(FRAME_UPLOAD_PBOS, u->pbos);
+  memset(u, 0, sizeof(*u));
+}
+
+static void upload_plane(GLuint tex, int width, int height, int row_length, GLenum format, size_t offset) {
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, (const void *)offset);
+}
+
+void frame_upload(FrameUpload *u, const void *frame) {
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, u->pbos[u->pbo_idx]);
+  u->pbo_idx = (u->pbo_idx + 1) % FRAME_UPLOAD_PBOS;
+
+  // invalidating lets the driver hand out fresh storage instead of waiting on the last read
+  void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, u->size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  assert(dst);
+  memcpy(dst, frame, u->size);
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+  // the offsets are into the bound buffer, the copy to the textures happens asynchronously
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (u->format == FRAME_FORMAT_BGR) {
+    upload_plane(u->texs[0], u->width, u->height, u->stride / 3, GL_RGB, 0);
+  } else {
+    const size_t y_size = (size_t)u->stride * u->height;
+    upload_plane(u->texs[0], u->width, u->height, u->stride, GL_RED, 0);
+    upload_plane(u->texs[1], u->width / 2, u->height / 2, u->stride / 2, GL_RED, y_size);
+    upload_plane(u->texs[2], u->width / 2, u->height / 2, u->stride / 2, GL_RED, y_size + y_size / 4);
+  }
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void frame_upload_bind(const FrameUpload *u) {
+  for (int i = 0; i < u->num_texs; i++) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, u->texs[i]);
+  }
+  glActiveTexture(GL_TEXTURE0);
+}
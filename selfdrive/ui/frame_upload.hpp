@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "common/glutil.h"
+
+// Streams camera frames into textures where they aren't shared with the GPU through
+// ion (everywhere but QCOM). The texture storage is allocated once, and each new frame
+// goes through the next of a ring of pixel buffers so the copy to the texture doesn't
+// stall on the previous one.
+
+#define FRAME_UPLOAD_PBOS 3
+
+typedef enum FrameFormat {
+  // packed BGR, as the RGB vision streams are
+  FRAME_FORMAT_BGR,
+  // planar I420, as the YUV vision streams are. half the bytes, converted in the shader
+  FRAME_FORMAT_YUV420,
+} FrameFormat;
+
+typedef struct FrameUpload {
+  FrameFormat format;
+  int width, height, stride;
+  size_t size;
+  // BGR: one texture. YUV: the Y, U and V planes
+  GLuint texs[3];
+  int num_texs;
+  GLuint pbos[FRAME_UPLOAD_PBOS];
+  int pbo_idx;
+} FrameUpload;
+
+void frame_upload_init(FrameUpload *u, FrameFormat format, int width, int height, int stride);
+void frame_upload_destroy(FrameUpload *u);
+
+// copies the frame into the next pixel buffer and starts the transfer to the textures.
+// only call it for new frames, the textures keep the last one
+void frame_upload(FrameUpload *u, const void *frame);
+
+// binds the textures to units 0, 1 and 2
+void frame_upload_bind(const FrameUpload *u);
@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "geometry.hpp"
+
+// the compiler's vector extensions, SSE on x86 and NEON on arm
+typedef float f32x4 __attribute__((vector_size(16)));
+
+static inline f32x4 splat(float v) {
+  return (f32x4){v, v, v, v};
+}
+
+static inline f32x4 load4(const float *src, int n) {
+  f32x4 v = splat(0.f);
+  memcpy(&v, src, n * sizeof(float));
+  return v;
+}
+
+static inline void store4(float *dst, f32x4 v, int n) {
+  memcpy(dst, &v, n * sizeof(float));
+}
+
+void projection_init(FrameProjection *p, const mat3 &intrinsic, const mat4 &extrinsic) {
+  // the last row of the extrinsics is zero, the points have z = 0 and w = 1
+  const int cols[3] = {0, 1, 3};
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      float v = 0.0;
+      for (int k = 0; k < 3; k++) {
+        v += intrinsic.v[r*3 + k] * extrinsic.v[k*4 + cols[c]];
+      }
+      p->h[r*3 + c] = v;
+    }
+  }
+}
+
+void poly_eval_points(const float *poly, float *out, int n) {
+  const f32x4 p0 = splat(poly[0]), p1 = splat(poly[1]), p2 = splat(poly[2]), p3 = splat(poly[3]);
+  f32x4 x = {0.f, 1.f, 2.f, 3.f};
+  for (int i = 0; i < n; i += 4) {
+    const f32x4 y = ((p0 * x + p1) * x + p2) * x + p3;
+    store4(&out[i], y, n - i < 4 ? n - i : 4);
+    x += splat(4.f);
+  }
+}
+
+void project_points(const FrameProjection *p, const float *x, const float *y, float *u, float *v, int n) {
+  const float *h = p->h;
+  for (int i = 0; i < n; i += 4) {
+    const int len = n - i < 4 ? n - i : 4;
+    const f32x4 px = load4(&x[i], len);
+    const f32x4 py = load4(&y[i], len);
+    const f32x4 a = splat(h[0]) * px + splat(h[1]) * py + splat(h[2]);
+    const f32x4 b = splat(h[3]) * px + splat(h[4]) * py + splat(h[5]);
+    const f32x4 w = splat(h[6]) * px + splat(h[7]) * py + splat(h[8]);
+    store4(&u[i], a / w, len);
+    store4(&v[i], b / w, len);
+  }
+}
+
+int clip_vertices(const float *u, const float *v, int n, float max_x, float max_y, vertex_data *out) {
+  int cnt = 0;
+  for (int i = 0; i < n; i++) {
+    // branchless, the write is always done and kept when in the frame
+    out[cnt].x = u[i];
+    out[cnt].y = v[i];
+    cnt += (u[i] >= 0 && u[i] <= max_x && v[i] >= 0 && v[i] <= max_y);
+  }
+  return cnt;
+}
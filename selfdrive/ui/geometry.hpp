@@ -0,0 +1,27 @@
+#pragma once
+
+#include "common/mat.h"
+
+// Batched geometry of the drawn path and lanes: the model polynomials are evaluated
+// and car space points on the road are projected to full frame image space four at a time.
+
+typedef struct vertex_data {
+  float x, y;
+} vertex_data;
+
+typedef struct FrameProjection {
+  // intrinsics * extrinsics with the z column dropped, maps (x, y, 1) of a point on the
+  // road to homogeneous image coordinates
+  float h[3*3];
+} FrameProjection;
+
+void projection_init(FrameProjection *p, const mat3 &intrinsic, const mat4 &extrinsic);
+
+// out[i] = poly[0]*i^3 + poly[1]*i^2 + poly[2]*i + poly[3] for i in [0, n)
+void poly_eval_points(const float *poly, float *out, int n);
+
+// (u[i], v[i]) is where (x[i], y[i], 0) in car space lands in the full frame
+void project_points(const FrameProjection *p, const float *x, const float *y, float *u, float *v, int n);
+
+// copies the points within [0, max_x] x [0, max_y] to out in order, returns how many
+int clip_vertices(const float *u, const float *v, int n, float max_x, float max_y, vertex_data *out);
@@ -0,0 +1,158 @@
+#include <math.h>
+#include <signal.h>
+
+#include "common/timing.h"
+#include "ui.hpp"
+#include "ingest.hpp"
+
+extern volatile sig_atomic_t do_exit;
+
+// in UIService order
+static const char *service_names[UI_SERVICE_COUNT] = {
+  "model", "controlsState", "uiLayoutState", "liveCalibration", "radarState", "thermal",
+  "health", "carParams", "ubloxGnss", "driverState", "dMonitoringState",
+};
+
+static void fill_path(PathSnapshot *p, const cereal::ModelData::PathData::Reader &path) {
+  const capnp::List<float>::Reader &poly = path.getPoly();
+  const float coeffs[POLYFIT_DEGREE] = {poly[0], poly[1], poly[2], poly[3]};
+  p->valid_len = path.getValidLen();
+  p->prob = path.getProb();
+  p->std = path.getStd();
+  poly_eval_points(coeffs, p->points, fmin(MODEL_PATH_DISTANCE, ceil(p->valid_len)));
+}
+
+static void fill_lead(LeadSnapshot *l, const cereal::RadarState::LeadData::Reader &lead) {
+  l->status = lead.getStatus();
+  l->d_rel = lead.getDRel();
+  l->y_rel = lead.getYRel();
+  l->v_rel = lead.getVRel();
+}
+
+static void decode(UISnapshot *snap, SubMaster &sm, UIService service) {
+  auto event = sm[service_names[service]];
+  switch (service) {
+  case UI_SERVICE_MODEL: {
+    auto model = event.getModel();
+    fill_path(&snap->model.path, model.getPath());
+    fill_path(&snap->model.left_lane, model.getLeftLane());
+    fill_path(&snap->model.right_lane, model.getRightLane());
+    break;
+  }
+  case UI_SERVICE_CONTROLS_STATE: {
+    auto cs = event.getControlsState();
+    ControlsSnapshot &c = snap->controls_state;
+    c.enabled = cs.getEnabled();
+    c.engageable = cs.getEngageable();
+    c.decel_for_model = cs.getDecelForModel();
+    c.v_ego = cs.getVEgo();
+    c.v_cruise = cs.getVCruise();
+    c.alert_text1 = cs.getAlertText1();
+    c.alert_text2 = cs.getAlertText2();
+    c.alert_type = cs.getAlertType();
+    c.alert_size = cs.getAlertSize();
+    c.alert_status = cs.getAlertStatus();
+    c.alert_sound = cs.getAlertSound();
+    c.alert_blinking_rate = cs.getAlertBlinkingRate();
+    break;
+  }
+  case UI_SERVICE_UI_LAYOUT_STATE: {
+    auto data = event.getUiLayoutState();
+    snap->active_app = data.getActiveApp();
+    snap->sidebar_collapsed = data.getSidebarCollapsed();
+    break;
+  }
+  case UI_SERVICE_LIVE_CALIBRATION: {
+    auto extrinsicl = event.getLiveCalibration().getExtrinsicMatrix();
+    for (int i = 0; i < 3 * 4; i++) {
+      snap->extrinsic_matrix.v[i] = extrinsicl[i];
+    }
+    projection_init(&snap->projection, intrinsic_matrix, snap->extrinsic_matrix);
+    break;
+  }
+  case UI_SERVICE_RADAR_STATE: {
+    auto data = event.getRadarState();
+    fill_lead(&snap->lead_data[0], data.getLeadOne());
+    fill_lead(&snap->lead_data[1], data.getLeadTwo());
+    break;
+  }
+  case UI_SERVICE_THERMAL: {
+    auto thermal = event.getThermal();
+    ThermalSnapshot &t = snap->thermal;
+    t.started = thermal.getStarted();
+    t.network_type = thermal.getNetworkType();
+    t.network_strength = thermal.getNetworkStrength();
+    t.battery_charging = thermal.getBatteryStatus() == "Charging";
+    t.battery_percent = thermal.getBatteryPercent();
+    t.ambient = thermal.getAmbient();
+    t.thermal_status = thermal.getThermalStatus();
+    break;
+  }
+  case UI_SERVICE_HEALTH: {
+    auto health = event.getHealth();
+    snap->hw_type = health.getHwType();
+    snap->ignition = health.getIgnitionLine() || health.getIgnitionCan();
+    break;
+  }
+  case UI_SERVICE_CAR_PARAMS:
+    snap->longitudinal_control = event.getCarParams().getOpenpilotLongitudinalControl();
+    break;
+  case UI_SERVICE_UBLOX_GNSS: {
+    auto data = event.getUbloxGnss();
+    if (data.which() == cereal::UbloxGnss::MEASUREMENT_REPORT) {
+      snap->satellite_count = data.getMeasurementReport().getNumMeas();
+    }
+    break;
+  }
+  case UI_SERVICE_DRIVER_STATE: {
+    auto fxy_list = event.getDriverState().getFacePosition();
+    snap->driver_state.face_position[0] = fxy_list[0];
+    snap->driver_state.face_position[1] = fxy_list[1];
+    break;
+  }
+  case UI_SERVICE_DMONITORING_STATE: {
+    auto data = event.getDMonitoringState();
+    snap->dmonitoring_state.face_detected = data.getFaceDetected();
+    snap->dmonitoring_state.is_rhd = data.getIsRHD();
+    snap->dmonitoring_state.is_preview = data.getIsPreview();
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+UIIngest::UIIngest() : exit(false) {
+  thread = std::thread(&UIIngest::run, this);
+}
+
+UIIngest::~UIIngest() {
+  exit = true;
+  thread.join();
+}
+
+void UIIngest::run() {
+  SubMaster sm({"model", "controlsState", "uiLayoutState", "liveCalibration", "radarState", "thermal",
+                "health", "carParams", "ubloxGnss", "driverState", "dMonitoringState"});
+
+  // accumulates every message, a copy is published after each batch
+  UISnapshot *snap = new UISnapshot();
+  snap->satellite_count = -1;
+
+  while (!do_exit && !exit) {
+    // wakes up now and then to see exit
+    if (sm.update(1000 / UI_FREQ) == 0) continue;
+
+    const uint64_t now = nanos_since_boot();
+    for (int i = 0; i < UI_SERVICE_COUNT; i++) {
+      if (!sm.updated(service_names[i])) continue;
+      decode(snap, sm, (UIService)i);
+      snap->rcv_count[i]++;
+      snap->rcv_time[i] = now;
+    }
+    snap->publish_time = now;
+    snapshots.back() = *snap;
+    snapshots.publish();
+  }
+  delete snap;
+}
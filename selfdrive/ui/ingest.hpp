@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "messaging.hpp"
+#include "common/mat.h"
+#include "common/modeldata.h"
+#include "geometry.hpp"
+#include "snapshot_buffer.hpp"
+
+// The messages the UI draws from are received and decoded on their own thread into plain
+// structs, so nothing the renderer reads aliases a message buffer and a burst of messages
+// doesn't hold up a draw.
+
+typedef enum UIService {
+  UI_SERVICE_MODEL,
+  UI_SERVICE_CONTROLS_STATE,
+  UI_SERVICE_UI_LAYOUT_STATE,
+  UI_SERVICE_LIVE_CALIBRATION,
+  UI_SERVICE_RADAR_STATE,
+  UI_SERVICE_THERMAL,
+  UI_SERVICE_HEALTH,
+  UI_SERVICE_CAR_PARAMS,
+  UI_SERVICE_UBLOX_GNSS,
+  UI_SERVICE_DRIVER_STATE,
+  UI_SERVICE_DMONITORING_STATE,
+  UI_SERVICE_COUNT,
+} UIService;
+
+typedef struct LeadSnapshot {
+  bool status;
+  float d_rel, y_rel, v_rel;
+} LeadSnapshot;
+
+typedef struct PathSnapshot {
+  // the poly evaluated at every meter up to valid_len
+  float points[MODEL_PATH_DISTANCE];
+  float valid_len, prob, std;
+} PathSnapshot;
+
+typedef struct ModelSnapshot {
+  PathSnapshot path, left_lane, right_lane;
+} ModelSnapshot;
+
+typedef struct ControlsSnapshot {
+  bool enabled, engageable, decel_for_model;
+  float v_ego, v_cruise;
+  std::string alert_text1, alert_text2, alert_type;
+  cereal::ControlsState::AlertSize alert_size;
+  cereal::ControlsState::AlertStatus alert_status;
+  AudibleAlert alert_sound;
+  float alert_blinking_rate;
+} ControlsSnapshot;
+
+typedef struct ThermalSnapshot {
+  bool started;
+  cereal::ThermalData::NetworkType network_type;
+  cereal::ThermalData::NetworkStrength network_strength;
+  bool battery_charging;
+  int battery_percent;
+  float ambient;
+  cereal::ThermalData::ThermalStatus thermal_status;
+} ThermalSnapshot;
+
+typedef struct DriverSnapshot {
+  float face_position[2];
+} DriverSnapshot;
+
+typedef struct DMonitoringSnapshot {
+  bool face_detected, is_rhd, is_preview;
+} DMonitoringSnapshot;
+
+typedef struct UISnapshot {
+  // per service, how many messages were folded in and when the last one came.
+  // a changed count means its fields below were updated
+  uint64_t rcv_count[UI_SERVICE_COUNT];
+  uint64_t rcv_time[UI_SERVICE_COUNT];
+  // nanos_since_boot when it was published
+  uint64_t publish_time;
+
+  ModelSnapshot model;
+  ControlsSnapshot controls_state;
+  cereal::UiLayoutState::App active_app;
+  bool sidebar_collapsed;
+  mat4 extrinsic_matrix;
+  FrameProjection projection;
+  LeadSnapshot lead_data[2];
+  ThermalSnapshot thermal;
+  cereal::HealthData::HwType hw_type;
+  bool ignition;
+  bool longitudinal_control;
+  int satellite_count;
+  DriverSnapshot driver_state;
+  DMonitoringSnapshot dmonitoring_state;
+} UISnapshot;
+
+class UIIngest {
+public:
+  UIIngest();
+  // stops and joins the thread
+  ~UIIngest();
+
+  SnapshotBuffer<UISnapshot> snapshots;
+
+private:
+  void run();
+
+  std::atomic<bool> exit;
+  std::thread thread;
+};
@@ -16,13 +16,6 @@ extern "C"{
 #include "paint.hpp"
 #include "sidebar.hpp"
 
-// TODO: this is also hardcoded in common/transformations/camera.py
-const mat3 intrinsic_matrix = (mat3){{
-  910., 0., 582.,
-  0., 910., 437.,
-  0.,   0.,   1.
-}};
-
 const uint8_t alert_colors[][4] = {
   [STATUS_OFFROAD] = {0x07, 0x23, 0x39, 0xf1},
   [STATUS_DISENGAGED] = {0x17, 0x33, 0x49, 0xc8},
@@ -113,13 +106,13 @@ static void ui_draw_circle_image(NVGcontext *vg, float x, float y, int size, int
   ui_draw_circle_image(vg, x, y, size, image, nvgRGBA(0, 0, 0, (255 * bg_alpha)), img_alpha);
 }
 
-static void draw_lead(UIState *s, const cereal::RadarState::LeadData::Reader &lead){
+static void draw_lead(UIState *s, const LeadSnapshot &lead){
   // Draw lead car indicator
   float fillAlpha = 0;
   float speedBuff = 10.;
   float leadBuff = 40.;
-  float d_rel = lead.getDRel();
-  float v_rel = lead.getVRel();
+  float d_rel = lead.d_rel;
+  float v_rel = lead.v_rel;
   if (d_rel < leadBuff) {
     fillAlpha = 255*(1.0-(d_rel/leadBuff));
     if (v_rel < 0) {
@@ -127,7 +120,7 @@ static void draw_lead(UIState *s, const cereal::RadarState::LeadData::Reader &le
     }
     fillAlpha = (int)(fmin(fillAlpha, 255));
   }
-  draw_chevron(s, d_rel, lead.getYRel(), 25, nvgRGBA(201, 34, 49, fillAlpha), COLOR_YELLOW);
+  draw_chevron(s, d_rel, lead.y_rel, 25, nvgRGBA(201, 34, 49, fillAlpha), COLOR_YELLOW);
 }
 
 static void ui_draw_lane_line(UIState *s, const model_path_vertices_data *pvd, NVGcolor color) {
@@ -145,59 +138,39 @@ static void ui_draw_lane_line(UIState *s, const model_path_vertices_data *pvd, N
 
 static void update_track_data(UIState *s, bool is_mpc, track_vertices_data *pvd) {
   const UIScene *scene = &s->scene;
-  const float *points = scene->path_points;
+  const float *points = scene->model.path.points;
   const float *mpc_x_coords = &scene->mpc_x[0];
   const float *mpc_y_coords = &scene->mpc_y[0];
 
   float off = is_mpc?0.3:0.5;
-  float lead_d = scene->lead_data[0].getDRel()*2.;
+  float lead_d = scene->lead_data[0].d_rel*2.;
   float path_height = is_mpc?(lead_d>5.)?fmin(lead_d, 25.)-fmin(lead_d*0.35, 10.):20.
                             :(lead_d>0.)?fmin(lead_d, 50.)-fmin(lead_d*0.35, 10.):49.;
-  path_height = fmin(path_height, scene->model.getPath().getValidLen());
+  path_height = fmin(path_height, scene->model.path.valid_len);
+  const int n = path_height + 1;
   pvd->cnt = 0;
-  // left side up
-  for (int i=0; i<=path_height; i++) {
-    float px, py, mpx;
-    if (is_mpc) {
-      mpx = i==0?0.0:mpc_x_coords[i];
-      px = lerp(mpx+1.0, mpx, i/100.0);
-      py = mpc_y_coords[i] - off;
-    } else {
-      px = lerp(i+1.0, i, i/100.0);
-      py = points[i] - off;
-    }
-
-    vec4 p_car_space = (vec4){{px, py, 0., 1.}};
-    vec3 p_full_frame = car_space_to_full_frame(s, p_car_space);
-    if (p_full_frame.v[0] < 0. || p_full_frame.v[1] < 0.) {
-      continue;
-    }
-    pvd->v[pvd->cnt].x = p_full_frame.v[0];
-    pvd->v[pvd->cnt].y = p_full_frame.v[1];
-    pvd->cnt += 1;
-  }
+  if (n <= 0) return;
 
-  // right side down
-  for (int i=path_height; i>=0; i--) {
-    float px, py, mpx;
+  // left side up then right side down, projected together
+  float x[TRACK_POINTS_MAX_CNT], y[TRACK_POINTS_MAX_CNT];
+  for (int i = 0; i < n; i++) {
+    float px, py;
     if (is_mpc) {
-      mpx = i==0?0.0:mpc_x_coords[i];
+      float mpx = i==0?0.0:mpc_x_coords[i];
       px = lerp(mpx+1.0, mpx, i/100.0);
-      py = mpc_y_coords[i] + off;
+      py = mpc_y_coords[i];
     } else {
       px = lerp(i+1.0, i, i/100.0);
-      py = points[i] + off;
-    }
-
-    vec4 p_car_space = (vec4){{px, py, 0., 1.}};
-    vec3 p_full_frame = car_space_to_full_frame(s, p_car_space);
-    if (p_full_frame.v[0] < 0. || p_full_frame.v[1] < 0.) {
-      continue;
+      py = points[i];
     }
-    pvd->v[pvd->cnt].x = p_full_frame.v[0];
-    pvd->v[pvd->cnt].y = p_full_frame.v[1];
-    pvd->cnt += 1;
+    x[i] = x[2*n - 1 - i] = px;
+    y[i] = py - off;
+    y[2*n - 1 - i] = py + off;
   }
+
+  float u[TRACK_POINTS_MAX_CNT], v[TRACK_POINTS_MAX_CNT];
+  project_points(&scene->projection, x, y, u, v, 2*n);
+  pvd->cnt = clip_vertices(u, v, 2*n, INFINITY, INFINITY, pvd->v);
 }
 
 static void update_all_track_data(UIState *s) {
@@ -205,7 +178,7 @@ static void update_all_track_data(UIState *s) {
   // Draw vision path
   update_track_data(s, false, &s->track_vertices[0]);
 
-  if (scene->controls_state.getEnabled()) {
+  if (scene->controls_state.enabled) {
     // Draw MPC path when engaged
     update_track_data(s, true, &s->track_vertices[1]);
   }
@@ -247,14 +220,18 @@ static void draw_frame(UIState *s) {
   }
   glActiveTexture(GL_TEXTURE0);
 
+#ifdef QCOM
   if (s->stream.last_idx >= 0) {
     glBindTexture(GL_TEXTURE_2D, s->frame_texs[s->stream.last_idx]);
-#ifndef QCOM
-    // this is handled in ion on QCOM
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, s->stream.bufs_info.width, s->stream.bufs_info.height,
-                 0, GL_RGB, GL_UNSIGNED_BYTE, s->priv_hnds[s->stream.last_idx]);
-#endif
   }
+#else
+  // this is handled in ion on QCOM. only new frames are uploaded
+  if (s->frame_pending && s->stream.last_idx >= 0) {
+    frame_upload(&s->frame_upload, s->stream.bufs[s->stream.last_idx].addr);
+    s->frame_pending = false;
+  }
+  frame_upload_bind(&s->frame_upload);
+#endif
 
   glUseProgram(s->frame_program);
   glUniform1i(s->frame_texture_loc, 0);
@@ -267,40 +244,28 @@ static void draw_frame(UIState *s) {
   glBindVertexArray(0);
 }
 
-static inline bool valid_frame_pt(UIState *s, float x, float y) {
-  return x >= 0 && x <= s->stream.bufs_info.width && y >= 0 && y <= s->stream.bufs_info.height;
-}
-
 static void update_lane_line_data(UIState *s, const float *points, float off, model_path_vertices_data *pvd, float valid_len) {
   pvd->cnt = 0;
-  int rcount = fmin(MODEL_PATH_MAX_VERTICES_CNT / 2, valid_len);
+  const int rcount = fmin(MODEL_PATH_MAX_VERTICES_CNT / 2, valid_len);
+  if (rcount <= 0) return;
+
+  // up the left side, then down the right side short of the first point
+  const int n = 2*rcount - 1;
+  float x[MODEL_PATH_MAX_VERTICES_CNT], y[MODEL_PATH_MAX_VERTICES_CNT];
   for (int i = 0; i < rcount; i++) {
-    float px = (float)i;
-    float py = points[i] - off;
-    const vec4 p_car_space = (vec4){{px, py, 0., 1.}};
-    const vec3 p_full_frame = car_space_to_full_frame(s, p_car_space);
-    if(!valid_frame_pt(s, p_full_frame.v[0], p_full_frame.v[1]))
-      continue;
-    pvd->v[pvd->cnt].x = p_full_frame.v[0];
-    pvd->v[pvd->cnt].y = p_full_frame.v[1];
-    pvd->cnt += 1;
-  }
-  for (int i = rcount - 1; i > 0; i--) {
-    float px = (float)i;
-    float py = points[i] + off;
-    const vec4 p_car_space = (vec4){{px, py, 0., 1.}};
-    const vec3 p_full_frame = car_space_to_full_frame(s, p_car_space);
-    if(!valid_frame_pt(s, p_full_frame.v[0], p_full_frame.v[1]))
-      continue;
-    pvd->v[pvd->cnt].x = p_full_frame.v[0];
-    pvd->v[pvd->cnt].y = p_full_frame.v[1];
-    pvd->cnt += 1;
+    x[i] = x[n - i] = i;
+    y[i] = points[i] - off;
+    y[n - i] = points[i] + off;
   }
+
+  float u[MODEL_PATH_MAX_VERTICES_CNT], v[MODEL_PATH_MAX_VERTICES_CNT];
+  project_points(&s->scene.projection, x, y, u, v, n);
+  pvd->cnt = clip_vertices(u, v, n, s->stream.bufs_info.width, s->stream.bufs_info.height, pvd->v);
 }
 
-static void update_all_lane_lines_data(UIState *s, const cereal::ModelData::PathData::Reader &path, const float *points, model_path_vertices_data *pstart) {
-  update_lane_line_data(s, points, 0.025*path.getProb(), pstart, path.getValidLen());
-  update_lane_line_data(s, points, fmin(path.getStd(), 0.7), pstart + 1, path.getValidLen());
+static void update_all_lane_lines_data(UIState *s, const PathSnapshot &path, model_path_vertices_data *pstart) {
+  update_lane_line_data(s, path.points, 0.025*path.prob, pstart, path.valid_len);
+  update_lane_line_data(s, path.points, fmin(path.std, 0.7), pstart + 1, path.valid_len);
 }
 
 static void ui_draw_lane(UIState *s,  model_path_vertices_data *pstart, NVGcolor color) {
@@ -312,24 +277,26 @@ static void ui_draw_lane(UIState *s,  model_path_vertices_data *pstart, NVGcolor
 static void ui_draw_vision_lanes(UIState *s) {
   const UIScene *scene = &s->scene;
   model_path_vertices_data *pvd = &s->model_path_vertices[0];
-  if(s->sm->updated("model")) {
-    update_all_lane_lines_data(s, scene->model.getLeftLane(), scene->left_lane_points, pvd);
-    update_all_lane_lines_data(s, scene->model.getRightLane(), scene->right_lane_points, pvd + MODEL_LANE_PATH_CNT);
+  if (scene->lane_vertices_dirty) {
+    update_all_lane_lines_data(s, scene->model.left_lane, pvd);
+    update_all_lane_lines_data(s, scene->model.right_lane, pvd + MODEL_LANE_PATH_CNT);
+    s->scene.lane_vertices_dirty = false;
   }
 
   // Draw left lane edge
-  ui_draw_lane(s, pvd, nvgRGBAf(1.0, 1.0, 1.0, scene->model.getLeftLane().getProb()));
+  ui_draw_lane(s, pvd, nvgRGBAf(1.0, 1.0, 1.0, scene->model.left_lane.prob));
 
   // Draw right lane edge
-  ui_draw_lane(s, pvd + MODEL_LANE_PATH_CNT, nvgRGBAf(1.0, 1.0, 1.0, scene->model.getRightLane().getProb()));
+  ui_draw_lane(s, pvd + MODEL_LANE_PATH_CNT, nvgRGBAf(1.0, 1.0, 1.0, scene->model.right_lane.prob));
 
-  if(s->sm->updated("radarState")) {
+  if (scene->track_vertices_dirty) {
     update_all_track_data(s);
+    s->scene.track_vertices_dirty = false;
   }
 
   // Draw vision path
   ui_draw_track(s, false, &s->track_vertices[0]);
-  if (scene->controls_state.getEnabled()) {
+  if (scene->controls_state.enabled) {
     // Draw MPC path when engaged
     ui_draw_track(s, true, &s->track_vertices[1]);
   }
@@ -359,10 +326,10 @@ static void ui_draw_world(UIState *s) {
 
   // Draw lead indicators if openpilot is handling longitudinal
   if (s->longitudinal_control) {
-    if (scene->lead_data[0].getStatus()) {
+    if (scene->lead_data[0].status) {
       draw_lead(s, scene->lead_data[0]);
     }
-    if (scene->lead_data[1].getStatus() && (std::abs(scene->lead_data[0].getDRel() - scene->lead_data[1].getDRel()) > 3.0)) {
+    if (scene->lead_data[1].status && (std::abs(scene->lead_data[0].d_rel - scene->lead_data[1].d_rel) > 3.0)) {
       draw_lead(s, scene->lead_data[1]);
     }
   }
@@ -371,7 +338,7 @@ static void ui_draw_world(UIState *s) {
 
 static void ui_draw_vision_maxspeed(UIState *s) {
   char maxspeed_str[32];
-  float maxspeed = s->scene.controls_state.getVCruise();
+  float maxspeed = s->scene.controls_state.v_cruise;
   int maxspeed_calc = maxspeed * 0.6225 + 0.5;
   if (s->is_metric) {
     maxspeed_calc = maxspeed + 0.5;
@@ -408,7 +375,7 @@ static void ui_draw_vision_maxspeed(UIState *s) {
 
 static void ui_draw_vision_speed(UIState *s) {
   const Rect &viz_rect = s->scene.viz_rect;
-  float v_ego = s->scene.controls_state.getVEgo();
+  float v_ego = s->scene.controls_state.v_ego;
   float speed = v_ego * 2.2369363 + 0.5;
   if (s->is_metric){
     speed = v_ego * 3.6 + 0.5;
@@ -430,7 +397,7 @@ static void ui_draw_vision_event(UIState *s) {
   const int viz_event_w = 220;
   const int viz_event_x = s->scene.viz_rect.right() - (viz_event_w + bdr_s*2);
   const int viz_event_y = s->scene.viz_rect.y + (bdr_s*1.5);
-  if (s->scene.controls_state.getDecelForModel() && s->scene.controls_state.getEnabled()) {
+  if (s->scene.controls_state.decel_for_model && s->scene.controls_state.enabled) {
     // draw winding road sign
     const int img_turn_size = 160*1.5;
     ui_draw_image(s->vg, viz_event_x - (img_turn_size / 4), viz_event_y + bdr_s - 25, img_turn_size, img_turn_size, s->img_turn, 1.0f);
@@ -448,7 +415,7 @@ static void ui_draw_vision_event(UIState *s) {
       color = nvgRGBA(23, 51, 73, 255);
     }
 
-    if (s->scene.controls_state.getEngageable()){
+    if (s->scene.controls_state.engageable){
       ui_draw_circle_image(s->vg, bg_wheel_x, bg_wheel_y, bg_wheel_size, s->img_wheel, color, 1.0f, bg_wheel_y - 25);
     }
   }
@@ -458,7 +425,7 @@ static void ui_draw_vision_face(UIState *s) {
   const int face_size = 96;
   const int face_x = (s->scene.viz_rect.x + face_size + (bdr_s * 2));
   const int face_y = (s->scene.viz_rect.bottom() - footer_h + ((footer_h - face_size) / 2));
-  ui_draw_circle_image(s->vg, face_x, face_y, face_size, s->img_face, s->scene.dmonitoring_state.getFaceDetected());
+  ui_draw_circle_image(s->vg, face_x, face_y, face_size, s->img_face, s->scene.dmonitoring_state.face_detected);
 }
 
 static void ui_draw_driver_view(UIState *s) {
@@ -486,8 +453,8 @@ static void ui_draw_driver_view(UIState *s) {
   ui_draw_rect(s->vg, valid_frame_x + valid_frame_w, box_y, frame_w - valid_frame_w - (valid_frame_x - frame_x), box_h, nvgRGBA(23, 51, 73, 255));
 
   // draw face box
-  if (scene->dmonitoring_state.getFaceDetected()) {
-    auto fxy_list = scene->driver_state.getFacePosition();
+  if (scene->dmonitoring_state.face_detected) {
+    const float *fxy_list = scene->driver_state.face_position;
     const float face_x = fxy_list[0];
     const float face_y = fxy_list[1];
     float fbox_x;
@@ -511,7 +478,7 @@ static void ui_draw_driver_view(UIState *s) {
   const int face_size = 85;
   const int x = (valid_frame_x + face_size + (bdr_s * 2)) + (scene->is_rhd ? valid_frame_w - box_h / 2:0);
   const int y = (box_y + box_h - face_size - bdr_s - (bdr_s * 1.5));
-  ui_draw_circle_image(s->vg, x, y, face_size, s->img_face, scene->dmonitoring_state.getFaceDetected());
+  ui_draw_circle_image(s->vg, x, y, face_size, s->img_face, scene->dmonitoring_state.face_detected);
 }
 
 static void ui_draw_vision_header(UIState *s) {
@@ -584,28 +551,36 @@ static void ui_draw_vision(UIState *s) {
   glEnable(GL_SCISSOR_TEST);
   glViewport(viz_rect.x+scene->ui_viz_ro, viz_rect.y, s->fb_w - bdr_s*2, viz_rect.h);
   glScissor(viz_rect.x, viz_rect.y, viz_rect.w, viz_rect.h);
+  draw_stage_begin(s->draw_stats, DRAW_STAGE_FRAME);
   draw_frame(s);
+  draw_stage_end(s->draw_stats);
   glDisable(GL_SCISSOR_TEST);
 
   glViewport(0, 0, s->fb_w, s->fb_h);
 
   // Draw augmented elements
   if (!scene->frontview && scene->world_objects_visible) {
+    draw_stage_begin(s->draw_stats, DRAW_STAGE_WORLD);
     ui_draw_world(s);
+    draw_stage_end(s->draw_stats);
   }
   // Set Speed, Current Speed, Status/Events
+  draw_stage_begin(s->draw_stats, DRAW_STAGE_HUD);
   if (!scene->frontview) {
     ui_draw_vision_header(s);
   } else {
     ui_draw_driver_view(s);
   }
+  draw_stage_end(s->draw_stats);
 
+  draw_stage_begin(s->draw_stats, DRAW_STAGE_ALERT);
   if (scene->alert_size != cereal::ControlsState::AlertSize::NONE) {
     ui_draw_vision_alert(s, scene->alert_size, s->status,
                          scene->alert_text1.c_str(), scene->alert_text2.c_str());
   } else if (!scene->frontview) {
     ui_draw_vision_footer(s);
   }
+  draw_stage_end(s->draw_stats);
 }
 
 static void ui_draw_background(UIState *s) {
@@ -623,17 +598,23 @@ void ui_draw(UIState *s) {
     s->scene.ui_viz_ro = -(sbr_w - 6 * bdr_s);
   }
 
+  draw_stage_begin(s->draw_stats, DRAW_STAGE_BACKGROUND);
   ui_draw_background(s);
+  draw_stage_end(s->draw_stats);
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   glViewport(0, 0, s->fb_w, s->fb_h);
   nvgBeginFrame(s->vg, s->fb_w, s->fb_h, 1.0f);
+  draw_stage_begin(s->draw_stats, DRAW_STAGE_SIDEBAR);
   ui_draw_sidebar(s);
+  draw_stage_end(s->draw_stats);
   if (s->started && s->active_app == cereal::UiLayoutState::App::NONE &&
       s->status != STATUS_OFFROAD && s->vision_connected) {
     ui_draw_vision(s);
   }
+  draw_stage_begin(s->draw_stats, DRAW_STAGE_FLUSH);
   nvgEndFrame(s->vg);
+  draw_stage_end(s->draw_stats);
   glDisable(GL_BLEND);
 }
 
@@ -694,6 +675,28 @@ static const char frame_fragment_shader[] =
   "  colorOut = texture(uTexture, vTexCoord.xy);\n"
   "}\n";
 
+#ifndef QCOM
+// the Y plane is bound to uTexture
+static const char frame_yuv_fragment_shader[] =
+#ifdef NANOVG_GL3_IMPLEMENTATION
+  "#version 150 core\n"
+#else
+  "#version 300 es\n"
+#endif
+  "precision mediump float;\n"
+  "uniform sampler2D uTexture;\n"
+  "uniform sampler2D uTextureU;\n"
+  "uniform sampler2D uTextureV;\n"
+  "in vec4 vTexCoord;\n"
+  "out vec4 colorOut;\n"
+  "void main() {\n"
+  "  float y = 1.164 * (texture(uTexture, vTexCoord.xy).r - 0.0625);\n"
+  "  float u = texture(uTextureU, vTexCoord.xy).r - 0.5;\n"
+  "  float v = texture(uTextureV, vTexCoord.xy).r - 0.5;\n"
+  "  colorOut = vec4(y + 1.596 * v, y - 0.392 * u - 0.813 * v, y + 2.017 * u, 1.0);\n"
+  "}\n";
+#endif
+
 static const mat4 device_transform = {{
   1.0,  0.0, 0.0, 0.0,
   0.0,  1.0, 0.0, 0.0,
@@ -750,7 +753,11 @@ void ui_nvg_init(UIState *s) {
   }
 
   // init gl
+#ifdef QCOM
   s->frame_program = load_program(frame_vertex_shader, frame_fragment_shader);
+#else
+  s->frame_program = load_program(frame_vertex_shader, s->yuv_frames ? frame_yuv_fragment_shader : frame_fragment_shader);
+#endif
   assert(s->frame_program);
 
   s->frame_pos_loc = glGetAttribLocation(s->frame_program, "aPosition");
@@ -758,6 +765,14 @@ void ui_nvg_init(UIState *s) {
 
   s->frame_texture_loc = glGetUniformLocation(s->frame_program, "uTexture");
   s->frame_transform_loc = glGetUniformLocation(s->frame_program, "uTransform");
+#ifndef QCOM
+  if (s->yuv_frames) {
+    glUseProgram(s->frame_program);
+    glUniform1i(glGetUniformLocation(s->frame_program, "uTextureU"), 1);
+    glUniform1i(glGetUniformLocation(s->frame_program, "uTextureV"), 2);
+    glUseProgram(0);
+  }
+#endif
 
   glViewport(0, 0, s->fb_w, s->fb_h);
 
@@ -816,8 +831,10 @@ void ui_nvg_init(UIState *s) {
   s->front_frame_mat = matmul(device_transform, full_to_wide_frame_transform);
   s->rear_frame_mat = matmul(device_transform, frame_transform);
 
+#ifdef QCOM
   for(int i = 0; i < UI_BUF_COUNT; i++) {
     s->khr[i] = 0;
     s->priv_hnds[i] = NULL;
   }
+#endif
 }
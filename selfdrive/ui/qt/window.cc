@@ -82,7 +82,7 @@ void GLWindow::initializeGL() {
 }
 
 void GLWindow::timerUpdate(){
-  ui_update(ui_state);
+  const bool changed = ui_update(ui_state);
 
 #ifdef QCOM2
   if (ui_state->started != onroad){
@@ -98,7 +98,9 @@ void GLWindow::timerUpdate(){
   }
 #endif
 
-  update();
+  if (changed) {
+    update();
+  }
 }
 
 void GLWindow::resizeGL(int w, int h) {
@@ -107,6 +109,7 @@ void GLWindow::resizeGL(int w, int h) {
 
 void GLWindow::paintGL() {
   ui_draw(ui_state);
+  ui_frame_drawn(ui_state);
 }
 
 void GLWindow::mousePressEvent(QMouseEvent *e) {
@@ -118,24 +121,11 @@ void GLWindow::mousePressEvent(QMouseEvent *e) {
   // Vision click
   if (ui_state->started && (e->x() >= ui_state->scene.viz_rect.x - bdr_s)){
     ui_state->scene.uilayout_sidebarcollapsed = !ui_state->scene.uilayout_sidebarcollapsed;
+    update();
   }
 }
 
 
-GLuint visionimg_to_gl(const VisionImg *img, EGLImageKHR *pkhr, void **pph) {
-  unsigned int texture;
-  glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, img->width, img->height, 0, GL_RGB, GL_UNSIGNED_BYTE, *pph);
-  glGenerateMipmap(GL_TEXTURE_2D);
-  *pkhr = (EGLImageKHR)1; // not NULL
-  return texture;
-}
-
-void visionimg_destroy_gl(EGLImageKHR khr, void *ph) {
-  // empty
-}
-
 FramebufferState* framebuffer_init(const char* name, int32_t layer, int alpha,
                                    int *out_w, int *out_h) {
   return (FramebufferState*)1; // not null
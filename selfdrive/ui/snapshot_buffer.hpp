@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// Hands the latest value from one writer thread to one reader thread. The writer fills
+// the back buffer without holding the lock and only takes it to swap, the reader copies
+// the front buffer under it, so neither waits on the other for longer than a copy.
+// Values published faster than they are read are coalesced, the reader sees the latest.
+template <class T>
+class SnapshotBuffer {
+public:
+  // the buffer to fill before publish(). only the writer touches it
+  T &back() { return bufs[1 - front]; }
+
+  void publish() {
+    {
+      std::lock_guard<std::mutex> lk(lock);
+      front = 1 - front;
+      seq++;
+    }
+    cv.notify_one();
+  }
+
+  // copies the latest value to out if it's newer than *last_seq. returns how many were
+  // published since *last_seq, 0 if none
+  uint64_t read(T *out, uint64_t *last_seq) {
+    std::lock_guard<std::mutex> lk(lock);
+    const uint64_t n = seq - *last_seq;
+    if (n > 0) {
+      *out = bufs[front];
+      *last_seq = seq;
+    }
+    return n;
+  }
+
+  // waits up to timeout_ms for a value newer than last_seq. returns whether there is one
+  bool wait(uint64_t last_seq, int timeout_ms) {
+    std::unique_lock<std::mutex> lk(lock);
+    return cv.wait_for(lk, std::chrono::milliseconds(timeout_ms), [&] { return seq != last_seq; });
+  }
+
+private:
+  T bufs[2] = {};
+  int front = 0;
+  uint64_t seq = 0;
+  std::mutex lock;
+  std::condition_variable cv;
+};
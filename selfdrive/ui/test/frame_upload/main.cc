@@ -0,0 +1,276 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "frame_upload.hpp"
+
+// frame times of the UI camera view on a synthetic vision stream, headless through EGL.
+// compares a glTexImage2D of the whole frame on every draw, as paint.cc did, with
+// FrameUpload for the BGR and the YUV streams, and checks the YUV shader against BGR.
+// usage: ./main [frames]
+
+#define FRAME_W 1164
+#define FRAME_H 874
+#define FB_W 1920
+#define FB_H 1080
+#define STREAM_BUFS 4
+
+// as in paint.cc
+static const char frame_vertex_shader[] =
+  "#version 300 es\n"
+  "in vec4 aPosition;\n"
+  "in vec4 aTexCoord;\n"
+  "out vec4 vTexCoord;\n"
+  "void main() {\n"
+  "  gl_Position = aPosition;\n"
+  "  vTexCoord = aTexCoord;\n"
+  "}\n";
+
+static const char frame_fragment_shader[] =
+  "#version 300 es\n"
+  "precision mediump float;\n"
+  "uniform sampler2D uTexture;\n"
+  "in vec4 vTexCoord;\n"
+  "out vec4 colorOut;\n"
+  "void main() {\n"
+  "  colorOut = texture(uTexture, vTexCoord.xy);\n"
+  "}\n";
+
+static const char frame_yuv_fragment_shader[] =
+  "#version 300 es\n"
+  "precision mediump float;\n"
+  "uniform sampler2D uTexture;\n"
+  "uniform sampler2D uTextureU;\n"
+  "uniform sampler2D uTextureV;\n"
+  "in vec4 vTexCoord;\n"
+  "out vec4 colorOut;\n"
+  "void main() {\n"
+  "  float y = 1.164 * (texture(uTexture, vTexCoord.xy).r - 0.0625);\n"
+  "  float u = texture(uTextureU, vTexCoord.xy).r - 0.5;\n"
+  "  float v = texture(uTextureV, vTexCoord.xy).r - 0.5;\n"
+  "  colorOut = vec4(y + 1.596 * v, y - 0.392 * u - 0.813 * v, y + 2.017 * u, 1.0);\n"
+  "}\n";
+
+static void init_egl() {
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  EGLDisplay display = get_platform_display ? get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL)
+                                            : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  EGLint major, minor;
+  assert(eglInitialize(display, &major, &minor));
+
+  const EGLint config_attribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT, EGL_NONE};
+  EGLConfig config;
+  EGLint num_configs = 0;
+  eglChooseConfig(display, config_attribs, &config, 1, &num_configs);
+  eglBindAPI(EGL_OPENGL_ES_API);
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+  EGLContext context = eglCreateContext(display, num_configs ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+  assert(context != EGL_NO_CONTEXT);
+  assert(eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context));
+  printf("%s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+}
+
+typedef struct Renderer {
+  GLuint fbo, color;
+  GLuint vao, vbo;
+  GLuint programs[2];
+} Renderer;
+
+static void renderer_init(Renderer *r) {
+  glGenTextures(1, &r->color);
+  glBindTexture(GL_TEXTURE_2D, r->color);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, FB_W, FB_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glGenFramebuffers(1, &r->fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, r->fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, r->color, 0);
+  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+  glViewport(0, 0, FB_W, FB_H);
+
+  const float quad[4][4] = {
+    {-1.0, -1.0, 0.0, 1.0},
+    {-1.0,  1.0, 0.0, 0.0},
+    { 1.0, -1.0, 1.0, 1.0},
+    { 1.0,  1.0, 1.0, 0.0},
+  };
+  glGenVertexArrays(1, &r->vao);
+  glBindVertexArray(r->vao);
+  glGenBuffers(1, &r->vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+  const char *fragment_shaders[2] = {frame_fragment_shader, frame_yuv_fragment_shader};
+  for (int i = 0; i < 2; i++) {
+    r->programs[i] = load_program(frame_vertex_shader, fragment_shaders[i]);
+    assert(r->programs[i]);
+    glUseProgram(r->programs[i]);
+    glUniform1i(glGetUniformLocation(r->programs[i], "uTexture"), 0);
+    if (i == 1) {
+      glUniform1i(glGetUniformLocation(r->programs[i], "uTextureU"), 1);
+      glUniform1i(glGetUniformLocation(r->programs[i], "uTextureV"), 2);
+    }
+  }
+  // both programs link the attributes the same way
+  const GLint pos = glGetAttribLocation(r->programs[0], "aPosition");
+  const GLint texcoord = glGetAttribLocation(r->programs[0], "aTexCoord");
+  glEnableVertexAttribArray(pos);
+  glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, sizeof(quad[0]), (const void *)0);
+  glEnableVertexAttribArray(texcoord);
+  glVertexAttribPointer(texcoord, 2, GL_FLOAT, GL_FALSE, sizeof(quad[0]), (const void *)(sizeof(float) * 2));
+  assert(glGetError() == GL_NO_ERROR);
+}
+
+static void draw(const Renderer *r, bool yuv) {
+  glUseProgram(r->programs[yuv]);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  // stands in for the swap
+  glFinish();
+}
+
+// the synthetic stream: a moving gradient, BGR and I420 from the same pixels with
+// camerad's rgb_to_yuv
+static void gen_frames(std::vector<uint8_t> *bgr, std::vector<uint8_t> *yuv) {
+  for (int f = 0; f < STREAM_BUFS; f++) {
+    bgr[f].resize(FRAME_W * FRAME_H * 3);
+    yuv[f].resize(FRAME_W * FRAME_H * 3 / 2);
+    uint8_t *y_plane = yuv[f].data();
+    uint8_t *u_plane = y_plane + FRAME_W * FRAME_H;
+    uint8_t *v_plane = u_plane + FRAME_W * FRAME_H / 4;
+    for (int y = 0; y < FRAME_H; y++) {
+      for (int x = 0; x < FRAME_W; x++) {
+        // constant over each 2x2 block, so the subsampled chroma is exact
+        const int bx = x / 2 * 2, by = y / 2 * 2;
+        const int r = (bx + f * 16) % 256, g = (by * 2) % 256, b = (bx + by + f * 32) % 256;
+        uint8_t *px = &bgr[f][(y * FRAME_W + x) * 3];
+        px[0] = b; px[1] = g; px[2] = r;
+        y_plane[y * FRAME_W + x] = (((b * 13 + g * 65 + r * 33) + 64) >> 7) + 16;
+        if (x % 2 == 0 && y % 2 == 0) {
+          // camerad's AVERAGE of the block is twice the mean
+          u_plane[(y / 2) * (FRAME_W / 2) + x / 2] = (2*b * 56 - 2*g * 37 - 2*r * 19 + 0x8080) >> 8;
+          v_plane[(y / 2) * (FRAME_W / 2) + x / 2] = (2*r * 56 - 2*g * 47 - 2*b * 9 + 0x8080) >> 8;
+        }
+      }
+    }
+  }
+}
+
+static double millis() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000.0 + t.tv_nsec * 1e-6;
+}
+
+typedef struct Timing {
+  double upload, frame;
+} Timing;
+
+static void report(const char *name, Timing t, int frames) {
+  printf("%-26s upload %6.2f ms, frame %6.2f ms\n", name, t.upload / frames, t.frame / frames);
+}
+
+// the old path uploads on every draw, whether the frame is new or not
+static Timing run_teximage(const Renderer *r, std::vector<uint8_t> *bgr, int frames) {
+  GLuint tex;
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  Timing t = {};
+  for (int i = 0; i < frames; i++) {
+    const double t1 = millis();
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, FRAME_W, FRAME_H, 0, GL_RGB, GL_UNSIGNED_BYTE, bgr[i % STREAM_BUFS].data());
+    const double t2 = millis();
+    draw(r, false);
+    t.upload += t2 - t1;
+    t.frame += millis() - t1;
+  }
+  glDeleteTextures(1, &tex);
+  return t;
+}
+
+static Timing run_upload(const Renderer *r, std::vector<uint8_t> *frames_data, bool yuv, int frames, int new_every) {
+  FrameUpload u;
+  frame_upload_init(&u, yuv ? FRAME_FORMAT_YUV420 : FRAME_FORMAT_BGR, FRAME_W, FRAME_H, yuv ? FRAME_W : FRAME_W * 3);
+  Timing t = {};
+  for (int i = 0; i < frames; i++) {
+    const double t1 = millis();
+    if (i % new_every == 0) {
+      frame_upload(&u, frames_data[(i / new_every) % STREAM_BUFS].data());
+    }
+    frame_upload_bind(&u);
+    const double t2 = millis();
+    draw(r, yuv);
+    t.upload += t2 - t1;
+    t.frame += millis() - t1;
+  }
+  frame_upload_destroy(&u);
+  return t;
+}
+
+static std::vector<uint8_t> read_frame() {
+  std::vector<uint8_t> px(FB_W * FB_H * 4);
+  glReadPixels(0, 0, FB_W, FB_H, GL_RGBA, GL_UNSIGNED_BYTE, px.data());
+  return px;
+}
+
+static int check_yuv(const Renderer *r, std::vector<uint8_t> *bgr, std::vector<uint8_t> *yuv) {
+  FrameUpload u;
+  frame_upload_init(&u, FRAME_FORMAT_BGR, FRAME_W, FRAME_H, FRAME_W * 3);
+  frame_upload(&u, bgr[1].data());
+  frame_upload_bind(&u);
+  draw(r, false);
+  std::vector<uint8_t> expected = read_frame();
+  frame_upload_destroy(&u);
+
+  frame_upload_init(&u, FRAME_FORMAT_YUV420, FRAME_W, FRAME_H, FRAME_W);
+  frame_upload(&u, yuv[1].data());
+  frame_upload_bind(&u);
+  draw(r, true);
+  std::vector<uint8_t> got = read_frame();
+  frame_upload_destroy(&u);
+
+  int max_err = 0;
+  for (size_t i = 0; i < got.size(); i++) {
+    max_err = std::max(max_err, abs(got[i] - expected[i]));
+  }
+  return max_err;
+}
+
+int main(int argc, char **argv) {
+  const int frames = argc > 1 ? atoi(argv[1]) : 200;
+
+  init_egl();
+  Renderer r;
+  renderer_init(&r);
+
+  static std::vector<uint8_t> bgr[STREAM_BUFS], yuv[STREAM_BUFS];
+  gen_frames(bgr, yuv);
+
+  // the conversion in camerad rounds, a few levels off is expected
+  const int max_err = check_yuv(&r, bgr, yuv);
+  printf("YUV shader vs BGR: max error %d\n", max_err);
+  if (max_err > 6) {
+    printf("FAILED\n");
+    return 1;
+  }
+
+  // the upload is the CPU time the UI thread spends on the frame before drawing. on a
+  // software renderer the frame time is mostly rasterizing, on a GPU the PBO copy overlaps it
+  printf("%dx%d frames drawn to %dx%d, per frame over %d frames\n", FRAME_W, FRAME_H, FB_W, FB_H, frames);
+  report("glTexImage2D every draw", run_teximage(&r, bgr, frames), frames);
+  report("PBO BGR", run_upload(&r, bgr, false, frames, 1), frames);
+  report("PBO YUV", run_upload(&r, yuv, true, frames, 1), frames);
+  // the UI redraws faster than the camera, e.g. on touch or a new alert
+  report("PBO BGR, new every 3rd", run_upload(&r, bgr, false, frames, 3), frames);
+  report("PBO YUV, new every 3rd", run_upload(&r, yuv, true, frames, 3), frames);
+  assert(glGetError() == GL_NO_ERROR);
+  return 0;
+}
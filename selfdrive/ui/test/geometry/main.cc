@@ -0,0 +1,274 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common/modeldata.h"
+#include "geometry.hpp"
+
+// checks the batched path and lane geometry against the per point projection paint.cc
+// did before, and times the CPU work of a UI frame for both. ./main bench for timings.
+// the vertex building mirrors update_lane_line_data and update_track_data, without
+// the messaging they read from
+
+#define LANE_MAX_VERTICES 98
+#define TRACK_MAX_VERTICES 100
+#define FRAME_W 1164
+#define FRAME_H 874
+
+const mat3 intrinsic_matrix = (mat3){{
+  910., 0., 582.,
+  0., 910., 437.,
+  0.,   0.,   1.
+}};
+
+typedef struct Frame {
+  mat4 extrinsic;
+  float poly[3][POLYFIT_DEGREE];
+  float valid_len[3];
+  float prob[3], std[3];
+  float lead_d;
+} Frame;
+
+typedef struct Vertices {
+  vertex_data lanes[4][LANE_MAX_VERTICES];
+  int lane_cnt[4];
+  vertex_data tracks[2][TRACK_MAX_VERTICES];
+  int track_cnt[2];
+} Vertices;
+
+static float lerp(float v0, float v1, float t) {
+  return (1 - t) * v0 + t * v1;
+}
+
+static float track_height(const Frame &f, bool is_mpc) {
+  float lead_d = f.lead_d*2.;
+  float path_height = is_mpc?(lead_d>5.)?fmin(lead_d, 25.)-fmin(lead_d*0.35, 10.):20.
+                            :(lead_d>0.)?fmin(lead_d, 50.)-fmin(lead_d*0.35, 10.):49.;
+  return fmin(path_height, f.valid_len[0]);
+}
+
+// the scalar code
+
+static vec3 car_space_to_full_frame(const mat4 &extrinsic, vec4 car_space_projective) {
+  const vec4 Ep4 = matvecmul(extrinsic, car_space_projective);
+  const vec3 Ep = {{Ep4.v[0], Ep4.v[1], Ep4.v[2]}};
+  const vec3 KEp = matvecmul3(intrinsic_matrix, Ep);
+  const vec3 p_image = {{KEp.v[0] / KEp.v[2], KEp.v[1] / KEp.v[2], 1.}};
+  return p_image;
+}
+
+static void fill_path_points_scalar(const float *poly, float valid_len, float *points) {
+  for (int i = 0; i < valid_len; i++) {
+    points[i] = poly[0] * (i * i * i) + poly[1] * (i * i) + poly[2] * i + poly[3];
+  }
+}
+
+static bool valid_frame_pt(float x, float y) {
+  return x >= 0 && x <= FRAME_W && y >= 0 && y <= FRAME_H;
+}
+
+static int lane_line_scalar(const mat4 &extrinsic, const float *points, float off, float valid_len, vertex_data *v) {
+  int cnt = 0;
+  int rcount = fmin(LANE_MAX_VERTICES / 2, valid_len);
+  for (int i = 0; i < rcount; i++) {
+    const vec3 p = car_space_to_full_frame(extrinsic, (vec4){{(float)i, points[i] - off, 0., 1.}});
+    if (!valid_frame_pt(p.v[0], p.v[1])) continue;
+    v[cnt++] = {p.v[0], p.v[1]};
+  }
+  for (int i = rcount - 1; i > 0; i--) {
+    const vec3 p = car_space_to_full_frame(extrinsic, (vec4){{(float)i, points[i] + off, 0., 1.}});
+    if (!valid_frame_pt(p.v[0], p.v[1])) continue;
+    v[cnt++] = {p.v[0], p.v[1]};
+  }
+  return cnt;
+}
+
+static int track_scalar(const Frame &f, const float *points, bool is_mpc, vertex_data *v) {
+  // the mpc path is all zeros in the UI
+  const float mpc[50] = {};
+  float off = is_mpc?0.3:0.5;
+  float path_height = track_height(f, is_mpc);
+  int cnt = 0;
+  for (int i=0; i<=path_height; i++) {
+    float mpx = i==0?0.0:mpc[i];
+    float px = is_mpc ? lerp(mpx+1.0, mpx, i/100.0) : lerp(i+1.0, i, i/100.0);
+    float py = (is_mpc ? mpc[i] : points[i]) - off;
+    const vec3 p = car_space_to_full_frame(f.extrinsic, (vec4){{px, py, 0., 1.}});
+    if (p.v[0] < 0. || p.v[1] < 0.) continue;
+    v[cnt++] = {p.v[0], p.v[1]};
+  }
+  for (int i=path_height; i>=0; i--) {
+    float mpx = i==0?0.0:mpc[i];
+    float px = is_mpc ? lerp(mpx+1.0, mpx, i/100.0) : lerp(i+1.0, i, i/100.0);
+    float py = (is_mpc ? mpc[i] : points[i]) + off;
+    const vec3 p = car_space_to_full_frame(f.extrinsic, (vec4){{px, py, 0., 1.}});
+    if (p.v[0] < 0. || p.v[1] < 0.) continue;
+    v[cnt++] = {p.v[0], p.v[1]};
+  }
+  return cnt;
+}
+
+static void frame_scalar(const Frame &f, Vertices *out) {
+  float points[3][MODEL_PATH_DISTANCE];
+  for (int l = 0; l < 3; l++) {
+    fill_path_points_scalar(f.poly[l], f.valid_len[l], points[l]);
+  }
+  for (int l = 1; l < 3; l++) {
+    vertex_data *v = out->lanes[2*(l-1)];
+    out->lane_cnt[2*(l-1)] = lane_line_scalar(f.extrinsic, points[l], 0.025*f.prob[l], f.valid_len[l], v);
+    out->lane_cnt[2*(l-1) + 1] = lane_line_scalar(f.extrinsic, points[l], fmin(f.std[l], 0.7), f.valid_len[l], v + LANE_MAX_VERTICES);
+  }
+  for (int k = 0; k < 2; k++) {
+    out->track_cnt[k] = track_scalar(f, points[0], k == 1, out->tracks[k]);
+  }
+}
+
+// the batched code
+
+static int lane_line_batched(const FrameProjection *proj, const float *points, float off, float valid_len, vertex_data *out) {
+  const int rcount = fmin(LANE_MAX_VERTICES / 2, valid_len);
+  if (rcount <= 0) return 0;
+  const int n = 2*rcount - 1;
+  float x[LANE_MAX_VERTICES], y[LANE_MAX_VERTICES];
+  for (int i = 0; i < rcount; i++) {
+    x[i] = x[n - i] = i;
+    y[i] = points[i] - off;
+    y[n - i] = points[i] + off;
+  }
+  float u[LANE_MAX_VERTICES], v[LANE_MAX_VERTICES];
+  project_points(proj, x, y, u, v, n);
+  return clip_vertices(u, v, n, FRAME_W, FRAME_H, out);
+}
+
+static int track_batched(const Frame &f, const FrameProjection *proj, const float *points, bool is_mpc, vertex_data *out) {
+  const float mpc[50] = {};
+  float off = is_mpc?0.3:0.5;
+  const int n = track_height(f, is_mpc) + 1;
+  if (n <= 0) return 0;
+  float x[TRACK_MAX_VERTICES], y[TRACK_MAX_VERTICES];
+  for (int i = 0; i < n; i++) {
+    float mpx = i==0?0.0:mpc[i];
+    float px = is_mpc ? lerp(mpx+1.0, mpx, i/100.0) : lerp(i+1.0, i, i/100.0);
+    float py = is_mpc ? mpc[i] : points[i];
+    x[i] = x[2*n - 1 - i] = px;
+    y[i] = py - off;
+    y[2*n - 1 - i] = py + off;
+  }
+  float u[TRACK_MAX_VERTICES], v[TRACK_MAX_VERTICES];
+  project_points(proj, x, y, u, v, 2*n);
+  return clip_vertices(u, v, 2*n, INFINITY, INFINITY, out);
+}
+
+static void frame_batched(const Frame &f, Vertices *out) {
+  FrameProjection proj;
+  projection_init(&proj, intrinsic_matrix, f.extrinsic);
+  float points[3][MODEL_PATH_DISTANCE];
+  for (int l = 0; l < 3; l++) {
+    poly_eval_points(f.poly[l], points[l], fmin(MODEL_PATH_DISTANCE, ceil(f.valid_len[l])));
+  }
+  for (int l = 1; l < 3; l++) {
+    vertex_data *v = out->lanes[2*(l-1)];
+    out->lane_cnt[2*(l-1)] = lane_line_batched(&proj, points[l], 0.025*f.prob[l], f.valid_len[l], v);
+    out->lane_cnt[2*(l-1) + 1] = lane_line_batched(&proj, points[l], fmin(f.std[l], 0.7), f.valid_len[l], v + LANE_MAX_VERTICES);
+  }
+  for (int k = 0; k < 2; k++) {
+    out->track_cnt[k] = track_batched(f, &proj, points[0], k == 1, out->tracks[k]);
+  }
+}
+
+static float frand(float lo, float hi) {
+  return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+static void gen_frame(Frame *f) {
+  // camera 1.22m over the road looking forward, with a small pitch and yaw
+  const float pitch = frand(-0.03, 0.03), yaw = frand(-0.03, 0.03), h = 1.22;
+  const mat4 e = {{
+    -sinf(yaw), cosf(yaw), 0., 0.,
+    sinf(pitch), 0., cosf(pitch), h,
+    cosf(pitch) * cosf(yaw), cosf(pitch) * sinf(yaw), -sinf(pitch), 0.,
+    0., 0., 0., 0.,
+  }};
+  f->extrinsic = e;
+  const float offsets[3] = {0., 1.8, -1.8};
+  for (int l = 0; l < 3; l++) {
+    f->poly[l][0] = frand(-2e-6, 2e-6);
+    f->poly[l][1] = frand(-3e-4, 3e-4);
+    f->poly[l][2] = frand(-0.02, 0.02);
+    f->poly[l][3] = offsets[l] + frand(-0.3, 0.3);
+    f->valid_len[l] = frand(5, MODEL_PATH_DISTANCE);
+    f->prob[l] = frand(0, 1);
+    f->std[l] = frand(0.05, 1.5);
+  }
+  f->lead_d = rand() % 4 == 0 ? 0 : frand(2, 80);
+}
+
+static bool check(const vertex_data *ref, int ref_cnt, const vertex_data *got, int got_cnt, const char *name) {
+  if (ref_cnt != got_cnt) {
+    printf("%s: %d vertices, expected %d\n", name, got_cnt, ref_cnt);
+    return false;
+  }
+  // the projection is composed once, so not bit exact
+  for (int i = 0; i < ref_cnt; i++) {
+    const float tol = 1e-3 * (1. + fabs(ref[i].x) + fabs(ref[i].y));
+    if (fabs(ref[i].x - got[i].x) > tol || fabs(ref[i].y - got[i].y) > tol) {
+      printf("%s[%d]: (%f, %f), expected (%f, %f)\n", name, i, got[i].x, got[i].y, ref[i].x, ref[i].y);
+      return false;
+    }
+  }
+  return true;
+}
+
+static double millis() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000.0 + t.tv_nsec * 1e-6;
+}
+
+int main(int argc, char **argv) {
+  const bool bench = argc > 1 && strcmp(argv[1], "bench") == 0;
+  srand(1234);
+
+  const int frames = 2000;
+  static Frame f[frames];
+  for (int i = 0; i < frames; i++) gen_frame(&f[i]);
+
+  int failed = 0;
+  for (int i = 0; i < frames; i++) {
+    Vertices ref, got;
+    frame_scalar(f[i], &ref);
+    frame_batched(f[i], &got);
+    bool ok = true;
+    for (int k = 0; k < 4; k++) {
+      ok &= check(ref.lanes[k], ref.lane_cnt[k], got.lanes[k], got.lane_cnt[k], "lane");
+    }
+    for (int k = 0; k < 2; k++) {
+      ok &= check(ref.tracks[k], ref.track_cnt[k], got.tracks[k], got.track_cnt[k], "track");
+    }
+    failed += !ok;
+  }
+  printf("%d frames, %d mismatched\n", frames, failed);
+
+  if (bench) {
+    static Vertices out;
+    const int reps = 50;
+    double t1 = millis();
+    for (int r = 0; r < reps; r++) {
+      for (int i = 0; i < frames; i++) frame_scalar(f[i], &out);
+    }
+    double t2 = millis();
+    for (int r = 0; r < reps; r++) {
+      for (int i = 0; i < frames; i++) frame_batched(f[i], &out);
+    }
+    double t3 = millis();
+    const double scalar_us = (t2 - t1) * 1000. / (reps * frames);
+    const double batched_us = (t3 - t2) * 1000. / (reps * frames);
+    // paint.cc now only recomputes when a model, calibration or radar message came in,
+    // the other UI frames reuse the vertices
+    printf("geometry per UI frame: scalar %.2f us, batched %.2f us (%.2fx), frames without new messages 0 us\n",
+           scalar_us, batched_us, scalar_us / batched_us);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,310 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "common/timing.h"
+#include "ui.hpp"
+#include "paint.hpp"
+
+// Draws synthetic UI scenes headless, into an offscreen framebuffer on a surfaceless EGL
+// context, and reports CPU and GPU times per ui_draw stage. Run from selfdrive/ui, the
+// assets are loaded relative to it:
+//   test/render/render_bench [frames per scene] [png dir]
+// With a png dir, the last frame of each scene is written there for visual diffing.
+
+// eglext.h clashes with the EGLImageKHR stand-in of visionimg.h off QCOM
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+#define FB_W 1920
+#define FB_H 1080
+#define FRAME_W 1164
+#define FRAME_H 874
+
+typedef struct Scene {
+  const char *name;
+  void (*setup)(UIState *s);
+} Scene;
+
+static void init_egl() {
+  EGLDisplay display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  EGLint major, minor;
+  assert(eglInitialize(display, &major, &minor));
+
+  const EGLint config_attribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT, EGL_NONE};
+  EGLConfig config;
+  EGLint num_configs = 0;
+  eglChooseConfig(display, config_attribs, &config, 1, &num_configs);
+  eglBindAPI(EGL_OPENGL_ES_API);
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+  EGLContext context = eglCreateContext(display, num_configs ? config : (EGLConfig)0, EGL_NO_CONTEXT, context_attribs);
+  assert(context != EGL_NO_CONTEXT);
+  assert(eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context));
+  printf("renderer: %s\n", glGetString(GL_RENDERER));
+}
+
+// stands in for the default framebuffer, nanovg needs the stencil
+static void init_framebuffer(int w, int h) {
+  GLuint fbo, rbos[2];
+  glGenFramebuffers(1, &fbo);
+  glGenRenderbuffers(2, rbos);
+  glBindRenderbuffer(GL_RENDERBUFFER, rbos[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+  glBindRenderbuffer(GL_RENDERBUFFER, rbos[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbos[0]);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbos[1]);
+  assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+}
+
+// a BGR road-ish gradient as the camera frame
+static void init_vision(UIState *s, std::vector<uint8_t> &frame, VIPCBuf *buf) {
+  const int stride = FRAME_W * 3;
+  frame.resize(stride * FRAME_H);
+  for (int y = 0; y < FRAME_H; y++) {
+    for (int x = 0; x < FRAME_W; x++) {
+      uint8_t *p = &frame[y * stride + x * 3];
+      const bool sky = y < FRAME_H / 2;
+      p[0] = sky ? 200 - y / 4 : 60 + (x * 7 + y * 3) % 40;
+      p[1] = sky ? 160 - y / 6 : 60 + (x * 3 + y * 5) % 40;
+      p[2] = sky ? 120 : 60 + (x + y) % 40;
+    }
+  }
+  buf->addr = frame.data();
+  buf->len = frame.size();
+
+  s->stream.bufs = buf;
+  s->stream.num_bufs = 1;
+  s->stream.last_idx = 0;
+  s->stream.bufs_info.width = FRAME_W;
+  s->stream.bufs_info.height = FRAME_H;
+  s->stream.bufs_info.stride = stride;
+  s->stream.bufs_info.buf_len = frame.size();
+  frame_upload_init(&s->frame_upload, FRAME_FORMAT_BGR, FRAME_W, FRAME_H, stride);
+}
+
+// a camera 1.22m over the road looking straight ahead
+static void init_calibration(UIScene *scene) {
+  const mat4 extrinsic = {{
+    0., 1., 0., 0.,
+    0., 0., 1., 1.22,
+    1., 0., 0., 0.,
+    0., 0., 0., 0.,
+  }};
+  scene->extrinsic_matrix = extrinsic;
+  projection_init(&scene->projection, intrinsic_matrix, extrinsic);
+  scene->world_objects_visible = true;
+}
+
+static void setup_offroad(UIState *s) {
+  s->started = false;
+  s->status = STATUS_OFFROAD;
+  s->active_app = cereal::UiLayoutState::App::HOME;
+  s->scene.uilayout_sidebarcollapsed = false;
+}
+
+static void setup_onroad(UIState *s) {
+  s->started = true;
+  s->status = STATUS_ENGAGED;
+  s->active_app = cereal::UiLayoutState::App::NONE;
+  s->scene.uilayout_sidebarcollapsed = true;
+  s->scene.frontview = false;
+  s->scene.alert_size = cereal::ControlsState::AlertSize::NONE;
+}
+
+static void setup_onroad_sidebar(UIState *s) {
+  setup_onroad(s);
+  s->scene.uilayout_sidebarcollapsed = false;
+}
+
+static void setup_alert(UIState *s) {
+  setup_onroad(s);
+  s->status = STATUS_ALERT;
+  s->scene.alert_text1 = "TAKE CONTROL IMMEDIATELY";
+  s->scene.alert_text2 = "Controls Unresponsive";
+  s->scene.alert_size = cereal::ControlsState::AlertSize::FULL;
+}
+
+static void setup_driver_view(UIState *s) {
+  setup_onroad(s);
+  s->status = STATUS_DISENGAGED;
+  s->scene.frontview = true;
+}
+
+static const Scene scenes[] = {
+  {"offroad", setup_offroad},
+  {"onroad", setup_onroad},
+  {"onroad_sidebar", setup_onroad_sidebar},
+  {"alert", setup_alert},
+  {"driver_view", setup_driver_view},
+};
+
+static void fill_path(PathSnapshot *p, float offset, float curvature, float valid_len) {
+  const float poly[POLYFIT_DEGREE] = {0., curvature, 0., offset};
+  poly_eval_points(poly, p->points, fmin(MODEL_PATH_DISTANCE, ceil(valid_len)));
+  p->valid_len = valid_len;
+  p->prob = 0.8;
+  p->std = 0.2;
+}
+
+// what a new model, radarState and controlsState at 20Hz would change
+static void update_scene(UIState *s, int frame) {
+  UIScene &scene = s->scene;
+  const float t = frame / (float)UI_FREQ;
+  const float curvature = 0.0004 * sinf(t * 0.5);
+
+  fill_path(&scene.model.path, 0., curvature, 60. + 30. * sinf(t * 0.3));
+  fill_path(&scene.model.left_lane, 1.8, curvature, 50. + 20. * sinf(t * 0.2));
+  fill_path(&scene.model.right_lane, -1.8, curvature, 50. + 20. * cosf(t * 0.2));
+  for (int i = 0; i < 50; i++) {
+    scene.mpc_x[i] = i;
+    scene.mpc_y[i] = curvature * i * i;
+  }
+
+  scene.lead_data[0] = {.status = true, .d_rel = 30.f + 15.f * sinf(t * 0.4), .y_rel = 0.3f, .v_rel = -2.f};
+  scene.lead_data[1] = {.status = true, .d_rel = 70.f, .y_rel = -3.f, .v_rel = 1.f};
+
+  scene.controls_state.enabled = s->status == STATUS_ENGAGED;
+  scene.controls_state.engageable = true;
+  scene.controls_state.v_ego = 25. + 2. * sinf(t);
+  scene.controls_state.v_cruise = 110.;
+  scene.driver_state.face_position[0] = 0.1 * sinf(t);
+  scene.driver_state.face_position[1] = 0.1 * cosf(t);
+  scene.dmonitoring_state.face_detected = true;
+
+  scene.lane_vertices_dirty = true;
+  scene.track_vertices_dirty = true;
+  s->frame_pending = true;
+}
+
+static void write_png_chunk(FILE *f, const char *type, const uint8_t *data, uint32_t len) {
+  const uint8_t len_be[4] = {(uint8_t)(len >> 24), (uint8_t)(len >> 16), (uint8_t)(len >> 8), (uint8_t)len};
+  fwrite(len_be, 1, 4, f);
+  fwrite(type, 1, 4, f);
+  fwrite(data, 1, len, f);
+  uint32_t crc = crc32(crc32(0, (const Bytef *)type, 4), data, len);
+  const uint8_t crc_be[4] = {(uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc};
+  fwrite(crc_be, 1, 4, f);
+}
+
+static void write_png(const char *path, int w, int h) {
+  std::vector<uint8_t> pixels(w * h * 4);
+  glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+  // rows top down, each behind a filter type byte
+  std::vector<uint8_t> raw((w * 4 + 1) * h);
+  for (int y = 0; y < h; y++) {
+    uint8_t *row = &raw[y * (w * 4 + 1)];
+    row[0] = 0;
+    memcpy(row + 1, &pixels[(h - 1 - y) * w * 4], w * 4);
+  }
+  uLongf zlen = compressBound(raw.size());
+  std::vector<uint8_t> z(zlen);
+  assert(compress2(z.data(), &zlen, raw.data(), raw.size(), Z_DEFAULT_COMPRESSION) == Z_OK);
+
+  FILE *f = fopen(path, "wb");
+  assert(f);
+  const uint8_t sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  fwrite(sig, 1, 8, f);
+  const uint8_t ihdr[13] = {
+    (uint8_t)(w >> 24), (uint8_t)(w >> 16), (uint8_t)(w >> 8), (uint8_t)w,
+    (uint8_t)(h >> 24), (uint8_t)(h >> 16), (uint8_t)(h >> 8), (uint8_t)h,
+    8, 6, 0, 0, 0,  // 8 bit RGBA
+  };
+  write_png_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+  write_png_chunk(f, "IDAT", z.data(), zlen);
+  write_png_chunk(f, "IEND", NULL, 0);
+  fclose(f);
+}
+
+int main(int argc, char *argv[]) {
+  const int frames = argc > 1 ? atoi(argv[1]) : 200;
+  const char *png_dir = argc > 2 ? argv[2] : NULL;
+
+  init_egl();
+  init_framebuffer(FB_W, FB_H);
+
+  UIState *s = new UIState();
+  s->fb_w = FB_W;
+  s->fb_h = FB_H;
+  s->is_metric = true;
+  s->longitudinal_control = true;
+  s->scene.satelliteCount = 9;
+  s->scene.hwType = cereal::HealthData::HwType::UNO;
+  s->scene.athenaStatus = NET_CONNECTED;
+  s->scene.thermal.network_type = cereal::ThermalData::NetworkType::WIFI;
+  s->scene.thermal.network_strength = cereal::ThermalData::NetworkStrength::GREAT;
+  s->scene.thermal.battery_percent = 80;
+  s->scene.thermal.ambient = 35.;
+  ui_nvg_init(s);
+
+  std::vector<uint8_t> frame;
+  VIPCBuf buf = {};
+  init_vision(s, frame, &buf);
+  s->vision_connected = true;
+  init_calibration(&s->scene);
+
+  DrawStats stats;
+  draw_stats_init(&stats);
+  s->draw_stats = &stats;
+  if (!stats.gpu_timing) {
+    printf("no timer queries, GPU times are 0\n");
+  }
+
+  printf("%d frames per scene at %dx%d, mean ms per frame\n", frames, FB_W, FB_H);
+  printf("%-16s %-10s %8s %8s\n", "scene", "stage", "cpu", "gpu");
+  for (const Scene &scene : scenes) {
+    scene.setup(s);
+    // not counted, the first frames build caches
+    for (int i = 0; i < 5; i++) {
+      update_scene(s, i);
+      ui_draw(s);
+      draw_stats_frame_done(&stats);
+    }
+    draw_stats_reset(&stats);
+
+    double draw_ms = 0, finish_ms = 0;
+    for (int i = 0; i < frames; i++) {
+      update_scene(s, i);
+      const double t1 = millis_since_boot();
+      ui_draw(s);
+      const double t2 = millis_since_boot();
+      // the swap would wait for the GPU too. on a software rasterizer this is where
+      // most of the drawing happens, the timer queries miss it
+      glFinish();
+      const double t3 = millis_since_boot();
+      draw_ms += t2 - t1;
+      finish_ms += t3 - t2;
+      draw_stats_frame_done(&stats);
+    }
+    assert(glGetError() == GL_NO_ERROR);
+
+    for (int i = 0; i < DRAW_STAGE_COUNT; i++) {
+      printf("%-16s %-10s %8.3f %8.3f\n", scene.name, draw_stage_names[i],
+             stats.cpu_ms[i] / stats.frames, stats.gpu_ms[i] / stats.frames);
+    }
+    // cpu is all of ui_draw, gpu the wait for glFinish after it
+    printf("%-16s %-10s %8.3f %8.3f\n", scene.name, "total", draw_ms / frames, finish_ms / frames);
+
+    if (png_dir) {
+      std::string path = std::string(png_dir) + "/" + scene.name + ".png";
+      write_png(path.c_str(), FB_W, FB_H);
+    }
+  }
+
+  draw_stats_destroy(&stats);
+  frame_upload_destroy(&s->frame_upload);
+  delete s;
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <thread>
+
+#include "snapshot_buffer.hpp"
+
+// a writer publishing much faster than the reader takes values: the reader must never see
+// a value that mixes two publishes, always get the latest, and account for every publish
+
+#define VALUE_LEN 1024
+#define PUBLISHES 200000
+
+struct Value {
+  uint64_t seq;
+  uint64_t data[VALUE_LEN];
+};
+
+int main() {
+  SnapshotBuffer<Value> buf;
+
+  // nothing published yet
+  Value v = {};
+  uint64_t last_seq = 0;
+  assert(buf.read(&v, &last_seq) == 0);
+  assert(!buf.wait(last_seq, 1));
+
+  std::thread writer([&] {
+    for (uint64_t i = 1; i <= PUBLISHES; i++) {
+      Value &back = buf.back();
+      back.seq = i;
+      for (int j = 0; j < VALUE_LEN; j++) {
+        back.data[j] = i;
+      }
+      buf.publish();
+    }
+  });
+
+  uint64_t reads = 0, seen = 0, prev = 0;
+  while (last_seq < PUBLISHES) {
+    buf.wait(last_seq, 100);
+    const uint64_t n = buf.read(&v, &last_seq);
+    if (n == 0) continue;
+
+    // the latest value, whole
+    assert(v.seq == last_seq);
+    for (int j = 0; j < VALUE_LEN; j++) {
+      assert(v.data[j] == v.seq);
+    }
+    assert(v.seq > prev);
+    prev = v.seq;
+    seen += n;
+    reads++;
+    usleep(10);
+  }
+  writer.join();
+
+  assert(seen == PUBLISHES);
+  assert(buf.read(&v, &last_seq) == 0);
+  printf("%llu publishes coalesced into %llu reads\n", (unsigned long long)seen, (unsigned long long)reads);
+  printf("ok\n");
+  return 0;
+}
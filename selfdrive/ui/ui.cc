@@ -1,11 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <math.h>
 #include <signal.h>
 #include <unistd.h>
 #include <assert.h>
 #include <poll.h>
 #include <sys/mman.h>
+#include <algorithm>
 
 #include "common/util.h"
 #include "common/swaglog.h"
@@ -23,13 +26,15 @@ int write_param_float(float param, const char* param_name, bool persistent_param
 }
 
 void ui_init(UIState *s) {
-  s->sm = new SubMaster({"model", "controlsState", "uiLayoutState", "liveCalibration", "radarState", "thermal",
-                         "health", "carParams", "ubloxGnss", "driverState", "dMonitoringState"});
+  s->ingest = new UIIngest();
 
   s->started = false;
   s->status = STATUS_OFFROAD;
   s->scene.satelliteCount = -1;
   read_param(&s->is_metric, "IsMetric");
+#ifndef QCOM
+  s->yuv_frames = getenv("UI_YUV_FRAMES") != NULL;
+#endif
 
   s->fb = framebuffer_init("ui", 0, true, &s->fb_w, &s->fb_h);
   assert(s->fb);
@@ -40,7 +45,10 @@ void ui_init(UIState *s) {
 static void ui_init_vision(UIState *s) {
   // Invisible until we receive a calibration message.
   s->scene.world_objects_visible = false;
+  // the frame size may have changed
+  s->scene.lane_vertices_dirty = true;
 
+#ifdef QCOM
   for (int i = 0; i < UI_BUF_COUNT; i++) {
     if (s->khr[i] != 0) {
       visionimg_destroy_gl(s->khr[i], s->priv_hnds[i]);
@@ -56,9 +64,6 @@ static void ui_init_vision(UIState *s) {
       .bpp = 3,
       .size = s->stream.bufs_info.buf_len,
     };
-#ifndef QCOM
-    s->priv_hnds[i] = s->stream.bufs[i].addr;
-#endif
     s->frame_texs[i] = visionimg_to_gl(&img, &s->khr[i], &s->priv_hnds[i]);
 
     glBindTexture(GL_TEXTURE_2D, s->frame_texs[i]);
@@ -70,14 +75,29 @@ static void ui_init_vision(UIState *s) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
   }
+#else
+  frame_upload_destroy(&s->frame_upload);
+  frame_upload_init(&s->frame_upload, s->yuv_frames ? FRAME_FORMAT_YUV420 : FRAME_FORMAT_BGR,
+                    s->stream.bufs_info.width, s->stream.bufs_info.height, s->stream.bufs_info.stride);
+  s->frame_pending = false;
+#endif
   assert(glGetError() == GL_NO_ERROR);
 }
 
 void ui_update_vision(UIState *s) {
 
   if (!s->vision_connected && s->started) {
-    const VisionStreamType type = s->scene.frontview ? VISION_STREAM_RGB_FRONT : VISION_STREAM_RGB_BACK;
-    int err = visionstream_init(&s->stream, type, true, nullptr);
+    VisionStreamType type = s->scene.frontview ? VISION_STREAM_RGB_FRONT : VISION_STREAM_RGB_BACK;
+    bool tbuffer = true;
+#ifndef QCOM
+    if (s->yuv_frames) {
+      // modeld and dmonitoringmodeld read the yuv tbuffers, which hand each frame to one reader.
+      // the pool queue gets every frame, as in loggerd
+      type = s->scene.frontview ? VISION_STREAM_YUV_FRONT : VISION_STREAM_YUV;
+      tbuffer = false;
+    }
+#endif
+    int err = visionstream_init(&s->stream, type, tbuffer, nullptr);
     if (err == 0) {
       ui_init_vision(s);
       s->vision_connected = true;
@@ -92,9 +112,16 @@ void ui_update_vision(UIState *s) {
       .fd = s->stream.ipc_fd,
       .events = POLLOUT,
     }};
+    uint64_t t = nanos_since_boot();
     int ret = poll(fds, 1, 100);
+    s->vision_wait_end = nanos_since_boot();
+    s->metrics.vision_wait_ns += s->vision_wait_end - t;
     if (ret > 0) {
       if (!visionstream_get(&s->stream, nullptr)) goto destroy;
+      if (s->frame_pending) {
+        s->metrics.dropped++;
+      }
+      s->frame_pending = true;
     }
   }
 
@@ -105,50 +132,50 @@ destroy:
   s->vision_connected = false;
 }
 
-static inline void fill_path_points(const cereal::ModelData::PathData::Reader &path, float *points) {
-  const capnp::List<float>::Reader &poly = path.getPoly();
-  for (int i = 0; i < path.getValidLen(); i++) {
-    points[i] = poly[0] * (i * i * i) + poly[1] * (i * i) + poly[2] * i + poly[3];
-  }
+static inline bool service_updated(UIState *s, UIService service) {
+  return s->snapshot.rcv_count[service] != s->rcv_count[service];
 }
 
-void update_sockets(UIState *s) {
+static inline uint64_t since_rcv(UIState *s, UIService service, uint64_t now) {
+  return now - s->snapshot.rcv_time[service];
+}
+
+// applies what changed in the latest snapshot to the scene. returns whether there was one
+static bool update_snapshot(UIState *s) {
 
   UIScene &scene = s->scene;
-  SubMaster &sm = *(s->sm);
+  const UISnapshot &snap = s->snapshot;
 
-  // poll sockets
-  if (sm.update(0) == 0){
-    return;
+  if (s->ingest->snapshots.read(&s->snapshot, &s->snapshot_seq) == 0) {
+    return false;
   }
 
-  if (s->started && sm.updated("controlsState")) {
-    auto event = sm["controlsState"];
-    scene.controls_state = event.getControlsState();
+  if (s->started && service_updated(s, UI_SERVICE_CONTROLS_STATE)) {
+    scene.controls_state = snap.controls_state;
 
     // TODO: the alert stuff shouldn't be handled here
-    auto alert_sound = scene.controls_state.getAlertSound();
-    if (scene.alert_type.compare(scene.controls_state.getAlertType()) != 0) {
+    auto alert_sound = scene.controls_state.alert_sound;
+    if (scene.alert_type.compare(scene.controls_state.alert_type) != 0) {
       if (alert_sound == AudibleAlert::NONE) {
         s->sound->stop();
       } else {
         s->sound->play(alert_sound);
       }
     }
-    scene.alert_text1 = scene.controls_state.getAlertText1();
-    scene.alert_text2 = scene.controls_state.getAlertText2();
-    scene.alert_size = scene.controls_state.getAlertSize();
-    scene.alert_type = scene.controls_state.getAlertType();
-    auto alertStatus = scene.controls_state.getAlertStatus();
+    scene.alert_text1 = scene.controls_state.alert_text1;
+    scene.alert_text2 = scene.controls_state.alert_text2;
+    scene.alert_size = scene.controls_state.alert_size;
+    scene.alert_type = scene.controls_state.alert_type;
+    auto alertStatus = scene.controls_state.alert_status;
     if (alertStatus == cereal::ControlsState::AlertStatus::USER_PROMPT) {
       s->status = STATUS_WARNING;
     } else if (alertStatus == cereal::ControlsState::AlertStatus::CRITICAL) {
       s->status = STATUS_ALERT;
     } else{
-      s->status = scene.controls_state.getEnabled() ? STATUS_ENGAGED : STATUS_DISENGAGED;
+      s->status = scene.controls_state.enabled ? STATUS_ENGAGED : STATUS_DISENGAGED;
     }
 
-    float alert_blinkingrate = scene.controls_state.getAlertBlinkingRate();
+    float alert_blinkingrate = scene.controls_state.alert_blinking_rate;
     if (alert_blinkingrate > 0.) {
       if (s->alert_blinked) {
         if (s->alert_blinking_alpha > 0.0 && s->alert_blinking_alpha < 1.0) {
@@ -166,95 +193,110 @@ void update_sockets(UIState *s) {
       }
     }
   }
-  if (sm.updated("radarState")) {
-    auto data = sm["radarState"].getRadarState();
-    scene.lead_data[0] = data.getLeadOne();
-    scene.lead_data[1] = data.getLeadTwo();
+  if (service_updated(s, UI_SERVICE_RADAR_STATE)) {
+    scene.lead_data[0] = snap.lead_data[0];
+    scene.lead_data[1] = snap.lead_data[1];
+    scene.track_vertices_dirty = true;
   }
-  if (sm.updated("liveCalibration")) {
+  if (service_updated(s, UI_SERVICE_LIVE_CALIBRATION)) {
     scene.world_objects_visible = true;
-    auto extrinsicl = sm["liveCalibration"].getLiveCalibration().getExtrinsicMatrix();
-    for (int i = 0; i < 3 * 4; i++) {
-      scene.extrinsic_matrix.v[i] = extrinsicl[i];
-    }
+    scene.extrinsic_matrix = snap.extrinsic_matrix;
+    scene.projection = snap.projection;
+    scene.lane_vertices_dirty = true;
+    scene.track_vertices_dirty = true;
   }
-  if (sm.updated("model")) {
-    scene.model = sm["model"].getModel();
-    fill_path_points(scene.model.getPath(), scene.path_points);
-    fill_path_points(scene.model.getLeftLane(), scene.left_lane_points);
-    fill_path_points(scene.model.getRightLane(), scene.right_lane_points);
+  if (service_updated(s, UI_SERVICE_MODEL)) {
+    scene.model = snap.model;
+    scene.lane_vertices_dirty = true;
+    scene.track_vertices_dirty = true;
   }
-  if (sm.updated("uiLayoutState")) {
-    auto data = sm["uiLayoutState"].getUiLayoutState();
-    s->active_app = data.getActiveApp();
-    scene.uilayout_sidebarcollapsed = data.getSidebarCollapsed();
+  if (service_updated(s, UI_SERVICE_UI_LAYOUT_STATE)) {
+    s->active_app = snap.active_app;
+    scene.uilayout_sidebarcollapsed = snap.sidebar_collapsed;
   }
-  if (sm.updated("thermal")) {
-    scene.thermal = sm["thermal"].getThermal();
+  if (service_updated(s, UI_SERVICE_THERMAL)) {
+    scene.thermal = snap.thermal;
   }
-  if (sm.updated("ubloxGnss")) {
-    auto data = sm["ubloxGnss"].getUbloxGnss();
-    if (data.which() == cereal::UbloxGnss::MEASUREMENT_REPORT) {
-      scene.satelliteCount = data.getMeasurementReport().getNumMeas();
-    }
+  if (service_updated(s, UI_SERVICE_UBLOX_GNSS)) {
+    scene.satelliteCount = snap.satellite_count;
   }
-  if (sm.updated("health")) {
-    auto health = sm["health"].getHealth();
-    scene.hwType = health.getHwType();
-    s->ignition = health.getIgnitionLine() || health.getIgnitionCan();
-  } else if ((s->sm->frame - s->sm->rcv_frame("health")) > 5*UI_FREQ) {
-    scene.hwType = cereal::HealthData::HwType::UNKNOWN;
+  if (service_updated(s, UI_SERVICE_HEALTH)) {
+    scene.hwType = snap.hw_type;
+    s->ignition = snap.ignition;
   }
-  if (sm.updated("carParams")) {
-    s->longitudinal_control = sm["carParams"].getCarParams().getOpenpilotLongitudinalControl();
+  if (service_updated(s, UI_SERVICE_CAR_PARAMS)) {
+    s->longitudinal_control = snap.longitudinal_control;
   }
-  if (sm.updated("driverState")) {
-    scene.driver_state = sm["driverState"].getDriverState();
+  if (service_updated(s, UI_SERVICE_DRIVER_STATE)) {
+    scene.driver_state = snap.driver_state;
   }
-  if (sm.updated("dMonitoringState")) {
-    scene.dmonitoring_state = sm["dMonitoringState"].getDMonitoringState();
-    scene.is_rhd = scene.dmonitoring_state.getIsRHD();
-    scene.frontview = scene.dmonitoring_state.getIsPreview();
-  } else if ((sm.frame - sm.rcv_frame("dMonitoringState")) > UI_FREQ/2) {
-    scene.frontview = false;
+  if (service_updated(s, UI_SERVICE_DMONITORING_STATE)) {
+    scene.dmonitoring_state = snap.dmonitoring_state;
+    scene.is_rhd = scene.dmonitoring_state.is_rhd;
+    scene.frontview = scene.dmonitoring_state.is_preview;
   }
 
-  s->started = scene.thermal.getStarted() || scene.frontview;
+  memcpy(s->rcv_count, snap.rcv_count, sizeof(s->rcv_count));
+  if (s->change_time == 0) {
+    s->change_time = snap.publish_time;
+  }
+  return true;
 }
 
-void ui_update(UIState *s) {
+bool ui_update(UIState *s) {
+
+  bool changed = update_snapshot(s);
+  const uint64_t now = nanos_since_boot();
+
+  // the snapshot keeps the last values, time out the ones that stopped coming
+  if (since_rcv(s, UI_SERVICE_HEALTH, now) > 5e9) {
+    s->scene.hwType = cereal::HealthData::HwType::UNKNOWN;
+  }
+  if (s->scene.frontview && since_rcv(s, UI_SERVICE_DMONITORING_STATE, now) > 0.5e9) {
+    s->scene.frontview = false;
+    changed = true;
+  }
+  s->started = s->scene.thermal.started || s->scene.frontview;
 
-  update_sockets(s);
   ui_update_vision(s);
+  if (s->frame_pending) {
+    changed = true;
+    if (s->change_time == 0) {
+      s->change_time = nanos_since_boot();
+    }
+  }
 
   // Handle onroad/offroad transition
   if (!s->started && s->status != STATUS_OFFROAD) {
     s->status = STATUS_OFFROAD;
     s->active_app = cereal::UiLayoutState::App::HOME;
     s->scene.uilayout_sidebarcollapsed = false;
+    changed = true;
   } else if (s->started && s->status == STATUS_OFFROAD) {
     s->status = STATUS_DISENGAGED;
-    s->started_frame = s->sm->frame;
+    s->started_time = now;
 
     s->active_app = cereal::UiLayoutState::App::NONE;
     s->scene.uilayout_sidebarcollapsed = true;
     s->alert_blinked = false;
     s->alert_blinking_alpha = 1.0;
     s->scene.alert_size = cereal::ControlsState::AlertSize::NONE;
+    changed = true;
   }
 
   // Handle controls timeout
-  if (s->started && !s->scene.frontview && ((s->sm)->frame - s->started_frame) > 5*UI_FREQ) {
-    if ((s->sm)->rcv_frame("controlsState") < s->started_frame) {
+  if (s->started && !s->scene.frontview && (now - s->started_time) > 5e9) {
+    if (s->snapshot.rcv_time[UI_SERVICE_CONTROLS_STATE] < s->started_time) {
       // car is started, but controlsState hasn't been seen at all
       s->scene.alert_text1 = "openpilot Unavailable";
       s->scene.alert_text2 = "Waiting for controls to start";
       s->scene.alert_size = cereal::ControlsState::AlertSize::MID;
-    } else if (((s->sm)->frame - (s->sm)->rcv_frame("controlsState")) > 5*UI_FREQ) {
+    } else if (since_rcv(s, UI_SERVICE_CONTROLS_STATE, now) > 5e9) {
       // car is started, but controls is lagging or died
       if (s->scene.alert_text2 != "Controls Unresponsive") {
         s->sound->play(AudibleAlert::CHIME_WARNING_REPEAT);
         LOGE("Controls unresponsive");
+        changed = true;
       }
 
       s->scene.alert_text1 = "TAKE CONTROL IMMEDIATELY";
@@ -265,9 +307,10 @@ void ui_update(UIState *s) {
   }
 
   // Read params
-  if ((s->sm)->frame % (5*UI_FREQ) == 0) {
+  if ((now - s->is_metric_read_time) > 5e9) {
     read_param(&s->is_metric, "IsMetric");
-  } else if ((s->sm)->frame % (6*UI_FREQ) == 0) {
+    s->is_metric_read_time = now;
+  } else if ((now - s->athena_read_time) > 6e9) {
     int param_read = read_param(&s->last_athena_ping, "LastAthenaPingTime");
     if (param_read != 0) { // Failed to read param
       s->scene.athenaStatus = NET_DISCONNECTED;
@@ -276,5 +319,33 @@ void ui_update(UIState *s) {
     } else {
       s->scene.athenaStatus = NET_ERROR;
     }
+    s->athena_read_time = now;
+  }
+
+  return changed;
+}
+
+void ui_wait(UIState *s, int timeout_ms) {
+  s->ingest->snapshots.wait(s->snapshot_seq, timeout_ms);
+}
+
+void ui_frame_drawn(UIState *s) {
+  const uint64_t now = nanos_since_boot();
+  s->metrics.drawn++;
+  // a change that came in while waiting for a vision frame couldn't be drawn before the wait ended
+  const uint64_t due = std::max(s->change_time, s->vision_wait_end);
+  if (s->change_time != 0 && now > due && (now - due) > 1e9 / UI_FREQ) {
+    s->metrics.late++;
+  }
+  s->change_time = 0;
+  s->frame_pending = false;
+
+  if (s->metrics.start_time == 0) {
+    s->metrics.start_time = now;
+  } else if ((now - s->metrics.start_time) > 10e9) {
+    LOG("ui frames drawn %d dropped %d late %d, %.1fms waiting for vision in %.1fs", s->metrics.drawn, s->metrics.dropped,
+        s->metrics.late, s->metrics.vision_wait_ns * 1e-6, (now - s->metrics.start_time) * 1e-9);
+    s->metrics = {};
+    s->metrics.start_time = now;
   }
 }
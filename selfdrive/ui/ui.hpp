@@ -26,6 +26,10 @@
 #include "common/modeldata.h"
 #include "common/params.h"
 #include "sound.hpp"
+#include "geometry.hpp"
+#include "frame_upload.hpp"
+#include "ingest.hpp"
+#include "draw_stats.hpp"
 
 #define COLOR_BLACK nvgRGBA(0, 0, 0, 255)
 #define COLOR_BLACK_ALPHA(x) nvgRGBA(0, 0, 0, x)
@@ -56,6 +60,13 @@ const Rect home_btn = {60, 1080 - 180 - 40, 180, 180};
 
 const int UI_FREQ = 20;   // Hz
 
+// TODO: this is also hardcoded in common/transformations/camera.py
+const mat3 intrinsic_matrix = (mat3){{
+  910., 0., 582.,
+  0., 910., 437.,
+  0.,   0.,   1.
+}};
+
 const int MODEL_PATH_MAX_VERTICES_CNT = 98;
 const int MODEL_LANE_PATH_CNT = 2;
 const int TRACK_POINTS_MAX_CNT = 50 * 2;
@@ -94,7 +105,11 @@ typedef struct UIScene {
   float mpc_y[50];
 
   mat4 extrinsic_matrix;      // Last row is 0 so we can use mat4.
+  FrameProjection projection;
   bool world_objects_visible;
+  // the vertices of the lanes and tracks are recomputed on the next draw
+  bool lane_vertices_dirty;
+  bool track_vertices_dirty;
 
   bool is_rhd;
   bool frontview;
@@ -112,21 +127,14 @@ typedef struct UIScene {
   int satelliteCount;
   NetStatus athenaStatus;
 
-  cereal::ThermalData::Reader thermal;
-  cereal::RadarState::LeadData::Reader lead_data[2];
-  cereal::ControlsState::Reader controls_state;
-  cereal::DriverState::Reader driver_state;
-  cereal::DMonitoringState::Reader dmonitoring_state;
-  cereal::ModelData::Reader model;
-  float left_lane_points[MODEL_PATH_DISTANCE];
-  float path_points[MODEL_PATH_DISTANCE];
-  float right_lane_points[MODEL_PATH_DISTANCE];
+  ThermalSnapshot thermal;
+  LeadSnapshot lead_data[2];
+  ControlsSnapshot controls_state;
+  DriverSnapshot driver_state;
+  DMonitoringSnapshot dmonitoring_state;
+  ModelSnapshot model;
 } UIScene;
 
-typedef struct {
-  float x, y;
-} vertex_data;
-
 typedef struct {
   vertex_data v[MODEL_PATH_MAX_VERTICES_CNT];
   int cnt;
@@ -159,7 +167,11 @@ typedef struct UIState {
   int img_battery_charging;
   int img_network[6];
 
-  SubMaster *sm;
+  UIIngest *ingest;
+  // the last snapshot read and the per service counts already applied to the scene
+  UISnapshot snapshot;
+  uint64_t snapshot_seq;
+  uint64_t rcv_count[UI_SERVICE_COUNT];
 
   Sound *sound;
   UIStatus status;
@@ -172,9 +184,17 @@ typedef struct UIState {
 
   // graphics
   GLuint frame_program;
+#ifdef QCOM
   GLuint frame_texs[UI_BUF_COUNT];
   EGLImageKHR khr[UI_BUF_COUNT];
   void *priv_hnds[UI_BUF_COUNT];
+#else
+  // UI_YUV_FRAMES, draw from the YUV stream instead of the RGB one
+  bool yuv_frames;
+  FrameUpload frame_upload;
+#endif
+  // the stream got a frame that isn't drawn yet
+  bool frame_pending;
 
   GLint frame_pos_loc, frame_texcoord_loc;
   GLint frame_texture_loc, frame_transform_loc;
@@ -183,7 +203,7 @@ typedef struct UIState {
 
   // device state
   bool awake;
-  int awake_timeout;
+  double awake_until;  // millis_since_boot
   std::atomic<float> light_sensor;
 
   bool started;
@@ -191,17 +211,40 @@ typedef struct UIState {
   bool is_metric;
   bool longitudinal_control;
   uint64_t last_athena_ping;
-  uint64_t started_frame;
+  // nanos_since_boot
+  uint64_t started_time;
+  uint64_t is_metric_read_time, athena_read_time;
 
   bool alert_blinked;
   float alert_blinking_alpha;
 
   track_vertices_data track_vertices[2];
   model_path_vertices_data model_path_vertices[MODEL_LANE_PATH_CNT * 2];
+
+  // per stage frame times, only kept by the headless renderer
+  DrawStats *draw_stats;
+
+  // when the oldest change that isn't drawn yet came in, 0 if there is none
+  uint64_t change_time;
+  // when the last wait for a vision frame ended
+  uint64_t vision_wait_end;
+  // drawn frames, vision frames replaced before they were drawn, frames drawn more than a
+  // UI period after what they show came in, or after the vision wait if that ended later,
+  // and the time spent in that wait. logged and reset every few seconds
+  struct {
+    int drawn, dropped, late;
+    uint64_t vision_wait_ns;
+    uint64_t start_time;
+  } metrics;
 } UIState;
 
 void ui_init(UIState *s);
-void ui_update(UIState *s);
+// returns whether there is anything new to draw
+bool ui_update(UIState *s);
+// waits up to timeout_ms for a new snapshot
+void ui_wait(UIState *s, int timeout_ms);
+// call after each ui_draw
+void ui_frame_drawn(UIState *s);
 
 int write_param_float(float param, const char* param_name, bool persistent_param = false);
 template <class T>
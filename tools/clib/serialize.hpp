@@ -0,0 +1,32 @@
+#ifndef SERIALIZE_HPP
+#define SERIALIZE_HPP
+
+#include <stdint.h>
+#include <kj/array.h>
+#include <capnp/common.h>
+
+// rewrite logMonoTime directly in a serialized event, returns false if the layout isn't the simple single root struct
+static inline bool set_log_mono_time(kj::ArrayPtr<capnp::word> words, uint64_t t) {
+  if (words.size() < 2) return false;
+
+  // segment table: (segment count - 1) followed by the segment sizes, padded to a word
+  const uint32_t *table = (const uint32_t *)words.begin();
+  size_t table_words = (table[0] + 3) / 2;
+  if (words.size() < table_words + 1) return false;
+
+  // root pointer is the first word of the first segment
+  uint64_t *seg = (uint64_t *)(words.begin() + table_words);
+  uint64_t root = seg[0];
+  if ((root & 3) != 0) return false;
+
+  int32_t offset = ((int32_t)(root & 0xffffffff)) >> 2;
+  uint16_t data_words = (root >> 32) & 0xffff;
+  uint64_t *data = seg + 1 + offset;
+  if (data_words < 1 || (capnp::word *)(data + 1) > words.end()) return false;
+
+  // logMonoTime is the first field in the data section of Event
+  *data = t;
+  return true;
+}
+
+#endif
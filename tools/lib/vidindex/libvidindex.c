@@ -0,0 +1,710 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "bitstream.h"
+#include "vidindex.h"
+
+#define START_CODE 0x000001
+
+// enough to cover any slice header field we read
+#define MAX_HEADER_SIZE 256
+
+static uint32_t read24be(const uint8_t* ptr) {
+    return (ptr[0] << 16) | (ptr[1] << 8) | ptr[2];
+}
+static void write32le(FILE *of, uint32_t v) {
+  uint8_t va[4] = {
+    v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, (v >> 24) & 0xff
+  };
+  fwrite(va, 1, sizeof(va), of);
+}
+
+// Table 7-1
+enum hevc_nal_type {
+  HEVC_NAL_TYPE_TRAIL_N = 0,
+  HEVC_NAL_TYPE_TRAIL_R = 1,
+  HEVC_NAL_TYPE_TSA_N = 2,
+  HEVC_NAL_TYPE_TSA_R = 3,
+  HEVC_NAL_TYPE_STSA_N = 4,
+  HEVC_NAL_TYPE_STSA_R = 5,
+  HEVC_NAL_TYPE_RADL_N = 6,
+  HEVC_NAL_TYPE_RADL_R = 7,
+  HEVC_NAL_TYPE_RASL_N = 8,
+  HEVC_NAL_TYPE_RASL_R = 9,
+  HEVC_NAL_TYPE_BLA_W_LP = 16,
+  HEVC_NAL_TYPE_BLA_W_RADL = 17,
+  HEVC_NAL_TYPE_BLA_N_LP = 18,
+  HEVC_NAL_TYPE_IDR_W_RADL = 19,
+  HEVC_NAL_TYPE_IDR_N_LP = 20,
+  HEVC_NAL_TYPE_CRA_NUT = 21,
+  HEVC_NAL_TYPE_RSV_IRAP_VCL23 = 23,
+  HEVC_NAL_TYPE_VPS_NUT = 32,
+  HEVC_NAL_TYPE_SPS_NUT = 33,
+  HEVC_NAL_TYPE_PPS_NUT = 34,
+  HEVC_NAL_TYPE_AUD_NUT = 35,
+  HEVC_NAL_TYPE_EOS_NUT = 36,
+  HEVC_NAL_TYPE_EOB_NUT = 37,
+  HEVC_NAL_TYPE_FD_NUT = 38,
+  HEVC_NAL_TYPE_PREFIX_SEI_NUT = 39,
+  HEVC_NAL_TYPE_SUFFIX_SEI_NUT = 40,
+};
+
+// Table 7-7
+enum hevc_slice_type {
+  HEVC_SLICE_B = 0,
+  HEVC_SLICE_P = 1,
+  HEVC_SLICE_I = 2,
+};
+
+// Table 7-1
+enum h264_nal_type {
+  H264_NAL_SLICE           = 1,
+  H264_NAL_DPA             = 2,
+  H264_NAL_DPB             = 3,
+  H264_NAL_DPC             = 4,
+  H264_NAL_IDR_SLICE       = 5,
+  H264_NAL_SEI             = 6,
+  H264_NAL_SPS             = 7,
+  H264_NAL_PPS             = 8,
+  H264_NAL_AUD             = 9,
+  H264_NAL_END_SEQUENCE    = 10,
+  H264_NAL_END_STREAM      = 11,
+  H264_NAL_FILLER_DATA     = 12,
+  H264_NAL_SPS_EXT         = 13,
+  H264_NAL_AUXILIARY_SLICE = 19,
+};
+
+enum h264_slice_type {
+  H264_SLICE_P = 0,
+  H264_SLICE_B = 1,
+  H264_SLICE_I = 2,
+  // ...
+};
+
+struct index_builder {
+  struct vidindex *idx;
+  size_t frames_cap;
+  size_t prefix_cap;
+};
+
+static void add_frame(struct index_builder *b, const struct vidindex_frame *f) {
+  struct vidindex *idx = b->idx;
+  if (idx->num_frames == b->frames_cap) {
+    b->frames_cap = b->frames_cap ? b->frames_cap * 2 : 1024;
+    idx->frames = realloc(idx->frames, b->frames_cap * sizeof(*idx->frames));
+    assert(idx->frames);
+  }
+  idx->frames[idx->num_frames++] = *f;
+}
+
+static void add_prefix(struct index_builder *b, const uint8_t *ptr, size_t len) {
+  struct vidindex *idx = b->idx;
+  if (idx->prefix_len + len > b->prefix_cap) {
+    b->prefix_cap = (idx->prefix_len + len) * 2;
+    idx->prefix = realloc(idx->prefix, b->prefix_cap);
+    assert(idx->prefix);
+  }
+  memcpy(idx->prefix + idx->prefix_len, ptr, len);
+  idx->prefix_len += len;
+}
+
+// find the next start code after ptr, same bounds as the original byte by byte scan
+static const uint8_t *next_start_code(const uint8_t *ptr, const uint8_t *ptr_end) {
+  const uint8_t *p = ptr + 3;
+  while (p < ptr_end - 2) {
+    p = memchr(p, 0x01, (ptr_end - 2) - p);
+    if (p == NULL) break;
+    if (p[-1] == 0 && p[-2] == 0) return p - 2;
+    p++;
+  }
+  return ptr_end - 4 > ptr ? ptr_end - 4 : ptr + 1;
+}
+
+// copy the start of a nal into out with the emulation prevention bytes removed
+static size_t unescape_header(const uint8_t *nal, size_t nal_size, uint8_t *out, size_t out_size) {
+  size_t n = 0;
+  int zeros = 0;
+  for (size_t i = 0; i < nal_size && n < out_size; i++) {
+    // the start code itself is never escaped
+    if (i >= 3 && zeros >= 2 && nal[i] == 0x03) {
+      zeros = 0;
+      continue;
+    }
+    zeros = nal[i] == 0 ? zeros + 1 : 0;
+    out[n++] = nal[i];
+  }
+  return n;
+}
+
+// 7.3.3
+static void hevc_skip_profile_tier_level(struct bitstream *bs, uint32_t max_sub_layers_minus1) {
+  bs_get(bs, 2 + 1 + 5);  // general_profile_space, general_tier_flag, general_profile_idc
+  bs_get(bs, 32);         // general_profile_compatibility_flag
+  bs_get(bs, 4);          // progressive, interlaced, non_packed, frame_only
+  bs_get(bs, 22);         // reserved
+  bs_get(bs, 22);
+  bs_get(bs, 8);          // general_level_idc
+
+  uint32_t profile_present[8] = {0}, level_present[8] = {0};
+  for (int i = 0; i < max_sub_layers_minus1; i++) {
+    profile_present[i] = bs_get(bs, 1);
+    level_present[i] = bs_get(bs, 1);
+  }
+  if (max_sub_layers_minus1 > 0) {
+    for (int i = max_sub_layers_minus1; i < 8; i++) {
+      bs_get(bs, 2);
+    }
+  }
+  for (int i = 0; i < max_sub_layers_minus1; i++) {
+    if (profile_present[i]) {
+      bs_get(bs, 32);
+      bs_get(bs, 32);
+      bs_get(bs, 24);
+    }
+    if (level_present[i]) {
+      bs_get(bs, 8);
+    }
+  }
+}
+
+static int hevc_index(const uint8_t *data, size_t file_size, struct index_builder *b) {
+  const uint8_t* ptr = data;
+  const uint8_t* ptr_end = data + file_size;
+
+  if (ptr[0] != 0) return -1;
+  ptr++;
+  if (read24be(ptr) != START_CODE) return -1;
+
+  // sps
+  uint32_t separate_colour_plane_flag = 0;
+  uint32_t log2_max_pic_order_cnt_lsb = 4;
+
+  // pps
+  uint32_t num_extra_slice_header_bits = 0;
+  uint32_t dependent_slice_segments_enabled_flag = 0;
+  uint32_t output_flag_present_flag = 0;
+
+  // 8.3.1, poc of the previous TemporalId 0 picture
+  int32_t prev_poc_tid0 = 0;
+  bool first_picture = true;
+
+  uint8_t hdr[MAX_HEADER_SIZE];
+
+  while (ptr < ptr_end) {
+    const uint8_t* next = next_start_code(ptr, ptr_end);
+    size_t nal_size = next - ptr;
+    if (nal_size < 6) {
+      break;
+    }
+
+    {
+      size_t hdr_size = unescape_header(ptr, nal_size, hdr, sizeof(hdr));
+      struct bitstream bs = {0};
+      bs_init(&bs, hdr, hdr_size);
+
+      uint32_t start_code = bs_get(&bs, 24);
+      assert(start_code == 0x000001);
+
+      // nal_unit_header
+      uint32_t forbidden_zero_bit = bs_get(&bs, 1);
+      uint32_t nal_unit_type = bs_get(&bs, 6);
+      uint32_t nuh_layer_id = bs_get(&bs, 6);
+      uint32_t nuh_temporal_id_plus1 = bs_get(&bs, 3);
+
+      switch (nal_unit_type) {
+      case HEVC_NAL_TYPE_SPS_NUT: {
+        // 7.3.2.2
+        bs_get(&bs, 4);  // sps_video_parameter_set_id
+        uint32_t sps_max_sub_layers_minus1 = bs_get(&bs, 3);
+        bs_get(&bs, 1);  // sps_temporal_id_nesting_flag
+        hevc_skip_profile_tier_level(&bs, sps_max_sub_layers_minus1);
+        bs_ue(&bs);      // sps_seq_parameter_set_id
+        uint32_t chroma_format_idc = bs_ue(&bs);
+        if (chroma_format_idc == 3) {
+          separate_colour_plane_flag = bs_get(&bs, 1);
+        }
+        bs_ue(&bs);      // pic_width_in_luma_samples
+        bs_ue(&bs);      // pic_height_in_luma_samples
+        if (bs_get(&bs, 1)) {
+          // conformance_window offsets
+          bs_ue(&bs); bs_ue(&bs); bs_ue(&bs); bs_ue(&bs);
+        }
+        bs_ue(&bs);      // bit_depth_luma_minus8
+        bs_ue(&bs);      // bit_depth_chroma_minus8
+        log2_max_pic_order_cnt_lsb = bs_ue(&bs) + 4;
+      }
+        // fallthrough
+      case HEVC_NAL_TYPE_VPS_NUT:
+        add_prefix(b, ptr, nal_size);
+        break;
+      case HEVC_NAL_TYPE_PPS_NUT:
+        // 7.3.2.3
+        bs_ue(&bs);  // pps_pic_parameter_set_id
+        bs_ue(&bs);  // pps_seq_parameter_set_id
+        dependent_slice_segments_enabled_flag = bs_get(&bs, 1);
+        output_flag_present_flag = bs_get(&bs, 1);
+        num_extra_slice_header_bits = bs_get(&bs, 3);
+        add_prefix(b, ptr, nal_size);
+        break;
+      case HEVC_NAL_TYPE_TRAIL_N:
+      case HEVC_NAL_TYPE_TRAIL_R:
+      case HEVC_NAL_TYPE_TSA_N:
+      case HEVC_NAL_TYPE_TSA_R:
+      case HEVC_NAL_TYPE_STSA_N:
+      case HEVC_NAL_TYPE_STSA_R:
+      case HEVC_NAL_TYPE_RADL_N:
+      case HEVC_NAL_TYPE_RADL_R:
+      case HEVC_NAL_TYPE_RASL_N:
+      case HEVC_NAL_TYPE_RASL_R:
+      case HEVC_NAL_TYPE_BLA_W_LP:
+      case HEVC_NAL_TYPE_BLA_W_RADL:
+      case HEVC_NAL_TYPE_BLA_N_LP:
+      case HEVC_NAL_TYPE_IDR_W_RADL:
+      case HEVC_NAL_TYPE_IDR_N_LP:
+      case HEVC_NAL_TYPE_CRA_NUT: {
+        bool irap = nal_unit_type >= HEVC_NAL_TYPE_BLA_W_LP && nal_unit_type <= HEVC_NAL_TYPE_RSV_IRAP_VCL23;
+        bool idr = nal_unit_type == HEVC_NAL_TYPE_IDR_W_RADL || nal_unit_type == HEVC_NAL_TYPE_IDR_N_LP;
+
+        // slice_segment_header
+        uint32_t first_slice_segment_in_pic_flag = bs_get(&bs, 1);
+        if (irap) {
+          uint32_t no_output_of_prior_pics_flag = bs_get(&bs, 1);
+        }
+        uint32_t slice_pic_parameter_set_id = bs_ue(&bs);
+        if (!first_slice_segment_in_pic_flag) {
+          // ...
+          break;
+        }
+
+        if (!dependent_slice_segments_enabled_flag) {
+          for (int i=0; i<num_extra_slice_header_bits; i++) {
+            bs_get(&bs, 1);
+          }
+          uint32_t slice_type = bs_ue(&bs);
+          if (output_flag_present_flag) {
+            bs_get(&bs, 1);  // pic_output_flag
+          }
+          if (separate_colour_plane_flag) {
+            bs_get(&bs, 2);  // colour_plane_id
+          }
+
+          // 8.3.1
+          int32_t poc = 0;
+          if (!idr) {
+            int32_t poc_lsb = bs_get(&bs, log2_max_pic_order_cnt_lsb);
+            int32_t max_poc_lsb = 1 << log2_max_pic_order_cnt_lsb;
+            int32_t poc_msb = 0;
+            // BLA and the first CRA start a new coded video sequence
+            bool no_rasl_output = irap && (nal_unit_type != HEVC_NAL_TYPE_CRA_NUT || first_picture);
+            if (!no_rasl_output) {
+              int32_t prev_lsb = prev_poc_tid0 & (max_poc_lsb - 1);
+              int32_t prev_msb = prev_poc_tid0 - prev_lsb;
+              if (poc_lsb < prev_lsb && (prev_lsb - poc_lsb) >= max_poc_lsb / 2) {
+                poc_msb = prev_msb + max_poc_lsb;
+              } else if (poc_lsb > prev_lsb && (poc_lsb - prev_lsb) > max_poc_lsb / 2) {
+                poc_msb = prev_msb - max_poc_lsb;
+              } else {
+                poc_msb = prev_msb;
+              }
+            }
+            poc = poc_msb + poc_lsb;
+          }
+
+          // RASL, RADL and sub-layer non-reference pictures don't update prevTid0Pic
+          bool sub_layer_non_ref = nal_unit_type <= 14 && (nal_unit_type % 2) == 0;
+          if (nuh_temporal_id_plus1 == 1 && !sub_layer_non_ref &&
+              !(nal_unit_type >= HEVC_NAL_TYPE_RADL_N && nal_unit_type <= HEVC_NAL_TYPE_RASL_R)) {
+            prev_poc_tid0 = poc;
+          }
+          first_picture = false;
+
+          struct vidindex_frame f = {
+            .slice_type = slice_type,
+            .nal_type = nal_unit_type,
+            .poc = poc,
+            .keyframe = irap,
+            .offset = ptr - data,
+          };
+          add_frame(b, &f);
+        }
+
+        break;
+      }
+      }
+    }
+
+    ptr = next;
+  }
+  return 0;
+}
+
+static int h264_index(const uint8_t *data, size_t file_size, struct index_builder *b) {
+  const uint8_t* ptr = data;
+  const uint8_t* ptr_end = data + file_size;
+
+  if (ptr[0] != 0) return -1;
+  ptr++;
+  if (read24be(ptr) != START_CODE) return -1;
+
+  uint32_t sps_log2_max_frame_num_minus4 = 0;
+
+  uint8_t hdr[MAX_HEADER_SIZE];
+
+  while (ptr < ptr_end) {
+    const uint8_t* next = next_start_code(ptr, ptr_end);
+    size_t nal_size = next - ptr;
+    if (nal_size < 5) {
+      break;
+    }
+
+    {
+      size_t hdr_size = unescape_header(ptr, nal_size, hdr, sizeof(hdr));
+      struct bitstream bs = {0};
+      bs_init(&bs, hdr, hdr_size);
+
+      uint32_t start_code = bs_get(&bs, 24);
+      assert(start_code == 0x000001);
+
+      // nal_unit_header
+      uint32_t forbidden_zero_bit = bs_get(&bs, 1);
+      uint32_t nal_ref_idx = bs_get(&bs, 2);
+      uint32_t nal_unit_type = bs_get(&bs, 5);
+
+      switch (nal_unit_type) {
+      case H264_NAL_SPS:
+
+        {
+          uint32_t profile_idx = bs_get(&bs, 8);
+          uint32_t constraint_sets = bs_get(&bs, 4);
+          uint32_t reserved = bs_get(&bs, 5);
+          uint32_t level_idc = bs_get(&bs, 5);
+          uint32_t seq_parameter_set_id = bs_ue(&bs);
+          sps_log2_max_frame_num_minus4 = bs_ue(&bs);
+        }
+
+        // fallthrough
+      case H264_NAL_PPS:
+        add_prefix(b, ptr, nal_size);
+        break;
+
+      case H264_NAL_SLICE:
+      case H264_NAL_IDR_SLICE: {
+        // slice header
+        uint32_t first_mb_in_slice = bs_ue(&bs);
+        uint32_t slice_type = bs_ue(&bs);
+        uint32_t pic_parameter_set_id = bs_ue(&bs);
+
+        uint32_t frame_num = bs_get(&bs, sps_log2_max_frame_num_minus4+4);
+
+        if (first_mb_in_slice == 0) {
+          struct vidindex_frame f = {
+            .slice_type = slice_type,
+            .nal_type = nal_unit_type,
+            .poc = -1,
+            .keyframe = nal_unit_type == H264_NAL_IDR_SLICE,
+            .offset = ptr - data,
+          };
+          add_frame(b, &f);
+        }
+
+        break;
+      }
+
+      }
+
+    }
+
+    ptr = next;
+  }
+  return 0;
+}
+
+int vidindex_build(const char *path, enum vidindex_type type, struct vidindex *out) {
+  memset(out, 0, sizeof(*out));
+  out->type = type;
+
+  int fd = open(path, O_RDONLY, 0);
+  if (fd < 0) return -1;
+
+  off_t file_size = lseek(fd, 0, SEEK_END);
+  lseek(fd, 0, SEEK_SET);
+  if (file_size <= 4) {
+    close(fd);
+    return -1;
+  }
+
+  const uint8_t* data = (const uint8_t*)mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    close(fd);
+    return -1;
+  }
+  // the whole file is read front to back once
+  madvise((void*)data, file_size, MADV_SEQUENTIAL);
+
+  struct index_builder b = {.idx = out};
+  int err;
+  if (type == VIDINDEX_HEVC) {
+    err = hevc_index(data, file_size, &b);
+  } else {
+    err = h264_index(data, file_size, &b);
+  }
+  out->file_size = file_size;
+
+  munmap((void*)data, file_size);
+  close(fd);
+
+  if (err != 0) vidindex_free(out);
+  return err;
+}
+
+void vidindex_free(struct vidindex *idx) {
+  free(idx->frames);
+  free(idx->prefix);
+  idx->frames = NULL;
+  idx->prefix = NULL;
+  idx->num_frames = 0;
+  idx->prefix_len = 0;
+}
+
+int vidindex_gop_range(const struct vidindex *idx, size_t frame, uint64_t *start, uint64_t *end) {
+  if (frame >= idx->num_frames) return -1;
+
+  size_t first = frame;
+  while (first > 0 && !idx->frames[first].keyframe) first--;
+
+  size_t last = frame + 1;
+  while (last < idx->num_frames && !idx->frames[last].keyframe) last++;
+
+  *start = idx->frames[first].offset;
+  *end = last < idx->num_frames ? idx->frames[last].offset : idx->file_size;
+  return 0;
+}
+
+void vidindex_write_legacy(const struct vidindex *idx, FILE *of_prefix, FILE *of_index) {
+  fwrite(idx->prefix, 1, idx->prefix_len, of_prefix);
+  for (size_t i = 0; i < idx->num_frames; i++) {
+    write32le(of_index, idx->frames[i].slice_type);
+    write32le(of_index, idx->frames[i].offset);
+  }
+  write32le(of_index, -1);
+  write32le(of_index, idx->file_size);
+}
+
+// cache
+
+struct cache_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t type;
+  uint32_t frame_size;
+  uint64_t file_size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t num_frames;
+  uint64_t prefix_len;
+};
+
+void vidindex_cache_path(const char *path, const char *cache_dir, char *out, size_t out_size) {
+  char default_dir[PATH_MAX];
+  if (cache_dir == NULL) {
+    cache_dir = getenv("VIDINDEX_CACHE");
+  }
+  if (cache_dir == NULL) {
+    // next to the python index cache in tools/lib/cache.py
+    const char *home = getenv("HOME");
+    snprintf(default_dir, sizeof(default_dir), "%s/.commacache/vidindex", home ? home : "/tmp");
+    cache_dir = default_dir;
+  }
+
+  char abs_path[PATH_MAX];
+  if (realpath(path, abs_path) == NULL) {
+    snprintf(abs_path, sizeof(abs_path), "%s", path);
+  }
+  for (char *c = abs_path; *c; c++) {
+    if (*c == '/') *c = '_';
+  }
+  snprintf(out, out_size, "%s/%s.vidx", cache_dir, abs_path);
+}
+
+static void mkdirs(const char *path) {
+  char tmp[PATH_MAX];
+  snprintf(tmp, sizeof(tmp), "%s", path);
+  for (char *p = tmp + 1; *p; p++) {
+    if (*p == '/') {
+      *p = 0;
+      mkdir(tmp, 0777);
+      *p = '/';
+    }
+  }
+}
+
+static bool fill_header(const char *path, enum vidindex_type type, struct cache_header *h) {
+  struct stat st;
+  if (stat(path, &st) != 0) return false;
+
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, "VIDX", 4);
+  h->version = VIDINDEX_CACHE_VERSION;
+  h->type = type;
+  h->frame_size = sizeof(struct vidindex_frame);
+  h->file_size = st.st_size;
+  h->mtime_sec = st.st_mtim.tv_sec;
+  h->mtime_nsec = st.st_mtim.tv_nsec;
+  return true;
+}
+
+static int cache_read(const char *cache_path, const struct cache_header *want, struct vidindex *out) {
+  FILE *f = fopen(cache_path, "rb");
+  if (f == NULL) return -1;
+
+  int err = -1;
+  struct cache_header h;
+  if (fread(&h, sizeof(h), 1, f) != 1) goto done;
+  if (memcmp(h.magic, want->magic, 4) != 0 || h.version != want->version || h.type != want->type ||
+      h.frame_size != want->frame_size || h.file_size != want->file_size ||
+      h.mtime_sec != want->mtime_sec || h.mtime_nsec != want->mtime_nsec) {
+    goto done;
+  }
+
+  memset(out, 0, sizeof(*out));
+  out->type = h.type;
+  out->file_size = h.file_size;
+  out->num_frames = h.num_frames;
+  out->prefix_len = h.prefix_len;
+  out->frames = malloc(h.num_frames * sizeof(struct vidindex_frame) + 1);
+  out->prefix = malloc(h.prefix_len + 1);
+  assert(out->frames && out->prefix);
+  if (fread(out->frames, sizeof(struct vidindex_frame), h.num_frames, f) != h.num_frames ||
+      fread(out->prefix, 1, h.prefix_len, f) != h.prefix_len) {
+    vidindex_free(out);
+    goto done;
+  }
+  err = 0;
+
+done:
+  fclose(f);
+  return err;
+}
+
+static void cache_write(const char *cache_path, const struct cache_header *hdr, const struct vidindex *idx) {
+  mkdirs(cache_path);
+
+  // write to a temp file and rename so readers never see a partial entry
+  char tmp_path[PATH_MAX];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%d.%lu", cache_path, getpid(), (unsigned long)pthread_self());
+  FILE *f = fopen(tmp_path, "wb");
+  if (f == NULL) return;
+
+  struct cache_header h = *hdr;
+  h.num_frames = idx->num_frames;
+  h.prefix_len = idx->prefix_len;
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+            fwrite(idx->frames, sizeof(struct vidindex_frame), idx->num_frames, f) == idx->num_frames &&
+            fwrite(idx->prefix, 1, idx->prefix_len, f) == idx->prefix_len;
+  ok = (fclose(f) == 0) && ok;
+
+  if (!ok || rename(tmp_path, cache_path) != 0) {
+    unlink(tmp_path);
+  }
+}
+
+int vidindex_build_cached(const char *path, enum vidindex_type type, const char *cache_dir, struct vidindex *out) {
+  struct cache_header h;
+  if (!fill_header(path, type, &h)) return -1;
+
+  char cache_path[PATH_MAX];
+  vidindex_cache_path(path, cache_dir, cache_path, sizeof(cache_path));
+  if (cache_read(cache_path, &h, out) == 0) {
+    return 0;
+  }
+
+  int err = vidindex_build(path, type, out);
+  if (err == 0) {
+    cache_write(cache_path, &h, out);
+  }
+  return err;
+}
+
+// parallel
+
+struct build_many_state {
+  const char **paths;
+  size_t num_paths;
+  enum vidindex_type type;
+  const char *cache_dir;
+  struct vidindex *outs;
+  int *errs;
+
+  pthread_mutex_t lock;
+  size_t next;
+  int failures;
+};
+
+static void* build_many_thread(void *arg) {
+  struct build_many_state *s = arg;
+  while (true) {
+    pthread_mutex_lock(&s->lock);
+    size_t i = s->next++;
+    pthread_mutex_unlock(&s->lock);
+    if (i >= s->num_paths) break;
+
+    int err;
+    if (s->cache_dir != NULL && strcmp(s->cache_dir, "") == 0) {
+      // empty cache dir disables the cache
+      err = vidindex_build(s->paths[i], s->type, &s->outs[i]);
+    } else {
+      err = vidindex_build_cached(s->paths[i], s->type, s->cache_dir, &s->outs[i]);
+    }
+    s->errs[i] = err;
+    if (err != 0) {
+      pthread_mutex_lock(&s->lock);
+      s->failures++;
+      pthread_mutex_unlock(&s->lock);
+    }
+  }
+  return NULL;
+}
+
+int vidindex_build_many(const char **paths, size_t num_paths, enum vidindex_type type,
+                        const char *cache_dir, int num_threads, struct vidindex *outs, int *errs) {
+  struct build_many_state s = {
+    .paths = paths,
+    .num_paths = num_paths,
+    .type = type,
+    .cache_dir = cache_dir,
+    .outs = outs,
+    .errs = errs,
+  };
+  pthread_mutex_init(&s.lock, NULL);
+
+  if (num_threads <= 0) {
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (num_threads > num_paths) num_threads = num_paths;
+  if (num_threads < 1) num_threads = 1;
+
+  pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+  assert(threads);
+  for (int i = 0; i < num_threads; i++) {
+    int err = pthread_create(&threads[i], NULL, build_many_thread, &s);
+    assert(err == 0);
+  }
+  for (int i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  pthread_mutex_destroy(&s.lock);
+
+  return s.failures;
+}
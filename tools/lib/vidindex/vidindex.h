@@ -0,0 +1,61 @@
+#ifndef VIDINDEX_H
+#define VIDINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VIDINDEX_CACHE_VERSION 1
+
+enum vidindex_type {
+  VIDINDEX_HEVC = 0,
+  VIDINDEX_H264 = 1,
+};
+
+struct vidindex_frame {
+  uint32_t slice_type;
+  uint32_t nal_type;
+  // picture order count, hevc only. -1 for h264
+  int32_t poc;
+  // a frame can be decoded starting here with only the global prefix
+  uint32_t keyframe;
+  uint64_t offset;
+};
+
+struct vidindex {
+  enum vidindex_type type;
+  uint64_t file_size;
+  size_t num_frames;
+  struct vidindex_frame *frames;
+  // vps/sps/pps (or sps/pps) needed to start decoding anywhere
+  size_t prefix_len;
+  uint8_t *prefix;
+};
+
+// parse a whole file. returns 0 on success
+int vidindex_build(const char *path, enum vidindex_type type, struct vidindex *out);
+// same as vidindex_build, but goes through the on disk cache in cache_dir (NULL for the default)
+int vidindex_build_cached(const char *path, enum vidindex_type type, const char *cache_dir, struct vidindex *out);
+// index many files on num_threads workers. errs[i] is the result for paths[i]. returns the number of failures
+int vidindex_build_many(const char **paths, size_t num_paths, enum vidindex_type type,
+                        const char *cache_dir, int num_threads, struct vidindex *outs, int *errs);
+void vidindex_free(struct vidindex *idx);
+
+// byte range [start, end) of the GOP containing frame. returns 0 on success
+int vidindex_gop_range(const struct vidindex *idx, size_t frame, uint64_t *start, uint64_t *end);
+
+// the original (slice_type, offset) uint32 pairs and prefix blob read by tools/lib/framereader.py
+void vidindex_write_legacy(const struct vidindex *idx, FILE *of_prefix, FILE *of_index);
+
+// the cache file used for path, written into out
+void vidindex_cache_path(const char *path, const char *cache_dir, char *out, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -84,13 +84,13 @@ void LogReader::mergeEvents(int dled) {
       capnp::FlatArrayMessageReader cmsg = capnp::FlatArrayMessageReader(amsg);
 
       // this needed? it is
-      capnp::FlatArrayMessageReader *tmsg =
-        new capnp::FlatArrayMessageReader(kj::arrayPtr(amsg.begin(), cmsg.getEnd()));
+      auto words = kj::arrayPtr((capnp::word*)amsg.begin(), (capnp::word*)cmsg.getEnd());
+      capnp::FlatArrayMessageReader *tmsg = new capnp::FlatArrayMessageReader(words);
 
       amsg = kj::arrayPtr(cmsg.getEnd(), amsg.end());
 
       cereal::Event::Reader event = tmsg->getRoot<cereal::Event>();
-      events_local.insert(event.getLogMonoTime(), event);
+      events_local.insert(event.getLogMonoTime(), {event, words});
 
       // hack
       // TODO: rewrite with callback
@@ -38,7 +38,13 @@ private:
   QString file;
 };
 
-typedef QMultiMap<uint64_t, cereal::Event::Reader> Events;
+// an event along with the serialized words backing it in the log buffer
+struct EventRef {
+  cereal::Event::Reader event;
+  kj::ArrayPtr<capnp::word> words;
+};
+
+typedef QMultiMap<uint64_t, EventRef> Events;
 
 class LogReader : public FileReader {
 Q_OBJECT
@@ -1,5 +1,6 @@
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <yaml-cpp/yaml.h>
 #include <capnp/dynamic.h>
 #include <capnp/schema.h>
@@ -9,6 +10,7 @@
 #include "cereal/gen/cpp/log.capnp.c++"
 
 #include "Unlogger.hpp"
+#include "serialize.hpp"
 
 #include <stdint.h>
 #include <time.h>
@@ -23,7 +25,6 @@ static inline uint64_t nanos_since_boot() {
   return t.tv_sec * 1000000000ULL + t.tv_nsec;
 }
 
-
 Unlogger::Unlogger(Events *events_, QReadWriteLock* events_lock_, QMap<int, FrameReader*> *frs_, int seek)
   : events(events_), events_lock(events_lock_), frs(frs_) {
   ctx = Context::create();
@@ -31,6 +32,11 @@ Unlogger::Unlogger(Events *events_, QReadWriteLock* events_lock_, QMap<int, Fram
 
   seek_request = seek*1e9;
 
+  const char *speed_env = getenv("SPEED");
+  if (speed_env != NULL) {
+    setSpeed(atof(speed_env));
+  }
+
   QStringList block = QString(getenv("BLOCK")).split(",");
   qDebug() << "blocklist" << block;
 
@@ -69,11 +75,33 @@ Unlogger::Unlogger(Events *events_, QReadWriteLock* events_lock_, QMap<int, Fram
 
         //qDebug() << "here" << tname.c_str() << type << cereal::Event::CONTROLS_STATE;
         socks.insert(type, sock);
+        sock_names.insert(type, name);
       }
     }
   }
 }
 
+void Unlogger::setSpeed(float speed_) {
+  if (speed_ <= 0) {
+    speed = 0;
+    qDebug() << "running unthrottled";
+  } else {
+    speed = std::min(std::max(speed_, 0.1f), 100.0f);
+    qDebug() << "running at" << speed << "x";
+  }
+}
+
+void Unlogger::reportRate(uint64_t elapsed_ns) {
+  double secs = elapsed_ns * 1e-9;
+  uint64_t total = 0;
+  for (auto it = sent_count.begin(); it != sent_count.end(); ++it) {
+    qDebug() << qPrintable(QString("%1").arg(sock_names[it.key()].c_str(), -24)) << it.value() / secs << "msgs/sec";
+    total += it.value();
+  }
+  qDebug() << "total" << total / secs << "msgs/sec";
+  sent_count.clear();
+}
+
 void Unlogger::process() {
   qDebug() << "hello from unlogger thread";
   while (events->size() == 0) {
@@ -95,6 +123,7 @@ void Unlogger::process() {
   timer.start();
 
   uint64_t last_elapsed = 0;
+  uint64_t last_report = timer.nsecsElapsed();
 
   // loops
   while (1) {
@@ -106,7 +135,7 @@ void Unlogger::process() {
     while (eit != events->end()) {
       while (paused) {
         QThread::usleep(1000);
-        t0 = eit->getLogMonoTime();
+        t0 = eit.key();
         t0r = timer.nsecsElapsed();
       }
 
@@ -128,59 +157,76 @@ void Unlogger::process() {
         last_elapsed = tc;
       }
 
-      auto e = *eit;
+      uint64_t now = timer.nsecsElapsed();
+      if (now - last_report > 5e9) {
+        reportRate(now - last_report);
+        last_report = now;
+      }
+
+      auto e = eit->event;
       auto type = e.which();
-      uint64_t tm = e.getLogMonoTime();
+      uint64_t tm = eit.key();
       auto it = socks.find(type);
       tc = tm;
       if (it != socks.end()) {
-        long etime = tm-t0;
-        long rtime = timer.nsecsElapsed() - t0r;
-        long us_behind = ((etime-rtime)*1e-3)+0.5;
-        if (us_behind > 0) {
-          if (us_behind > 1e6) {
-            qWarning() << "OVER ONE SECOND BEHIND, HACKING" << us_behind;
-            us_behind = 0;
-            t0 = tm;
-            t0r = timer.nsecsElapsed();
+        if (speed > 0) {
+          long etime = (tm-t0) / speed;
+          long rtime = timer.nsecsElapsed() - t0r;
+          long us_behind = ((etime-rtime)*1e-3)+0.5;
+          if (us_behind > 0) {
+            if (us_behind > 1e6) {
+              qWarning() << "OVER ONE SECOND BEHIND, HACKING" << us_behind;
+              us_behind = 0;
+              t0 = tm;
+              t0r = timer.nsecsElapsed();
+            }
+            QThread::usleep(us_behind);
+            //qDebug() << "sleeping" << us_behind << etime << timer.nsecsElapsed();
           }
-          QThread::usleep(us_behind);
-          //qDebug() << "sleeping" << us_behind << etime << timer.nsecsElapsed();
         }
 
-        capnp::MallocMessageBuilder msg;
-        msg.setRoot(e);
-
-        auto ee = msg.getRoot<cereal::Event>();
-        ee.setLogMonoTime(nanos_since_boot());
-
-        if (e.which() == cereal::Event::FRAME) {
-          auto fr = msg.getRoot<cereal::Event>().getFrame();
-
+        // frames with a decoded image need the RGB data injected, which means reserializing
+        uint8_t *frame_data = NULL;
+        int frame_size = 0;
+        if (type == cereal::Event::FRAME) {
           // TODO: better way?
-          auto it = eidx.find(fr.getFrameId());
-          if (it != eidx.end()) {
-            auto pp = *it;
-            //qDebug() << fr.getFrameId() << pp;
+          auto fit = eidx.find(e.getFrame().getFrameId());
+          if (fit != eidx.end()) {
+            auto pp = *fit;
+            //qDebug() << e.getFrame().getFrameId() << pp;
 
             if (frs->find(pp.first) != frs->end()) {
               auto frm = (*frs)[pp.first];
-              auto data = frm->get(pp.second);
-              if (data != NULL) {
-                fr.setImage(kj::arrayPtr(data, frm->getRGBSize()));
-              }
+              frame_data = frm->get(pp.second);
+              frame_size = frm->getRGBSize();
             }
           }
         }
 
-        auto words = capnp::messageToFlatArray(msg);
-        auto bytes = words.asBytes();
+        if (frame_data == NULL && set_log_mono_time(eit->words, nanos_since_boot())) {
+          // publish straight out of the log buffer
+          auto bytes = eit->words.asBytes();
+          (*it)->send((char*)bytes.begin(), bytes.size());
+        } else {
+          capnp::MallocMessageBuilder msg;
+          msg.setRoot(e);
+
+          auto ee = msg.getRoot<cereal::Event>();
+          ee.setLogMonoTime(nanos_since_boot());
 
-        // TODO: Can PubSocket take a const char?
-        (*it)->send((char*)bytes.begin(), bytes.size());
+          if (frame_data != NULL) {
+            ee.getFrame().setImage(kj::arrayPtr(frame_data, frame_size));
+          }
+
+          auto words = capnp::messageToFlatArray(msg);
+          auto bytes = words.asBytes();
+
+          // TODO: Can PubSocket take a const char?
+          (*it)->send((char*)bytes.begin(), bytes.size());
+        }
+        sent_count[type]++;
       }
       ++eit;
     }
   }
 }
-
@@ -15,6 +15,8 @@ Q_OBJECT
     void setSeekRequest(uint64_t seek_request_) { seek_request = seek_request_; }
     void setPause(bool pause) { paused = pause; }
     void togglePause() { paused = !paused; }
+    // playback speed relative to realtime, <= 0 runs unthrottled
+    void setSpeed(float speed_);
     QMap<int, QPair<int, int> > eidx;
   public slots:
     void process();
@@ -26,10 +28,14 @@ Q_OBJECT
     QReadWriteLock *events_lock;
     QMap<int, FrameReader*> *frs;
     QMap<int, PubSocket*> socks;
+    QMap<int, std::string> sock_names;
+    QMap<int, uint64_t> sent_count;
+    void reportRate(uint64_t elapsed_ns);
     Context *ctx;
     uint64_t tc = 0;
     uint64_t seek_request = 0;
     bool paused = false;
+    float speed = 1.0;
 };
 
 #endif
@@ -177,12 +177,14 @@ void Window::paintEvent(QPaintEvent *event) {
 
     int lt = -1;
     int lvv = 0;
-    for (auto e : events) {
+    for (auto it = events.begin(); it != events.end(); ++it) {
+      // the unlogger rewrites logMonoTime in place, so use the key for the logged time
+      auto e = it->event;
       auto type = e.which();
-      //printf("%lld %d\n", e.getLogMonoTime()-t0, type);
+      //printf("%lld %d\n", it.key()-t0, type);
       if (type == cereal::Event::CONTROLS_STATE) {
         auto controlsState = e.getControlsState();
-        uint64_t t = (e.getLogMonoTime()-t0);
+        uint64_t t = (it.key()-t0);
         float vEgo = controlsState.getVEgo();
         int enabled = controlsState.getState() == cereal::ControlsState::OpenpilotState::ENABLED;
         int rt = timeToPixel(t); // 250 ms per pixel
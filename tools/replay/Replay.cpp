@@ -0,0 +1,304 @@
+#include "Replay.hpp"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include <bzlib.h>
+#include <capnp/schema.h>
+
+#include "common/timing.h"
+#include "common/swaglog.h"
+#include "services.h"
+
+#include "serialize.hpp"
+
+static bool ends_with(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// reads a whole log into word aligned memory, decompressing it if needed
+static kj::Array<capnp::word> read_log(const std::string &fn) {
+  FILE *f = fopen(fn.c_str(), "rb");
+  if (f == NULL) return nullptr;
+
+  std::string dat;
+  char buf[1 << 16];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+    dat.append(buf, len);
+  }
+  fclose(f);
+
+  if (ends_with(fn, ".bz2")) {
+    bz_stream bs = {0};
+    int ret = BZ2_bzDecompressInit(&bs, 0, 0);
+    if (ret != BZ_OK) return nullptr;
+
+    std::string out;
+    out.resize(std::max(dat.size() * 5, sizeof(buf)));
+    bs.next_in = (char *)dat.data();
+    bs.avail_in = dat.size();
+    bs.next_out = &out[0];
+    bs.avail_out = out.size();
+    while (true) {
+      unsigned int avail_out = bs.avail_out;
+      ret = BZ2_bzDecompress(&bs);
+      if (ret == BZ_STREAM_END) break;
+      if (ret != BZ_OK) {
+        LOGE("bz2 decompress failed for %s", fn.c_str());
+        break;
+      }
+      if (bs.avail_in == 0 && bs.avail_out == avail_out) {
+        // truncated, like the segment a live route is still writing
+        LOGW("bz2 stream of %s ends early, replaying what's there", fn.c_str());
+        break;
+      }
+      if (bs.avail_out == 0) {
+        size_t used = out.size();
+        out.resize(used * 2);
+        bs.next_out = &out[used];
+        bs.avail_out = out.size() - used;
+      }
+    }
+    out.resize(out.size() - bs.avail_out);
+    BZ2_bzDecompressEnd(&bs);
+    dat.swap(out);
+  }
+
+  auto words = kj::heapArray<capnp::word>(dat.size() / sizeof(capnp::word));
+  memcpy(words.begin(), dat.data(), words.size() * sizeof(capnp::word));
+  return words;
+}
+
+Replay::Replay(const std::vector<ReplaySegment> &segments_, const ReplayOptions &opts_)
+  : segments(segments_), opts(opts_), do_exit(false), seek_request(-1) {
+  if (opts.speed > 0) {
+    opts.speed = std::min(std::max(opts.speed, 0.1f), 100.0f);
+  }
+}
+
+Replay::~Replay() {
+  for (auto &it : pub_socks) delete it.second.sock;
+  for (auto &it : road_cameras) delete it.second;
+  for (auto &it : driver_cameras) delete it.second;
+  delete vision_server;
+  delete ctx;
+}
+
+bool Replay::loadSegment(int segment) {
+  const std::string &fn = segments[segment].log_path;
+  auto words = read_log(fn);
+  if (words.size() == 0) {
+    LOGE("failed to read %s", fn.c_str());
+    return false;
+  }
+
+  kj::ArrayPtr<capnp::word> amsg = words;
+  size_t count = 0;
+  while (amsg.size() > 0) {
+    try {
+      capnp::FlatArrayMessageReader cmsg(amsg);
+      auto msg_words = kj::arrayPtr(amsg.begin(), (capnp::word *)cmsg.getEnd());
+      amsg = kj::arrayPtr((capnp::word *)cmsg.getEnd(), amsg.end());
+
+      cereal::Event::Reader event = cmsg.getRoot<cereal::Event>();
+      events.push_back({event.getLogMonoTime(), event.which(), segment, msg_words});
+      count++;
+
+      if (event.which() == cereal::Event::ENCODE_IDX) {
+        auto ee = event.getEncodeIdx();
+        if (ee.getType() == cereal::EncodeIndex::Type::FULL_H_E_V_C) {
+          road_eidx[ee.getFrameId()] = {segment, (int)ee.getSegmentId()};
+        } else if (ee.getType() == cereal::EncodeIndex::Type::FRONT) {
+          driver_eidx[ee.getFrameId()] = {segment, (int)ee.getSegmentId()};
+        }
+      }
+    } catch (const kj::Exception &e) {
+      // truncated logs end in a partial message
+      LOGW("stopped parsing %s after %zu events: %s", fn.c_str(), count, e.getDescription().cStr());
+      break;
+    }
+  }
+
+  logs.push_back(kj::mv(words));
+  return true;
+}
+
+bool Replay::load() {
+  double t1 = millis_since_boot();
+  for (int i = 0; i < segments.size(); i++) {
+    loadSegment(i);
+  }
+  if (events.size() == 0) return false;
+
+  // logs aren't strictly ordered across processes
+  std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b) {
+    return a.mono_time < b.mono_time;
+  });
+
+  printf("loaded %zu events from %zu segments in %.2f ms\n", events.size(), segments.size(), millis_since_boot() - t1);
+
+  ctx = Context::create();
+  std::map<std::string, cereal::Event::Which> which_by_name;
+  for (auto field : capnp::Schema::from<cereal::Event>().getUnionFields()) {
+    which_by_name[field.getProto().getName()] = (cereal::Event::Which)field.getProto().getDiscriminantValue();
+  }
+
+  for (const auto &it : services) {
+    std::string name = it.name;
+    if (!opts.allow.empty() && opts.allow.count(name) == 0) continue;
+    if (opts.block.count(name) != 0) continue;
+
+    auto w = which_by_name.find(name);
+    if (w == which_by_name.end()) continue;
+
+    PubSocket *sock = PubSocket::create(ctx, name);
+    if (sock == NULL) {
+      LOGE("failed to create socket for %s", name.c_str());
+      continue;
+    }
+    pub_socks[w->second] = {name, sock};
+  }
+
+  if (opts.vipc) {
+    for (int i = 0; i < segments.size(); i++) {
+      if (!segments[i].road_camera_path.empty()) {
+        road_cameras[i] = new CameraReader(segments[i].road_camera_path.c_str());
+      }
+      if (!segments[i].driver_camera_path.empty()) {
+        driver_cameras[i] = new CameraReader(segments[i].driver_camera_path.c_str());
+      }
+    }
+    if (!road_cameras.empty() || !driver_cameras.empty()) {
+      vision_server = new VisionServer();
+      vision_server->start();
+    }
+  }
+  return true;
+}
+
+double Replay::routeSeconds() {
+  if (events.empty()) return 0;
+  return (events.back().mono_time - events.front().mono_time) * 1e-9;
+}
+
+void Replay::publishFrame(const Event &e, VisionStreamType stream, bool road) {
+  capnp::FlatArrayMessageReader cmsg(e.words);
+  cereal::Event::Reader event = cmsg.getRoot<cereal::Event>();
+  auto frame = road ? event.getFrame() : event.getFrontFrame();
+
+  auto &eidx = road ? road_eidx : driver_eidx;
+  auto &cameras = road ? road_cameras : driver_cameras;
+  auto it = eidx.find(frame.getFrameId());
+  if (it == eidx.end()) return;
+  auto cam = cameras.find(it->second.segment);
+  if (cam == cameras.end() || !cam->second->valid()) return;
+
+  CameraReader *cr = cam->second;
+  int buf_idx;
+  uint8_t *dst = vision_server->select(stream, cr->getWidth(), cr->getHeight(), &buf_idx);
+  if (cr->decode(it->second.idx, dst)) {
+    vision_server->dispatch(stream, buf_idx, frame.getFrameId(), frame.getTimestampEof());
+    stats.frames++;
+  }
+}
+
+void Replay::publish(const Event &e) {
+  auto it = pub_socks.find(e.which);
+  if (it == pub_socks.end()) return;
+
+  if (vision_server != NULL) {
+    // frames go out over visionipc before the frame event, like camerad
+    if (e.which == cereal::Event::FRAME) {
+      publishFrame(e, VISION_STREAM_YUV, true);
+    } else if (e.which == cereal::Event::FRONT_FRAME) {
+      publishFrame(e, VISION_STREAM_YUV_FRONT, false);
+    }
+  }
+
+  auto bytes = e.words.asBytes();
+  if (set_log_mono_time(e.words, nanos_since_boot())) {
+    it->second.sock->send((char *)bytes.begin(), bytes.size());
+  } else {
+    capnp::FlatArrayMessageReader cmsg(e.words);
+    capnp::MallocMessageBuilder msg;
+    msg.setRoot(cmsg.getRoot<cereal::Event>());
+    msg.getRoot<cereal::Event>().setLogMonoTime(nanos_since_boot());
+    auto words = capnp::messageToFlatArray(msg);
+    auto out = words.asBytes();
+    it->second.sock->send((char *)out.begin(), out.size());
+  }
+
+  stats.messages++;
+  stats.bytes += bytes.size();
+  stats.service_messages[it->second.name]++;
+}
+
+void Replay::run() {
+  if (events.empty()) return;
+
+  const uint64_t route_start = events.front().mono_time;
+  uint64_t wall_start = nanos_since_boot();
+  uint64_t route_covered = 0;
+  uint64_t t0 = 0, last_tm = 0;
+
+  // adds the route time played since t0, at every seek, resync and end
+  auto cover = [&]() {
+    route_covered += last_tm - t0;
+    t0 = last_tm;
+  };
+
+  auto find_event = [&](double seconds) {
+    uint64_t t = route_start + std::max(seconds, 0.0) * 1e9;
+    return std::lower_bound(events.begin(), events.end(), t, [](const Event &e, uint64_t t) {
+      return e.mono_time < t;
+    });
+  };
+
+  auto eit = find_event(opts.seek);
+  while (!do_exit) {
+    // relative timing is anchored at the first event after every (re)start or seek
+    t0 = last_tm = eit != events.end() ? eit->mono_time : 0;
+    uint64_t t0r = nanos_since_boot();
+
+    for (; eit != events.end() && !do_exit; ++eit) {
+      double seek_to = seek_request.exchange(-1);
+      if (seek_to >= 0) {
+        cover();
+        eit = find_event(seek_to);
+        if (eit == events.end()) break;
+        t0 = last_tm = eit->mono_time;
+        t0r = nanos_since_boot();
+      }
+
+      uint64_t tm = eit->mono_time;
+      if (opts.speed > 0) {
+        int64_t etime = (tm - t0) / opts.speed;
+        int64_t rtime = nanos_since_boot() - t0r;
+        int64_t us_behind = ((etime - rtime) * 1e-3) + 0.5;
+        if (us_behind > 1e6) {
+          // a gap in the log, don't stall on it
+          LOGW("over one second ahead of log time, resyncing");
+          cover();
+          t0 = last_tm = tm;
+          t0r = nanos_since_boot();
+        } else if (us_behind > 0) {
+          usleep(us_behind);
+        }
+      }
+
+      publish(*eit);
+      last_tm = tm;
+    }
+    cover();
+
+    if (!opts.loop || do_exit) break;
+    eit = events.begin();
+  }
+
+  stats.route_seconds = route_covered * 1e-9;
+  stats.wall_seconds = (nanos_since_boot() - wall_start) * 1e-9;
+}
@@ -0,0 +1,107 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <kj/array.h>
+#include <capnp/serialize.h>
+
+#include "messaging.hpp"
+#include "cereal/gen/cpp/log.capnp.h"
+
+#include "VisionServer.hpp"
+
+struct ReplaySegment {
+  std::string log_path;
+  std::string road_camera_path;   // fcamera.hevc, optional
+  std::string driver_camera_path; // dcamera.hevc, optional
+};
+
+struct ReplayOptions {
+  // playback speed relative to realtime, <= 0 runs unthrottled
+  float speed = 1.0;
+  // seconds from the start of the route
+  double seek = 0;
+  bool loop = false;
+  // serve decoded camera frames over visionipc
+  bool vipc = true;
+  // empty allow means all services
+  std::set<std::string> allow;
+  std::set<std::string> block;
+};
+
+struct ReplayStats {
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+  uint64_t frames = 0;
+  // route time covered vs. wall time spent
+  double route_seconds = 0;
+  double wall_seconds = 0;
+  std::map<std::string, uint64_t> service_messages;
+};
+
+class Replay {
+public:
+  Replay(const std::vector<ReplaySegment> &segments, const ReplayOptions &opts);
+  ~Replay();
+
+  // loads and indexes all the logs, returns false if nothing could be read
+  bool load();
+  // publishes until the end of the route, forever in loop mode or until stop() is called
+  void run();
+  void stop() { do_exit = true; }
+  void seek(double seconds) { seek_request = seconds; }
+
+  const ReplayStats &getStats() { return stats; }
+  size_t eventCount() { return events.size(); }
+  double routeSeconds();
+
+private:
+  struct Event {
+    uint64_t mono_time;
+    cereal::Event::Which which;
+    int segment;
+    kj::ArrayPtr<capnp::word> words;
+  };
+
+  struct EncodeIdx {
+    int segment;
+    int idx;
+  };
+
+  struct Service {
+    std::string name;
+    PubSocket *sock;
+  };
+
+  bool loadSegment(int segment);
+  void publish(const Event &e);
+  void publishFrame(const Event &e, VisionStreamType stream, bool road);
+
+  std::vector<ReplaySegment> segments;
+  ReplayOptions opts;
+
+  // backing store for the logs, the events point into these
+  std::vector<kj::Array<capnp::word>> logs;
+  std::vector<Event> events;
+  std::map<uint32_t, EncodeIdx> road_eidx;
+  std::map<uint32_t, EncodeIdx> driver_eidx;
+
+  Context *ctx = NULL;
+  std::map<cereal::Event::Which, Service> pub_socks;
+
+  VisionServer *vision_server = NULL;
+  std::map<int, CameraReader *> road_cameras;
+  std::map<int, CameraReader *> driver_cameras;
+
+  std::atomic<bool> do_exit;
+  std::atomic<double> seek_request;
+  ReplayStats stats;
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include "VisionServer.hpp"
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "common/ipc.h"
+#include "common/swaglog.h"
+
+CameraReader::CameraReader(const char *fn_) : fn(fn_) {
+  av_register_all();
+  if (!open()) {
+    LOGE("failed to open %s", fn.c_str());
+  }
+}
+
+CameraReader::~CameraReader() {
+  close();
+}
+
+bool CameraReader::open() {
+  if (avformat_open_input(&pFormatCtx, fn.c_str(), NULL, NULL) != 0) {
+    return false;
+  }
+  if (avformat_find_stream_info(pFormatCtx, NULL) < 0) {
+    close();
+    return false;
+  }
+
+  auto pCodecCtxOrig = pFormatCtx->streams[0]->codec;
+  auto pCodec = avcodec_find_decoder(pCodecCtxOrig->codec_id);
+  if (pCodec == NULL) {
+    close();
+    return false;
+  }
+
+  pCodecCtx = avcodec_alloc_context3(pCodec);
+  int ret = avcodec_copy_context(pCodecCtx, pCodecCtxOrig);
+  assert(ret == 0);
+  ret = avcodec_open2(pCodecCtx, pCodec, NULL);
+  assert(ret >= 0);
+
+  pFrame = av_frame_alloc();
+  width = pCodecCtx->width;
+  height = pCodecCtx->height;
+  next_idx = 0;
+  return true;
+}
+
+void CameraReader::close() {
+  if (pFrame) av_frame_free(&pFrame);
+  if (pCodecCtx) avcodec_free_context(&pCodecCtx);
+  if (pFormatCtx) avformat_close_input(&pFormatCtx);
+}
+
+bool CameraReader::decode(int idx, uint8_t *dst) {
+  if (idx < next_idx) {
+    // seeked backwards, start over from the first keyframe
+    close();
+    if (!open()) return false;
+  }
+  if (!valid()) return false;
+
+  AVPacket pkt;
+  while (next_idx <= idx) {
+    if (av_read_frame(pFormatCtx, &pkt) < 0) return false;
+    int frame_finished = 0;
+    avcodec_decode_video2(pCodecCtx, pFrame, &frame_finished, &pkt);
+    av_free_packet(&pkt);
+    if (!frame_finished) continue;
+
+    if (next_idx == idx && dst != NULL) {
+      uint8_t *y = dst;
+      uint8_t *u = y + width * height;
+      uint8_t *v = u + (width / 2) * (height / 2);
+      for (int r = 0; r < height; r++) {
+        memcpy(y + r * width, pFrame->data[0] + r * pFrame->linesize[0], width);
+      }
+      for (int r = 0; r < height / 2; r++) {
+        memcpy(u + r * (width / 2), pFrame->data[1] + r * pFrame->linesize[1], width / 2);
+        memcpy(v + r * (width / 2), pFrame->data[2] + r * pFrame->linesize[2], width / 2);
+      }
+    }
+    next_idx++;
+  }
+  return true;
+}
+
+VisionServer::VisionServer() : do_exit(false) {
+}
+
+VisionServer::~VisionServer() {
+  stop();
+  for (auto &s : streams) {
+    if (!s.inited) continue;
+    for (int i = 0; i < REPLAY_YUV_COUNT; i++) {
+      visionbuf_free(&s.bufs[i]);
+    }
+  }
+}
+
+void VisionServer::start() {
+  listen_fd = ipc_bind(VIPC_SOCKET_PATH);
+  assert(listen_fd >= 0);
+  server_thread = std::thread(&VisionServer::serverThread, this);
+}
+
+void VisionServer::stop() {
+  if (do_exit) return;
+  do_exit = true;
+
+  {
+    std::lock_guard<std::mutex> lk(streams_lock);
+    for (auto &s : streams) {
+      if (s.inited) pool_stop(&s.pool);
+    }
+  }
+
+  if (server_thread.joinable()) server_thread.join();
+  for (auto &t : client_threads) t.join();
+  client_threads.clear();
+  if (listen_fd >= 0) close(listen_fd);
+  listen_fd = -1;
+}
+
+uint8_t *VisionServer::select(VisionStreamType type, int width, int height, int *out_idx) {
+  assert(type == VISION_STREAM_YUV || type == VISION_STREAM_YUV_FRONT || type == VISION_STREAM_YUV_WIDE);
+  Stream &s = streams[type];
+
+  {
+    std::lock_guard<std::mutex> lk(streams_lock);
+    if (!s.inited) {
+      s.width = width;
+      s.height = height;
+      s.buf_size = width * height * 3 / 2;
+      for (int i = 0; i < REPLAY_YUV_COUNT; i++) {
+        s.bufs[i] = visionbuf_allocate(s.buf_size);
+      }
+      pool_init(&s.pool, REPLAY_YUV_COUNT);
+      s.inited = true;
+    }
+  }
+  assert(s.width == width && s.height == height);
+
+  int idx = pool_select(&s.pool);
+  *out_idx = idx;
+  return (uint8_t *)s.bufs[idx].addr;
+}
+
+void VisionServer::dispatch(VisionStreamType type, int idx, uint32_t frame_id, uint64_t timestamp_eof) {
+  Stream &s = streams[type];
+  s.metas[idx].frame_id = frame_id;
+  s.metas[idx].timestamp_eof = timestamp_eof;
+  pool_push(&s.pool, idx);
+}
+
+void VisionServer::serverThread() {
+  while (!do_exit) {
+    struct pollfd pfd = {.fd = listen_fd, .events = POLLIN};
+    int ret = poll(&pfd, 1, 100);
+    if (ret < 0) {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      LOGE("poll failed (%d - %d)", ret, errno);
+      break;
+    } else if (ret == 0) {
+      continue;
+    }
+
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) continue;
+    client_threads.emplace_back(&VisionServer::clientThread, this, fd);
+  }
+}
+
+void VisionServer::clientThread(int fd) {
+  struct ClientStream {
+    bool subscribed = false;
+    int bufs_outstanding = 0;
+    PoolQueue *queue = NULL;
+  } cstreams[VISION_STREAM_MAX];
+
+  LOGW("client start fd %d", fd);
+
+  while (!do_exit) {
+    struct pollfd polls[1+VISION_STREAM_MAX] = {{0}};
+    int poll_to_stream[1+VISION_STREAM_MAX] = {0};
+    polls[0].fd = fd;
+    polls[0].events = POLLIN;
+    int num_polls = 1;
+    for (int i = 0; i < VISION_STREAM_MAX; i++) {
+      if (!cstreams[i].subscribed || cstreams[i].bufs_outstanding >= 2) continue;
+      polls[num_polls].fd = poolq_efd(cstreams[i].queue);
+      polls[num_polls].events = POLLIN;
+      poll_to_stream[num_polls] = i;
+      num_polls++;
+    }
+
+    int ret = poll(polls, num_polls, 100);
+    if (ret < 0) {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      LOGE("poll failed (%d - %d)", ret, errno);
+      break;
+    } else if (ret == 0) {
+      continue;
+    }
+
+    if (polls[0].revents) {
+      VisionPacket p;
+      int err = vipc_recv(fd, &p);
+      if (err <= 0) {
+        break;
+      } else if (p.type == VIPC_STREAM_SUBSCRIBE) {
+        VisionStreamType stream_type = p.d.stream_sub.type;
+        if (stream_type != VISION_STREAM_YUV && stream_type != VISION_STREAM_YUV_FRONT && stream_type != VISION_STREAM_YUV_WIDE) {
+          LOGE("replay only serves yuv streams, got subscribe for %d", stream_type);
+          break;
+        }
+
+        // the stream is set up by the first decoded frame
+        Stream &s = streams[stream_type];
+        while (!do_exit) {
+          {
+            std::lock_guard<std::mutex> lk(streams_lock);
+            if (s.inited) break;
+          }
+          usleep(10*1000);
+        }
+        if (do_exit) break;
+
+        VisionPacket rep = {
+          .type = VIPC_STREAM_BUFS,
+          .d = { .stream_bufs = { .type = stream_type }, },
+        };
+        VisionStreamBufs *stream_bufs = &rep.d.stream_bufs;
+        stream_bufs->width = s.width;
+        stream_bufs->height = s.height;
+        stream_bufs->stride = s.width;
+        stream_bufs->buf_len = s.buf_size;
+        rep.num_fds = REPLAY_YUV_COUNT;
+        for (int i = 0; i < rep.num_fds; i++) {
+          rep.fds[i] = s.bufs[i].fd;
+        }
+        // the replay pool only supports queues, tbuffer subscribers get the same in-order delivery
+        cstreams[stream_type].queue = pool_get_queue(&s.pool);
+        cstreams[stream_type].subscribed = true;
+        vipc_send(fd, &rep);
+      } else if (p.type == VIPC_STREAM_RELEASE) {
+        int si = p.d.stream_rel.type;
+        assert(si < VISION_STREAM_MAX);
+        poolq_release(cstreams[si].queue, p.d.stream_rel.idx);
+        cstreams[si].bufs_outstanding--;
+      }
+    }
+
+    for (int i = 1; i < num_polls; i++) {
+      if (!polls[i].revents) continue;
+      int si = poll_to_stream[i];
+      int idx = poolq_pop(cstreams[si].queue);
+      if (idx < 0) continue;
+      cstreams[si].bufs_outstanding++;
+
+      VisionPacket rep = {
+        .type = VIPC_STREAM_ACQUIRE,
+        .d = {.stream_acq = {
+          .type = (VisionStreamType)si,
+          .idx = idx,
+        }},
+      };
+      rep.d.stream_acq.extra = streams[si].metas[idx];
+      vipc_send(fd, &rep);
+    }
+  }
+
+  LOGW("client end fd %d", fd);
+
+  for (int i = 0; i < VISION_STREAM_MAX; i++) {
+    if (cstreams[i].subscribed) pool_release_queue(cstreams[i].queue);
+  }
+  close(fd);
+}
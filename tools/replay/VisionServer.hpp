@@ -0,0 +1,74 @@
+#ifndef VISIONSERVER_HPP
+#define VISIONSERVER_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common/visionipc.h"
+#include "common/visionbuf.h"
+#include "common/buffering.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#define REPLAY_YUV_COUNT 40
+
+// decodes a camera file front to back into I420
+class CameraReader {
+public:
+  CameraReader(const char *fn);
+  ~CameraReader();
+  bool valid() { return pCodecCtx != NULL; }
+  int getWidth() { return width; }
+  int getHeight() { return height; }
+  // decode up to and including frame idx into dst, rewinds if idx is behind
+  bool decode(int idx, uint8_t *dst);
+private:
+  bool open();
+  void close();
+  std::string fn;
+  AVFormatContext *pFormatCtx = NULL;
+  AVCodecContext *pCodecCtx = NULL;
+  AVFrame *pFrame = NULL;
+  int width = 0, height = 0;
+  int next_idx = 0;
+};
+
+// a minimal visionipc server for the yuv streams, so modeld and friends can run without camerad
+class VisionServer {
+public:
+  VisionServer();
+  ~VisionServer();
+  void start();
+  void stop();
+  // returns the next free I420 buffer of the stream, fill it then hand it to the clients with dispatch
+  uint8_t *select(VisionStreamType type, int width, int height, int *out_idx);
+  void dispatch(VisionStreamType type, int idx, uint32_t frame_id, uint64_t timestamp_eof);
+private:
+  struct Stream {
+    bool inited = false;
+    int width = 0, height = 0;
+    size_t buf_size = 0;
+    VisionBuf bufs[REPLAY_YUV_COUNT];
+    VIPCBufExtra metas[REPLAY_YUV_COUNT];
+    Pool pool;
+  };
+  Stream streams[VISION_STREAM_MAX];
+  std::mutex streams_lock;
+
+  std::atomic<bool> do_exit;
+  int listen_fd = -1;
+  std::thread server_thread;
+  std::vector<std::thread> client_threads;
+
+  void serverThread();
+  void clientThread(int fd);
+};
+
+#endif
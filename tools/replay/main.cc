@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <sstream>
+
+#include "Replay.hpp"
+
+static Replay *replay = NULL;
+
+static void set_do_exit(int sig) {
+  if (replay) replay->stop();
+}
+
+static bool file_exists(const std::string &fn) {
+  struct stat st;
+  return stat(fn.c_str(), &st) == 0;
+}
+
+static std::set<std::string> split(const char *s) {
+  std::set<std::string> ret;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (!item.empty()) ret.insert(item);
+  }
+  return ret;
+}
+
+// a segment is either a directory as written by loggerd, or a single rlog file
+static bool find_segment(const std::string &path, ReplaySegment *seg) {
+  if (!file_exists(path)) return false;
+
+  struct stat st;
+  stat(path.c_str(), &st);
+  if (!S_ISDIR(st.st_mode)) {
+    seg->log_path = path;
+    return true;
+  }
+
+  for (auto fn : {"rlog.bz2", "rlog"}) {
+    if (file_exists(path + "/" + fn)) {
+      seg->log_path = path + "/" + fn;
+      break;
+    }
+  }
+  if (file_exists(path + "/fcamera.hevc")) seg->road_camera_path = path + "/fcamera.hevc";
+  if (file_exists(path + "/dcamera.hevc")) seg->driver_camera_path = path + "/dcamera.hevc";
+  return !seg->log_path.empty();
+}
+
+static void usage(const char *name) {
+  printf("usage: %s [options] <segment dir or rlog>...\n", name);
+  printf("  --speed <x>     playback speed from 0.1 to 100, 0 runs unthrottled (default 1)\n");
+  printf("  --seek <s>      start this many seconds into the route\n");
+  printf("  --allow <a,b>   only publish these services\n");
+  printf("  --block <a,b>   don't publish these services\n");
+  printf("  --loop          start over at the end of the route\n");
+  printf("  --no-vipc       don't decode and serve camera frames\n");
+  printf("  --benchmark     replay once unthrottled and report the sustained rate\n");
+}
+
+int main(int argc, char *argv[]) {
+  ReplayOptions opts;
+  bool benchmark = false;
+
+  static struct option long_options[] = {
+    {"speed", required_argument, 0, 's'},
+    {"seek", required_argument, 0, 'k'},
+    {"allow", required_argument, 0, 'a'},
+    {"block", required_argument, 0, 'b'},
+    {"loop", no_argument, 0, 'l'},
+    {"no-vipc", no_argument, 0, 'n'},
+    {"benchmark", no_argument, 0, 'B'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0},
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "s:k:a:b:lnBh", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 's': opts.speed = atof(optarg); break;
+    case 'k': opts.seek = atof(optarg); break;
+    case 'a': opts.allow = split(optarg); break;
+    case 'b': opts.block = split(optarg); break;
+    case 'l': opts.loop = true; break;
+    case 'n': opts.vipc = false; break;
+    case 'B': benchmark = true; break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  std::vector<ReplaySegment> segments;
+  for (int i = optind; i < argc; i++) {
+    ReplaySegment seg;
+    if (!find_segment(argv[i], &seg)) {
+      fprintf(stderr, "no log found in %s\n", argv[i]);
+      return 1;
+    }
+    segments.push_back(seg);
+  }
+  if (segments.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (benchmark) {
+    opts.speed = 0;
+    opts.loop = false;
+  }
+
+  signal(SIGINT, (sighandler_t)set_do_exit);
+  signal(SIGTERM, (sighandler_t)set_do_exit);
+
+  replay = new Replay(segments, opts);
+  if (!replay->load()) {
+    fprintf(stderr, "nothing to replay\n");
+    return 1;
+  }
+  replay->run();
+
+  const ReplayStats &stats = replay->getStats();
+  if (benchmark) {
+    for (auto &it : stats.service_messages) {
+      printf("%-24s %10.1f msgs/sec\n", it.first.c_str(), it.second / stats.wall_seconds);
+    }
+    printf("replayed %lu messages (%.1f MB) and %lu frames in %.2f s\n",
+           stats.messages, stats.bytes / 1e6, stats.frames, stats.wall_seconds);
+    printf("sustained %.1f msgs/sec, %.1f MB/sec, %.1f frames/sec, %.2fx realtime\n",
+           stats.messages / stats.wall_seconds, stats.bytes / 1e6 / stats.wall_seconds,
+           stats.frames / stats.wall_seconds, stats.route_seconds / stats.wall_seconds);
+  }
+
+  delete replay;
+  return 0;
+}